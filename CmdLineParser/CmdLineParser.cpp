@@ -148,11 +148,20 @@ void CmdLineParser::_DisplayUsageInfo(const char *pszFilename) const
     printf("                          Examples: -a0,1,2 and -ag0,0,1,2 are equivalent.\n");
     printf("                                    -ag0,0,1,2,g1,0,1,2 specifies the first three cores in groups 0 and 1.\n");
     printf("                                    -ag0,0,1,2 -ag1,0,1,2 is equivalent.\n");
+    printf("  -a<c|n|l|s|d>         topology affinity - affinitize threads round-robin to processors chosen by policy:\n");
+    printf("                          c: one thread per physical core; SMT siblings only once every core has a thread\n");
+    printf("                          n: spread threads across NUMA nodes\n");
+    printf("                          l: compact threads on the processors sharing one L3 cache\n");
+    printf("                          s: avoid SMT siblings; only the first processor of each physical core\n");
+    printf("                          d: the NUMA node of the device backing each thread's target; the target's\n");
+    printf("                             buffers are allocated from that node too\n");
     printf("  -b<size>[K|M|G]       block size in bytes or KiB/MiB/GiB [default=64K]\n");
     printf("  -B<offs>[K|M|G|b]     base target offset in bytes or KiB/MiB/GiB/blocks [default=0]\n");
     printf("                          (offset from the beginning of the file)\n");
     printf("  -c<size>[K|M|G|b]     create files of the given size.\n");
     printf("                          Size can be stated in bytes or KiB/MiB/GiB/blocks\n");
+    printf("  -c<size>[K|M|G|b],<n> create files of the given size laid out in <n> separate extents, as on an aged\n");
+    printf("                          filesystem. Needs as much free space again while the file is created\n");
     printf("  -C<seconds>           cool down time - duration of the test after measurements finished [default=0s].\n");
     printf("  -D<milliseconds>      Capture IOPs statistics in intervals of <milliseconds>; these are per-thread\n");
     printf("                          per-target: text output provides IOPs standard deviation, XML provides the full\n");
@@ -169,13 +178,55 @@ void CmdLineParser::_DisplayUsageInfo(const char *pszFilename) const
     printf("  -g<bytes per ms>      throughput per-thread per-target throttled to given bytes per millisecond\n");
     printf("                          note that this can not be specified when using completion routines\n");
     printf("                          [default inactive]\n"); 
+    printf("  -G                    group commit log: the threads of the target commit fixed-size records to it,\n");
+    printf("                          each waiting until its record is durable. A commit which finds no append\n");
+    printf("                          in progress appends the records of all threads committed by then in one\n");
+    printf("                          sequential write, padded to the block size (-b) and flushed (see -Yf/-Yd/-Yb)\n");
+    printf("                          unless written through (-Sh); commits arriving meanwhile join the next append.\n");
+    printf("                          The access pattern options (-r, -s, -w, -o, -g) do not apply. Reports the\n");
+    printf("                          commit latency of every record and the records and bytes per append\n");
+    printf("  -Gr<count>            records each thread commits per second, timed from when they are due;\n");
+    printf("                          0 commits the next record as soon as the last is durable [default=0]\n");
+    printf("  -Gs<size>[K|M]        record size [default=512]\n");
+    printf("  -Gb<size>[K|M]        largest append, in bytes of records [default=1M]\n");
+    printf("  -Gd<microseconds>     time an append waits for more records to join it [default=0]\n");
     printf("  -h                    deprecated, see -Sh\n");
     printf("  -i<count>             number of IOs per burst; see -j [default: inactive]\n");
     printf("  -j<milliseconds>      interval in <milliseconds> between issuing IO bursts; see -i [default: inactive]\n");
     printf("  -I<priority>          Set IO priority to <priority>. Available values are: 1-very low, 2-low, 3-normal (default)\n");
+    printf("  -K<c|e|m|s<cycles>>   run an application work stage over the data of every completed I/O:\n");
+    printf("                          c: CRC32C checksum, e: AES encryption pass (AES-NI), m: copy to an\n");
+    printf("                          application buffer, s<cycles>: spin for <cycles> TSC cycles per byte\n");
     printf("  -l                    Use large pages for IO buffers\n");
+    printf("  -lk                   Pre-fault IO buffers and lock them into memory, so that page faults and\n");
+    printf("                          working set trimming do not occur during the test (large pages always are)\n");
     printf("  -L                    measure latency statistics\n");
+    printf("                          with -g or -i/-j, latency is also reported from the time the IO was scheduled\n");
+    printf("                          to be issued, along with the number and duration of schedule slips\n");
+    printf("  -L<N>                 measure latency statistics for one in every <N> I/Os of each thread;\n");
+    printf("                          I/O and byte counts remain exact\n");
+    printf("  -m<size>[K|M|G|b]     rotate each thread's IOs to a target through a buffer working set of <size>\n");
+    printf("                          bytes, so that the buffers are not all resident in the CPU caches (overrides -q)\n");
+    printf("  -mi<size>[K|M|G|b]    as -m, with the working set's blocks interleaved across all NUMA nodes\n");
+    printf("  -M<cdehs>             monitor the load generator and the targets' devices; one or more of:\n");
+    printf("                          c: count TSC cycles spent per I/O in each phase of the worker loop\n");
+    printf("                          d: capture the statistics of the volumes and disks backing each target;\n");
+    printf("                             with -D they are also sampled at every interval\n");
+    printf("                          e: report each worker's CPU time, cycles and context switches per I/O,\n");
+    printf("                             and the page faults taken by the process\n");
+    printf("                          h: read the fixed-function hardware performance counters (instructions,\n");
+    printf("                             core and reference cycles) of each worker's core; requires user mode RDPMC\n");
+    printf("                             with the fixed counters enabled, and affinitized threads (not -n)\n");
+    printf("                          s: estimate how long each worker was runnable but not running (scheduling\n");
+    printf("                             delay); with -D it is also sampled at every interval\n");
     printf("  -n                    disable default affinity (-a)\n");
+    printf("  -N<c>,<s>,<o>,<r>,<u> make each target a directory for metadata operations instead of reads and writes:\n");
+    printf("                          every thread creates (c), stats (s), opens and closes (o), renames (r) and\n");
+    printf("                          deletes (u) empty files of its own, choosing operations by these relative\n");
+    printf("                          weights; each kind of operation gets its own rate and latency histogram.\n");
+    printf("                          Half of the files exist at the start; the rest are removed at the end.\n");
+    printf("                          With -F, every target must be a metadata target\n");
+    printf("  -Nf<count>[,<n>]      files each thread works over, <n> to a subdirectory [default=1000,1000]\n");
     printf("  -o<count>             number of outstanding I/O requests per target per thread\n");
     printf("                          (1=synchronous I/O, unless more than 1 thread is specified with -F)\n");
     printf("                          [default=2]\n");
@@ -183,6 +234,19 @@ void CmdLineParser::_DisplayUsageInfo(const char *pszFilename) const
     printf("                          (ignored if -r is specified, makes sense only with -o2 or greater)\n");
     printf("  -P<count>             enable printing a progress dot after each <count> [default=65536]\n");
     printf("                          completed I/O operations, counted separately by each thread \n");
+    printf("  -q<count>             number of IO buffers per target per thread, shared round-robin by the\n");
+    printf("                          outstanding I/O requests; bounds memory use at high -o [default=one per request]\n");
+    printf("  -Q<count>[,<n>]       make each target a file set: a directory of <count> files, <n> to a subdirectory\n");
+    printf("                          [default n=1000]. Missing files are created before the run. Every I/O goes to\n");
+    printf("                          a random block of a file chosen from the set, opened through a per-thread cache\n");
+    printf("                          of handles; the cost of opening and closing files and the hit ratio of the\n");
+    printf("                          cache are reported. -r, -s, -B, -T and -f do not apply to file sets\n");
+    printf("  -Qs<min>[,<max>]      sizes of the files of a set in bytes or KiB/MiB/GiB/blocks, spread uniformly\n");
+    printf("                          between <min> and <max> in whole blocks [default=one block]\n");
+    printf("  -Qz<skew>             choose files with a Zipf distribution of the given skew, below 1 (0.99 is\n");
+    printf("                          typical) [default=0, uniform]\n");
+    printf("  -Qw                   read or write each chosen file from start to end before choosing the next\n");
+    printf("  -Qh<count>            number of files of a set each thread keeps open [default=64]\n");
     printf("  -r<align>[K|M|G|b]    random I/O aligned to <align> in bytes/KiB/MiB/GiB/blocks (overrides -s)\n");
     printf("  -R<text|xml>          output format. Default is text.\n");
     printf("  -s[i]<size>[K|M|G|b]  sequential stride size, offset between subsequent I/O operations\n");
@@ -202,18 +266,37 @@ void CmdLineParser::_DisplayUsageInfo(const char *pszFilename) const
     printf("                          [default=0] (starting offset = base file offset + (thread number * <offs>)\n");
     printf("                          makes sense only with #threads > 1\n");
     printf("  -v                    verbose mode\n");
+    printf("  -V                    verify data: stamp every written block with its offset, a sequence number and a\n");
+    printf("                          CRC32C, and check them whenever a block is read back. Reports corrupt, misdirected,\n");
+    printf("                          stale and missing blocks. Requires block aligned IO and a buffer per outstanding IO\n");
     printf("  -w<percentage>        percentage of write requests (-w and -w0 are equivalent and result in a read-only workload).\n");
     printf("                        absence of this switch indicates 100%% reads\n");
     printf("                          IMPORTANT: a write test will destroy existing data without a warning\n");
     printf("  -W<seconds>           warm up time - duration of the test before measurements start [default=5s]\n");
     printf("  -x                    use completion routines instead of I/O Completion Ports\n");
     printf("  -X<filepath>          use an XML file for configuring the workload. Cannot be used with other parameters.\n");
+    printf("  -Yw<count>            flush the target after every <count> writes a thread completes\n");
+    printf("  -Yt<milliseconds>     flush the target when a thread has not flushed it for <milliseconds>; with -Yw,\n");
+    printf("                          whichever comes first. Flushes are issued by a helper thread of each worker,\n");
+    printf("                          one at a time, while the worker keeps issuing its IOs, and are timed separately;\n");
+    printf("                          with -L, the latency of the IOs in flight during a flush is also reported\n");
+    printf("  -Yf                   flush data, metadata and the device cache (FlushFileBuffers, like fsync) [default]\n");
+    printf("  -Yd                   flush data and only the metadata needed to read it back (like fdatasync;\n");
+    printf("                          Windows 10 1709 or newer)\n");
+    printf("  -Yb                   only write cached data out to the device, without flushing the device cache;\n");
+    printf("                          for buffered targets, similar to sync_file_range over the whole file\n");
     printf("  -z[seed]              set random seed [with no -z, seed=0; with plain -z, seed is based on system run time]\n");
     printf("\n");
     printf("Write buffers:\n");
     printf("  -Z                        zero buffers used for write tests\n");
     printf("  -Z<size>[K|M|G|b]         use a <size> buffer filled with random data as a source for write operations.\n");
     printf("  -Z<size>[K|M|G|b],<file>  use a <size> buffer filled with data from <file> as a source for write operations.\n");
+    printf("  -Zr                       fill every write with fresh pseudo-random data (vectorized, AVX2 if available);\n");
+    printf("                              unlike -Z<size>, no two writes share content. The fill time is reported\n");
+    printf("                              separately and is not part of the IO latency\n");
+    printf("  -Zc<c>[,<d>]              fill every write with freshly generated data: <c> percent of each 4KiB compresses\n");
+    printf("                              away (50 is 2:1, 75 is 4:1) and <d> percent of the blocks are duplicates of\n");
+    printf("                              a small set of blocks shared by all threads [default d=0]\n");
     printf("\n");
     printf("  By default, the write buffers are filled with a repeating pattern (0, 1, 2, ..., 255, 0, 1, ...)\n");
     printf("\n");
@@ -346,6 +429,29 @@ bool CmdLineParser::_ParseAffinity(const char *arg, TimeSpan *pTimeSpan)
         return true;
     }
 
+    // look for a topology-based policy: -ac, -an, -al, -as, -ad
+    if (*(c + 1) == '\0')
+    {
+        switch (*c)
+        {
+        case 'c':
+            pTimeSpan->SetAffinityPolicy(AffinityPolicy::PhysicalCore);
+            return true;
+        case 'n':
+            pTimeSpan->SetAffinityPolicy(AffinityPolicy::SpreadNodes);
+            return true;
+        case 'l':
+            pTimeSpan->SetAffinityPolicy(AffinityPolicy::CompactL3);
+            return true;
+        case 's':
+            pTimeSpan->SetAffinityPolicy(AffinityPolicy::AvoidSmt);
+            return true;
+        case 'd':
+            pTimeSpan->SetAffinityPolicy(AffinityPolicy::DeviceLocal);
+            return true;
+        }
+    }
+
     // look for the -ag simple case
     if (*c == 'g')
     {
@@ -580,16 +686,31 @@ bool CmdLineParser::_ReadParametersFromCmdLine(const int argc, const char *argv[
             }
             break;
 
-        case 'c':    //create file of the given size
+        case 'c':    //create file of the given size, optionally fragmented into a number of extents
             if (*(arg + 1) != '\0')
             {
                 UINT64 cb;
-                if (_GetSizeInBytes(arg + 1, cb))
+                DWORD dwFragmentCount = 0;
+                bool fFragmentsOk = true;
+                string sArg(arg + 1);
+                size_t iComma = sArg.find(',');
+                if (iComma != sArg.npos)
+                {
+                    //the extent count must be all digits - no sign, no trailing characters
+                    const char *pszCount = sArg.c_str() + iComma + 1;
+                    char *pszEnd;
+                    dwFragmentCount = strtoul(pszCount, &pszEnd, 10);
+                    fFragmentsOk = isdigit((unsigned char)*pszCount) && '\0' == *pszEnd && dwFragmentCount > 0;
+                    sArg.resize(iComma);
+                }
+
+                if (_GetSizeInBytes(sArg.c_str(), cb) && fFragmentsOk)
                 {
                     for (auto i = vTargets.begin(); i != vTargets.end(); i++)
                     {
                         i->SetFileSize(cb);
                         i->SetCreateFile(true);
+                        i->SetFragmentCount(dwFragmentCount);
                     }
                 }
                 else
@@ -740,6 +861,50 @@ bool CmdLineParser::_ReadParametersFromCmdLine(const int argc, const char *argv[
             }
             break;
 
+        case 'G':    //group commit log: -G, -Gr<records per second>, -Gs<record size>, -Gb<batch size>, -Gd<microseconds>
+            {
+                char ch = *(arg + 1);
+                UINT64 ullValue = 0;
+                if ('\0' != ch)
+                {
+                    if ('s' == ch || 'b' == ch)
+                    {
+                        fError = !_GetSizeInBytes(arg + 2, ullValue) || ullValue == 0 || ullValue > MAXDWORD;
+                    }
+                    else if ('r' == ch || 'd' == ch)
+                    {
+                        char *pszEnd = nullptr;
+                        ullValue = strtoul(arg + 2, &pszEnd, 10);
+                        fError = (pszEnd == arg + 2) || ('\0' != *pszEnd);
+                    }
+                    else
+                    {
+                        fError = true;
+                    }
+                }
+
+                for (auto i = vTargets.begin(); !fError && i != vTargets.end(); i++)
+                {
+                    i->SetGroupCommit(true);
+                    switch (ch)
+                    {
+                    case 'r':
+                        i->SetCommitRate(static_cast<DWORD>(ullValue));
+                        break;
+                    case 's':
+                        i->SetCommitRecordSize(static_cast<DWORD>(ullValue));
+                        break;
+                    case 'b':
+                        i->SetCommitBatchSize(static_cast<DWORD>(ullValue));
+                        break;
+                    case 'd':
+                        i->SetCommitDelay(static_cast<DWORD>(ullValue));
+                        break;
+                    }
+                }
+            }
+            break;
+
         case 'h':    //disable both software and hardware caching; now equivalent to -Sh
             for (auto i = vTargets.begin(); i != vTargets.end(); i++)
             {
@@ -801,21 +966,215 @@ bool CmdLineParser::_ReadParametersFromCmdLine(const int argc, const char *argv[
             }
             break;
 
-        case 'l':    //large pages
-            for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+        case 'l':    //large pages, or -lk to pre-fault and lock the buffers in regular pages
+            if ('\0' == *(arg + 1))
             {
-                i->SetUseLargePages(true);
+                for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                {
+                    i->SetUseLargePages(true);
+                }
+            }
+            else if ('k' == *(arg + 1) && '\0' == *(arg + 2))
+            {
+                for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                {
+                    i->SetLockBuffers(true);
+                }
+            }
+            else
+            {
+                fError = true;
             }
             break;
         
+        case 'K':    //application work stage over the data of every completed IO
+            {
+                WorkKernel kernel = WorkKernel::None;
+                DWORD dwCyclesPerByte = 0;
+                switch (*(arg + 1))
+                {
+                case 'c':
+                    kernel = WorkKernel::Crc32c;
+                    break;
+                case 'e':
+                    kernel = WorkKernel::Encrypt;
+                    break;
+                case 'm':
+                    kernel = WorkKernel::Copy;
+                    break;
+                case 's':
+                    kernel = WorkKernel::Spin;
+                    dwCyclesPerByte = atoi(arg + 2);
+                    break;
+                }
+
+                if (kernel == WorkKernel::None ||
+                    (kernel == WorkKernel::Spin && dwCyclesPerByte == 0) ||
+                    (kernel != WorkKernel::Spin && *(arg + 2) != '\0'))
+                {
+                    fError = true;
+                }
+                else
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetWorkKernel(kernel);
+                        i->SetWorkCyclesPerByte(dwCyclesPerByte);
+                    }
+                }
+            }
+            break;
+
         case 'L':    //measure latency
             timeSpan.SetMeasureLatency(true);
+            if ('\0' != *(arg + 1))
+            {
+                int c = atoi(arg + 1);
+                if (c > 0)
+                {
+                    timeSpan.SetLatencySampleRate(c);
+                }
+                else
+                {
+                    fError = true;
+                }
+            }
+            break;
+
+        case 'm':    //rotate IOs through a buffer working set of the given size, -mi interleaves it across NUMA nodes
+            {
+                bool fInterleave = ('i' == *(arg + 1));
+                UINT64 cb;
+                if (_GetSizeInBytes(arg + (fInterleave ? 2 : 1), cb) && (cb > 0))
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetBufferWorkingSetSize(cb);
+                        i->SetInterleaveBuffers(fInterleave);
+                    }
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid buffer working set size passed to -m\n");
+                    fError = true;
+                }
+            }
+            break;
+
+        case 'M':    //monitoring of the load generator
+            if ('\0' == *(arg + 1))
+            {
+                fError = true;
+            }
+            else
+            {
+                while (*(++arg) != '\0')
+                {
+                    switch (*arg)
+                    {
+                    case 'c':
+                        timeSpan.SetProfileCpuCycles(true);
+                        break;
+                    case 'd':
+                        timeSpan.SetDeviceStatistics(true);
+                        break;
+                    case 'e':
+                        timeSpan.SetCpuEfficiency(true);
+                        break;
+                    case 'h':
+                        timeSpan.SetHardwareCounters(true);
+                        break;
+                    case 's':
+                        timeSpan.SetSchedulingDelay(true);
+                        break;
+                    default:
+                        fError = true;
+                        break;
+                    }
+                }
+            }
             break;
 
         case 'n':    //disable affinity (by default simple affinity is turned on)
             timeSpan.SetDisableAffinity(true);
             break;
 
+        case 'N':    //metadata target: -N<create>,<stat>,<open>,<rename>,<unlink> weights; -Nf<files>[,<files per directory>]
+            if ('f' == *(arg + 1))
+            {
+                char *pszEnd = nullptr;
+                DWORD dwFileCount = strtoul(arg + 2, &pszEnd, 10);
+                DWORD dwFilesPerDirectory = 1000;
+                if (pszEnd == arg + 2)
+                {
+                    pszEnd = nullptr;
+                }
+                else if (',' == *pszEnd)
+                {
+                    const char *pszPerDirectory = pszEnd + 1;
+                    dwFilesPerDirectory = strtoul(pszPerDirectory, &pszEnd, 10);
+                    if (pszEnd == pszPerDirectory)
+                    {
+                        pszEnd = nullptr;
+                    }
+                }
+
+                if (pszEnd == nullptr || *pszEnd != '\0' || dwFileCount == 0 || dwFilesPerDirectory == 0)
+                {
+                    fError = true;
+                }
+                else
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetMetadataFileCount(dwFileCount);
+                        i->SetFilesPerDirectory(dwFilesPerDirectory);
+                    }
+                }
+            }
+            else
+            {
+                DWORD vdwWeights[static_cast<int>(MetadataOperation::Count)] = {};
+                const char *pszWeight = arg + 1;
+                DWORD dwTotalWeight = 0;
+                for (int iType = 0; iType < static_cast<int>(MetadataOperation::Count) && !fError; iType++)
+                {
+                    char *pszEnd = nullptr;
+                    vdwWeights[iType] = strtoul(pszWeight, &pszEnd, 10);
+                    dwTotalWeight += vdwWeights[iType];
+                    if (pszEnd == pszWeight)
+                    {
+                        fError = true;
+                    }
+                    else if (iType + 1 < static_cast<int>(MetadataOperation::Count))
+                    {
+                        fError = (',' != *pszEnd);
+                        pszWeight = pszEnd + 1;
+                    }
+                    else
+                    {
+                        fError = ('\0' != *pszEnd);
+                    }
+                }
+
+                if (!fError && dwTotalWeight == 0)
+                {
+                    fError = true;
+                }
+
+                if (!fError)
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        for (int iType = 0; iType < static_cast<int>(MetadataOperation::Count); iType++)
+                        {
+                            i->SetMetadataWeight(static_cast<MetadataOperation>(iType), vdwWeights[iType]);
+                        }
+                    }
+                }
+            }
+            break;
+
         case 'o':    //request count (1==synchronous)
             {
                 int c = atoi(arg + 1);
@@ -852,6 +1211,123 @@ bool CmdLineParser::_ReadParametersFromCmdLine(const int argc, const char *argv[
             }
             break;
 
+        case 'q':    //bound the number of IO buffers per target per thread
+            {
+                int c = atoi(arg + 1);
+                if (c > 0)
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetIoBufferCount(c);
+                    }
+                }
+                else
+                {
+                    fError = true;
+                }
+            }
+            break;
+
+        case 'Q':    //file set target: -Q<count>[,<files per directory>], -Qs, -Qz, -Qw and -Qh shape it
+            if (isdigit((unsigned char)*(arg + 1)))
+            {
+                char *pszEnd = nullptr;
+                DWORD dwFileCount = strtoul(arg + 1, &pszEnd, 10);
+                DWORD dwFilesPerDirectory = 1000;
+                if (',' == *pszEnd)
+                {
+                    const char *pszPerDirectory = pszEnd + 1;
+                    dwFilesPerDirectory = strtoul(pszPerDirectory, &pszEnd, 10);
+                    if (pszEnd == pszPerDirectory)
+                    {
+                        pszEnd = nullptr;
+                    }
+                }
+
+                if (pszEnd == nullptr || *pszEnd != '\0' || dwFileCount == 0 || dwFilesPerDirectory == 0)
+                {
+                    fError = true;
+                }
+                else
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetFileSetCount(dwFileCount);
+                        i->SetFilesPerDirectory(dwFilesPerDirectory);
+                    }
+                }
+            }
+            else if ('s' == *(arg + 1))
+            {
+                // -Qs<min>[,<max>]
+                string sArg(arg + 2);
+                size_t iComma = sArg.find(',');
+                UINT64 cbMin = 0;
+                UINT64 cbMax = 0;
+                bool fOk = _GetSizeInBytes(sArg.substr(0, iComma).c_str(), cbMin);
+                cbMax = cbMin;
+                if (fOk && iComma != sArg.npos)
+                {
+                    fOk = _GetSizeInBytes(sArg.substr(iComma + 1).c_str(), cbMax);
+                }
+
+                if (fOk)
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetFileSetMinFileSize(cbMin);
+                        i->SetFileSetMaxFileSize(cbMax);
+                    }
+                }
+                else
+                {
+                    fError = true;
+                }
+            }
+            else if ('z' == *(arg + 1))
+            {
+                char *pszEnd = nullptr;
+                double fSkew = strtod(arg + 2, &pszEnd);
+                if (pszEnd == arg + 2 || *pszEnd != '\0')
+                {
+                    fError = true;
+                }
+                else
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetFileSetSkew(fSkew);
+                    }
+                }
+            }
+            else if ('w' == *(arg + 1) && '\0' == *(arg + 2))
+            {
+                for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                {
+                    i->SetFileSetWholeFile(true);
+                }
+            }
+            else if ('h' == *(arg + 1))
+            {
+                int c = atoi(arg + 2);
+                if (c > 0)
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetHandleCacheSize(c);
+                    }
+                }
+                else
+                {
+                    fError = true;
+                }
+            }
+            else
+            {
+                fError = true;
+            }
+            break;
+
         case 'r':    //random access
             {
                 UINT64 cb = _dwBlockSize;
@@ -994,6 +1470,20 @@ bool CmdLineParser::_ReadParametersFromCmdLine(const int argc, const char *argv[
             pProfile->SetVerbose(true);
             break;
 
+        case 'V':    //stamp written blocks and verify them when they are read back
+            if (*(arg + 1) == '\0')
+            {
+                for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                {
+                    i->SetVerifyData(true);
+                }
+            }
+            else
+            {
+                fError = true;
+            }
+            break;
+
         case 'w':    //write test [default=read]
             {
                 int c = -1;
@@ -1100,6 +1590,55 @@ bool CmdLineParser::_ReadParametersFromCmdLine(const int argc, const char *argv[
             default:
                 fError = true;
             }
+            break;
+
+        case 'Y':    //flushes: -Yw<writes>, -Yt<milliseconds> and the flush mode -Yf, -Yd or -Yb
+            switch (*(arg + 1))
+            {
+            case 'w':
+            case 't':
+                {
+                    int c = atoi(arg + 2);
+                    if (c > 0)
+                    {
+                        for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                        {
+                            if ('w' == *(arg + 1))
+                            {
+                                i->SetFlushWriteInterval(c);
+                            }
+                            else
+                            {
+                                i->SetFlushTimeInterval(c);
+                            }
+                        }
+                    }
+                    else
+                    {
+                        fError = true;
+                    }
+                }
+                break;
+
+            case 'f':
+            case 'd':
+            case 'b':
+                if ('\0' != *(arg + 2))
+                {
+                    fError = true;
+                    break;
+                }
+                for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                {
+                    i->SetFlushMode(('f' == *(arg + 1)) ? FlushMode::Full : (('d' == *(arg + 1)) ? FlushMode::Data : FlushMode::Writeback));
+                }
+                break;
+
+            default:
+                fError = true;
+                break;
+            }
+            break;
 
         case 'z':    //random seed
             if (*(arg + 1) == '\0')
@@ -1128,6 +1667,45 @@ bool CmdLineParser::_ReadParametersFromCmdLine(const int argc, const char *argv[
                     i->SetZeroWriteBuffers(true);
                 }
             }
+            else if ('r' == *(arg + 1) && '\0' == *(arg + 2))
+            {
+                for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                {
+                    i->SetRandomizeWriteData(true);
+                }
+            }
+            else if ('c' == *(arg + 1))
+            {
+                // -Zc<compression percent>[,<duplicate percent>]
+                char *pszEnd = nullptr;
+                DWORD dwCompressionPercent = strtoul(arg + 2, &pszEnd, 10);
+                DWORD dwDuplicatePercent = 0;
+                if (pszEnd != arg + 2 && ',' == *pszEnd)
+                {
+                    const char *pszDuplicate = pszEnd + 1;
+                    dwDuplicatePercent = strtoul(pszDuplicate, &pszEnd, 10);
+                    if (pszEnd == pszDuplicate)
+                    {
+                        pszEnd = nullptr;
+                    }
+                }
+
+                if (pszEnd == arg + 2 || pszEnd == nullptr || *pszEnd != '\0' ||
+                    dwCompressionPercent > 100 || dwDuplicatePercent > 100)
+                {
+                    fprintf(stderr, "ERROR: invalid percentages passed to -Zc\n");
+                    fError = true;
+                }
+                else
+                {
+                    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+                    {
+                        i->SetGenerateWriteData(true);
+                        i->SetDataCompressionPercent(dwCompressionPercent);
+                        i->SetDataDuplicatePercent(dwDuplicatePercent);
+                    }
+                }
+            }
             else
             {
                 UINT64 cb = 0;
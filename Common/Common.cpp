@@ -33,63 +33,1964 @@ SystemInformation g_SystemInformation;
 
 UINT64 PerfTimer::GetTime()
 {
+    if (TSC_FREQ != 0)
+    {
+        return __rdtsc();
+    }
+
     LARGE_INTEGER li;
     QueryPerformanceCounter(&li);
     return li.QuadPart;
 }
 
-UINT64 PerfTimer::_GetPerfTimerFreq()
+TimerSource PerfTimer::GetSource()
+{
+    return (TSC_FREQ != 0) ? TimerSource::InvariantTsc : TimerSource::Qpc;
+}
+
+const char* PerfTimer::GetSourceName()
+{
+    return (TSC_FREQ != 0) ? "InvariantTSC" : "QueryPerformanceCounter";
+}
+
+UINT64 PerfTimer::GetFrequency()
+{
+    return TIMER_FREQ;
+}
+
+UINT64 PerfTimer::_CalibrateTscFreq()
+{
+    // the TSC is only usable as a clock if it is invariant (CPUID 80000007h EDX bit 8),
+    // i.e. it ticks at a constant rate across P-/C-states and is synchronized across cores
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 0x80000000);
+    if (static_cast<unsigned int>(cpuInfo[0]) < 0x80000007)
+    {
+        return 0;
+    }
+    __cpuid(cpuInfo, 0x80000007);
+    if ((cpuInfo[3] & (1 << 8)) == 0)
+    {
+        return 0;
+    }
+
+    LARGE_INTEGER liQpcFreq;
+    QueryPerformanceFrequency(&liQpcFreq);
+
+    // measure the TSC rate against QPC over two consecutive 20ms windows; busy wait so
+    // that the thread is not descheduled in the middle of a window
+    double vfTscFreq[2];
+    for (auto& fTscFreq : vfTscFreq)
+    {
+        LARGE_INTEGER liStart;
+        LARGE_INTEGER liEnd;
+        QueryPerformanceCounter(&liStart);
+        UINT64 ullTscStart = __rdtsc();
+        do
+        {
+            QueryPerformanceCounter(&liEnd);
+        } while (liEnd.QuadPart - liStart.QuadPart < liQpcFreq.QuadPart / 50);
+        UINT64 ullTscEnd = __rdtsc();
+
+        if (ullTscEnd <= ullTscStart)
+        {
+            return 0;
+        }
+        fTscFreq = static_cast<double>(ullTscEnd - ullTscStart) * liQpcFreq.QuadPart / (liEnd.QuadPart - liStart.QuadPart);
+    }
+
+    // reject a TSC whose rate is not stable to within 0.1% between the windows
+    // (e.g. virtualized TSCs without proper scaling)
+    if (fabs(vfTscFreq[0] - vfTscFreq[1]) > vfTscFreq[1] / 1000)
+    {
+        return 0;
+    }
+
+    return static_cast<UINT64>((vfTscFreq[0] + vfTscFreq[1]) / 2);
+}
+
+UINT64 PerfTimer::_GetPerfTimerFreq()
+{
+    if (TSC_FREQ != 0)
+    {
+        return TSC_FREQ;
+    }
+
+    LARGE_INTEGER li;
+    QueryPerformanceFrequency(&li);
+    return li.QuadPart;
+}
+
+// TSC_FREQ must be initialized before TIMER_FREQ
+const UINT64 PerfTimer::TSC_FREQ = _CalibrateTscFreq();
+const UINT64 PerfTimer::TIMER_FREQ = _GetPerfTimerFreq();
+
+double PerfTimer::PerfTimeToMicroseconds(const double perfTime)
+{
+    return perfTime / (TIMER_FREQ / 1000000.0);
+}
+
+double PerfTimer::PerfTimeToMilliseconds(const double perfTime)
+{
+    return PerfTimeToMicroseconds(perfTime) / 1000;
+}
+
+double PerfTimer::PerfTimeToSeconds(const double perfTime)
+{
+    return PerfTimeToMilliseconds(perfTime) / 1000;
+}
+
+double PerfTimer::PerfTimeToMicroseconds(const UINT64 perfTime)
+{
+    return PerfTimeToMicroseconds(static_cast<double>(perfTime));
+}
+
+double PerfTimer::PerfTimeToMilliseconds(const UINT64 perfTime)
+{
+    return PerfTimeToMilliseconds(static_cast<double>(perfTime));
+}
+
+double PerfTimer::PerfTimeToSeconds(const UINT64 perfTime)
+{
+    return PerfTimeToSeconds(static_cast<double>(perfTime));
+}
+
+UINT64 PerfTimer::MicrosecondsToPerfTime(const double microseconds)
+{
+    return static_cast<UINT64>(TIMER_FREQ * (microseconds / 1000000.0));
+}
+
+UINT64 PerfTimer::MillisecondsToPerfTime(const double milliseconds)
+{
+    return static_cast<UINT64>(TIMER_FREQ * (milliseconds / 1000.0));
+}
+
+UINT64 PerfTimer::SecondsToPerfTime(const double seconds)
+{
+    return static_cast<UINT64>(TIMER_FREQ * seconds);
+}
+
+// fixed-function counters are selected by setting bit 30 of the RDPMC index; they are 48 bits wide
+#define FIXED_COUNTER(n) ((1UL << 30) | (n))
+#define FIXED_COUNTER_MASK ((1ULL << 48) - 1)
+
+bool HardwareCounters::IsAvailable()
+{
+    // architectural performance monitoring version 2+ with at least 3 fixed-function counters
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 0);
+    if (cpuInfo[0] < 0xA)
+    {
+        return false;
+    }
+    __cpuid(cpuInfo, 0xA);
+    if ((cpuInfo[0] & 0xFF) < 2 || (cpuInfo[3] & 0x1F) < COUNTER_COUNT)
+    {
+        return false;
+    }
+
+    // RDPMC faults unless user mode access has been enabled (CR4.PCE)
+    UINT64 vullBefore[COUNTER_COUNT];
+    __try
+    {
+        _Read(vullBefore);
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        return false;
+    }
+
+    // a fixed counter can be readable and still not count: its enable bits (IA32_FIXED_CTR_CTRL,
+    // IA32_PERF_GLOBAL_CTRL) cannot be read from user mode, so check that all of them move over some work
+    volatile UINT64 ullSpin = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        ullSpin = ullSpin + i;
+    }
+    UINT64 vullAfter[COUNTER_COUNT];
+    _Read(vullAfter);
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        if (((vullAfter[i] - vullBefore[i]) & FIXED_COUNTER_MASK) == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void HardwareCounters::_Read(UINT64 vullCounters[COUNTER_COUNT])
+{
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        vullCounters[i] = __readpmc(FIXED_COUNTER(i));
+    }
+}
+
+void HardwareCounters::_Transition()
+{
+    if (!_fCounting)
+    {
+        _Read(_vullStart);
+        _fCounting = true;
+    }
+    else
+    {
+        UINT64 vullEnd[COUNTER_COUNT];
+        _Read(vullEnd);
+        _pResults->ullInstructionsRetired += (vullEnd[0] - _vullStart[0]) & FIXED_COUNTER_MASK;
+        _pResults->ullCoreCycles += (vullEnd[1] - _vullStart[1]) & FIXED_COUNTER_MASK;
+        _pResults->ullReferenceCycles += (vullEnd[2] - _vullStart[2]) & FIXED_COUNTER_MASK;
+        _fCounting = false;
+    }
+}
+
+bool WorkStage::IsCrc32cAccelerated()
+{
+    // SSE4.2 (CPUID 1 ECX bit 20) provides the CRC32 instruction, which implements CRC32C
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    return (cpuInfo[2] & (1 << 20)) != 0;
+}
+
+bool WorkStage::IsEncryptAvailable()
+{
+    // AES-NI: CPUID 1 ECX bit 25
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    return (cpuInfo[2] & (1 << 25)) != 0;
+}
+
+void WorkStage::Start(const vector<Target>& vTargets, volatile bool *pfAccountingOn)
+{
+    _pfAccountingOn = pfAccountingOn;
+
+    size_t cbApplicationBuffer = 0;
+    for (const auto& target : vTargets)
+    {
+        if (target.GetWorkKernel() == WorkKernel::Copy || target.GetWorkKernel() == WorkKernel::Encrypt)
+        {
+            cbApplicationBuffer = max(cbApplicationBuffer, (size_t)target.GetBlockSizeInBytes());
+        }
+    }
+    _vApplicationBuffer.resize(cbApplicationBuffer);
+}
+
+void WorkStage::Run(const Target& target, const BYTE *pData, DWORD cbData, TargetResults *pTargetResults)
+{
+    WorkKernel kernel = target.GetWorkKernel();
+    if (kernel == WorkKernel::None)
+    {
+        return;
+    }
+
+    UINT64 ullStartTime = PerfTimer::GetTime();
+    UINT64 ullStartCycles = __rdtsc();
+    switch (kernel)
+    {
+    case WorkKernel::Crc32c:
+        _ulChecksum += Crc32c(0xFFFFFFFF, pData, cbData);
+        break;
+    case WorkKernel::Encrypt:
+        _Encrypt(pData, cbData);
+        break;
+    case WorkKernel::Copy:
+        memcpy(&_vApplicationBuffer[0], pData, cbData);
+        break;
+    case WorkKernel::Spin:
+        _Spin((UINT64)target.GetWorkCyclesPerByte() * cbData);
+        break;
+    }
+
+    if (*_pfAccountingOn)
+    {
+        pTargetResults->ullWorkCycles += __rdtsc() - ullStartCycles;
+        pTargetResults->ullWorkTime += PerfTimer::GetTime() - ullStartTime;
+        pTargetResults->ullWorkBytes += cbData;
+    }
+}
+
+UINT32 WorkStage::Crc32c(UINT32 ulCrc, const BYTE *pData, size_t cbData)
+{
+    static const bool fAccelerated = IsCrc32cAccelerated();
+    if (fAccelerated)
+    {
+#if defined(_M_X64)
+        for (; cbData >= sizeof(UINT64); cbData -= sizeof(UINT64), pData += sizeof(UINT64))
+        {
+            UINT64 ullData;
+            memcpy(&ullData, pData, sizeof(ullData));
+            ulCrc = static_cast<UINT32>(_mm_crc32_u64(ulCrc, ullData));
+        }
+#endif
+        for (; cbData >= sizeof(UINT32); cbData -= sizeof(UINT32), pData += sizeof(UINT32))
+        {
+            UINT32 ulData;
+            memcpy(&ulData, pData, sizeof(ulData));
+            ulCrc = _mm_crc32_u32(ulCrc, ulData);
+        }
+        for (; cbData > 0; cbData--, pData++)
+        {
+            ulCrc = _mm_crc32_u8(ulCrc, *pData);
+        }
+        return ulCrc;
+    }
+
+    // table driven fallback, reflected Castagnoli polynomial
+    struct Crc32cTable
+    {
+        UINT32 vulEntries[256];
+
+        Crc32cTable()
+        {
+            for (UINT32 i = 0; i < 256; i++)
+            {
+                UINT32 ulEntry = i;
+                for (int iBit = 0; iBit < 8; iBit++)
+                {
+                    ulEntry = (ulEntry >> 1) ^ ((ulEntry & 1) ? 0x82F63B78 : 0);
+                }
+                vulEntries[i] = ulEntry;
+            }
+        }
+    };
+    static const Crc32cTable table;
+
+    for (; cbData > 0; cbData--, pData++)
+    {
+        ulCrc = table.vulEntries[(ulCrc ^ *pData) & 0xFF] ^ (ulCrc >> 8);
+    }
+    return ulCrc;
+}
+
+// Ten AES rounds over every 16 byte block, into the application buffer: the cost of AES-128 encryption.
+// The round keys are fixed rather than expanded from a key, since only the work is of interest.
+void WorkStage::_Encrypt(const BYTE *pData, size_t cbData)
+{
+    __m128i vRoundKeys[11];
+    for (int i = 0; i < _countof(vRoundKeys); i++)
+    {
+        vRoundKeys[i] = _mm_set1_epi32(0x9E3779B9 * (i + 1));
+    }
+
+    for (size_t i = 0; i + 16 <= cbData; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pData + i));
+        block = _mm_xor_si128(block, vRoundKeys[0]);
+        for (int iRound = 1; iRound < 10; iRound++)
+        {
+            block = _mm_aesenc_si128(block, vRoundKeys[iRound]);
+        }
+        block = _mm_aesenclast_si128(block, vRoundKeys[10]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&_vApplicationBuffer[i]), block);
+    }
+}
+
+void WorkStage::_Spin(UINT64 ullCycles)
+{
+    UINT64 ullEnd = __rdtsc() + ullCycles;
+    while (__rdtsc() < ullEnd)
+    {
+        _mm_pause();
+    }
+}
+
+// splitmix64 finalizer: spreads a counter over all 64 bits
+static UINT64 MixBits(UINT64 ullValue)
+{
+    ullValue = (ullValue ^ (ullValue >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    ullValue = (ullValue ^ (ullValue >> 27)) * 0x94D049BB133111EBULL;
+    return ullValue ^ (ullValue >> 31);
+}
+
+// xorshift64*: advances a nonzero state and returns the next number
+static UINT64 NextXorshift(UINT64& ullState)
+{
+    ullState ^= ullState >> 12;
+    ullState ^= ullState << 25;
+    ullState ^= ullState >> 27;
+    return ullState * 0x2545F4914F6CDD1DULL;
+}
+
+static UINT64 GreatestCommonDivisor(UINT64 a, UINT64 b)
+{
+    while (b != 0)
+    {
+        UINT64 r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+bool WriteDataGenerator::IsAvx2Available()
+{
+    // AVX2: CPUID 7 EBX bit 5, and the OS must save the YMM registers (OSXSAVE, XCR0 bits 1 and 2)
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    if ((cpuInfo[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1 << 5)) != 0;
+}
+
+void WriteDataGenerator::Start(UINT32 ulThreadNo, const vector<Target>& vTargets, volatile bool *pfAccountingOn, ThreadResults *pResults)
+{
+    _pfAccountingOn = pfAccountingOn;
+    _pResults = pResults;
+
+    bool fCompressible = false;
+    for (const auto& target : vTargets)
+    {
+        fCompressible = fCompressible || target.GetGenerateWriteData();
+    }
+
+    _ullSalt = MixBits(PerfTimer::GetTime() ^ ((UINT64)ulThreadNo << 32));
+    _ullNextBlock = 0;
+    _ullRandom = MixBits(_ullSalt);
+    for (int i = 0; i < _countof(_vullRandomState); i++)
+    {
+        // xorshift128+ must not start from an all zero state
+        _vullRandomState[i] = MixBits(_ullSalt + i + 1) | 1;
+    }
+    _fAvx2 = IsAvx2Available();
+
+    if (fCompressible)
+    {
+        // the pool is seeded the same way in every thread so that duplicate blocks match; the slack
+        // past its end lets a full chunk be copied from any segment
+        _vSegmentPool.resize(SEGMENT_POOL_BYTES + CHUNK_BYTES);
+        for (size_t i = 0; i < _vSegmentPool.size(); i += sizeof(UINT64))
+        {
+            UINT64 ullRandom = MixBits(i);
+            memcpy(&_vSegmentPool[i], &ullRandom, sizeof(ullRandom));
+        }
+    }
+}
+
+void WriteDataGenerator::Fill(size_t iTarget, const Target& target, BYTE *pBuffer, DWORD cbBlock)
+{
+    if (!target.GetRandomizeWriteData() && !target.GetGenerateWriteData())
+    {
+        return;
+    }
+
+    UINT64 ullStartTime = PerfTimer::GetTime();
+    if (target.GetRandomizeWriteData())
+    {
+        if (_fAvx2)
+        {
+            _FillRandomAvx2(pBuffer, cbBlock);
+        }
+        else
+        {
+            _FillRandomSse2(pBuffer, cbBlock);
+        }
+    }
+    else
+    {
+        _FillCompressible(target, pBuffer, cbBlock);
+    }
+
+    if (*_pfAccountingOn)
+    {
+        TargetResults& targetResults = _pResults->vTargetResults[iTarget];
+        targetResults.ullWriteFillTime += PerfTimer::GetTime() - ullStartTime;
+        targetResults.ullWriteFillBytes += cbBlock;
+        targetResults.ullWriteFillCount++;
+    }
+}
+
+// one xorshift128+ step in each 64 bit lane
+__inline static __m256i NextRandomAvx2(__m256i& s0, __m256i& s1)
+{
+    __m256i x = s0;
+    const __m256i y = s1;
+    s0 = y;
+    x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 23));
+    s1 = _mm256_xor_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(_mm256_srli_epi64(x, 17), _mm256_srli_epi64(y, 26)));
+    return _mm256_add_epi64(s1, y);
+}
+
+__inline static __m128i NextRandomSse2(__m128i& s0, __m128i& s1)
+{
+    __m128i x = s0;
+    const __m128i y = s1;
+    s0 = y;
+    x = _mm_xor_si128(x, _mm_slli_epi64(x, 23));
+    s1 = _mm_xor_si128(_mm_xor_si128(x, y), _mm_xor_si128(_mm_srli_epi64(x, 17), _mm_srli_epi64(y, 26)));
+    return _mm_add_epi64(s1, y);
+}
+
+void WriteDataGenerator::_FillRandomAvx2(BYTE *pBuffer, size_t cbBuffer)
+{
+    __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&_vullRandomState[0]));
+    __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&_vullRandomState[4]));
+    __m256i random;
+
+    size_t i = 0;
+    for (; i + sizeof(__m256i) <= cbBuffer; i += sizeof(__m256i))
+    {
+        random = NextRandomAvx2(s0, s1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pBuffer + i), random);
+    }
+    if (i < cbBuffer)
+    {
+        random = NextRandomAvx2(s0, s1);
+        memcpy(pBuffer + i, &random, cbBuffer - i);
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&_vullRandomState[0]), s0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&_vullRandomState[4]), s1);
+}
+
+void WriteDataGenerator::_FillRandomSse2(BYTE *pBuffer, size_t cbBuffer)
+{
+    // the four generators as two pairs, one pair per register
+    __m128i s0a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&_vullRandomState[0]));
+    __m128i s0b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&_vullRandomState[2]));
+    __m128i s1a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&_vullRandomState[4]));
+    __m128i s1b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&_vullRandomState[6]));
+    __m128i vRandom[2];
+
+    size_t i = 0;
+    for (; i + sizeof(vRandom) <= cbBuffer; i += sizeof(vRandom))
+    {
+        vRandom[0] = NextRandomSse2(s0a, s1a);
+        vRandom[1] = NextRandomSse2(s0b, s1b);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pBuffer + i), vRandom[0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pBuffer + i + sizeof(__m128i)), vRandom[1]);
+    }
+    if (i < cbBuffer)
+    {
+        vRandom[0] = NextRandomSse2(s0a, s1a);
+        vRandom[1] = NextRandomSse2(s0b, s1b);
+        memcpy(pBuffer + i, vRandom, cbBuffer - i);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&_vullRandomState[0]), s0a);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&_vullRandomState[2]), s0b);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&_vullRandomState[4]), s1a);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&_vullRandomState[6]), s1b);
+}
+
+UINT64 WriteDataGenerator::_NextRandom()
+{
+    return NextXorshift(_ullRandom);
+}
+
+void WriteDataGenerator::_FillCompressible(const Target& target, BYTE *pBuffer, DWORD cbBlock)
+{
+    // duplicate blocks are named below 2^63, unique blocks above
+    UINT64 ullName;
+    if ((_NextRandom() % 100) < target.GetDataDuplicatePercent())
+    {
+        ullName = _NextRandom() % DUPLICATE_BLOCK_COUNT;
+    }
+    else
+    {
+        ullName = MixBits(_ullSalt + _ullNextBlock++) | (1ULL << 63);
+    }
+
+    DWORD dwIncompressiblePercent = 100 - target.GetDataCompressionPercent();
+    for (size_t iChunk = 0; iChunk < cbBlock; iChunk += CHUNK_BYTES)
+    {
+        BYTE *pChunk = pBuffer + iChunk;
+        size_t cbChunk = min((size_t)(cbBlock - iChunk), CHUNK_BYTES);
+
+        UINT64 vullHeader[2] = { ullName, iChunk / CHUNK_BYTES };
+        size_t cbHeader = min(sizeof(vullHeader), cbChunk);
+        size_t cbIncompressible = max(cbChunk * dwIncompressiblePercent / 100, cbHeader);
+        memcpy(pChunk, vullHeader, cbHeader);
+
+        // segments start 16 byte aligned so the copy runs at full vector width
+        size_t iSegment = static_cast<size_t>(MixBits(ullName + vullHeader[1]) % SEGMENT_POOL_BYTES) & ~(size_t)15;
+        memcpy(pChunk + cbHeader, &_vSegmentPool[iSegment], cbIncompressible - cbHeader);
+        memset(pChunk + cbIncompressible, 0, cbChunk - cbIncompressible);
+    }
+}
+
+// A write's sequence slot carries this flag when the write overlapped another write to its block;
+// a read's carries it when a write to its block was in flight as the read was issued.
+static const UINT64 VERIFY_RACED = 1ULL << 63;
+
+void TargetVerifyState::Initialize(UINT64 ullTargetSize, DWORD cbBlock)
+{
+    AcquireSRWLockExclusive(&_lock);
+    if (!_fInitialized)
+    {
+        UINT64 cBlocks = (ullTargetSize + cbBlock - 1) / cbBlock;
+        _fExact = (cBlocks <= MAX_TRACKED_BLOCKS);
+        _cbBlock = cbBlock;
+        _vBlocks.resize(static_cast<size_t>(max(min(cBlocks, (UINT64)MAX_TRACKED_BLOCKS), (UINT64)1)));
+        _fInitialized = true;
+    }
+    ReleaseSRWLockExclusive(&_lock);
+}
+
+void DataVerifier::Start(UINT32 ulThreadNo, const vector<Target>& vTargets, const vector<TargetVerifyState *>& vpStates, volatile bool *pfAccountingOn, PUINT64 pullStartTime, ThreadResults *pResults)
+{
+    _ulThreadNo = ulThreadNo;
+    _pfAccountingOn = pfAccountingOn;
+    _pullStartTime = pullStartTime;
+    _pResults = pResults;
+
+    _vpStates.clear();
+    for (size_t i = 0; i < vTargets.size(); i++)
+    {
+        _vpStates.push_back(vTargets[i].GetVerifyData() ? vpStates[i] : nullptr);
+    }
+}
+
+void DataVerifier::Prepare(size_t iTarget, IOOperation type, BYTE *pBuffer, DWORD cbBlock, UINT64 ullOffset, UINT64 *pullSequence)
+{
+    TargetVerifyState *pState = _vpStates[iTarget];
+    if (pState == nullptr)
+    {
+        return;
+    }
+
+    TargetVerifyState::BlockState& block = pState->GetBlockState(ullOffset);
+    if (type == IOOperation::WriteIO)
+    {
+        bool fRaced = (InterlockedIncrement(&block.lWritesInFlight) != 1);
+        UINT64 ullSequence = InterlockedIncrement64(&pState->llNextSequence);
+        InterlockedExchange64(&block.llLastIssued, ullSequence);
+
+        BlockStamp *pStamp = reinterpret_cast<BlockStamp *>(pBuffer);
+        pStamp->ulMagic = BlockStamp::MAGIC;
+        pStamp->ulCrc = 0;
+        pStamp->ullOffset = ullOffset;
+        pStamp->ullSequence = ullSequence;
+        pStamp->ulThreadNo = _ulThreadNo;
+        pStamp->ulReserved = 0;
+        pStamp->ulCrc = WorkStage::Crc32c(0xFFFFFFFF, pBuffer, cbBlock);
+
+        *pullSequence = ullSequence | (fRaced ? VERIFY_RACED : 0);
+    }
+    else
+    {
+        bool fRaced = (block.lWritesInFlight != 0);
+        *pullSequence = static_cast<UINT64>(block.llLastIssued) | (fRaced ? VERIFY_RACED : 0);
+    }
+}
+
+void DataVerifier::Complete(size_t iTarget, IOOperation type, const BYTE *pBuffer, DWORD cbBlock, UINT64 ullOffset, UINT64 ullSequence)
+{
+    TargetVerifyState *pState = _vpStates[iTarget];
+    if (pState == nullptr)
+    {
+        return;
+    }
+
+    TargetVerifyState::BlockState& block = pState->GetBlockState(ullOffset);
+    TargetResults& targetResults = _pResults->vTargetResults[iTarget];
+    if (type == IOOperation::WriteIO)
+    {
+        // only a write which had its block to itself for its whole lifetime is known to be on the media;
+        // one which a later write was issued against is raced even if that write completed first, so
+        // that the overlap is never cleared by the earlier write completing last
+        bool fRaced = (InterlockedDecrement(&block.lWritesInFlight) != 0) ||
+            ((ullSequence & VERIFY_RACED) != 0) ||
+            (static_cast<UINT64>(block.llLastIssued) != ullSequence);
+        InterlockedExchange(&block.lLastWriteRaced, fRaced ? 1 : 0);
+        if (!fRaced)
+        {
+            LONG64 llSequence = static_cast<LONG64>(ullSequence);
+            LONG64 llBound = block.llLowerBound;
+            while (llBound < llSequence)
+            {
+                LONG64 llPrevious = InterlockedCompareExchange64(&block.llLowerBound, llSequence, llBound);
+                if (llPrevious == llBound)
+                {
+                    break;
+                }
+                llBound = llPrevious;
+            }
+        }
+
+        if (*_pfAccountingOn)
+        {
+            targetResults.ullStampedWriteCount++;
+        }
+        return;
+    }
+
+    // a write issued or in flight during the read may have left either version, or a mix of both;
+    // so may writes which raced each other before it, even though all of them have completed
+    if ((ullSequence & VERIFY_RACED) != 0 ||
+        block.lWritesInFlight != 0 ||
+        block.lLastWriteRaced != 0 ||
+        static_cast<UINT64>(block.llLastIssued) != ullSequence)
+    {
+        if (*_pfAccountingOn)
+        {
+            targetResults.ullUnverifiedReadCount++;
+        }
+        return;
+    }
+
+    UINT64 ullLowerBound = static_cast<UINT64>(block.llLowerBound);
+    const BlockStamp *pStamp = reinterpret_cast<const BlockStamp *>(pBuffer);
+    if (pStamp->ulMagic != BlockStamp::MAGIC)
+    {
+        // blocks which were never written during the run hold whatever the file was created with
+        if (ullLowerBound > 0 && pState->IsExact())
+        {
+            _RecordFailure(iTarget, VerifyFailureType::Missing, ullOffset, ullLowerBound, nullptr);
+        }
+        else if (*_pfAccountingOn)
+        {
+            targetResults.ullUnverifiedReadCount++;
+        }
+        return;
+    }
+
+    BlockStamp stamp = *pStamp;
+    UINT32 ulCrc = WorkStage::Crc32c(0xFFFFFFFF, reinterpret_cast<const BYTE *>(&stamp.ulMagic), sizeof(stamp.ulMagic));
+    ulCrc = WorkStage::Crc32c(ulCrc, reinterpret_cast<const BYTE *>("\0\0\0\0"), sizeof(stamp.ulCrc));
+    ulCrc = WorkStage::Crc32c(ulCrc, pBuffer + offsetof(BlockStamp, ullOffset), cbBlock - offsetof(BlockStamp, ullOffset));
+
+    if (ulCrc != stamp.ulCrc)
+    {
+        _RecordFailure(iTarget, VerifyFailureType::Corrupt, ullOffset, ullLowerBound, &stamp);
+    }
+    else if (stamp.ullOffset != ullOffset)
+    {
+        _RecordFailure(iTarget, VerifyFailureType::Misdirected, ullOffset, ullLowerBound, &stamp);
+    }
+    else if (stamp.ullSequence < ullLowerBound && pState->IsExact())
+    {
+        _RecordFailure(iTarget, VerifyFailureType::Stale, ullOffset, ullLowerBound, &stamp);
+    }
+    else if (*_pfAccountingOn)
+    {
+        targetResults.ullVerifiedReadCount++;
+    }
+}
+
+// Failures are counted whether or not the measured window is open: a block corrupted during
+// warm up is still corrupt.
+void DataVerifier::_RecordFailure(size_t iTarget, VerifyFailureType type, UINT64 ullOffset, UINT64 ullExpectedSequence, const BlockStamp *pStamp)
+{
+    TargetResults& targetResults = _pResults->vTargetResults[iTarget];
+    targetResults.ullVerifyFailureCount++;
+    if (targetResults.vVerifyFailures.size() >= MAX_RECORDED_FAILURES)
+    {
+        return;
+    }
+
+    VerifyFailure failure;
+    failure.type = type;
+    failure.ullOffset = ullOffset;
+    failure.fMeasured = *_pfAccountingOn;
+    failure.ullTime = failure.fMeasured ? PerfTimer::GetTime() - *_pullStartTime : 0;
+    failure.ullExpectedSequence = ullExpectedSequence;
+    failure.ullFoundSequence = (pStamp != nullptr) ? pStamp->ullSequence : 0;
+    failure.ullFoundOffset = (pStamp != nullptr) ? pStamp->ullOffset : 0;
+    failure.ulWriterThreadNo = (pStamp != nullptr) ? pStamp->ulThreadNo : 0;
+    targetResults.vVerifyFailures.push_back(failure);
+}
+
+void FileSetCache::Start(UINT32 ulThreadNo, const vector<Target>& vTargets, size_t cIos, HANDLE hCompletionPort, volatile bool *pfAccountingOn, ThreadResults *pResults)
+{
+    _pvTargets = &vTargets;
+    _hCompletionPort = hCompletionPort;
+    _pfAccountingOn = pfAccountingOn;
+    _pResults = pResults;
+    _ullRandom = MixBits(PerfTimer::GetTime() ^ ((UINT64)ulThreadNo << 32)) | 1;
+    _vpIoFiles.assign(cIos, nullptr);
+    _vTargetFiles.resize(vTargets.size());
+
+    for (size_t iTarget = 0; iTarget < vTargets.size(); iTarget++)
+    {
+        const Target& target = vTargets[iTarget];
+        TargetFiles& files = _vTargetFiles[iTarget];
+        files.ullWholeFileSize = 0;
+        files.ullWholeFileOffset = 0;
+        if (target.GetFileSetCount() == 0 || target.GetFileSetSkew() <= 0)
+        {
+            continue;
+        }
+
+        // Gray et al., "Quickly Generating Billion-Record Synthetic Databases"; zeta(n) is summed
+        // once per thread, which takes a moment for the largest file sets
+        double fTheta = target.GetFileSetSkew();
+        UINT64 n = target.GetFileSetCount();
+        double fZetaN = 0;
+        for (UINT64 i = 1; i <= n; i++)
+        {
+            fZetaN += 1 / pow((double)i, fTheta);
+        }
+        double fZeta2 = 1 + 1 / pow(2.0, fTheta);
+        files.fZetaN = fZetaN;
+        files.fAlpha = 1 / (1 - fTheta);
+        files.fEta = (1 - pow(2.0 / n, 1 - fTheta)) / (1 - fZeta2 / fZetaN);
+
+        // the permutation depends only on the file count, so that all threads agree on which files are popular;
+        // both factors are below n < 2^32, so the product cannot overflow
+        files.ullRankMultiplier = MixBits(n) % n;
+        while (GreatestCommonDivisor(files.ullRankMultiplier, n) != 1)
+        {
+            files.ullRankMultiplier = (files.ullRankMultiplier + 1) % n;
+        }
+        files.ullRankOffset = MixBits(n + 1) % n;
+    }
+}
+
+UINT64 FileSetCache::_NextRandom()
+{
+    return NextXorshift(_ullRandom);
+}
+
+UINT64 FileSetCache::_ChooseFile(const Target& target, const TargetFiles& files)
+{
+    UINT64 cFiles = target.GetFileSetCount();
+    if (target.GetFileSetSkew() <= 0)
+    {
+        return _NextRandom() % cFiles;
+    }
+
+    double u = (double)(_NextRandom() >> 11) / (double)(1ULL << 53);
+    double uz = u * files.fZetaN;
+    UINT64 ullRank;
+    if (uz < 1)
+    {
+        ullRank = 0;
+    }
+    else if (uz < 1 + pow(0.5, target.GetFileSetSkew()))
+    {
+        ullRank = 1;
+    }
+    else
+    {
+        ullRank = min((UINT64)(cFiles * pow(files.fEta * u - files.fEta + 1, files.fAlpha)), cFiles - 1);
+    }
+
+    // scatter the popular files over the whole set instead of the first directories; the mapping
+    // is a permutation, so every rank lands on a file of its own
+    return (ullRank * files.ullRankMultiplier + files.ullRankOffset) % cFiles;
+}
+
+HANDLE FileSetCache::Acquire(size_t iTarget, size_t iIo, UINT64 *pullOffset)
+{
+    const Target& target = (*_pvTargets)[iTarget];
+    TargetFiles& files = _vTargetFiles[iTarget];
+    DWORD cbBlock = target.GetBlockSizeInBytes();
+
+    UINT64 ullFile;
+    if (target.GetFileSetWholeFile())
+    {
+        if (files.ullWholeFileOffset + cbBlock > files.ullWholeFileSize)
+        {
+            files.ullWholeFile = _ChooseFile(target, files);
+            files.ullWholeFileSize = target.GetFileSetFileSize(files.ullWholeFile);
+            files.ullWholeFileOffset = 0;
+        }
+        ullFile = files.ullWholeFile;
+        *pullOffset = files.ullWholeFileOffset;
+        files.ullWholeFileOffset += cbBlock;
+    }
+    else
+    {
+        ullFile = _ChooseFile(target, files);
+        *pullOffset = (_NextRandom() % (target.GetFileSetFileSize(ullFile) / cbBlock)) * cbBlock;
+    }
+
+    bool fAccounting = *_pfAccountingOn;
+    TargetResults& targetResults = _pResults->vTargetResults[iTarget];
+    auto iEntry = files.mFiles.find(ullFile);
+    if (iEntry != files.mFiles.end())
+    {
+        // move the file to the front of the LRU list
+        files.lFiles.splice(files.lFiles.begin(), files.lFiles, iEntry->second);
+        if (fAccounting)
+        {
+            targetResults.ullHandleCacheHitCount++;
+        }
+    }
+    else
+    {
+        // make room, starting from the least recently used file which has no IOs in flight
+        auto iVictim = files.lFiles.end();
+        while (files.lFiles.size() >= target.GetHandleCacheSize() && iVictim != files.lFiles.begin())
+        {
+            --iVictim;
+            if (iVictim->dwIosInFlight == 0)
+            {
+                _CloseFile(iTarget, iVictim->hFile);
+                files.mFiles.erase(iVictim->ullFile);
+                iVictim = files.lFiles.erase(iVictim);
+            }
+        }
+
+        DWORD dwDesiredAccess = GENERIC_READ | GENERIC_WRITE;
+        if (target.GetWriteRatio() == 0)
+        {
+            dwDesiredAccess = GENERIC_READ;
+        }
+        else if (target.GetWriteRatio() == 100)
+        {
+            dwDesiredAccess = GENERIC_WRITE;
+        }
+
+        UINT64 ullStartTime = PerfTimer::GetTime();
+        HANDLE hFile = CreateFile(target.GetFileSetFilePath(ullFile).c_str(),
+                                  dwDesiredAccess,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  target.GetCreateFlags(true),
+                                  nullptr);
+        if (INVALID_HANDLE_VALUE == hFile)
+        {
+            return INVALID_HANDLE_VALUE;
+        }
+        if (target.GetIOPriorityHint() != IoPriorityHintNormal)
+        {
+            FILE_IO_PRIORITY_HINT_INFO hintInfo;
+            hintInfo.PriorityHint = target.GetIOPriorityHint();
+            SetFileInformationByHandle(hFile, FileIoPriorityHintInfo, &hintInfo, sizeof(hintInfo));
+        }
+        if (nullptr != _hCompletionPort && nullptr == CreateIoCompletionPort(hFile, _hCompletionPort, 0, 1))
+        {
+            DWORD dwError = GetLastError();
+            CloseHandle(hFile);
+            SetLastError(dwError);
+            return INVALID_HANDLE_VALUE;
+        }
+        if (fAccounting)
+        {
+            targetResults.ullFileOpenTime += PerfTimer::GetTime() - ullStartTime;
+            targetResults.ullFileOpenCount++;
+        }
+
+        OpenFile file;
+        file.ullFile = ullFile;
+        file.hFile = hFile;
+        file.dwIosInFlight = 0;
+        files.lFiles.push_front(file);
+        files.mFiles[ullFile] = files.lFiles.begin();
+        iEntry = files.mFiles.find(ullFile);
+    }
+
+    OpenFile *pFile = &*iEntry->second;
+    pFile->dwIosInFlight++;
+    _vpIoFiles[iIo] = pFile;
+    return pFile->hFile;
+}
+
+void FileSetCache::Release(size_t iIo)
+{
+    if (_vpIoFiles.size() > iIo && nullptr != _vpIoFiles[iIo])
+    {
+        _vpIoFiles[iIo]->dwIosInFlight--;
+        _vpIoFiles[iIo] = nullptr;
+    }
+}
+
+void FileSetCache::_CloseFile(size_t iTarget, HANDLE hFile)
+{
+    UINT64 ullStartTime = PerfTimer::GetTime();
+    CloseHandle(hFile);
+    if (*_pfAccountingOn)
+    {
+        TargetResults& targetResults = _pResults->vTargetResults[iTarget];
+        targetResults.ullFileCloseTime += PerfTimer::GetTime() - ullStartTime;
+        targetResults.ullFileCloseCount++;
+    }
+}
+
+void FileSetCache::Close()
+{
+    for (auto& files : _vTargetFiles)
+    {
+        for (const auto& file : files.lFiles)
+        {
+            CloseHandle(file.hFile);
+        }
+        files.lFiles.clear();
+        files.mFiles.clear();
+    }
+    _vpIoFiles.assign(_vpIoFiles.size(), nullptr);
+}
+
+bool MetadataWorker::Start(UINT32 ulThreadNo, const vector<Target>& vTargets, volatile bool *pfAccountingOn, ThreadResults *pResults)
+{
+    _pvTargets = &vTargets;
+    _pfAccountingOn = pfAccountingOn;
+    _pResults = pResults;
+    _ullRandom = MixBits(PerfTimer::GetTime() ^ ((UINT64)ulThreadNo << 32)) | 1;
+    _iNextTarget = 0;
+    _vTargetFiles.resize(vTargets.size());
+
+    for (size_t iTarget = 0; iTarget < vTargets.size(); iTarget++)
+    {
+        const Target& target = vTargets[iTarget];
+        TargetFiles& files = _vTargetFiles[iTarget];
+        files.cExisting = 0;
+        files.dwTotalWeight = 0;
+        for (int i = 0; i < static_cast<int>(MetadataOperation::Count); i++)
+        {
+            files.dwTotalWeight += target.GetMetadataWeight(static_cast<MetadataOperation>(i));
+        }
+        if (files.dwTotalWeight == 0)
+        {
+            continue;
+        }
+
+        char szDirectory[32];
+        sprintf_s(szDirectory, _countof(szDirectory), "t%05u", ulThreadNo);
+        files.sDirectory = target.GetPath();
+        if (!files.sDirectory.empty() && files.sDirectory[files.sDirectory.length() - 1] != '\\')
+        {
+            files.sDirectory += '\\';
+        }
+        files.sDirectory += szDirectory;
+
+        // the target directory is shared by all threads, and their own may remain from an earlier run
+        CreateDirectory(target.GetPath().c_str(), nullptr);
+        if (!CreateDirectory(files.sDirectory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+        {
+            return false;
+        }
+
+        DWORD cFiles = target.GetMetadataFileCount();
+        files.vdwFiles.resize(cFiles);
+        files.vfRenamed.assign(cFiles, false);
+        files.cExisting = cFiles / 2;
+        for (DWORD dwFile = 0; dwFile < cFiles; dwFile++)
+        {
+            files.vdwFiles[dwFile] = dwFile;
+
+            string sPath = _GetFilePath(target, files, dwFile, false);
+            if (dwFile % target.GetFilesPerDirectory() == 0)
+            {
+                string sSubdirectory = sPath.substr(0, sPath.rfind('\\'));
+                if (!CreateDirectory(sSubdirectory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+                {
+                    return false;
+                }
+            }
+
+            DeleteFile(_GetFilePath(target, files, dwFile, true).c_str());
+            if (dwFile < files.cExisting)
+            {
+                HANDLE hFile = CreateFile(sPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (INVALID_HANDLE_VALUE == hFile)
+                {
+                    return false;
+                }
+                CloseHandle(hFile);
+            }
+            else
+            {
+                DeleteFile(sPath.c_str());
+            }
+        }
+    }
+    return true;
+}
+
+UINT64 MetadataWorker::_NextRandom()
+{
+    return NextXorshift(_ullRandom);
+}
+
+string MetadataWorker::_GetFilePath(const Target& target, const TargetFiles& files, DWORD dwFile, bool fRenamed) const
+{
+    char szFile[64];
+    sprintf_s(szFile, _countof(szFile), "\\d%05u\\m%08u.%s", dwFile / target.GetFilesPerDirectory(), dwFile, fRenamed ? "ren" : "dat");
+    return files.sDirectory + szFile;
+}
+
+bool MetadataWorker::Run(MetadataOperation *pType)
+{
+    size_t iTarget = _iNextTarget;
+    _iNextTarget = (_iNextTarget + 1) % _vTargetFiles.size();
+
+    const Target& target = (*_pvTargets)[iTarget];
+    TargetFiles& files = _vTargetFiles[iTarget];
+    DWORD cFiles = (DWORD)files.vdwFiles.size();
+
+    MetadataOperation type = MetadataOperation::Create;
+    DWORD dwChoice = (DWORD)(_NextRandom() % files.dwTotalWeight);
+    for (int i = 0; i < static_cast<int>(MetadataOperation::Count); i++)
+    {
+        DWORD dwWeight = target.GetMetadataWeight(static_cast<MetadataOperation>(i));
+        if (dwChoice < dwWeight)
+        {
+            type = static_cast<MetadataOperation>(i);
+            break;
+        }
+        dwChoice -= dwWeight;
+    }
+
+    if (type == MetadataOperation::Create && files.cExisting == cFiles)
+    {
+        type = MetadataOperation::Unlink;
+    }
+    else if (type != MetadataOperation::Create && files.cExisting == 0)
+    {
+        type = MetadataOperation::Create;
+    }
+    *pType = type;
+
+    DWORD iSlot;
+    if (type == MetadataOperation::Create)
+    {
+        iSlot = files.cExisting + (DWORD)(_NextRandom() % (cFiles - files.cExisting));
+    }
+    else
+    {
+        iSlot = (DWORD)(_NextRandom() % files.cExisting);
+    }
+    DWORD dwFile = files.vdwFiles[iSlot];
+    string sPath = _GetFilePath(target, files, dwFile, files.vfRenamed[dwFile]);
+    string sNewPath;
+    if (type == MetadataOperation::Rename)
+    {
+        sNewPath = _GetFilePath(target, files, dwFile, !files.vfRenamed[dwFile]);
+    }
+
+    BOOL fOk = FALSE;
+    HANDLE hFile;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    UINT64 ullStartTime = PerfTimer::GetTime();
+    switch (type)
+    {
+    case MetadataOperation::Create:
+        hFile = CreateFile(sPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        fOk = (INVALID_HANDLE_VALUE != hFile) && CloseHandle(hFile);
+        break;
+    case MetadataOperation::Stat:
+        fOk = GetFileAttributesEx(sPath.c_str(), GetFileExInfoStandard, &attributes);
+        break;
+    case MetadataOperation::Open:
+        hFile = CreateFile(sPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        fOk = (INVALID_HANDLE_VALUE != hFile) && CloseHandle(hFile);
+        break;
+    case MetadataOperation::Rename:
+        fOk = MoveFileEx(sPath.c_str(), sNewPath.c_str(), 0);
+        break;
+    case MetadataOperation::Unlink:
+        fOk = DeleteFile(sPath.c_str());
+        break;
+    }
+    UINT64 ullDuration = PerfTimer::GetTime() - ullStartTime;
+    if (!fOk)
+    {
+        return false;
+    }
+
+    if (*_pfAccountingOn)
+    {
+        _pResults->vTargetResults[iTarget].AddMetadata(type, ullDuration);
+    }
+
+    switch (type)
+    {
+    case MetadataOperation::Create:
+        swap(files.vdwFiles[iSlot], files.vdwFiles[files.cExisting]);
+        files.cExisting++;
+        break;
+    case MetadataOperation::Rename:
+        files.vfRenamed[dwFile] = !files.vfRenamed[dwFile];
+        break;
+    case MetadataOperation::Unlink:
+        files.vfRenamed[dwFile] = false;
+        files.cExisting--;
+        swap(files.vdwFiles[iSlot], files.vdwFiles[files.cExisting]);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+void MetadataWorker::Close()
+{
+    for (size_t iTarget = 0; iTarget < _vTargetFiles.size(); iTarget++)
+    {
+        const Target& target = (*_pvTargets)[iTarget];
+        TargetFiles& files = _vTargetFiles[iTarget];
+        if (files.sDirectory.empty())
+        {
+            continue;
+        }
+
+        for (DWORD iSlot = 0; iSlot < files.cExisting; iSlot++)
+        {
+            DWORD dwFile = files.vdwFiles[iSlot];
+            DeleteFile(_GetFilePath(target, files, dwFile, files.vfRenamed[dwFile]).c_str());
+        }
+        for (DWORD dwFile = 0; dwFile < files.vdwFiles.size(); dwFile += target.GetFilesPerDirectory())
+        {
+            string sPath = _GetFilePath(target, files, dwFile, false);
+            RemoveDirectory(sPath.substr(0, sPath.rfind('\\')).c_str());
+        }
+        RemoveDirectory(files.sDirectory.c_str());
+
+        files.sDirectory.clear();
+        files.vdwFiles.clear();
+        files.vfRenamed.clear();
+        files.cExisting = 0;
+    }
+}
+
+const char *MetadataWorker::GetOperationName(MetadataOperation type)
+{
+    switch (type)
+    {
+    case MetadataOperation::Create:
+        return "create";
+    case MetadataOperation::Stat:
+        return "stat";
+    case MetadataOperation::Open:
+        return "open";
+    case MetadataOperation::Rename:
+        return "rename";
+    case MetadataOperation::Unlink:
+        return "unlink";
+    default:
+        return "unknown";
+    }
+}
+
+// flags of NtFlushBuffersFileEx, for SDKs which predate them
+#ifndef FLUSH_FLAGS_FILE_DATA_ONLY
+#define FLUSH_FLAGS_FILE_DATA_ONLY          0x00000001
+#endif
+#ifndef FLUSH_FLAGS_NO_SYNC
+#define FLUSH_FLAGS_NO_SYNC                 0x00000002
+#endif
+#ifndef FLUSH_FLAGS_FILE_DATA_SYNC_ONLY
+#define FLUSH_FLAGS_FILE_DATA_SYNC_ONLY     0x00000004
+#endif
+
+bool FlushInjector::Start(const vector<Target>& vTargets, const vector<HANDLE>& vhTargets, volatile bool *pfAccountingOn, ThreadResults *pResults)
+{
+    _pvTargets = &vTargets;
+    _pfAccountingOn = pfAccountingOn;
+    _pResults = pResults;
+    _ullLastFlushStartTime = 0;
+    _ullLastFlushEndTime = 0;
+    _fActive = false;
+    _fStop = false;
+    _lPendingTarget = -1;
+    _lFlushDone = 0;
+    TargetFlush noFlush = { INVALID_HANDLE_VALUE, 0, 0 };
+    _vTargetFlushes.assign(vTargets.size(), noFlush);
+
+    UINT64 ullNow = PerfTimer::GetTime();
+    for (size_t iTarget = 0; iTarget < vTargets.size(); iTarget++)
+    {
+        const Target& target = vTargets[iTarget];
+        TargetFlush& flush = _vTargetFlushes[iTarget];
+        flush.ullNextFlushTime = ullNow + PerfTimer::MillisecondsToPerfTime(target.GetFlushTimeInterval());
+
+        // the appends of a group commit log are flushed on their own, unless they are written through
+        bool fIntervalFlush = (target.GetFlushWriteInterval() > 0 || target.GetFlushTimeInterval() > 0);
+        bool fGroupCommitFlush = target.GetGroupCommit() && (target.GetCacheMode() != TargetCacheMode::DisableAllCache);
+        if (!fIntervalFlush && !fGroupCommitFlush)
+        {
+            continue;
+        }
+
+        // NtFlushBuffersFileEx is in Windows 8 and newer, and data-only flushes (Data) in Windows 10 1709
+        // and newer; older systems fail the flush itself
+        if (target.GetFlushMode() != FlushMode::Full && _pfnNtFlushBuffersFileEx == nullptr)
+        {
+            _pfnNtFlushBuffersFileEx = (NtFlushBuffersFileEx)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtFlushBuffersFileEx");
+            if (_pfnNtFlushBuffersFileEx == nullptr)
+            {
+                return false;
+            }
+        }
+
+        // an overlapped handle would let the flush complete asynchronously, with no way to wait for it
+        // apart from the target's other IOs
+        flush.hFile = ReOpenFile(vhTargets[iTarget], GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0);
+        if (INVALID_HANDLE_VALUE == flush.hFile)
+        {
+            return false;
+        }
+        _fActive = _fActive || fIntervalFlush;
+    }
+
+    if (_fActive)
+    {
+        _hFlushEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        if (nullptr == _hFlushEvent)
+        {
+            return false;
+        }
+        _hThread = CreateThread(nullptr, 64 * 1024, _ThreadFunc, this, 0, nullptr);
+        if (nullptr == _hThread)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+DWORD WINAPI FlushInjector::_ThreadFunc(LPVOID pContext)
+{
+    FlushInjector *pInjector = reinterpret_cast<FlushInjector *>(pContext);
+    for (;;)
+    {
+        WaitForSingleObject(pInjector->_hFlushEvent, INFINITE);
+        if (pInjector->_fStop)
+        {
+            break;
+        }
+
+        bool fOk = pInjector->_Flush(pInjector->_lPendingTarget, &pInjector->_ullFlushStartTime, &pInjector->_ullFlushEndTime);
+        pInjector->_dwFlushError = fOk ? ERROR_SUCCESS : GetLastError();
+        InterlockedExchange(&pInjector->_lFlushDone, 1);
+    }
+    return 0;
+}
+
+void FlushInjector::Complete(size_t iTarget, IOOperation type, UINT64 ullIoStartTime)
+{
+    if (!_fActive)
+    {
+        return;
+    }
+
+    if (type == IOOperation::WriteIO)
+    {
+        _vTargetFlushes[iTarget].dwWrites++;
+    }
+
+    // the IO was in flight during the last finished flush or during the one under way
+    if (ullIoStartTime != 0 && *_pfAccountingOn)
+    {
+        UINT64 ullNow = PerfTimer::GetTime();
+        bool fOverlap = (ullIoStartTime < _ullLastFlushEndTime && ullNow > _ullLastFlushStartTime) ||
+                        (_lPendingTarget >= 0 && ullNow > _ullPendingFlushStartTime);
+        if (fOverlap)
+        {
+            float fDuration = static_cast<float>(PerfTimer::PerfTimeToMicroseconds(ullNow - ullIoStartTime));
+            _pResults->vTargetResults[iTarget].flushOverlapLatencyHistogram.Add(fDuration);
+        }
+    }
+}
+
+bool FlushInjector::Run()
+{
+    if (!_fActive)
+    {
+        return true;
+    }
+
+    // one flush at a time; the next one which is due waits for it
+    if (_lPendingTarget >= 0)
+    {
+        if (InterlockedCompareExchange(&_lFlushDone, 0, 1) == 0)
+        {
+            return true;
+        }
+
+        size_t iTarget = _lPendingTarget;
+        _lPendingTarget = -1;
+        if (_dwFlushError != ERROR_SUCCESS)
+        {
+            SetLastError(_dwFlushError);
+            return false;
+        }
+        _Account(iTarget, _ullFlushStartTime, _ullFlushEndTime);
+    }
+
+    UINT64 ullNow = 0;
+    for (size_t iTarget = 0; iTarget < _vTargetFlushes.size(); iTarget++)
+    {
+        const Target& target = (*_pvTargets)[iTarget];
+        TargetFlush& flush = _vTargetFlushes[iTarget];
+        if (INVALID_HANDLE_VALUE == flush.hFile)
+        {
+            continue;
+        }
+
+        bool fDue = (target.GetFlushWriteInterval() > 0 && flush.dwWrites >= target.GetFlushWriteInterval());
+        if (!fDue && target.GetFlushTimeInterval() > 0)
+        {
+            if (ullNow == 0)
+            {
+                ullNow = PerfTimer::GetTime();
+            }
+            fDue = (ullNow >= flush.ullNextFlushTime);
+        }
+
+        if (fDue)
+        {
+            // the flush covers the writes which completed before it was handed over
+            flush.dwWrites = 0;
+            _ullPendingFlushStartTime = PerfTimer::GetTime();
+            _lPendingTarget = static_cast<LONG>(iTarget);
+            SetEvent(_hFlushEvent);
+            break;
+        }
+    }
+    return true;
+}
+
+bool FlushInjector::Flush(size_t iTarget)
+{
+    UINT64 ullStartTime;
+    UINT64 ullEndTime;
+    if (!_Flush(iTarget, &ullStartTime, &ullEndTime))
+    {
+        return false;
+    }
+    _vTargetFlushes[iTarget].dwWrites = 0;
+    _Account(iTarget, ullStartTime, ullEndTime);
+    return true;
+}
+
+bool FlushInjector::_Flush(size_t iTarget, UINT64 *pullStartTime, UINT64 *pullEndTime) const
+{
+    const Target& target = (*_pvTargets)[iTarget];
+    const TargetFlush& flush = _vTargetFlushes[iTarget];
+
+    BOOL fOk;
+    *pullStartTime = PerfTimer::GetTime();
+    if (target.GetFlushMode() == FlushMode::Full)
+    {
+        fOk = FlushFileBuffers(flush.hFile);
+    }
+    else
+    {
+        IO_STATUS_BLOCK ioStatus;
+        ULONG ulFlags = (target.GetFlushMode() == FlushMode::Data) ? FLUSH_FLAGS_FILE_DATA_SYNC_ONLY : (FLUSH_FLAGS_FILE_DATA_ONLY | FLUSH_FLAGS_NO_SYNC);
+        NTSTATUS status = _pfnNtFlushBuffersFileEx(flush.hFile, ulFlags, nullptr, 0, &ioStatus);
+        fOk = (status >= 0);
+        if (!fOk)
+        {
+            SetLastError((DWORD)status);
+        }
+    }
+    *pullEndTime = PerfTimer::GetTime();
+    return (fOk != FALSE);
+}
+
+void FlushInjector::_Account(size_t iTarget, UINT64 ullStartTime, UINT64 ullEndTime)
+{
+    const Target& target = (*_pvTargets)[iTarget];
+    if (*_pfAccountingOn)
+    {
+        TargetResults& targetResults = _pResults->vTargetResults[iTarget];
+        targetResults.ullFlushCount++;
+        targetResults.flushLatencyHistogram.Add(static_cast<float>(PerfTimer::PerfTimeToMicroseconds(ullEndTime - ullStartTime)));
+    }
+
+    // the time interval runs from the end of the last flush, whatever triggered it
+    _vTargetFlushes[iTarget].ullNextFlushTime = ullEndTime + PerfTimer::MillisecondsToPerfTime(target.GetFlushTimeInterval());
+    _ullLastFlushStartTime = ullStartTime;
+    _ullLastFlushEndTime = ullEndTime;
+}
+
+void FlushInjector::Close()
+{
+    // the helper finishes the flush under way before it sees the stop
+    if (nullptr != _hThread)
+    {
+        _fStop = true;
+        SetEvent(_hFlushEvent);
+        WaitForSingleObject(_hThread, INFINITE);
+        CloseHandle(_hThread);
+        _hThread = nullptr;
+    }
+    if (nullptr != _hFlushEvent)
+    {
+        CloseHandle(_hFlushEvent);
+        _hFlushEvent = nullptr;
+    }
+
+    for (auto& flush : _vTargetFlushes)
+    {
+        if (INVALID_HANDLE_VALUE != flush.hFile)
+        {
+            CloseHandle(flush.hFile);
+            flush.hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+    _fActive = false;
+    _lPendingTarget = -1;
+    _lFlushDone = 0;
+}
+
+GroupCommitLog::~GroupCommitLog()
+{
+    if (pBuffer != nullptr)
+    {
+        VirtualFree(pBuffer, 0, MEM_RELEASE);
+        pBuffer = nullptr;
+    }
+}
+
+bool GroupCommitLog::Initialize(const Target& target, UINT64 ullFileSize)
+{
+    bool fOk = true;
+    AcquireSRWLockExclusive(&lock);
+    if (!_fInitialized)
+    {
+        // appends are padded to whole blocks, which keeps them aligned for unbuffered IO
+        UINT64 cbRecords = (target.GetCommitBatchSize() / target.GetCommitRecordSize()) * (UINT64)target.GetCommitRecordSize();
+        UINT64 cbAppend = ((cbRecords + target.GetBlockSizeInBytes() - 1) / target.GetBlockSizeInBytes()) * target.GetBlockSizeInBytes();
+
+        ullStartOffset = target.GetBaseFileOffsetInBytes();
+        ullEndOffset = ullFileSize;
+        if (target.GetMaxFileSize() > 0)
+        {
+            ullEndOffset = min(ullEndOffset, target.GetMaxFileSize());
+        }
+        ullNextOffset = ullStartOffset;
+
+        if (cbAppend > MAXDWORD || ullEndOffset < ullStartOffset || ullEndOffset - ullStartOffset < cbAppend)
+        {
+            SetLastError(ERROR_INVALID_PARAMETER);
+            fOk = false;
+        }
+        else
+        {
+            cbBuffer = static_cast<DWORD>(cbAppend);
+            pBuffer = (BYTE *)VirtualAlloc(nullptr, cbBuffer, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+            fOk = (pBuffer != nullptr);
+        }
+
+        if (fOk && !target.GetZeroWriteBuffers())
+        {
+            for (size_t i = 0; i < cbBuffer; i++)
+            {
+                pBuffer[i] = (BYTE)(i % 256);
+            }
+        }
+        _fInitialized = fOk;
+    }
+    ReleaseSRWLockExclusive(&lock);
+    return fOk;
+}
+
+bool GroupCommitter::Start(const Target& target, HANDLE hFile, UINT64 ullFileSize, GroupCommitLog *pLog, FlushInjector *pFlushInjector,
+                           bool fMeasureLatency, bool fCalculateIopsStdDev, volatile bool *pfAccountingOn, PUINT64 pullStartTime, ThreadResults *pResults,
+                           SchedulingProbe *pSchedulingProbe)
 {
-    LARGE_INTEGER li;
-    QueryPerformanceFrequency(&li);
-    return li.QuadPart;
-}
+    _hFile = hFile;
+    _pLog = pLog;
+    _pFlushInjector = pFlushInjector;
+    _ullInterval = (target.GetCommitRate() > 0) ? PerfTimer::GetFrequency() / target.GetCommitRate() : 0;
+    _ullNextDueTime = 0;
+    _ullDelay = PerfTimer::MicrosecondsToPerfTime(target.GetCommitDelay());
+    _cbRecord = target.GetCommitRecordSize();
+    _cbBlock = target.GetBlockSizeInBytes();
+    _cMaxBatchRecords = target.GetCommitBatchSize() / target.GetCommitRecordSize();
+    _fMeasureLatency = fMeasureLatency;
+    _fCalculateIopsStdDev = fCalculateIopsStdDev;
+    _pfAccountingOn = pfAccountingOn;
+    _pullStartTime = pullStartTime;
+    _pResults = pResults;
+    _pSchedulingProbe = pSchedulingProbe;
+
+    if (!_pLog->Initialize(target, ullFileSize))
+    {
+        return false;
+    }
 
-const UINT64 PerfTimer::TIMER_FREQ = _GetPerfTimerFreq();
+    _hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    return (_hEvent != nullptr);
+}
 
-double PerfTimer::PerfTimeToMicroseconds(const double perfTime)
+bool GroupCommitter::Run()
 {
-    return perfTime / (TIMER_FREQ / 1000000.0);
+    // paced records are timed from when they were due, so that a commit held up behind the
+    // previous one is not left out of the latency; the wait is at millisecond granularity, like
+    // the throughput meter's, and a record committed early is timed from its commit
+    UINT64 ullRecordTime = PerfTimer::GetTime();
+    if (_ullInterval > 0)
+    {
+        if (_ullNextDueTime == 0)
+        {
+            _ullNextDueTime = ullRecordTime;
+        }
+        if (ullRecordTime < _ullNextDueTime)
+        {
+            DWORD dwSleepTime = static_cast<DWORD>(PerfTimer::PerfTimeToMilliseconds(_ullNextDueTime - ullRecordTime));
+            if (dwSleepTime > 0)
+            {
+                _pSchedulingProbe->EnterWait();
+                Sleep(dwSleepTime);
+                _pSchedulingProbe->LeaveWait();
+            }
+        }
+        ullRecordTime = min(_ullNextDueTime, PerfTimer::GetTime());
+        _ullNextDueTime += _ullInterval;
+    }
+
+    bool fOk = true;
+    DWORD dwError = ERROR_SUCCESS;
+    AcquireSRWLockExclusive(&_pLog->lock);
+    UINT64 ullSequence = ++_pLog->ullCommittedSequence;
+    while (_pLog->ullDurableSequence < ullSequence)
+    {
+        if (_pLog->fAppending)
+        {
+            _pSchedulingProbe->EnterWait();
+            SleepConditionVariableSRW(&_pLog->appendDone, &_pLog->lock, INFINITE, 0);
+            _pSchedulingProbe->LeaveWait();
+            continue;
+        }
+
+        _pLog->fAppending = true;
+        if (_ullDelay > 0)
+        {
+            // give the commits of other threads a chance to join the append
+            ReleaseSRWLockExclusive(&_pLog->lock);
+            UINT64 ullDelayEndTime = PerfTimer::GetTime() + _ullDelay;
+            while (PerfTimer::GetTime() < ullDelayEndTime)
+            {
+                YieldProcessor();
+            }
+            AcquireSRWLockExclusive(&_pLog->lock);
+        }
+
+        UINT64 cRecords = min(_pLog->ullCommittedSequence - _pLog->ullDurableSequence, _cMaxBatchRecords);
+        DWORD cbAppend = static_cast<DWORD>(((cRecords * _cbRecord + _cbBlock - 1) / _cbBlock) * _cbBlock);
+        if (_pLog->ullNextOffset + cbAppend > _pLog->ullEndOffset)
+        {
+            _pLog->ullNextOffset = _pLog->ullStartOffset;
+        }
+        UINT64 ullOffset = _pLog->ullNextOffset;
+        _pLog->ullNextOffset += cbAppend;
+        ReleaseSRWLockExclusive(&_pLog->lock);
+
+        _pSchedulingProbe->EnterWait();
+        fOk = _Append(ullOffset, cbAppend, cRecords);
+        dwError = GetLastError();
+        _pSchedulingProbe->LeaveWait();
+
+        AcquireSRWLockExclusive(&_pLog->lock);
+        if (fOk)
+        {
+            _pLog->ullDurableSequence += cRecords;
+        }
+        _pLog->fAppending = false;
+        WakeAllConditionVariable(&_pLog->appendDone);
+        if (!fOk)
+        {
+            break;
+        }
+    }
+    ReleaseSRWLockExclusive(&_pLog->lock);
+
+    if (!fOk)
+    {
+        SetLastError(dwError);
+        return false;
+    }
+
+    if (*_pfAccountingOn)
+    {
+        TargetResults& targetResults = _pResults->vTargetResults[0];
+        targetResults.ullCommitCount++;
+        targetResults.commitLatencyHistogram.Add(static_cast<float>(PerfTimer::PerfTimeToMicroseconds(PerfTimer::GetTime() - ullRecordTime)));
+    }
+    return true;
 }
 
-double PerfTimer::PerfTimeToMilliseconds(const double perfTime)
+bool GroupCommitter::_Append(UINT64 ullOffset, DWORD cbAppend, UINT64 cRecords)
 {
-    return PerfTimeToMicroseconds(perfTime) / 1000;
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(ullOffset);
+    overlapped.OffsetHigh = static_cast<DWORD>(ullOffset >> 32);
+    overlapped.hEvent = _hEvent;
+
+    DWORD dwBytesWritten = 0;
+    UINT64 ullStartTime = PerfTimer::GetTime();
+    if (!WriteFile(_hFile, _pLog->pBuffer, cbAppend, &dwBytesWritten, &overlapped))
+    {
+        if (GetLastError() != ERROR_IO_PENDING || !GetOverlappedResult(_hFile, &overlapped, &dwBytesWritten, TRUE))
+        {
+            return false;
+        }
+    }
+
+    if (*_pfAccountingOn)
+    {
+        UINT64 ullIntendedStartTime = 0;
+        TargetResults& targetResults = _pResults->vTargetResults[0];
+        targetResults.Add(dwBytesWritten,
+            IOOperation::WriteIO,
+            &ullStartTime,
+            &ullIntendedStartTime,
+            nullptr,
+            nullptr,
+            _pullStartTime,
+            _fMeasureLatency,
+            _fCalculateIopsStdDev);
+        targetResults.ullLogAppendCount++;
+        targetResults.ullLogAppendRecordCount += cRecords;
+    }
+
+    return (_pFlushInjector == nullptr) || _pFlushInjector->Flush(0);
 }
 
-double PerfTimer::PerfTimeToSeconds(const double perfTime)
+void GroupCommitter::Close()
 {
-    return PerfTimeToMilliseconds(perfTime) / 1000;
+    if (_hEvent != nullptr)
+    {
+        CloseHandle(_hEvent);
+        _hEvent = nullptr;
+    }
 }
 
-double PerfTimer::PerfTimeToMicroseconds(const UINT64 perfTime)
+// NUMA_NODE_RELATIONSHIP as of Windows Server 2022 and Windows 11, where a node may span processor
+// groups; older headers leave GroupCount in Reserved and have room for one mask, and older systems
+// report it as 0. Nodes spanning groups are only reported in full for RelationNumaNodeEx.
+struct NumaNodeRelationship
 {
-    return PerfTimeToMicroseconds(static_cast<double>(perfTime));
+    DWORD NodeNumber;
+    BYTE Reserved[18];
+    WORD GroupCount;
+    GROUP_AFFINITY GroupMasks[1];
+};
+
+static const LOGICAL_PROCESSOR_RELATIONSHIP RELATION_NUMA_NODE_EX = static_cast<LOGICAL_PROCESSOR_RELATIONSHIP>(6);
+
+static bool ReadLogicalProcessorInformation(LOGICAL_PROCESSOR_RELATIONSHIP relationship, vector<BYTE>& vBuffer)
+{
+    DWORD ReturnedLength = 0;
+    GetLogicalProcessorInformationEx(relationship, nullptr, &ReturnedLength);
+    if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+    {
+        return false;
+    }
+
+    vBuffer.resize(ReturnedLength);
+    if (!GetLogicalProcessorInformationEx(relationship, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)&vBuffer[0], &ReturnedLength))
+    {
+        return false;
+    }
+    vBuffer.resize(ReturnedLength);
+    return true;
 }
 
-double PerfTimer::PerfTimeToMilliseconds(const UINT64 perfTime)
+// adds the node's processors in every group it spans, merging nodes reported once per group
+static void AddNumaNode(vector<ProcessorSetInformation>& vNumaNodes, const PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInformation)
 {
-    return PerfTimeToMilliseconds(static_cast<double>(perfTime));
+    const NumaNodeRelationship *pNode = reinterpret_cast<const NumaNodeRelationship *>(&pInformation->NumaNode);
+    ProcessorSetInformation *pSet = nullptr;
+    for (auto& node : vNumaNodes)
+    {
+        if (node._id == pNode->NodeNumber)
+        {
+            pSet = &node;
+            break;
+        }
+    }
+    if (pSet == nullptr)
+    {
+        vNumaNodes.emplace_back(pNode->NodeNumber);
+        pSet = &vNumaNodes.back();
+    }
+
+    WORD cGroups = max(pNode->GroupCount, (WORD)1);
+    for (WORD i = 0; i < cGroups; i++)
+    {
+        pSet->_vGroupMasks.push_back(pNode->GroupMasks[i]);
+    }
 }
 
-double PerfTimer::PerfTimeToSeconds(const UINT64 perfTime)
+void ProcessorTopology::_ReadProcessorSets()
 {
-    return PerfTimeToSeconds(static_cast<double>(perfTime));
+    // the full extent of the nodes first, where the system can report it
+    vector<BYTE> vNodeBuffer;
+    bool fNodesRead = ReadLogicalProcessorInformation(RELATION_NUMA_NODE_EX, vNodeBuffer);
+    if (fNodesRead)
+    {
+        for (DWORD dwOffset = 0; dwOffset < vNodeBuffer.size();)
+        {
+            PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInformation = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)&vNodeBuffer[dwOffset];
+            if (pInformation->Relationship == RelationNumaNode || pInformation->Relationship == RELATION_NUMA_NODE_EX)
+            {
+                AddNumaNode(_vNumaNodes, pInformation);
+            }
+            dwOffset += pInformation->Size;
+        }
+    }
+
+    vector<BYTE> vBuffer;
+    if (!ReadLogicalProcessorInformation(RelationAll, vBuffer))
+    {
+        return;
+    }
+    DWORD ReturnedLength = static_cast<DWORD>(vBuffer.size());
+
+    // the relationships come back as a packed list of variable size entries
+    for (DWORD dwOffset = 0; dwOffset < ReturnedLength;)
+    {
+        PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInformation = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)&vBuffer[dwOffset];
+        switch (pInformation->Relationship)
+        {
+        case RelationNumaNode:
+            if (!fNodesRead)
+            {
+                AddNumaNode(_vNumaNodes, pInformation);
+            }
+            break;
+
+        case RelationProcessorPackage:
+            _vSockets.emplace_back((DWORD)_vSockets.size());
+            for (WORD i = 0; i < pInformation->Processor.GroupCount; i++)
+            {
+                _vSockets.back()._vGroupMasks.push_back(pInformation->Processor.GroupMask[i]);
+            }
+            break;
+
+        case RelationProcessorCore:
+            _vCores.emplace_back((DWORD)_vCores.size());
+            for (WORD i = 0; i < pInformation->Processor.GroupCount; i++)
+            {
+                _vCores.back()._vGroupMasks.push_back(pInformation->Processor.GroupMask[i]);
+            }
+            break;
+
+        case RelationCache:
+            if (pInformation->Cache.Level == 3)
+            {
+                _vL3Caches.emplace_back((DWORD)_vL3Caches.size());
+                _vL3Caches.back()._vGroupMasks.push_back(pInformation->Cache.GroupMask);
+                _ullL3CacheBytes += pInformation->Cache.CacheSize;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        dwOffset += pInformation->Size;
+    }
 }
 
-UINT64 PerfTimer::MicrosecondsToPerfTime(const double microseconds)
+// Lists the processors of the cores in (or all cores, if pWithin is null) so that the first
+// processor of every core comes before any core's second SMT sibling.
+void ProcessorTopology::_GetCoreOrderedProcessors(const ProcessorSetInformation *pWithin, bool fFirstOfCoreOnly, vector<AffinityAssignment>& vAffinity) const
 {
-    return static_cast<UINT64>(TIMER_FREQ * (microseconds / 1000000.0));
+    vector<vector<AffinityAssignment>> vvCoreProcessors;
+    size_t cMaxSiblings = 0;
+
+    for (const auto& core : _vCores)
+    {
+        vector<AffinityAssignment> vProcessors;
+        for (const auto& mask : core._vGroupMasks)
+        {
+            for (BYTE bProc = 0; bProc < sizeof(KAFFINITY) * 8; bProc++)
+            {
+                if ((((KAFFINITY)1 << bProc) & mask.Mask) != 0)
+                {
+                    vProcessors.emplace_back(mask.Group, bProc);
+                }
+            }
+        }
+
+        if (vProcessors.size() > 0 && (pWithin == nullptr || pWithin->Contains(vProcessors[0].wGroup, vProcessors[0].bProc)))
+        {
+            cMaxSiblings = max(cMaxSiblings, vProcessors.size());
+            vvCoreProcessors.push_back(vProcessors);
+        }
+    }
+
+    if (fFirstOfCoreOnly)
+    {
+        cMaxSiblings = min(cMaxSiblings, (size_t)1);
+    }
+
+    for (size_t iSibling = 0; iSibling < cMaxSiblings; iSibling++)
+    {
+        for (const auto& vProcessors : vvCoreProcessors)
+        {
+            if (iSibling < vProcessors.size())
+            {
+                vAffinity.push_back(vProcessors[iSibling]);
+            }
+        }
+    }
 }
 
-UINT64 PerfTimer::MillisecondsToPerfTime(const double milliseconds)
+bool ProcessorTopology::GetPolicyAffinity(AffinityPolicy Policy, vector<AffinityAssignment>& vAffinity) const
 {
-    return static_cast<UINT64>(TIMER_FREQ * (milliseconds / 1000.0));
+    vAffinity.clear();
+
+    switch (Policy)
+    {
+    case AffinityPolicy::PhysicalCore:
+        _GetCoreOrderedProcessors(nullptr, false, vAffinity);
+        break;
+
+    case AffinityPolicy::AvoidSmt:
+        _GetCoreOrderedProcessors(nullptr, true, vAffinity);
+        break;
+
+    case AffinityPolicy::CompactL3:
+        // without an L3, the last level of cache is shared by the socket
+        if (_vL3Caches.size() > 0)
+        {
+            _GetCoreOrderedProcessors(&_vL3Caches[0], false, vAffinity);
+        }
+        else if (_vSockets.size() > 0)
+        {
+            _GetCoreOrderedProcessors(&_vSockets[0], false, vAffinity);
+        }
+        break;
+
+    case AffinityPolicy::SpreadNodes:
+        {
+            vector<vector<AffinityAssignment>> vvNodeProcessors(_vNumaNodes.size());
+            size_t cMaxProcessors = 0;
+            for (size_t iNode = 0; iNode < _vNumaNodes.size(); iNode++)
+            {
+                _GetCoreOrderedProcessors(&_vNumaNodes[iNode], false, vvNodeProcessors[iNode]);
+                cMaxProcessors = max(cMaxProcessors, vvNodeProcessors[iNode].size());
+            }
+
+            for (size_t iProcessor = 0; iProcessor < cMaxProcessors; iProcessor++)
+            {
+                for (const auto& vProcessors : vvNodeProcessors)
+                {
+                    if (iProcessor < vProcessors.size())
+                    {
+                        vAffinity.push_back(vProcessors[iProcessor]);
+                    }
+                }
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return vAffinity.size() > 0;
 }
 
-UINT64 PerfTimer::SecondsToPerfTime(const double seconds)
+bool ProcessorTopology::GetNumaNodeAffinity(DWORD Node, vector<AffinityAssignment>& vAffinity) const
 {
-    return static_cast<UINT64>(TIMER_FREQ * seconds);
+    vAffinity.clear();
+
+    for (const auto& node : _vNumaNodes)
+    {
+        if (node._id == Node)
+        {
+            _GetCoreOrderedProcessors(&node, false, vAffinity);
+            break;
+        }
+    }
+
+    return vAffinity.size() > 0;
 }
 
 string Util::DoubleToStringHelper(const double d)
@@ -100,6 +2001,20 @@ string Util::DoubleToStringHelper(const double d)
     return string(szFloatBuffer);
 }
 
+// Normal approximation of the binomial distribution of the rank at which a percentile of the
+// underlying population falls in a sample of the given size: the percentile whose sample value
+// bounds the population percentile at the confidence given by z (e.g. -1.96/+1.96 for 95%).
+double Util::PercentileConfidenceBound(const double percentile, const UINT64 ullSampleCount, const double z)
+{
+    if (ullSampleCount == 0)
+    {
+        return percentile;
+    }
+
+    double bound = percentile + z * sqrt(percentile * (1 - percentile) / ullSampleCount);
+    return max(0.0, min(1.0, bound));
+}
+
 string Target::GetXml() const
 {
     char buffer[4096];
@@ -116,6 +2031,8 @@ string Target::GetXml() const
     sXml += _fRandomAccessHint ? "<RandomAccess>true</RandomAccess>\n" : "<RandomAccess>false</RandomAccess>\n";
     sXml += _fTemporaryFileHint ? "<TemporaryFile>true</TemporaryFile>\n" : "<TemporaryFile>false</TemporaryFile>\n";
     sXml += _fUseLargePages ? "<UseLargePages>true</UseLargePages>\n" : "<UseLargePages>false</UseLargePages>\n";
+    sXml += _fLockBuffers ? "<LockBuffers>true</LockBuffers>\n" : "<LockBuffers>false</LockBuffers>\n";
+    sXml += _fVerifyData ? "<VerifyData>true</VerifyData>\n" : "<VerifyData>false</VerifyData>\n";
 
     // TargetCacheMode::Cached is implied default
     switch (_cacheMode) {
@@ -129,12 +2046,43 @@ string Target::GetXml() const
         sXml += "<DisableOSCache>true</DisableOSCache>\n";
         break;
     }
+
+    switch (_workKernel) {
+    case WorkKernel::Crc32c:
+        sXml += "<WorkKernel>Crc32c</WorkKernel>\n";
+        break;
+    case WorkKernel::Encrypt:
+        sXml += "<WorkKernel>Encrypt</WorkKernel>\n";
+        break;
+    case WorkKernel::Copy:
+        sXml += "<WorkKernel>Copy</WorkKernel>\n";
+        break;
+    case WorkKernel::Spin:
+        sXml += "<WorkKernel>Spin</WorkKernel>\n";
+        sprintf_s(buffer, _countof(buffer), "<WorkCyclesPerByte>%u</WorkCyclesPerByte>\n", _dwWorkCyclesPerByte);
+        sXml += buffer;
+        break;
+    }
     
     sXml += "<WriteBufferContent>\n";
     if (_fZeroWriteBuffers)
     {
         sXml += "<Pattern>zero</Pattern>\n";
     }
+    else if (_fRandomizeWriteData)
+    {
+        sXml += "<Pattern>prng</Pattern>\n";
+    }
+    else if (_fGenerateWriteData)
+    {
+        sXml += "<Pattern>generated</Pattern>\n";
+        sXml += "<DataGenerator>\n";
+        sprintf_s(buffer, _countof(buffer), "<CompressionPercent>%u</CompressionPercent>\n", _dwDataCompressionPercent);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<DuplicatePercent>%u</DuplicatePercent>\n", _dwDataDuplicatePercent);
+        sXml += buffer;
+        sXml += "</DataGenerator>\n";
+    }
     else if (_cbRandomDataWriteBuffer == 0)
     {
         sXml += "<Pattern>sequential</Pattern>\n";
@@ -171,6 +2119,87 @@ string Target::GetXml() const
     {
         sprintf_s(buffer, _countof(buffer), "<FileSize>%I64u</FileSize>\n", _ullFileSize);
         sXml += buffer;
+
+        if (_dwFragmentCount > 0)
+        {
+            sprintf_s(buffer, _countof(buffer), "<FragmentCount>%u</FragmentCount>\n", _dwFragmentCount);
+            sXml += buffer;
+        }
+    }
+
+    if (_dwFileSetCount > 0)
+    {
+        sXml += "<FileSet>\n";
+        sprintf_s(buffer, _countof(buffer), "<FileCount>%u</FileCount>\n", _dwFileSetCount);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<FilesPerDirectory>%u</FilesPerDirectory>\n", _dwFilesPerDirectory);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<MinFileSize>%I64u</MinFileSize>\n", _ullFileSetMinFileSize);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<MaxFileSize>%I64u</MaxFileSize>\n", _ullFileSetMaxFileSize);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<Skew>%.3f</Skew>\n", _fFileSetSkew);
+        sXml += buffer;
+        sXml += _fFileSetWholeFile ? "<WholeFile>true</WholeFile>\n" : "<WholeFile>false</WholeFile>\n";
+        sprintf_s(buffer, _countof(buffer), "<HandleCacheSize>%u</HandleCacheSize>\n", _dwHandleCacheSize);
+        sXml += buffer;
+        sXml += "</FileSet>\n";
+    }
+
+    if (_dwFlushWriteInterval > 0 || _dwFlushTimeInterval > 0 || (_fGroupCommit && _flushMode != FlushMode::Full))
+    {
+        sXml += "<Flush>\n";
+        sprintf_s(buffer, _countof(buffer), "<WriteInterval>%u</WriteInterval>\n", _dwFlushWriteInterval);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<TimeInterval>%u</TimeInterval>\n", _dwFlushTimeInterval);
+        sXml += buffer;
+        switch (_flushMode)
+        {
+        case FlushMode::Full:
+            sXml += "<Mode>full</Mode>\n";
+            break;
+        case FlushMode::Data:
+            sXml += "<Mode>data</Mode>\n";
+            break;
+        case FlushMode::Writeback:
+            sXml += "<Mode>writeback</Mode>\n";
+            break;
+        }
+        sXml += "</Flush>\n";
+    }
+
+    if (_fGroupCommit)
+    {
+        sXml += "<GroupCommit>\n";
+        sprintf_s(buffer, _countof(buffer), "<Rate>%u</Rate>\n", _dwCommitRate);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<RecordSize>%u</RecordSize>\n", _dwCommitRecordSize);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<BatchSize>%u</BatchSize>\n", _dwCommitBatchSize);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<Delay>%u</Delay>\n", _dwCommitDelay);
+        sXml += buffer;
+        sXml += "</GroupCommit>\n";
+    }
+
+    if (IsMetadataTarget())
+    {
+        sXml += "<Metadata>\n";
+        sprintf_s(buffer, _countof(buffer), "<Create>%u</Create>\n", GetMetadataWeight(MetadataOperation::Create));
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<Stat>%u</Stat>\n", GetMetadataWeight(MetadataOperation::Stat));
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<Open>%u</Open>\n", GetMetadataWeight(MetadataOperation::Open));
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<Rename>%u</Rename>\n", GetMetadataWeight(MetadataOperation::Rename));
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<Unlink>%u</Unlink>\n", GetMetadataWeight(MetadataOperation::Unlink));
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<FileCount>%u</FileCount>\n", _dwMetadataFileCount);
+        sXml += buffer;
+        sprintf_s(buffer, _countof(buffer), "<FilesPerDirectory>%u</FilesPerDirectory>\n", _dwFilesPerDirectory);
+        sXml += buffer;
+        sXml += "</Metadata>\n";
     }
 
     // If XML contains <Random>, <StrideSize> is ignored
@@ -198,6 +2227,19 @@ string Target::GetXml() const
     sprintf_s(buffer, _countof(buffer), "<RequestCount>%u</RequestCount>\n", _dwRequestCount);
     sXml += buffer;
 
+    if (_dwIoBufferCount > 0)
+    {
+        sprintf_s(buffer, _countof(buffer), "<IoBufferCount>%u</IoBufferCount>\n", _dwIoBufferCount);
+        sXml += buffer;
+    }
+
+    if (_ullBufferWorkingSetSize > 0)
+    {
+        sprintf_s(buffer, _countof(buffer), "<BufferWorkingSetSize>%I64u</BufferWorkingSetSize>\n", _ullBufferWorkingSetSize);
+        sXml += buffer;
+        sXml += _fInterleaveBuffers ? "<InterleaveBuffers>true</InterleaveBuffers>\n" : "<InterleaveBuffers>false</InterleaveBuffers>\n";
+    }
+
     sprintf_s(buffer, _countof(buffer), "<WriteRatio>%u</WriteRatio>\n", _ulWriteRatio);
     sXml += buffer;
 
@@ -270,11 +2312,73 @@ bool Target::_FillRandomDataWriteBuffer()
         }
         else
         {
-            fOk = false;
-            // TODO: print error message?
+            fOk = false;
+            // TODO: print error message?
+        }
+    }
+    return fOk;
+}
+
+DWORD Target::GetIoBufferCount() const
+{
+    if (_ullBufferWorkingSetSize > 0)
+    {
+        UINT64 cBlocks = max(_ullBufferWorkingSetSize / _dwBlockSize, (UINT64)1);
+        return static_cast<DWORD>(min(cBlocks, (UINT64)MAXDWORD));
+    }
+
+    return (_dwIoBufferCount > 0 && _dwIoBufferCount < _dwRequestCount) ? _dwIoBufferCount : _dwRequestCount;
+}
+
+UINT64 Target::GetFileSetFileSize(UINT64 iFile) const
+{
+    // every file has a fixed size, derived from its number, so that it needs no lookup
+    UINT64 ullMinSize = max(_ullFileSetMinFileSize, (UINT64)_dwBlockSize) / _dwBlockSize * _dwBlockSize;
+    UINT64 ullMaxSize = max(_ullFileSetMaxFileSize, ullMinSize);
+    UINT64 cSizes = (ullMaxSize - ullMinSize) / _dwBlockSize + 1;
+    return ullMinSize + (MixBits(iFile) % cSizes) * _dwBlockSize;
+}
+
+bool Target::IsMetadataTarget() const
+{
+    for (auto dw : _vdwMetadataWeights)
+    {
+        if (dw > 0)
+        {
+            return true;
         }
     }
-    return fOk;
+    return false;
+}
+
+string Target::GetFileSetFilePath(UINT64 iFile) const
+{
+    char szFile[64];
+    sprintf_s(szFile, _countof(szFile), "d%06I64u\\f%09I64u.dat", iFile / max(_dwFilesPerDirectory, (DWORD)1), iFile);
+
+    string sPath(_sPath);
+    if (!sPath.empty() && sPath[sPath.length() - 1] != '\\')
+    {
+        sPath += '\\';
+    }
+    return sPath + szFile;
+}
+
+// Takes the first-touch fault on every page of a freshly committed buffer now rather than during the
+// measured IOs, then locks the buffer into the working set so it is not trimmed during the run.
+// Large page allocations are always resident and non-pageable, so they do not need this.
+static bool PrefaultAndLockBuffer(BYTE *pBuffer, size_t cbBuffer)
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    volatile BYTE *pTouch = pBuffer;
+    for (size_t i = 0; i < cbBuffer; i += systemInfo.dwPageSize)
+    {
+        pTouch[i] = pTouch[i];
+    }
+
+    return (VirtualLock(pBuffer, cbBuffer) != FALSE);
 }
 
 bool Target::AllocateAndFillRandomDataWriteBuffer()
@@ -301,6 +2405,10 @@ bool Target::AllocateAndFillRandomDataWriteBuffer()
     {
         fOk = _FillRandomDataWriteBuffer();
     }
+    if (fOk && GetLockBuffers() && !GetUseLargePages())
+    {
+        fOk = PrefaultAndLockBuffer(_pRandomDataWriteBuffer, cb);
+    }
     return fOk;
 }
 
@@ -349,6 +2457,14 @@ string TimeSpan::GetXml() const
     sXml += _fMeasureLatency ? "<MeasureLatency>true</MeasureLatency>\n" : "<MeasureLatency>false</MeasureLatency>\n";
     sXml += _fCalculateIopsStdDev ? "<CalculateIopsStdDev>true</CalculateIopsStdDev>\n" : "<CalculateIopsStdDev>false</CalculateIopsStdDev>\n";
     sXml += _fDisableAffinity ? "<DisableAffinity>true</DisableAffinity>\n" : "<DisableAffinity>false</DisableAffinity>\n";
+    sXml += _fProfileCpuCycles ? "<ProfileCpuCycles>true</ProfileCpuCycles>\n" : "<ProfileCpuCycles>false</ProfileCpuCycles>\n";
+    sXml += _fHardwareCounters ? "<HardwareCounters>true</HardwareCounters>\n" : "<HardwareCounters>false</HardwareCounters>\n";
+    sXml += _fDeviceStatistics ? "<DeviceStatistics>true</DeviceStatistics>\n" : "<DeviceStatistics>false</DeviceStatistics>\n";
+    sXml += _fSchedulingDelay ? "<SchedulingDelay>true</SchedulingDelay>\n" : "<SchedulingDelay>false</SchedulingDelay>\n";
+    sXml += _fCpuEfficiency ? "<CpuEfficiency>true</CpuEfficiency>\n" : "<CpuEfficiency>false</CpuEfficiency>\n";
+
+    sprintf_s(buffer, _countof(buffer), "<LatencySampleRate>%u</LatencySampleRate>\n", _ulLatencySampleRate);
+    sXml += buffer;
 
     sprintf_s(buffer, _countof(buffer), "<Duration>%u</Duration>\n", _ulDuration);
     sXml += buffer;
@@ -368,6 +2484,27 @@ string TimeSpan::GetXml() const
     sprintf_s(buffer, _countof(buffer), "<RandSeed>%u</RandSeed>\n", _ulRandSeed);
     sXml += buffer;
 
+    if (_affinityPolicy == AffinityPolicy::PhysicalCore)
+    {
+        sXml += "<AffinityPolicy>PhysicalCore</AffinityPolicy>\n";
+    }
+    else if (_affinityPolicy == AffinityPolicy::SpreadNodes)
+    {
+        sXml += "<AffinityPolicy>SpreadNodes</AffinityPolicy>\n";
+    }
+    else if (_affinityPolicy == AffinityPolicy::CompactL3)
+    {
+        sXml += "<AffinityPolicy>CompactL3</AffinityPolicy>\n";
+    }
+    else if (_affinityPolicy == AffinityPolicy::AvoidSmt)
+    {
+        sXml += "<AffinityPolicy>AvoidSmt</AffinityPolicy>\n";
+    }
+    else if (_affinityPolicy == AffinityPolicy::DeviceLocal)
+    {
+        sXml += "<AffinityPolicy>DeviceLocal</AffinityPolicy>\n";
+    }
+
     if (_vAffinity.size() > 0)
     {
         sXml += "<Affinity>\n";
@@ -533,12 +2670,50 @@ bool Profile::Validate(bool fSingleSpec, SystemInformation *pSystem) const
                 }
             }
 
+            if (timeSpan.GetLatencySampleRate() == 0)
+            {
+                fprintf(stderr, "ERROR: latency sample rate must be at least 1\n");
+                fOk = false;
+            }
+
+            if (timeSpan.GetLatencySampleRate() > 1 && !timeSpan.GetMeasureLatency())
+            {
+                fprintf(stderr, "WARNING: latency sample rate has no effect unless latency is measured\n");
+            }
+
+            if (timeSpan.GetHardwareCounters() && !HardwareCounters::IsAvailable())
+            {
+                fprintf(stderr, "WARNING: hardware performance counters are not accessible from user mode and will not be reported\n");
+            }
+
+            // the counters are the core's: a thread which moves between cores mixes the counts of several
+            if (timeSpan.GetHardwareCounters() && timeSpan.GetDisableAffinity())
+            {
+                fprintf(stderr, "ERROR: hardware performance counters (-Mh) need threads affinitized to their processors and cannot be used with -n\n");
+                fOk = false;
+            }
+
             if (timeSpan.GetDisableAffinity() && timeSpan.GetAffinityAssignments().size() > 0)
             {
                 fprintf(stderr, "ERROR: -n and -a parameters cannot be used together\n");
                 fOk = false;
             }
 
+            if (timeSpan.GetAffinityPolicy() != AffinityPolicy::RoundRobin)
+            {
+                if (timeSpan.GetDisableAffinity())
+                {
+                    fprintf(stderr, "ERROR: -n and an affinity policy cannot be used together\n");
+                    fOk = false;
+                }
+
+                if (timeSpan.GetAffinityAssignments().size() > 0)
+                {
+                    fprintf(stderr, "ERROR: an affinity policy cannot be combined with an explicit affinity assignment\n");
+                    fOk = false;
+                }
+            }
+
             for (const auto& target : timeSpan.GetTargets())
             {
                 const bool targetHasMultipleThreads = (timeSpan.GetThreadCount() > 1) || (target.GetThreadsPerFile() > 1);
@@ -639,6 +2814,257 @@ bool Profile::Validate(bool fSingleSpec, SystemInformation *pSystem) const
                     }
                 }
 
+                if (target.GetWorkKernel() == WorkKernel::Encrypt && !WorkStage::IsEncryptAvailable())
+                {
+                    fprintf(stderr, "ERROR: the encrypt work stage (-Ke) requires a processor with AES-NI\n");
+                    fOk = false;
+                }
+
+                if (target.GetWorkKernel() == WorkKernel::Spin && target.GetWorkCyclesPerByte() == 0)
+                {
+                    fprintf(stderr, "ERROR: the spin work stage (-Ks) needs a number of cycles per byte\n");
+                    fOk = false;
+                }
+
+                if (target.GetInterleaveBuffers())
+                {
+                    if (target.GetBufferWorkingSetSize() == 0)
+                    {
+                        fprintf(stderr, "ERROR: buffer interleaving requires a buffer working set (-mi<size>)\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetUseLargePages())
+                    {
+                        fprintf(stderr, "ERROR: interleaved buffers (-mi) cannot be used with large pages (-l)\n");
+                        fOk = false;
+                    }
+
+                    if (timeSpan.GetAffinityPolicy() == AffinityPolicy::DeviceLocal)
+                    {
+                        fprintf(stderr, "ERROR: interleaved buffers (-mi) conflict with device-local affinity (-ad)\n");
+                        fOk = false;
+                    }
+                }
+
+                if (target.GetRandomizeWriteData())
+                {
+                    if (target.GetZeroWriteBuffers() || target.GetRandomDataWriteBufferSize() > 0 || target.GetGenerateWriteData())
+                    {
+                        fprintf(stderr, "ERROR: per-write random data (-Zr) cannot be combined with other write buffer content (-Z)\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetBufferWorkingSetSize() > 0 || target.GetIoBufferCount() < target.GetRequestCount())
+                    {
+                        fprintf(stderr, "ERROR: per-write random data (-Zr) needs a buffer per outstanding IO and cannot be used with -q or -m\n");
+                        fOk = false;
+                    }
+                }
+
+                if (target.GetFragmentCount() > 0 && !target.GetCreateFile())
+                {
+                    fprintf(stderr, "ERROR: a fragmented layout can only be given to files diskspd creates (-c<size>,<extents>)\n");
+                    fOk = false;
+                }
+                else if (target.GetFragmentCount() > 0)
+                {
+                    UINT64 ullExtentSize = Target::GetFragmentExtentSize(target.GetFileSize(), target.GetFragmentCount());
+                    UINT64 ullExtents = (target.GetFileSize() + ullExtentSize - 1) / ullExtentSize;
+                    if (ullExtents < target.GetFragmentCount())
+                    {
+                        fprintf(stderr, "ERROR: a %I64u byte file can only be laid out in %I64u extents, not %u; extents are multiples of %I64uKiB\n",
+                                target.GetFileSize(),
+                                ullExtents,
+                                target.GetFragmentCount(),
+                                Target::FRAGMENT_ALIGNMENT_BYTES / 1024);
+                        fOk = false;
+                    }
+                }
+
+                if (target.GetFileSetCount() > 0)
+                {
+                    const string sPath = target.GetPath();
+                    if (sPath.empty() || '#' == sPath[0] || (sPath.length() == 2 && ':' == sPath[1]))
+                    {
+                        fprintf(stderr, "ERROR: a file set (-Q) needs a directory as its target\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetCreateFile() || target.GetVerifyData())
+                    {
+                        fprintf(stderr, "ERROR: a file set (-Q) creates its own files and cannot be used with -c or -V\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetCacheMode() == TargetCacheMode::DisableLocalCache)
+                    {
+                        fprintf(stderr, "ERROR: a file set (-Q) cannot be used with -Sr\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetFileSetMaxFileSize() > 0 && target.GetFileSetMaxFileSize() < target.GetFileSetMinFileSize())
+                    {
+                        fprintf(stderr, "ERROR: the largest file of a file set (-Qs) must not be smaller than the smallest\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetFileSetSkew() < 0 || target.GetFileSetSkew() >= 1)
+                    {
+                        fprintf(stderr, "ERROR: the skew of a file set (-Qz) must be at least 0 and below 1\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetHandleCacheSize() == 0 || target.GetFilesPerDirectory() == 0)
+                    {
+                        fprintf(stderr, "ERROR: the handle cache (-Qh) and the directories of a file set must hold at least one file\n");
+                        fOk = false;
+                    }
+
+                    // a file set picks its own files and offsets in them (-Qz, -Qw); a stride equal to the
+                    // block size is what the XML profile of any target carries, and changes nothing
+                    if (target.GetUseRandomAccessPattern() ||
+                        target.GetBlockAlignmentInBytes() != target.GetBlockSizeInBytes() ||
+                        target.GetUseInterlockedSequential() ||
+                        target.GetBaseFileOffsetInBytes() > 0 ||
+                        target.GetThreadStrideInBytes() > 0 ||
+                        target.GetMaxFileSize() > 0)
+                    {
+                        fprintf(stderr, "ERROR: a file set (-Q) chooses its own offsets and cannot be used with -r, -s, -B, -T or -f\n");
+                        fOk = false;
+                    }
+                }
+
+                if (target.IsMetadataTarget())
+                {
+                    const string sPath = target.GetPath();
+                    if (sPath.empty() || '#' == sPath[0] || (sPath.length() == 2 && ':' == sPath[1]))
+                    {
+                        fprintf(stderr, "ERROR: metadata operations (-N) need a directory as their target\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetFileSetCount() > 0 || target.GetCreateFile() || target.GetVerifyData())
+                    {
+                        fprintf(stderr, "ERROR: metadata operations (-N) work on files of their own and cannot be used with -Q, -c or -V\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetMetadataFileCount() == 0 || target.GetFilesPerDirectory() == 0)
+                    {
+                        fprintf(stderr, "ERROR: metadata operations (-Nf) need at least one file, and at least one to a directory\n");
+                        fOk = false;
+                    }
+
+                    // with a fixed thread count every thread works on every target
+                    if (timeSpan.GetThreadCount() > 0)
+                    {
+                        for (const auto& otherTarget : timeSpan.GetTargets())
+                        {
+                            if (!otherTarget.IsMetadataTarget())
+                            {
+                                fprintf(stderr, "ERROR: with -F, metadata targets (-N) cannot be mixed with targets of reads and writes\n");
+                                fOk = false;
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                if (target.GetFlushWriteInterval() > 0 || target.GetFlushTimeInterval() > 0)
+                {
+                    if (target.GetFileSetCount() > 0 || target.IsMetadataTarget())
+                    {
+                        fprintf(stderr, "ERROR: flushes (-Y) cannot be injected into file sets (-Q) or metadata operations (-N)\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetWriteRatio() == 0 && !target.GetGroupCommit())
+                    {
+                        fprintf(stderr, "WARNING: flushes (-Y) of a target which is only read have nothing to write out\n");
+                    }
+                }
+
+                if (target.GetGroupCommit())
+                {
+                    if (target.GetFileSetCount() > 0 || target.IsMetadataTarget() || target.GetVerifyData())
+                    {
+                        fprintf(stderr, "ERROR: a group commit log (-G) cannot be used with -Q, -N or -V\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetFlushWriteInterval() > 0 || target.GetFlushTimeInterval() > 0)
+                    {
+                        fprintf(stderr, "ERROR: a group commit log (-G) flushes every append unless it is written through (-Sh) and cannot be used with -Yw or -Yt\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetCommitRecordSize() == 0 || target.GetCommitBatchSize() < target.GetCommitRecordSize())
+                    {
+                        fprintf(stderr, "ERROR: an append to a group commit log (-Gb) must hold at least one record (-Gs)\n");
+                        fOk = false;
+                    }
+
+                    // with a fixed thread count every thread works on every target
+                    if (timeSpan.GetThreadCount() > 0 && timeSpan.GetTargets().size() > 1)
+                    {
+                        fprintf(stderr, "ERROR: with -F, a group commit log (-G) must be the only target\n");
+                        fOk = false;
+                    }
+                }
+
+                if (target.GetGenerateWriteData())
+                {
+                    if (target.GetZeroWriteBuffers() || target.GetRandomDataWriteBufferSize() > 0)
+                    {
+                        fprintf(stderr, "ERROR: generated write data (-Zc) cannot be combined with other write buffer content (-Z)\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetDataCompressionPercent() > 100 || target.GetDataDuplicatePercent() > 100)
+                    {
+                        fprintf(stderr, "ERROR: generated write data (-Zc) compression and duplicate percentages must be between 0 and 100\n");
+                        fOk = false;
+                    }
+
+                    // filling a buffer which an IO in flight may still be writing from would tear its data
+                    if (target.GetBufferWorkingSetSize() > 0 || target.GetIoBufferCount() < target.GetRequestCount())
+                    {
+                        fprintf(stderr, "ERROR: generated write data (-Zc) needs a buffer per outstanding IO and cannot be used with -q or -m\n");
+                        fOk = false;
+                    }
+                }
+
+                if (target.GetVerifyData())
+                {
+                    // every IO in flight needs a buffer of its own to stamp or check
+                    if (target.GetRandomDataWriteBufferSize() > 0)
+                    {
+                        fprintf(stderr, "ERROR: data verification (-V) cannot be used with a custom write buffer (-Z)\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetBufferWorkingSetSize() > 0 || target.GetIoBufferCount() < target.GetRequestCount())
+                    {
+                        fprintf(stderr, "ERROR: data verification (-V) needs a buffer per outstanding IO and cannot be used with -q or -m\n");
+                        fOk = false;
+                    }
+
+                    if (target.GetBlockSizeInBytes() < sizeof(BlockStamp))
+                    {
+                        fprintf(stderr, "ERROR: data verification (-V) requires a block size of at least %u bytes\n", (UINT32)sizeof(BlockStamp));
+                        fOk = false;
+                    }
+
+                    if (target.GetBlockAlignmentInBytes() % target.GetBlockSizeInBytes() != 0 ||
+                        target.GetBaseFileOffsetInBytes() % target.GetBlockSizeInBytes() != 0 ||
+                        target.GetThreadStrideInBytes() % target.GetBlockSizeInBytes() != 0)
+                    {
+                        fprintf(stderr, "ERROR: data verification (-V) requires block aligned IO; -r/-s, -B and -T must be multiples of the block size\n");
+                        fOk = false;
+                    }
+                }
+
                 if (target.GetRandomDataWriteBufferSize() > 0)
                 {
                     if (target.GetRandomDataWriteBufferSize() < target.GetBlockSizeInBytes())
@@ -665,20 +3091,87 @@ bool Profile::Validate(bool fSingleSpec, SystemInformation *pSystem) const
     return fOk;
 }
 
-bool ThreadParameters::AllocateAndFillBufferForTarget(const Target& target)
+// Commits a reserved buffer one block (rounded up to whole pages) at a time, taking each block's
+// pages from the next NUMA node in turn, so consecutive IOs DMA into memory on different nodes.
+// Node numbers need not be contiguous and a node need not have memory, so the nodes are those of
+// the topology which report memory; with none, the buffer is committed with the default placement.
+static bool CommitInterleaved(BYTE *pBuffer, size_t cbBuffer, size_t cbBlock)
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    size_t cbChunk = (cbBlock + systemInfo.dwPageSize - 1) & ~((size_t)systemInfo.dwPageSize - 1);
+
+    // a node spanning processor groups may be listed once per group
+    vector<USHORT> vusNodes;
+    for (const auto& node : g_SystemInformation.processorTopology._vNumaNodes)
+    {
+        USHORT usNode = static_cast<USHORT>(node._id);
+        bool fListed = false;
+        for (auto usListed : vusNodes)
+        {
+            fListed = fListed || (usListed == usNode);
+        }
+
+        ULONGLONG ullAvailableBytes = 0;
+        if (!fListed && GetNumaAvailableMemoryNodeEx(usNode, &ullAvailableBytes) && ullAvailableBytes > 0)
+        {
+            vusNodes.push_back(usNode);
+        }
+    }
+
+    if (vusNodes.empty())
+    {
+        return (VirtualAlloc(pBuffer, cbBuffer, MEM_COMMIT, PAGE_READWRITE) != nullptr);
+    }
+
+    size_t iNode = 0;
+    for (size_t cbOffset = 0; cbOffset < cbBuffer; cbOffset += cbChunk)
+    {
+        size_t cbCommit = min(cbChunk, cbBuffer - cbOffset);
+        if (VirtualAllocExNuma(GetCurrentProcess(), pBuffer + cbOffset, cbCommit, MEM_COMMIT, PAGE_READWRITE, vusNodes[iNode]) == nullptr)
+        {
+            return false;
+        }
+        iNode = (iNode + 1) % vusNodes.size();
+    }
+    return true;
+}
+
+// dwNumaNode is the node the buffer's pages should come from, or NUMA_NO_NODE for the default placement
+bool ThreadParameters::AllocateAndFillBufferForTarget(const Target& target, DWORD dwNumaNode)
 {
     bool fOk = true;
     BYTE *pDataBuffer = nullptr;
-    size_t cbDataBuffer = target.GetBlockSizeInBytes() * target.GetRequestCount();
+    size_t cbDataBuffer = target.GetBlockSizeInBytes() * target.GetIoBufferCount();
+    size_t cbAllocation = cbDataBuffer;
+    DWORD dwAllocationType = MEM_COMMIT;
+    DWORD dwProtect = PAGE_READWRITE;
     if (target.GetUseLargePages())
     {
         size_t cbMinLargePage = GetLargePageMinimum();
-        size_t cbRoundedSize = (cbDataBuffer + cbMinLargePage - 1) & ~(cbMinLargePage - 1);
-        pDataBuffer = (BYTE *)VirtualAlloc(nullptr, cbRoundedSize, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_EXECUTE_READWRITE);
+        cbAllocation = (cbDataBuffer + cbMinLargePage - 1) & ~(cbMinLargePage - 1);
+        dwAllocationType = MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES;
+        dwProtect = PAGE_EXECUTE_READWRITE;
+    }
+
+    if (target.GetInterleaveBuffers())
+    {
+        pDataBuffer = (BYTE *)VirtualAlloc(nullptr, cbAllocation, MEM_RESERVE, dwProtect);
+        if (pDataBuffer != nullptr && !CommitInterleaved(pDataBuffer, cbAllocation, target.GetBlockSizeInBytes()))
+        {
+            DWORD dwError = GetLastError();
+            VirtualFree(pDataBuffer, 0, MEM_RELEASE);
+            SetLastError(dwError);
+            pDataBuffer = nullptr;
+        }
+    }
+    else if (dwNumaNode != NUMA_NO_NODE)
+    {
+        pDataBuffer = (BYTE *)VirtualAllocExNuma(GetCurrentProcess(), nullptr, cbAllocation, dwAllocationType | MEM_RESERVE, dwProtect, dwNumaNode);
     }
     else
     {
-        pDataBuffer = (BYTE *)VirtualAlloc(nullptr, cbDataBuffer, MEM_COMMIT, PAGE_READWRITE);
+        pDataBuffer = (BYTE *)VirtualAlloc(nullptr, cbAllocation, dwAllocationType, dwProtect);
     }
 
     fOk = (pDataBuffer != nullptr);
@@ -699,17 +3192,45 @@ bool ThreadParameters::AllocateAndFillBufferForTarget(const Target& target)
         }
     }
 
+    if (fOk && target.GetLockBuffers() && !target.GetUseLargePages())
+    {
+        fOk = PrefaultAndLockBuffer(pDataBuffer, cbDataBuffer);
+        if (!fOk)
+        {
+            DWORD dwError = GetLastError();
+            VirtualFree(pDataBuffer, 0, MEM_RELEASE);
+            SetLastError(dwError);
+        }
+    }
+
     if (fOk)
     {
         vpDataBuffers.push_back(pDataBuffer);
+        vulNextBufferBlock.push_back(0);
     }
 
     return fOk;
 }
 
+size_t ThreadParameters::_GetBufferBlock(size_t iTarget, size_t iRequest)
+{
+    const Target& target(vTargets[iTarget]);
+    size_t cBlocks = target.GetIoBufferCount();
+    if (target.GetBufferWorkingSetSize() == 0)
+    {
+        return iRequest % cBlocks;
+    }
+
+    // rotate through the working set; blocks still owned by an in-flight IO can be reused safely,
+    // just as in the bounded buffer pool
+    size_t iBlock = vulNextBufferBlock[iTarget];
+    vulNextBufferBlock[iTarget] = (iBlock + 1) % cBlocks;
+    return iBlock;
+}
+
 BYTE* ThreadParameters::GetReadBuffer(size_t iTarget, size_t iRequest)
 {
-    return vpDataBuffers[iTarget] + (iRequest * vTargets[iTarget].GetBlockSizeInBytes());
+    return vpDataBuffers[iTarget] + (_GetBufferBlock(iTarget, iRequest) * vTargets[iTarget].GetBlockSizeInBytes());
 }
 
 BYTE* ThreadParameters::GetWriteBuffer(size_t iTarget, size_t iRequest)
@@ -720,7 +3241,7 @@ BYTE* ThreadParameters::GetWriteBuffer(size_t iTarget, size_t iRequest)
     size_t cb = static_cast<size_t>(target.GetRandomDataWriteBufferSize());
     if (cb == 0)
     {
-        pBuffer = vpDataBuffers[iTarget] + (iRequest * vTargets[iTarget].GetBlockSizeInBytes());
+        pBuffer = vpDataBuffers[iTarget] + (_GetBufferBlock(iTarget, iRequest) * target.GetBlockSizeInBytes());
     }
     else
     {
@@ -729,6 +3250,34 @@ BYTE* ThreadParameters::GetWriteBuffer(size_t iTarget, size_t iRequest)
     return pBuffer;
 }
 
+// gives a write buffer its content for the next write, if the target generates it per write (-Zr, -Zc);
+// called before the IO's latency starts
+void ThreadParameters::PrepareWriteBuffer(size_t iTarget, BYTE *pBuffer)
+{
+    const Target& target(vTargets[iTarget]);
+    if (target.GetRandomDataWriteBufferSize() == 0)
+    {
+        writeDataGenerator.Fill(iTarget, target, pBuffer, target.GetBlockSizeInBytes());
+    }
+}
+
+// for a file set target, also moves the IO's offset into the file chosen for it
+HANDLE ThreadParameters::GetIoHandle(size_t iTarget, size_t iOverlapped)
+{
+    if (vTargets[iTarget].GetFileSetCount() == 0)
+    {
+        return vhTargets[iTarget];
+    }
+
+    LARGE_INTEGER li;
+    UINT64 ullOffset = 0;
+    HANDLE hFile = fileSetCache.Acquire(iTarget, iOverlapped, &ullOffset);
+    li.QuadPart = ullOffset;
+    vOverlapped[iOverlapped].Offset = li.LowPart;
+    vOverlapped[iOverlapped].OffsetHigh = li.HighPart;
+    return hFile;
+}
+
 DWORD ThreadParameters::GetTotalRequestCount() const
 {
     DWORD cRequests = 0;
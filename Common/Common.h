@@ -32,8 +32,11 @@ SOFTWARE.
 #include <windows.h>
 #include <ctime>
 #include <vector>
+#include <list>
+#include <unordered_map>
 #include <Winternl.h>   //ntdll.dll
 #include <assert.h>
+#include <intrin.h>     //__rdtsc, __cpuid
 #include "Histogram.h"
 #include "IoBucketizer.h"
 
@@ -135,12 +138,23 @@ namespace UnitTests
     class TargetUnitTests;
 }
 
+// PerfTimer reads the invariant TSC directly when the processor advertises one and it
+// passes a calibration self-check against QPC at startup; otherwise it falls back to QPC.
+enum class TimerSource {
+    Qpc = 1,
+    InvariantTsc
+};
+
 class PerfTimer
 {
 public:
 
     static UINT64 GetTime();
 
+    static TimerSource GetSource();
+    static const char* GetSourceName();
+    static UINT64 GetFrequency();
+
     static double PerfTimeToMicroseconds(const double);
     static double PerfTimeToMilliseconds(const double);
     static double PerfTimeToSeconds(const double);
@@ -154,7 +168,9 @@ public:
 
 private:
 
+    static const UINT64 TSC_FREQ;       // zero if the TSC is not used
     static const UINT64 TIMER_FREQ;
+    static UINT64 _CalibrateTscFreq();
     static UINT64 _GetPerfTimerFreq();
 
     friend class UnitTests::PerfTimerUnitTests;
@@ -170,6 +186,7 @@ class Util
 {
 public:
     static string DoubleToStringHelper(const double);
+    static double PercentileConfidenceBound(const double percentile, const UINT64 ullSampleCount, const double z);
     template<typename T> static T QuotientCeiling(T dividend, T divisor)
     {
         return (dividend + divisor - 1) / divisor;
@@ -183,6 +200,38 @@ enum class IOOperation
     WriteIO
 };
 
+// operations of a metadata target (-N)
+enum class MetadataOperation
+{
+    Create = 0,     // create a new, empty file
+    Stat,           // query the attributes of a file
+    Open,           // open a file and close it again
+    Rename,         // rename a file within its directory
+    Unlink,         // delete a file
+    Count
+};
+
+// Ways in which a read of a stamped block can fail data verification (-V)
+enum class VerifyFailureType
+{
+    Corrupt,        // the block's CRC32C does not match its contents (torn or corrupted write)
+    Misdirected,    // the block was stamped for another offset
+    Stale,          // the block is older than a write to it which had already completed
+    Missing         // the block has no stamp although a write to it had already completed
+};
+
+struct VerifyFailure
+{
+    VerifyFailureType type;
+    UINT64 ullOffset;               // offset the block was read from
+    bool fMeasured;                 // whether the read completed inside the measured window
+    UINT64 ullTime;                 // if so, when (PerfTimer units since the window began)
+    UINT64 ullExpectedSequence;     // oldest write the read should have seen
+    UINT64 ullFoundSequence;        // write the block was stamped by
+    UINT64 ullFoundOffset;          // offset the block was stamped for
+    UINT32 ulWriterThreadNo;        // thread which stamped the block
+};
+
 class TargetResults
 {
 public:
@@ -193,14 +242,53 @@ public:
         ullReadBytesCount(0),
         ullReadIOCount(0),
         ullWriteBytesCount(0),
-        ullWriteIOCount(0)
+        ullWriteIOCount(0),
+        ullScheduleSlipCount(0),
+        ullScheduleSlipTime(0),
+        ullWorkTime(0),
+        ullWorkCycles(0),
+        ullWorkBytes(0),
+        ullWriteFillTime(0),
+        ullWriteFillBytes(0),
+        ullWriteFillCount(0),
+        ullStampedWriteCount(0),
+        ullVerifiedReadCount(0),
+        ullUnverifiedReadCount(0),
+        ullVerifyFailureCount(0),
+        ullFileOpenCount(0),
+        ullFileOpenTime(0),
+        ullFileCloseCount(0),
+        ullFileCloseTime(0),
+        ullHandleCacheHitCount(0),
+        ullFlushCount(0),
+        ullCommitCount(0),
+        ullLogAppendCount(0),
+        ullLogAppendRecordCount(0),
+        dwDeviceNumaNode(NUMA_NO_NODE),
+        ullDataBufferBytes(0),
+        ullDataBufferPageSize(0),
+        fDataBufferLocked(false),
+        ullWriteBufferPageSize(0),
+        fWriteBufferLocked(false)
     {
+        for (auto& ull : vullMetadataCount)
+        {
+            ull = 0;
+        }
+    }
 
+    void AddMetadata(MetadataOperation type, UINT64 ullDuration)
+    {
+        vullMetadataCount[static_cast<int>(type)]++;
+        vMetadataLatencyHistograms[static_cast<int>(type)].Add(static_cast<float>(PerfTimer::PerfTimeToMicroseconds(ullDuration)));
     }
 
     void Add(DWORD dwBytesTransferred,
              IOOperation type,
              PUINT64 pullIoStartTime,
+             PUINT64 pullIntendedStartTime,
+             PUINT64 pullSubmitEndTime,
+             PUINT64 pullDequeueTime,
              PUINT64 pullSpanStartTime,
              bool fMeasureLatency,
              bool fCalculateIopsStdDev
@@ -227,6 +315,56 @@ public:
             {
                 writeLatencyHistogram.Add(fDurationMsec);
             }
+
+            // paced IOs are also measured from the time the schedule intended to issue them,
+            // so that stalls which delayed their submission are not omitted from the latency
+            if (*pullIntendedStartTime != 0)
+            {
+                UINT64 ullIntendedStartTime = min(*pullIntendedStartTime, *pullIoStartTime);
+                float fCorrectedDurationMsec = static_cast<float>(PerfTimer::PerfTimeToMicroseconds(ullEndTime - ullIntendedStartTime));
+
+                if (type == IOOperation::ReadIO)
+                {
+                    readCorrectedLatencyHistogram.Add(fCorrectedDurationMsec);
+                }
+                else
+                {
+                    writeCorrectedLatencyHistogram.Add(fCorrectedDurationMsec);
+                }
+
+                // the pacing works at millisecond granularity; only lateness beyond that is a slip
+                UINT64 ullSlip = *pullIoStartTime - ullIntendedStartTime;
+                if (ullSlip > PerfTimer::MillisecondsToPerfTime(1))
+                {
+                    ullScheduleSlipCount++;
+                    ullScheduleSlipTime += ullSlip;
+                }
+            }
+
+            // overlapped IOs also split the latency into the time spent in the ReadFile/WriteFile call,
+            // the time until the completion was dequeued, and the time until it was accounted for here.
+            // The completion's own time is not known: a completion which arrives while the thread is busy
+            // issuing or accounting waits for the thread's next dequeue, and that reap delay is part of
+            // the service time, which is therefore an upper bound of the device's
+            if (nullptr != pullSubmitEndTime && nullptr != pullDequeueTime)
+            {
+                float fSubmitDurationMsec = static_cast<float>(PerfTimer::PerfTimeToMicroseconds(*pullSubmitEndTime - *pullIoStartTime));
+                float fServiceDurationMsec = static_cast<float>(PerfTimer::PerfTimeToMicroseconds(*pullDequeueTime - *pullSubmitEndTime));
+                float fDispatchDurationMsec = static_cast<float>(PerfTimer::PerfTimeToMicroseconds(ullEndTime - *pullDequeueTime));
+
+                if (type == IOOperation::ReadIO)
+                {
+                    readSubmitLatencyHistogram.Add(fSubmitDurationMsec);
+                    readServiceLatencyHistogram.Add(fServiceDurationMsec);
+                    readDispatchLatencyHistogram.Add(fDispatchDurationMsec);
+                }
+                else
+                {
+                    writeSubmitLatencyHistogram.Add(fSubmitDurationMsec);
+                    writeServiceLatencyHistogram.Add(fServiceDurationMsec);
+                    writeDispatchLatencyHistogram.Add(fDispatchDurationMsec);
+                }
+            }
         }
 
         UINT64 ullRelativeCompletionTime = 0;
@@ -267,18 +405,403 @@ public:
     UINT64 ullReadIOCount;      //number of performed Read I/O operations
     UINT64 ullWriteBytesCount;  //number of bytes written
     UINT64 ullWriteIOCount;     //number of performed Write I/O operations
+    UINT64 ullScheduleSlipCount;    //number of paced I/O operations issued later than scheduled
+    UINT64 ullScheduleSlipTime;     //total time by which they were late (in PerfTimer units)
+    UINT64 ullWorkTime;         //time spent in the application work stage (in PerfTimer units)
+    UINT64 ullWorkCycles;       //TSC cycles spent in the application work stage
+    UINT64 ullWorkBytes;        //number of bytes the application work stage processed
+    UINT64 ullWriteFillTime;    //time spent generating write data (-Zc, -Zr), outside of the IO latency
+    UINT64 ullWriteFillBytes;   //number of bytes of write data generated
+    UINT64 ullWriteFillCount;   //number of write buffers filled
+
+    // data verification (-V); failures are counted over the whole run, the rest in the measured window
+    UINT64 ullStampedWriteCount;    //writes stamped
+    UINT64 ullVerifiedReadCount;    //reads checked against their block's stamp
+    UINT64 ullUnverifiedReadCount;  //reads of blocks never written, or which raced with a write to the block
+    UINT64 ullVerifyFailureCount;
+    vector<VerifyFailure> vVerifyFailures;  //the first failures, with details
+
+    // file set targets (-Q): every handle cache miss opens a file, and may close another to make room
+    UINT64 ullFileOpenCount;
+    UINT64 ullFileOpenTime;         //in PerfTimer units
+    UINT64 ullFileCloseCount;
+    UINT64 ullFileCloseTime;        //in PerfTimer units
+    UINT64 ullHandleCacheHitCount;  //IOs issued through a handle which was already open
+
+    // metadata targets (-N); the operations are slow next to reading the timer, so all of them are timed
+    UINT64 vullMetadataCount[static_cast<int>(MetadataOperation::Count)];
+    Histogram<float> vMetadataLatencyHistograms[static_cast<int>(MetadataOperation::Count)];
+
+    // flushes (-Y), all of them timed; and the latency of the sampled IOs which were in flight
+    // while a flush ran
+    UINT64 ullFlushCount;
+    Histogram<float> flushLatencyHistogram;
+    Histogram<float> flushOverlapLatencyHistogram;
+
+    // group commit targets (-G): the records the thread committed, all timed until they were durable,
+    // and the log appends it led, with the records of all threads they carried; the appends are also
+    // counted as the target's writes
+    UINT64 ullCommitCount;
+    Histogram<float> commitLatencyHistogram;
+    UINT64 ullLogAppendCount;
+    UINT64 ullLogAppendRecordCount;
+
+    DWORD dwDeviceNumaNode;     //NUMA node of the device backing the target, NUMA_NO_NODE if unknown
+
+    // page size backing the thread's IO buffer and the shared random data write buffer (0 if there is none),
+    // and whether the buffers are resident and cannot be paged out (locked or large pages)
+    UINT64 ullDataBufferBytes;  //size of the thread's IO buffer (or buffer working set) for the target
+    UINT64 ullDataBufferPageSize;
+    bool fDataBufferLocked;
+    UINT64 ullWriteBufferPageSize;
+    bool fWriteBufferLocked;
 
     Histogram<float> readLatencyHistogram;
     Histogram<float> writeLatencyHistogram;
 
+    // latency measured from the intended issue time of paced I/O operations (-g, -i/-j)
+    Histogram<float> readCorrectedLatencyHistogram;
+    Histogram<float> writeCorrectedLatencyHistogram;
+
+    // breakdown of overlapped I/O latency: ReadFile/WriteFile call, submit return to completion dequeue
+    // (including any time the completion waited for the thread to dequeue it), completion dequeue to accounting
+    Histogram<float> readSubmitLatencyHistogram;
+    Histogram<float> writeSubmitLatencyHistogram;
+    Histogram<float> readServiceLatencyHistogram;
+    Histogram<float> writeServiceLatencyHistogram;
+    Histogram<float> readDispatchLatencyHistogram;
+    Histogram<float> writeDispatchLatencyHistogram;
+
     IoBucketizer readBucketizer;
     IoBucketizer writeBucketizer;
 };
 
+// phases of the worker loop, for the generator self-overhead profile (-Mc)
+enum class WorkerPhase
+{
+    Throttle = 0,   // throughput meter / think time checks
+    IoType,         // deciding between read and write
+    Submit,         // ReadFile/WriteFile call
+    Wait,           // waiting for and dequeuing completions
+    Accounting,     // TargetResults::Add (counters, histograms, buckets)
+    Offset,         // next offset generation
+    Process,        // application work stage over the completed IO's data (-K)
+    FileOpen,       // choosing the file of a file set IO and opening it on a handle cache miss (-Q)
+    Count
+};
+
 class ThreadResults
 {
 public:
+    ThreadResults() :
+        wGroupNum(0),
+        bProcNum(0),
+        dwNumaNode(NUMA_NO_NODE),
+        ullKernelTime(0),
+        ullUserTime(0),
+        ullCycleTime(0),
+        ullContextSwitches(0),
+        fHardwareCountersAvailable(false),
+        ullInstructionsRetired(0),
+        ullCoreCycles(0),
+        ullReferenceCycles(0),
+        ullWaitTime(0),
+        ullWaitStartTime(0),
+        lWaitSequence(0),
+        ullSchedulingDelay(0)
+    {
+        for (auto& ull : vullPhaseCycles)
+        {
+            ull = 0;
+        }
+    }
+
     vector<TargetResults> vTargetResults;
+    WORD wGroupNum;             //processor the worker was affinitized to, unless affinity is disabled
+    BYTE bProcNum;
+    DWORD dwNumaNode;           //NUMA node of that processor, NUMA_NO_NODE if not affinitized
+    UINT64 vullPhaseCycles[static_cast<int>(WorkerPhase::Count)];   //TSC cycles spent in each phase while accounting was on
+
+    // CPU consumed by the worker thread while accounting was on
+    UINT64 ullKernelTime;       //100ns units
+    UINT64 ullUserTime;         //100ns units
+    UINT64 ullCycleTime;        //cycles charged to the thread (QueryThreadCycleTime)
+    UINT64 ullContextSwitches;
+
+    // fixed-function performance counters of the worker's core while accounting was on
+    bool fHardwareCountersAvailable;
+    UINT64 ullInstructionsRetired;
+    UINT64 ullCoreCycles;
+    UINT64 ullReferenceCycles;
+
+    // scheduling delay estimate (-Ms); see SchedulingProbe
+    // the main thread reads the wait time and start while the worker updates them; the worker makes
+    // the sequence odd for the length of an update, and a reader retries until it sees the same even value
+    // before and after reading both
+    volatile UINT64 ullWaitTime;                //PerfTimer units the worker spent in finished waits while accounting was on
+    volatile UINT64 ullWaitStartTime;           //start of the wait the worker is in, 0 if it is not waiting
+    volatile LONG lWaitSequence;
+    UINT64 ullSchedulingDelay;                  //PerfTimer units
+    vector<UINT64> vullSchedulingDelayBuckets;  //delay in each IOPS bucket (-D), if sampled
+
+    // while the worker is held off its processor, the IOs it has in flight cannot complete through it
+    // and the ones it would issue are not issued, so the delay adds to latency in proportion to its
+    // share of the measured window (Little's law)
+    bool IsSchedulingDelaySignificant(UINT64 ullTimeCount) const
+    {
+        return (ullTimeCount > 0) && (ullSchedulingDelay * 10 >= ullTimeCount);
+    }
+};
+
+// CycleProfiler charges the TSC cycles elapsed since the previous Mark() to the phase which
+// has just finished, so that consecutive marks partition the time spent in the worker loop.
+// Cycles are only accumulated while accounting is on.
+class CycleProfiler
+{
+public:
+    CycleProfiler() :
+        _fEnabled(false),
+        _ullLastMark(0),
+        _pfAccountingOn(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    void Start(bool fEnabled, volatile bool *pfAccountingOn, ThreadResults *pResults)
+    {
+        _fEnabled = fEnabled;
+        _pfAccountingOn = pfAccountingOn;
+        _pResults = pResults;
+        _ullLastMark = _fEnabled ? __rdtsc() : 0;
+    }
+
+    void Mark(WorkerPhase phase)
+    {
+        if (_fEnabled)
+        {
+            UINT64 ullNow = __rdtsc();
+            if (*_pfAccountingOn)
+            {
+                _pResults->vullPhaseCycles[static_cast<int>(phase)] += ullNow - _ullLastMark;
+            }
+            _ullLastMark = ullNow;
+        }
+    }
+
+private:
+    bool _fEnabled;
+    UINT64 _ullLastMark;
+    volatile bool *_pfAccountingOn;
+    ThreadResults *_pResults;
+};
+
+// HardwareCounters reads the fixed-function performance counters (instructions retired, unhalted
+// core and reference cycles) of the core the worker runs on with RDPMC. The counters are core-wide,
+// so they are only meaningful for workers affinitized to cores they do not share. User mode RDPMC
+// has to be enabled by a driver; if it is not, the counters are reported as unavailable.
+class HardwareCounters
+{
+public:
+    HardwareCounters() :
+        _fEnabled(false),
+        _fCounting(false),
+        _pfAccountingOn(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    void Start(bool fEnabled, volatile bool *pfAccountingOn, ThreadResults *pResults)
+    {
+        _fEnabled = fEnabled && IsAvailable();
+        _fCounting = false;
+        _pfAccountingOn = pfAccountingOn;
+        _pResults = pResults;
+        _pResults->fHardwareCountersAvailable = _fEnabled;
+    }
+
+    // called once per IO; accumulates the counters across the measured window
+    void Update()
+    {
+        if (_fEnabled && (*_pfAccountingOn != _fCounting))
+        {
+            _Transition();
+        }
+    }
+
+    static bool IsAvailable();
+
+private:
+    static const int COUNTER_COUNT = 3;
+
+    void _Transition();
+    static void _Read(UINT64 vullCounters[COUNTER_COUNT]);
+
+    bool _fEnabled;
+    bool _fCounting;
+    volatile bool *_pfAccountingOn;
+    ThreadResults *_pResults;
+    UINT64 _vullStart[COUNTER_COUNT];
+};
+
+// SchedulingProbe timestamps the points where a worker blocks waiting for IOs (or for the throughput
+// throttle) and where it resumes. Whatever part of the time outside of those waits was not charged to
+// the thread as CPU time, the thread spent runnable but not running: preempted or queued behind other
+// threads on its processor. Delay in waking up from a wait is not seen, so this is a lower bound.
+// Once the measured window is over the probe leaves the worker's state alone, so that a wait still
+// open then is closed at the window's end by the main thread instead of being dropped.
+class SchedulingProbe
+{
+public:
+    SchedulingProbe() :
+        _fEnabled(false),
+        _pfAccountingOn(nullptr),
+        _pullStartTime(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    void Start(bool fEnabled, volatile bool *pfAccountingOn, PUINT64 pullStartTime, ThreadResults *pResults)
+    {
+        _fEnabled = fEnabled;
+        _pfAccountingOn = pfAccountingOn;
+        _pullStartTime = pullStartTime;
+        _pResults = pResults;
+    }
+
+    void EnterWait()
+    {
+        if (_fEnabled && !_IsWindowOver(*_pfAccountingOn))
+        {
+            InterlockedIncrement(&_pResults->lWaitSequence);
+            _pResults->ullWaitStartTime = PerfTimer::GetTime();
+            InterlockedIncrement(&_pResults->lWaitSequence);
+        }
+    }
+
+    void LeaveWait()
+    {
+        bool fAccountingOn = *_pfAccountingOn;
+        if (_fEnabled && !_IsWindowOver(fAccountingOn))
+        {
+            UINT64 ullNow = PerfTimer::GetTime();
+            InterlockedIncrement(&_pResults->lWaitSequence);
+            if (fAccountingOn)
+            {
+                // waits which began before the measured window are only counted from its start
+                UINT64 ullWaitStart = _pResults->ullWaitStartTime;
+                ullWaitStart = max(ullWaitStart, *_pullStartTime);
+                if (ullNow > ullWaitStart)
+                {
+                    _pResults->ullWaitTime += ullNow - ullWaitStart;
+                }
+            }
+            _pResults->ullWaitStartTime = 0;
+            InterlockedIncrement(&_pResults->lWaitSequence);
+        }
+    }
+
+private:
+    // accounting is off, and it has been on: the start time is only set once the window begins
+    bool _IsWindowOver(bool fAccountingOn) const
+    {
+        return !fAccountingOn && (*_pullStartTime != 0);
+    }
+
+    bool _fEnabled;
+    volatile bool *_pfAccountingOn;
+    PUINT64 _pullStartTime;
+    ThreadResults *_pResults;
+};
+
+// LatencySampler deterministically selects one in every N IOs of each of a thread's targets for
+// latency measurement. The count is kept per target: a single count would alias with the round-robin
+// order the thread issues its targets in, and leave some targets unsampled whenever N is a multiple
+// of their number. Threads and targets start at different points of the cycle so that they do not
+// sample in lockstep.
+class LatencySampler
+{
+public:
+    LatencySampler() :
+        _ulRate(1)
+    {
+    }
+
+    void Start(UINT32 ulRate, UINT32 ulThreadNo, size_t cTargets)
+    {
+        _ulRate = ulRate;
+        _vulCountdowns.resize(cTargets);
+        for (size_t iTarget = 0; iTarget < cTargets; iTarget++)
+        {
+            _vulCountdowns[iTarget] = static_cast<UINT32>((ulThreadNo + iTarget) % ulRate) + 1;
+        }
+    }
+
+    bool Sample(size_t iTarget)
+    {
+        if (--_vulCountdowns[iTarget] == 0)
+        {
+            _vulCountdowns[iTarget] = _ulRate;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    UINT32 _ulRate;
+    vector<UINT32> _vulCountdowns;  //as many as targets
+};
+
+// statistics kept by a storage device driver (IOCTL_DISK_PERFORMANCE); times are in 100ns units
+struct DeviceStatistics
+{
+    UINT64 ullReadCount;
+    UINT64 ullWriteCount;
+    UINT64 ullBytesRead;
+    UINT64 ullBytesWritten;
+    UINT64 ullReadTime;         //cumulative time spent servicing reads
+    UINT64 ullWriteTime;        //cumulative time spent servicing writes
+    UINT64 ullIdleTime;         //time the device had no requests outstanding
+    UINT64 ullSplitCount;       //requests split by the driver
+    UINT64 ullQueryTime;        //time the statistics were read
+    DWORD dwQueueDepth;         //requests in flight when the statistics were read
+};
+
+class DeviceResults
+{
+public:
+    string sPath;                           //volume or physical disk the statistics were read from
+    vector<string> vTargetPaths;            //targets backed by this device
+    DeviceStatistics stats;                 //change over the measured window
+    vector<DeviceStatistics> vBuckets;      //change over each IOPS bucket (-D), if sampled
+};
+
+struct FileExtent
+{
+    UINT64 ullFileOffset;
+    INT64 llLcn;                // first cluster on the volume, -1 if the range is not allocated
+    UINT64 ullBytes;
+};
+
+// on-disk layout of a file target, read back from the filesystem before the run
+class TargetLayout
+{
+public:
+    static const size_t MAX_REPORTED_EXTENTS = 1024;
+
+    TargetLayout() :
+        ullClusterBytes(0),
+        ullExtentCount(0),
+        ullAllocatedBytes(0),
+        ullLargestExtentBytes(0)
+    {
+    }
+
+    string sPath;
+    UINT64 ullClusterBytes;
+    UINT64 ullExtentCount;          //allocated extents
+    UINT64 ullAllocatedBytes;
+    UINT64 ullLargestExtentBytes;
+    vector<FileExtent> vExtents;    //the first extents, in file order, including unallocated ranges
 };
 
 class Results
@@ -291,6 +814,11 @@ public:
     vector<ThreadResults> vThreadResults;
     UINT64 ullTimeCount;
     vector<SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION> vSystemProcessorPerfInfo;
+    bool fThreadCpuTimesAvailable;  //the workers' CPU times were read at both ends of the measured window
+    bool fPageFaultCountAvailable;
+    UINT64 ullPageFaultCount;   //page faults taken by the process while accounting was on
+    vector<DeviceResults> vDeviceResults;
+    vector<TargetLayout> vTargetLayouts;
 };
 
 typedef void (*CALLBACK_TEST_STARTED)();    //callback function to notify that the measured test is about to start
@@ -343,13 +871,59 @@ public:
     }
 };
 
+// how threads are placed on processors when no explicit assignment is given with -a
+enum class AffinityPolicy
+{
+    RoundRobin = 0,     // processors in order of absolute number, filling each group before the next (default)
+    PhysicalCore,       // one thread per physical core; SMT siblings are only used once every core has a thread
+    SpreadNodes,        // alternate between NUMA nodes, cores before SMT siblings within each node
+    CompactL3,          // only the processors sharing the first L3 cache, cores before SMT siblings
+    AvoidSmt,           // only the first processor of each physical core
+    DeviceLocal         // the NUMA node of the device backing the thread's (first) target, where it is known
+};
+
+class AffinityAssignment;
+
+// A set of processors sharing a NUMA node, a socket, an L3 cache or a physical core.
+// Sockets may span processor groups, so a set carries a mask per group.
+class ProcessorSetInformation
+{
+public:
+    DWORD _id;                              // node number for NUMA nodes, otherwise the order the system reported the set in
+    vector<GROUP_AFFINITY> _vGroupMasks;
+
+    ProcessorSetInformation(DWORD Id) :
+        _id(Id)
+    {
+    }
+
+    bool Contains(WORD Group, BYTE Processor) const
+    {
+        for (const auto& mask : _vGroupMasks)
+        {
+            if (mask.Group == Group && (((KAFFINITY)1 << Processor) & mask.Mask) != 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
 class ProcessorTopology
 {
 public:
     vector<ProcessorGroupInformation> _vProcessorGroupInformation;
     DWORD _ulProcCount;
 
-    ProcessorTopology()
+    vector<ProcessorSetInformation> _vNumaNodes;
+    vector<ProcessorSetInformation> _vSockets;
+    vector<ProcessorSetInformation> _vL3Caches;
+    vector<ProcessorSetInformation> _vCores;       // physical cores; more than one processor each with SMT
+    UINT64 _ullL3CacheBytes;                        // combined size of all L3 caches
+
+    ProcessorTopology() :
+        _ullL3CacheBytes(0)
     {
         BOOL fResult;
         PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInformation;
@@ -384,8 +958,18 @@ public:
         }
 
         delete [] pInformation;
+
+        _ReadProcessorSets();
     }
 
+    // Builds the round robin assignment list for an affinity policy. Returns false if the
+    // topology needed by the policy could not be read.
+    bool GetPolicyAffinity(AffinityPolicy Policy, vector<AffinityAssignment>& vAffinity) const;
+
+    // Builds the round robin assignment list over the processors of a NUMA node, cores before
+    // SMT siblings. Returns false if the node is not known.
+    bool GetNumaNodeAffinity(DWORD Node, vector<AffinityAssignment>& vAffinity) const;
+
     bool IsGroupValid(WORD Group)
     {
         if (Group < _vProcessorGroupInformation.size())
@@ -425,6 +1009,10 @@ public:
             }
         }
     }
+
+private:
+    void _ReadProcessorSets();
+    void _GetCoreOrderedProcessors(const ProcessorSetInformation *pWithin, bool fFirstOfCoreOnly, vector<AffinityAssignment>& vAffinity) const;
 };
 
 
@@ -516,12 +1104,50 @@ public:
             sXml += "\"/>\n";
 
         }
+        _AppendProcessorSetsXml(sXml, "NumaNode", "Node", processorTopology._vNumaNodes);
+        _AppendProcessorSetsXml(sXml, "Socket", "Socket", processorTopology._vSockets);
+        _AppendProcessorSetsXml(sXml, "L3Cache", "Cache", processorTopology._vL3Caches);
+        _AppendProcessorSetsXml(sXml, "Core", "Core", processorTopology._vCores);
         sXml += "</ProcessorTopology>\n";
 
+        // clock used for all timestamps and its resolution
+        sXml += "<Timer>\n";
+        sXml += "<Source>";
+        sXml += PerfTimer::GetSourceName();
+        sXml += "</Source>\n";
+        sXml += "<Frequency>";
+        sXml += to_string(PerfTimer::GetFrequency());
+        sXml += "</Frequency>\n";
+        nWritten = snprintf(szBuffer, _countof(szBuffer), "<ResolutionNanoseconds>%.3f</ResolutionNanoseconds>\n", 1e9 / PerfTimer::GetFrequency());
+        assert(nWritten && nWritten < _countof(szBuffer));
+        sXml += szBuffer;
+        sXml += "</Timer>\n";
+
         sXml += "</System>\n";
 
         return sXml;
     }
+
+private:
+    static void _AppendProcessorSetsXml(string& sXml, const char *pszElement, const char *pszIdAttribute, const vector<ProcessorSetInformation>& vSets)
+    {
+        char szBuffer[128];
+
+        for (const auto& set : vSets)
+        {
+            for (const auto& mask : set._vGroupMasks)
+            {
+                int nWritten = snprintf(szBuffer, _countof(szBuffer), "<%s %s=\"%u\" Group=\"%u\" Mask=\"0x%Ix\"/>\n",
+                    pszElement,
+                    pszIdAttribute,
+                    set._id,
+                    mask.Group,
+                    mask.Mask);
+                assert(nWritten && nWritten < _countof(szBuffer));
+                sXml += szBuffer;
+            }
+        }
+    }
 };
 
 extern SystemInformation g_SystemInformation;
@@ -552,6 +1178,22 @@ enum class TargetCacheMode {
     DisableLocalCache
 };
 
+// what a flush injected between the IOs of a target (-Y) makes durable
+enum class FlushMode {
+    Full = 1,       // FlushFileBuffers: data, metadata and the device cache (fsync)
+    Data,           // file data and the metadata needed to read it back (fdatasync)
+    Writeback       // file data written out of the cache, the device cache is not flushed
+};
+
+// application processing applied to the data of every completed IO (-K)
+enum class WorkKernel {
+    None = 0,
+    Crc32c,         // checksum the data
+    Encrypt,        // AES rounds over the data into an application buffer
+    Copy,           // copy the data into an application buffer
+    Spin            // spin for a number of TSC cycles per byte
+};
+
 class Target
 {
 public:
@@ -559,6 +1201,9 @@ public:
     Target() :
         _dwBlockSize(64 * 1024),
         _dwRequestCount(2),
+        _dwIoBufferCount(0),
+        _ullBufferWorkingSetSize(0),
+        _fInterleaveBuffers(false),
         _ullBlockAlignment(64 * 1024),
         _fBlockAlignmentValid(false),
         _fUseRandomAccessPattern(false),
@@ -566,13 +1211,28 @@ public:
         _fParallelAsyncIO(false),
         _fInterlockedSequential(false),
         _cacheMode(TargetCacheMode::Cached),
+        _workKernel(WorkKernel::None),
+        _dwWorkCyclesPerByte(0),
         _fZeroWriteBuffers(false),
+        _fGenerateWriteData(false),
+        _fRandomizeWriteData(false),
+        _dwDataCompressionPercent(0),
+        _dwDataDuplicatePercent(0),
         _dwThreadsPerFile(1),
         _ullThreadStride(0),
         _fCreateFile(false),
         _fPrecreated(false),
         _ullFileSize(0),
+        _dwFragmentCount(0),
         _ullMaxFileSize(0),
+        _dwFileSetCount(0),
+        _dwFilesPerDirectory(1000),
+        _ullFileSetMinFileSize(0),
+        _ullFileSetMaxFileSize(0),
+        _fFileSetWholeFile(false),
+        _fFileSetSkew(0),
+        _dwHandleCacheSize(64),
+        _dwMetadataFileCount(1000),
         _ulWriteRatio(0),
         _fUseBurstSize(false),
         _dwBurstSize(0),
@@ -582,12 +1242,26 @@ public:
         _fRandomAccessHint(false),
         _fTemporaryFileHint(false),
         _fUseLargePages(false),
+        _fLockBuffers(false),
+        _fVerifyData(false),
         _ioPriorityHint(IoPriorityHintNormal),
+        _dwFlushWriteInterval(0),
+        _dwFlushTimeInterval(0),
+        _flushMode(FlushMode::Full),
+        _fGroupCommit(false),
+        _dwCommitRate(0),
+        _dwCommitRecordSize(512),
+        _dwCommitBatchSize(1024 * 1024),
+        _dwCommitDelay(0),
         _dwThroughputBytesPerMillisecond(0),
         _cbRandomDataWriteBuffer(0),
         _sRandomDataWriteBufferSourcePath(),
         _pRandomDataWriteBuffer(nullptr)
     {
+        for (auto& dw : _vdwMetadataWeights)
+        {
+            dw = 0;
+        }
     }
 
     void SetPath(string sPath) { _sPath = sPath; }
@@ -625,15 +1299,80 @@ public:
     void SetUseLargePages(bool fBool) { _fUseLargePages = fBool; }
     bool GetUseLargePages() const { return _fUseLargePages; }
 
+    void SetLockBuffers(bool fBool) { _fLockBuffers = fBool; }
+    bool GetLockBuffers() const { return _fLockBuffers; }
+
+    void SetVerifyData(bool fBool) { _fVerifyData = fBool; }
+    bool GetVerifyData() const { return _fVerifyData; }
+
+    // each thread flushes the target after every FlushWriteInterval completed writes and/or every
+    // FlushTimeInterval milliseconds; 0 turns either off
+    void SetFlushWriteInterval(DWORD dwWrites) { _dwFlushWriteInterval = dwWrites; }
+    DWORD GetFlushWriteInterval() const { return _dwFlushWriteInterval; }
+
+    void SetFlushTimeInterval(DWORD dwMilliseconds) { _dwFlushTimeInterval = dwMilliseconds; }
+    DWORD GetFlushTimeInterval() const { return _dwFlushTimeInterval; }
+
+    void SetFlushMode(FlushMode flushMode) { _flushMode = flushMode; }
+    FlushMode GetFlushMode() const { return _flushMode; }
+
+    // a group commit target (-G) is a log its threads commit records of CommitRecordSize bytes to,
+    // CommitRate per second each (0 = as soon as the previous one is durable); an append carries at
+    // most CommitBatchSize bytes of records, after CommitDelay microseconds for more to join it
+    void SetGroupCommit(bool fBool) { _fGroupCommit = fBool; }
+    bool GetGroupCommit() const { return _fGroupCommit; }
+
+    void SetCommitRate(DWORD dwRecordsPerSecond) { _dwCommitRate = dwRecordsPerSecond; }
+    DWORD GetCommitRate() const { return _dwCommitRate; }
+
+    void SetCommitRecordSize(DWORD cbRecord) { _dwCommitRecordSize = cbRecord; }
+    DWORD GetCommitRecordSize() const { return _dwCommitRecordSize; }
+
+    void SetCommitBatchSize(DWORD cbBatch) { _dwCommitBatchSize = cbBatch; }
+    DWORD GetCommitBatchSize() const { return _dwCommitBatchSize; }
+
+    void SetCommitDelay(DWORD dwMicroseconds) { _dwCommitDelay = dwMicroseconds; }
+    DWORD GetCommitDelay() const { return _dwCommitDelay; }
+
     void SetRequestCount(DWORD dwRequestCount) { _dwRequestCount = dwRequestCount; }
     DWORD GetRequestCount() const { return _dwRequestCount; }
 
+    // in-flight IOs share a pool of at most this many buffers, which is safe since read data is
+    // discarded and write data is never modified once the buffers are filled; 0 means one per request
+    void SetIoBufferCount(DWORD dwIoBufferCount) { _dwIoBufferCount = dwIoBufferCount; }
+    DWORD GetIoBufferCount() const;
+
+    // with a buffer working set, each IO moves on to the next block of it instead of reusing its request's slot
+    void SetBufferWorkingSetSize(UINT64 cbWorkingSet) { _ullBufferWorkingSetSize = cbWorkingSet; }
+    UINT64 GetBufferWorkingSetSize() const { return _ullBufferWorkingSetSize; }
+
+    void SetInterleaveBuffers(bool fBool) { _fInterleaveBuffers = fBool; }
+    bool GetInterleaveBuffers() const { return _fInterleaveBuffers; }
+
     void SetCacheMode(TargetCacheMode cacheMode) { _cacheMode = cacheMode; }
     TargetCacheMode GetCacheMode() const { return _cacheMode;  }
 
+    void SetWorkKernel(WorkKernel workKernel) { _workKernel = workKernel; }
+    WorkKernel GetWorkKernel() const { return _workKernel; }
+
+    void SetWorkCyclesPerByte(DWORD dwCyclesPerByte) { _dwWorkCyclesPerByte = dwCyclesPerByte; }
+    DWORD GetWorkCyclesPerByte() const { return _dwWorkCyclesPerByte; }
+
     void SetZeroWriteBuffers(bool fBool) { _fZeroWriteBuffers = fBool; }
     bool GetZeroWriteBuffers() const { return _fZeroWriteBuffers; }
 
+    void SetGenerateWriteData(bool fBool) { _fGenerateWriteData = fBool; }
+    bool GetGenerateWriteData() const { return _fGenerateWriteData; }
+
+    void SetRandomizeWriteData(bool fBool) { _fRandomizeWriteData = fBool; }
+    bool GetRandomizeWriteData() const { return _fRandomizeWriteData; }
+
+    void SetDataCompressionPercent(DWORD dwPercent) { _dwDataCompressionPercent = dwPercent; }
+    DWORD GetDataCompressionPercent() const { return _dwDataCompressionPercent; }
+
+    void SetDataDuplicatePercent(DWORD dwPercent) { _dwDataDuplicatePercent = dwPercent; }
+    DWORD GetDataDuplicatePercent() const { return _dwDataDuplicatePercent; }
+
     void SetRandomDataWriteBufferSize(UINT64 cbWriteBuffer) { _cbRandomDataWriteBuffer = cbWriteBuffer; }
     UINT64 GetRandomDataWriteBufferSize(void) const { return _cbRandomDataWriteBuffer; }
 
@@ -661,9 +1400,62 @@ public:
     void SetFileSize(UINT64 ullFileSize) { _ullFileSize = ullFileSize; }
     UINT64 GetFileSize() const { return _ullFileSize; } // TODO: InBytes
 
+    void SetFragmentCount(DWORD dwFragmentCount) { _dwFragmentCount = dwFragmentCount; }
+    DWORD GetFragmentCount() const { return _dwFragmentCount; }
+
+    // extents of a fragmented layout are rounded up to a multiple of this size, so a small
+    // file cannot be split into arbitrarily many of them
+    static const UINT64 FRAGMENT_ALIGNMENT_BYTES = 64 * 1024;
+    static UINT64 GetFragmentExtentSize(UINT64 ullFileSize, DWORD dwFragmentCount)
+    {
+        UINT64 ullExtentSize = (ullFileSize + dwFragmentCount - 1) / dwFragmentCount;
+        return (ullExtentSize + FRAGMENT_ALIGNMENT_BYTES - 1) / FRAGMENT_ALIGNMENT_BYTES * FRAGMENT_ALIGNMENT_BYTES;
+    }
+
     void SetMaxFileSize(UINT64 ullMaxFileSize) { _ullMaxFileSize = ullMaxFileSize; }
     UINT64 GetMaxFileSize() const { return _ullMaxFileSize; }
 
+    // a file set target is a directory of FileSetCount files, FilesPerDirectory to a subdirectory;
+    // every IO goes to a file chosen with a Zipf distribution of the given skew (0 = uniform)
+    void SetFileSetCount(DWORD dwFileCount) { _dwFileSetCount = dwFileCount; }
+    DWORD GetFileSetCount() const { return _dwFileSetCount; }
+
+    void SetFilesPerDirectory(DWORD dwFilesPerDirectory) { _dwFilesPerDirectory = dwFilesPerDirectory; }
+    DWORD GetFilesPerDirectory() const { return _dwFilesPerDirectory; }
+
+    // file sizes are spread uniformly over the range in whole blocks; 0 means one block
+    void SetFileSetMinFileSize(UINT64 ullSize) { _ullFileSetMinFileSize = ullSize; }
+    UINT64 GetFileSetMinFileSize() const { return _ullFileSetMinFileSize; }
+
+    void SetFileSetMaxFileSize(UINT64 ullSize) { _ullFileSetMaxFileSize = ullSize; }
+    UINT64 GetFileSetMaxFileSize() const { return _ullFileSetMaxFileSize; }
+
+    // whole-file access reads or writes each chosen file from start to end before choosing the next;
+    // otherwise every IO chooses a file and a random block of it
+    void SetFileSetWholeFile(bool fBool) { _fFileSetWholeFile = fBool; }
+    bool GetFileSetWholeFile() const { return _fFileSetWholeFile; }
+
+    void SetFileSetSkew(double fSkew) { _fFileSetSkew = fSkew; }
+    double GetFileSetSkew() const { return _fFileSetSkew; }
+
+    // number of files of the set each thread keeps open
+    void SetHandleCacheSize(DWORD dwHandleCacheSize) { _dwHandleCacheSize = dwHandleCacheSize; }
+    DWORD GetHandleCacheSize() const { return _dwHandleCacheSize; }
+
+    UINT64 GetFileSetFileSize(UINT64 iFile) const;
+    string GetFileSetFilePath(UINT64 iFile) const;
+
+    // a metadata target is a directory in which every thread creates, stats, opens, renames and deletes
+    // files of its own, MetadataFileCount of them, FilesPerDirectory to a subdirectory; each operation is
+    // chosen with its relative weight
+    void SetMetadataWeight(MetadataOperation type, DWORD dwWeight) { _vdwMetadataWeights[static_cast<int>(type)] = dwWeight; }
+    DWORD GetMetadataWeight(MetadataOperation type) const { return _vdwMetadataWeights[static_cast<int>(type)]; }
+
+    void SetMetadataFileCount(DWORD dwFileCount) { _dwMetadataFileCount = dwFileCount; }
+    DWORD GetMetadataFileCount() const { return _dwMetadataFileCount; }
+
+    bool IsMetadataTarget() const;
+
     void SetWriteRatio(UINT32 ulWriteRatio) { _ulWriteRatio = ulWriteRatio; }
     UINT32 GetWriteRatio() const { return _ulWriteRatio; }
 
@@ -694,8 +1486,9 @@ public:
     bool AllocateAndFillRandomDataWriteBuffer();
     void FreeRandomDataWriteBuffer();
     BYTE* GetRandomDataWriteBuffer();
+    const BYTE* GetRandomDataWriteBufferBase() const { return _pRandomDataWriteBuffer; }
 
-    DWORD GetCreateFlags(bool fAsync)
+    DWORD GetCreateFlags(bool fAsync) const
     {
         DWORD dwFlags = FILE_ATTRIBUTE_NORMAL;
 
@@ -736,6 +1529,9 @@ private:
     string _sPath;
     DWORD _dwBlockSize;
     DWORD _dwRequestCount;      // TODO: change the name to something more descriptive (OutstandingRequestCount?)
+    DWORD _dwIoBufferCount;     // number of distinct IO buffers per thread (0 = one per outstanding request)
+    UINT64 _ullBufferWorkingSetSize;    // size of the per-thread buffer working set IOs rotate through (0 = disabled)
+    bool _fInterleaveBuffers;           // spread the buffer pages across all NUMA nodes
 
     UINT64 _ullBlockAlignment;
     bool _fBlockAlignmentValid;
@@ -746,15 +1542,32 @@ private:
     bool _fInterlockedSequential;
 
     TargetCacheMode _cacheMode;
+    WorkKernel _workKernel;         // application processing of each completed IO's data
+    DWORD _dwWorkCyclesPerByte;     // cost of the WorkKernel::Spin kernel
     bool _fZeroWriteBuffers;
+    bool _fGenerateWriteData;           // fill every write with generated data of the given compressibility and duplication
+    bool _fRandomizeWriteData;          // fill every write with fresh pseudo-random data
+    DWORD _dwDataCompressionPercent;    // share of every 4KiB of generated data which is zero filled
+    DWORD _dwDataDuplicatePercent;      // share of generated blocks which repeat a block from a small fixed set
     DWORD _dwThreadsPerFile;
     UINT64 _ullThreadStride;
 
     bool _fCreateFile;
     bool _fPrecreated;          // used to track which files have been created before the first timespan and which have to be created later
     UINT64 _ullFileSize;
+    DWORD _dwFragmentCount;     // number of extents a created file is laid out in (0 = contiguous)
     UINT64 _ullMaxFileSize;
 
+    DWORD _dwFileSetCount;          // number of files in the target directory (0 = the target is a single file)
+    DWORD _dwFilesPerDirectory;
+    UINT64 _ullFileSetMinFileSize;
+    UINT64 _ullFileSetMaxFileSize;
+    bool _fFileSetWholeFile;
+    double _fFileSetSkew;           // Zipf theta of the choice of files, below 1
+    DWORD _dwHandleCacheSize;       // open files of the set per thread
+
+    DWORD _vdwMetadataWeights[static_cast<int>(MetadataOperation::Count)];  // all 0 = the target is not a metadata target
+    DWORD _dwMetadataFileCount;     // files each thread works over
 
     UINT32 _ulWriteRatio;
     bool _fUseBurstSize;    // TODO: "use" or "enable"?; since burst size must be specified with the think time, one variable should be sufficient
@@ -768,6 +1581,18 @@ private:
     bool _fRandomAccessHint;        // open file with the FILE_FLAG_RANDOM_ACCESS hint
     bool _fTemporaryFileHint;       // open file with the FILE_ATTRIBUTE_TEMPORARY hint
     bool _fUseLargePages;           // Use large pages for IO buffers
+    bool _fLockBuffers;             // Pre-fault IO buffers and lock them into the working set
+    bool _fVerifyData;              // Stamp written blocks and verify them when they are read
+
+    DWORD _dwFlushWriteInterval;    // completed writes between flushes (-Yw), 0 = none
+    DWORD _dwFlushTimeInterval;     // milliseconds between flushes (-Yt), 0 = none
+    FlushMode _flushMode;
+
+    bool _fGroupCommit;             // the target is a group commit log (-G)
+    DWORD _dwCommitRate;            // records committed per second by each thread, 0 = back to back
+    DWORD _dwCommitRecordSize;      // bytes per record
+    DWORD _dwCommitBatchSize;       // maximum bytes of records per log append
+    DWORD _dwCommitDelay;           // microseconds an append waits for more records to join it
 
     UINT64 _cbRandomDataWriteBuffer;            // if > 0, then the write buffer should be filled with random data
     string _sRandomDataWriteBufferSourcePath;   // file that should be used for filling the write buffer (if the path is not available, use a crypto provider)
@@ -805,10 +1630,17 @@ public:
         _ulRandSeed(0),
         _dwThreadCount(0),
         _fDisableAffinity(false),
+        _affinityPolicy(AffinityPolicy::RoundRobin),
         _fCompletionRoutines(false),
         _fMeasureLatency(false),
         _fCalculateIopsStdDev(false),
-        _ulIoBucketDurationInMilliseconds(1000)
+        _ulIoBucketDurationInMilliseconds(1000),
+        _fProfileCpuCycles(false),
+        _ulLatencySampleRate(1),
+        _fHardwareCounters(false),
+        _fDeviceStatistics(false),
+        _fSchedulingDelay(false),
+        _fCpuEfficiency(false)
     {
     }
 
@@ -846,6 +1678,9 @@ public:
     void SetDisableAffinity(bool fDisableAffinity) { _fDisableAffinity = fDisableAffinity; }
     bool GetDisableAffinity() const { return _fDisableAffinity; }
 
+    void SetAffinityPolicy(AffinityPolicy policy) { _affinityPolicy = policy; }
+    AffinityPolicy GetAffinityPolicy() const { return _affinityPolicy; }
+
     void SetCompletionRoutines(bool fCompletionRoutines) { _fCompletionRoutines = fCompletionRoutines; }
     bool GetCompletionRoutines() const { return _fCompletionRoutines; }
     
@@ -857,6 +1692,24 @@ public:
 
     void SetIoBucketDurationInMilliseconds(UINT32 ulIoBucketDurationInMilliseconds) { _ulIoBucketDurationInMilliseconds = ulIoBucketDurationInMilliseconds; }
     UINT32 GetIoBucketDurationInMilliseconds() const { return _ulIoBucketDurationInMilliseconds; }
+
+    void SetProfileCpuCycles(bool fProfileCpuCycles) { _fProfileCpuCycles = fProfileCpuCycles; }
+    bool GetProfileCpuCycles() const { return _fProfileCpuCycles; }
+
+    void SetLatencySampleRate(UINT32 ulLatencySampleRate) { _ulLatencySampleRate = ulLatencySampleRate; }
+    UINT32 GetLatencySampleRate() const { return _ulLatencySampleRate; }
+
+    void SetHardwareCounters(bool fHardwareCounters) { _fHardwareCounters = fHardwareCounters; }
+    bool GetHardwareCounters() const { return _fHardwareCounters; }
+
+    void SetDeviceStatistics(bool fDeviceStatistics) { _fDeviceStatistics = fDeviceStatistics; }
+    bool GetDeviceStatistics() const { return _fDeviceStatistics; }
+
+    void SetSchedulingDelay(bool fSchedulingDelay) { _fSchedulingDelay = fSchedulingDelay; }
+    bool GetSchedulingDelay() const { return _fSchedulingDelay; }
+
+    void SetCpuEfficiency(bool fCpuEfficiency) { _fCpuEfficiency = fCpuEfficiency; }
+    bool GetCpuEfficiency() const { return _fCpuEfficiency; }
     
     string GetXml() const;
     void MarkFilesAsPrecreated(const vector<string> vFiles);
@@ -869,11 +1722,18 @@ private:
     UINT32 _ulRandSeed;
     DWORD _dwThreadCount;
     bool _fDisableAffinity;
+    AffinityPolicy _affinityPolicy;
     vector<AffinityAssignment> _vAffinity;
     bool _fCompletionRoutines;
     bool _fMeasureLatency;
     bool _fCalculateIopsStdDev;
     UINT32 _ulIoBucketDurationInMilliseconds;
+    bool _fProfileCpuCycles;
+    UINT32 _ulLatencySampleRate;        // latency is measured for one in every N IOs of a thread
+    bool _fHardwareCounters;
+    bool _fDeviceStatistics;
+    bool _fSchedulingDelay;
+    bool _fCpuEfficiency;
 
     friend class UnitTests::ProfileUnitTests;
 };
@@ -1004,6 +1864,462 @@ private:
     friend class UnitTests::ProfileUnitTests;
 };
 
+// WorkStage runs an application processing kernel over the data of each completed IO, so that the
+// CPU time and memory bandwidth an application spends consuming its data compete with the IO itself.
+class WorkStage
+{
+public:
+    WorkStage() :
+        _pfAccountingOn(nullptr),
+        _ulChecksum(0)
+    {
+    }
+
+    void Start(const vector<Target>& vTargets, volatile bool *pfAccountingOn);
+    void Run(const Target& target, const BYTE *pData, DWORD cbData, TargetResults *pTargetResults);
+
+    static bool IsCrc32cAccelerated();
+    static bool IsEncryptAvailable();
+    static UINT32 Crc32c(UINT32 ulCrc, const BYTE *pData, size_t cbData);
+
+private:
+    void _Encrypt(const BYTE *pData, size_t cbData);
+    static void _Spin(UINT64 ullCycles);
+
+    volatile bool *_pfAccountingOn;
+    vector<BYTE> _vApplicationBuffer;   // destination of the copy and encrypt kernels
+    UINT32 _ulChecksum;                 // keeps the checksums from being optimized away
+};
+
+// WriteDataGenerator fills the buffer of every write with fresh data, either pseudo-random (-Zr) or
+// of a given compressibility and duplication (-Zc). The time it takes is accounted for separately
+// and kept out of the IO latency.
+//
+// Pseudo-random data comes from four xorshift128+ generators run side by side in vector registers.
+// Compressible blocks are built in 4KiB chunks: a 16 byte header naming the block and chunk,
+// incompressible bytes copied from a pool of random segments, then zeros. Unique blocks are named
+// by a per-run, per-thread sequence; duplicate blocks by one of a small fixed set of names, so
+// they are identical across threads and targets.
+class WriteDataGenerator
+{
+public:
+    static const size_t CHUNK_BYTES = 4096;
+    static const size_t SEGMENT_POOL_BYTES = 1024 * 1024;
+    static const UINT64 DUPLICATE_BLOCK_COUNT = 1024;
+
+    WriteDataGenerator() :
+        _ullSalt(0),
+        _ullNextBlock(0),
+        _ullRandom(0),
+        _fAvx2(false),
+        _pfAccountingOn(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    void Start(UINT32 ulThreadNo, const vector<Target>& vTargets, volatile bool *pfAccountingOn, ThreadResults *pResults);
+    void Fill(size_t iTarget, const Target& target, BYTE *pBuffer, DWORD cbBlock);
+
+    static bool IsAvx2Available();
+
+private:
+    UINT64 _NextRandom();
+    void _FillCompressible(const Target& target, BYTE *pBuffer, DWORD cbBlock);
+    void _FillRandomAvx2(BYTE *pBuffer, size_t cbBuffer);
+    void _FillRandomSse2(BYTE *pBuffer, size_t cbBuffer);
+
+    vector<BYTE> _vSegmentPool;     // the same random bytes in every thread
+    UINT64 _ullSalt;
+    UINT64 _ullNextBlock;
+    UINT64 _ullRandom;
+    bool _fAvx2;
+    UINT64 _vullRandomState[8];     // xorshift128+ state of the four generators: four s0, then four s1
+    volatile bool *_pfAccountingOn;
+    ThreadResults *_pResults;
+};
+
+// BlockStamp heads every block written under data verification (-V). The CRC32C covers the whole
+// block, taking the ulCrc field as zero.
+struct BlockStamp
+{
+    static const UINT32 MAGIC = 0x50534B44;     // 'DKSP'
+
+    UINT32 ulMagic;
+    UINT32 ulCrc;
+    UINT64 ullOffset;       // offset the block was written to
+    UINT64 ullSequence;     // the target's write sequence number, starting at 1
+    UINT32 ulThreadNo;      // thread which wrote the block
+    UINT32 ulReserved;
+};
+
+// TargetVerifyState is shared by all the threads verifying a target. It tracks, for each block, the
+// writes in flight and the newest write a subsequent read must see. A read or write racing with
+// another write to the same block may legitimately see or leave either version, or a mix of both,
+// so writes which overlapped another write do not move that bound and racing reads are not checked.
+class TargetVerifyState
+{
+public:
+    // larger targets share entries between blocks, which keeps the race detection conservative
+    // but leaves too little information to detect stale or missing blocks
+    static const size_t MAX_TRACKED_BLOCKS = 4 * 1024 * 1024;
+
+    TargetVerifyState() :
+        llNextSequence(0),
+        _fInitialized(false),
+        _fExact(false)
+    {
+        InitializeSRWLock(&_lock);
+    }
+
+    void Initialize(UINT64 ullTargetSize, DWORD cbBlock);
+    bool IsExact() const { return _fExact; }
+
+    struct BlockState
+    {
+        volatile LONG lWritesInFlight;
+        volatile LONG64 llLastIssued;       // sequence of the most recently issued write
+        volatile LONG64 llLowerBound;       // newest write which completed without racing another
+        volatile LONG lLastWriteRaced;      // the block may hold a mix of racing writes until an unraced one completes
+    };
+    BlockState& GetBlockState(UINT64 ullOffset) { return _vBlocks[static_cast<size_t>((ullOffset / _cbBlock) % _vBlocks.size())]; }
+
+    volatile LONG64 llNextSequence;
+
+private:
+    SRWLOCK _lock;
+    bool _fInitialized;
+    bool _fExact;
+    DWORD _cbBlock;
+    vector<BlockState> _vBlocks;
+};
+
+// DataVerifier stamps the blocks a thread writes and checks the blocks it reads (-V)
+class DataVerifier
+{
+public:
+    static const size_t MAX_RECORDED_FAILURES = 16;
+
+    DataVerifier() :
+        _ulThreadNo(0),
+        _pfAccountingOn(nullptr),
+        _pullStartTime(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    void Start(UINT32 ulThreadNo, const vector<Target>& vTargets, const vector<TargetVerifyState *>& vpStates, volatile bool *pfAccountingOn, PUINT64 pullStartTime, ThreadResults *pResults);
+
+    // called before an IO is issued; ullSequence carries the IO's state to its completion
+    void Prepare(size_t iTarget, IOOperation type, BYTE *pBuffer, DWORD cbBlock, UINT64 ullOffset, UINT64 *pullSequence);
+    void Complete(size_t iTarget, IOOperation type, const BYTE *pBuffer, DWORD cbBlock, UINT64 ullOffset, UINT64 ullSequence);
+
+private:
+    void _RecordFailure(size_t iTarget, VerifyFailureType type, UINT64 ullOffset, UINT64 ullExpectedSequence, const BlockStamp *pStamp);
+
+    UINT32 _ulThreadNo;
+    vector<TargetVerifyState *> _vpStates;      //as many as targets; null for targets which are not verified
+    volatile bool *_pfAccountingOn;
+    PUINT64 _pullStartTime;
+    ThreadResults *_pResults;
+};
+
+// FileSetCache keeps the files a thread has open for its file set targets (-Q), up to each target's
+// handle cache size, closing the least recently used one to make room for the next. A file with IOs
+// in flight is never closed, so the cache grows past its size when that is below the number of
+// outstanding IOs. The time spent opening and closing files is accounted for per target.
+class FileSetCache
+{
+public:
+    FileSetCache() :
+        _pvTargets(nullptr),
+        _hCompletionPort(nullptr),
+        _ullRandom(0),
+        _pfAccountingOn(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    void Start(UINT32 ulThreadNo, const vector<Target>& vTargets, size_t cIos, HANDLE hCompletionPort, volatile bool *pfAccountingOn, ThreadResults *pResults);
+
+    // chooses the file and offset of the next IO to a file set target; returns INVALID_HANDLE_VALUE if the file cannot be opened
+    HANDLE Acquire(size_t iTarget, size_t iIo, UINT64 *pullOffset);
+    void Release(size_t iIo);
+    void Close();
+
+private:
+    struct OpenFile
+    {
+        UINT64 ullFile;
+        HANDLE hFile;
+        DWORD dwIosInFlight;
+    };
+
+    struct TargetFiles
+    {
+        list<OpenFile> lFiles;      // most recently used first
+        unordered_map<UINT64, list<OpenFile>::iterator> mFiles;
+        double fZetaN;              // constants of the Zipf distribution
+        double fAlpha;
+        double fEta;
+        UINT64 ullRankMultiplier;   // rank -> file permutation: (rank * multiplier + offset) % files, multiplier coprime to files
+        UINT64 ullRankOffset;
+        UINT64 ullWholeFile;        // whole-file access: the file being walked, its size and the next offset in it
+        UINT64 ullWholeFileSize;
+        UINT64 ullWholeFileOffset;
+    };
+
+    UINT64 _NextRandom();
+    UINT64 _ChooseFile(const Target& target, const TargetFiles& files);
+    void _CloseFile(size_t iTarget, HANDLE hFile);
+
+    const vector<Target> *_pvTargets;
+    vector<TargetFiles> _vTargetFiles;  //as many as targets
+    vector<OpenFile *> _vpIoFiles;      //as many as IOs; file the IO was issued to, null if none
+    HANDLE _hCompletionPort;
+    UINT64 _ullRandom;
+    volatile bool *_pfAccountingOn;
+    ThreadResults *_pResults;
+};
+
+// MetadataWorker runs the operations of a thread's metadata targets (-N), taking the targets in turn.
+// Every thread works in a directory of its own under the target, over a fixed set of names of which
+// half exist at the start: creates and deletes move files in and out of existence, renames switch a
+// file between two names, and stats and opens go to files which exist. An operation with nothing to
+// act on (a create when every file exists, anything else when none does) is replaced by its opposite.
+class MetadataWorker
+{
+public:
+    MetadataWorker() :
+        _pvTargets(nullptr),
+        _iNextTarget(0),
+        _ullRandom(0),
+        _pfAccountingOn(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    // lays out the thread's directories and files; false on failure, with the error in GetLastError
+    bool Start(UINT32 ulThreadNo, const vector<Target>& vTargets, volatile bool *pfAccountingOn, ThreadResults *pResults);
+
+    // issues the next operation; false on failure, with the error in GetLastError
+    bool Run(MetadataOperation *pType);
+
+    // deletes the files and directories the thread leaves behind
+    void Close();
+
+    static const char *GetOperationName(MetadataOperation type);
+
+private:
+    struct TargetFiles
+    {
+        string sDirectory;          // the thread's directory under the target
+        vector<DWORD> vdwFiles;     // the files which exist, then those which do not
+        vector<bool> vfRenamed;     // the file exists under its second name
+        DWORD cExisting;
+        DWORD dwTotalWeight;
+    };
+
+    UINT64 _NextRandom();
+    string _GetFilePath(const Target& target, const TargetFiles& files, DWORD dwFile, bool fRenamed) const;
+
+    const vector<Target> *_pvTargets;
+    vector<TargetFiles> _vTargetFiles;  //as many as targets
+    size_t _iNextTarget;
+    UINT64 _ullRandom;
+    volatile bool *_pfAccountingOn;
+    ThreadResults *_pResults;
+};
+
+// FlushInjector flushes a thread's targets (-Y) every so many completed writes or milliseconds.
+// Windows has no overlapped flush, so the flushes are handed to a helper thread of the worker's,
+// one at a time, and the worker keeps issuing and reaping its IOs while one runs; the latency of
+// the IOs in flight during a flush is kept apart to show what the flush costs the IOs around it.
+// The helper only flushes and times; the worker accounts for the flush once it has finished.
+// Flushes go through a synchronous handle of their own, reopened from the target's.
+class FlushInjector
+{
+public:
+    FlushInjector() :
+        _pvTargets(nullptr),
+        _pfnNtFlushBuffersFileEx(nullptr),
+        _ullLastFlushStartTime(0),
+        _ullLastFlushEndTime(0),
+        _ullPendingFlushStartTime(0),
+        _fActive(false),
+        _hThread(nullptr),
+        _hFlushEvent(nullptr),
+        _fStop(false),
+        _lPendingTarget(-1),
+        _lFlushDone(0),
+        _ullFlushStartTime(0),
+        _ullFlushEndTime(0),
+        _dwFlushError(ERROR_SUCCESS),
+        _pfAccountingOn(nullptr),
+        _pResults(nullptr)
+    {
+    }
+
+    // false if a target cannot be reopened or its flush mode is not supported by the system,
+    // with the error in GetLastError
+    bool Start(const vector<Target>& vTargets, const vector<HANDLE>& vhTargets, volatile bool *pfAccountingOn, ThreadResults *pResults);
+
+    // counts a completed IO; ullIoStartTime is 0 for IOs left out of the latency sample
+    void Complete(size_t iTarget, IOOperation type, UINT64 ullIoStartTime);
+
+    // accounts for the flush which has finished and hands the next target which is due to the
+    // helper thread; false if a flush failed, with the error in GetLastError
+    bool Run();
+
+    // flushes a group commit target after a log append, on the calling thread
+    bool Flush(size_t iTarget);
+
+    // waits for the flush under way and stops the helper thread
+    void Close();
+
+private:
+    struct TargetFlush
+    {
+        HANDLE hFile;                   // INVALID_HANDLE_VALUE if the target is not flushed
+        DWORD dwWrites;                 // completed since the last flush
+        UINT64 ullNextFlushTime;
+    };
+
+    typedef NTSTATUS (__stdcall *NtFlushBuffersFileEx)(HANDLE, ULONG, PVOID, ULONG, PIO_STATUS_BLOCK);
+
+    static DWORD WINAPI _ThreadFunc(LPVOID pContext);
+    bool _Flush(size_t iTarget, UINT64 *pullStartTime, UINT64 *pullEndTime) const;
+    void _Account(size_t iTarget, UINT64 ullStartTime, UINT64 ullEndTime);
+
+    const vector<Target> *_pvTargets;
+    vector<TargetFlush> _vTargetFlushes;    //as many as targets
+    NtFlushBuffersFileEx _pfnNtFlushBuffersFileEx;
+    UINT64 _ullLastFlushStartTime;          //of the last finished flush of any target
+    UINT64 _ullLastFlushEndTime;
+    UINT64 _ullPendingFlushStartTime;       //when the flush under way was handed to the helper thread
+    bool _fActive;                          //any target is flushed every so many writes or milliseconds
+
+    // shared with the helper thread: the worker hands it a target and the helper reports back
+    // when it is done, with the flush's times and error
+    HANDLE _hThread;
+    HANDLE _hFlushEvent;
+    volatile bool _fStop;
+    volatile LONG _lPendingTarget;          //-1 if no flush is under way
+    volatile LONG _lFlushDone;
+    UINT64 _ullFlushStartTime;
+    UINT64 _ullFlushEndTime;
+    DWORD _dwFlushError;
+
+    volatile bool *_pfAccountingOn;
+    ThreadResults *_pResults;
+};
+
+// GroupCommitLog is the log of a group commit target (-G), shared by all of its threads. Records
+// are made durable by sequential appends which start over at the beginning of the target when
+// they reach its end; the thread leading an append owns the buffer it is written from.
+class GroupCommitLog
+{
+public:
+    GroupCommitLog() :
+        ullCommittedSequence(0),
+        ullDurableSequence(0),
+        ullStartOffset(0),
+        ullEndOffset(0),
+        ullNextOffset(0),
+        fAppending(false),
+        pBuffer(nullptr),
+        cbBuffer(0),
+        _fInitialized(false)
+    {
+        InitializeSRWLock(&lock);
+        InitializeConditionVariable(&appendDone);
+    }
+
+    ~GroupCommitLog();
+
+    // the first of the target's threads to start lays the log out over the target; false if the
+    // target cannot hold the largest append or its buffer cannot be allocated
+    bool Initialize(const Target& target, UINT64 ullFileSize);
+
+    SRWLOCK lock;                       // guards the rest
+    CONDITION_VARIABLE appendDone;
+    UINT64 ullCommittedSequence;        // of the last record committed to the log
+    UINT64 ullDurableSequence;          // of the last record made durable by an append
+    UINT64 ullStartOffset;
+    UINT64 ullEndOffset;
+    UINT64 ullNextOffset;               // of the next append
+    bool fAppending;                    // a thread is leading an append
+    BYTE *pBuffer;
+    DWORD cbBuffer;                     // the largest append
+
+private:
+    GroupCommitLog(const GroupCommitLog&) = delete;
+    GroupCommitLog& operator=(const GroupCommitLog&) = delete;
+
+    bool _fInitialized;
+};
+
+// GroupCommitter commits a thread's records to the log of its group commit target (-G). A commit
+// which finds no append in progress leads one: it appends the records of all threads committed by
+// then in one sequential write padded to the block size, flushed unless the target is written
+// through (-Sh), and wakes the threads waiting for them. Commits arriving meanwhile wait and join
+// the next append, so batches grow with the load, as in the group commit of database logs.
+class GroupCommitter
+{
+public:
+    GroupCommitter() :
+        _hFile(INVALID_HANDLE_VALUE),
+        _hEvent(nullptr),
+        _pLog(nullptr),
+        _pFlushInjector(nullptr),
+        _ullInterval(0),
+        _ullNextDueTime(0),
+        _ullDelay(0),
+        _cbRecord(0),
+        _cbBlock(0),
+        _cMaxBatchRecords(0),
+        _fMeasureLatency(false),
+        _fCalculateIopsStdDev(false),
+        _pfAccountingOn(nullptr),
+        _pullStartTime(nullptr),
+        _pResults(nullptr),
+        _pSchedulingProbe(nullptr)
+    {
+    }
+
+    // pFlushInjector flushes the appends, null if the target is written through; false if the log
+    // cannot be laid out or the append event cannot be created, with the error in GetLastError.
+    // Only the pacing sleep, the wait for another thread's append and the append itself are
+    // reported to pSchedulingProbe as waits.
+    bool Start(const Target& target, HANDLE hFile, UINT64 ullFileSize, GroupCommitLog *pLog, FlushInjector *pFlushInjector,
+               bool fMeasureLatency, bool fCalculateIopsStdDev, volatile bool *pfAccountingOn, PUINT64 pullStartTime, ThreadResults *pResults,
+               SchedulingProbe *pSchedulingProbe);
+
+    // commits the thread's next record once it is due and returns when it is durable; false on
+    // failure, with the error in GetLastError
+    bool Run();
+    void Close();
+
+private:
+    bool _Append(UINT64 ullOffset, DWORD cbAppend, UINT64 cRecords);
+
+    HANDLE _hFile;
+    HANDLE _hEvent;                     // appends are waited for on it, whether or not the handle is overlapped
+    GroupCommitLog *_pLog;
+    FlushInjector *_pFlushInjector;
+    UINT64 _ullInterval;                // between paced commits, 0 if they are not paced
+    UINT64 _ullNextDueTime;
+    UINT64 _ullDelay;
+    DWORD _cbRecord;
+    DWORD _cbBlock;
+    UINT64 _cMaxBatchRecords;
+    bool _fMeasureLatency;
+    bool _fCalculateIopsStdDev;
+    volatile bool *_pfAccountingOn;
+    PUINT64 _pullStartTime;
+    ThreadResults *_pResults;
+    SchedulingProbe *_pSchedulingProbe;
+};
+
 class ThreadParameters
 {
 public:
@@ -1024,11 +2340,30 @@ public:
     vector<HANDLE> vhTargets;
     vector<UINT64> vullFileSizes;
     vector<BYTE *> vpDataBuffers;
+    vector<size_t> vulNextBufferBlock;          //as many as vpDataBuffers; next block of a rotating buffer working set
+    vector<DWORD> vdwTargetNumaNodes;           //as many as vTargets; NUMA node of the target's device, NUMA_NO_NODE if unknown
     vector<OVERLAPPED> vOverlapped;             // each target has RequestCount OVERLAPPED structures
     vector<size_t> vOverlappedIdToTargetId;
     vector<size_t> vFirstOverlappedIdForTargetId;   //id of the first overlapped structure in the vOverlapped vector by target
     vector<IOOperation> vdwIoType;                        //as many as vOverlapped; used by the completion routines
     vector<UINT64> vIoStartTimes;
+    vector<UINT64> vIntendedStartTimes;         //as many as vOverlapped; 0 for IOs which are not paced
+    vector<UINT64> vIoSubmitEndTimes;           //as many as vOverlapped; time the ReadFile/WriteFile call returned
+    vector<BYTE *> vpIoBuffers;                 //as many as vOverlapped; buffer the IO reads into or writes from
+    vector<UINT64> vullVerifySequences;         //as many as vOverlapped; data verification state of the IO
+    vector<TargetVerifyState *> vpVerifyStates; //as many as vTargets; shared data verification state, null if not verified
+    vector<GroupCommitLog *> vpGroupCommitLogs; //as many as vTargets; shared log of a group commit target, null for others
+    CycleProfiler cycleProfiler;
+    LatencySampler latencySampler;
+    HardwareCounters hardwareCounters;
+    SchedulingProbe schedulingProbe;
+    WorkStage workStage;
+    DataVerifier dataVerifier;
+    WriteDataGenerator writeDataGenerator;
+    FileSetCache fileSetCache;
+    MetadataWorker metadataWorker;
+    FlushInjector flushInjector;
+    GroupCommitter groupCommitter;
   
     // For vanilla sequential access (-s):
     // Private per-thread offsets, incremented directly, indexed to number of targets
@@ -1056,13 +2391,16 @@ public:
     // TODO: check how it's used
     HANDLE hEndEvent;        //used only in case of completion routines (not for IO Completion Ports)
     
-    bool AllocateAndFillBufferForTarget(const Target& target);
+    bool AllocateAndFillBufferForTarget(const Target& target, DWORD dwNumaNode);
     BYTE* GetReadBuffer(size_t iTarget, size_t iRequest);
     BYTE* GetWriteBuffer(size_t iTarget, size_t iRequest);
+    void PrepareWriteBuffer(size_t iTarget, BYTE *pBuffer);
+    HANDLE GetIoHandle(size_t iTarget, size_t iOverlapped);
     DWORD GetTotalRequestCount() const;
 
 private:
     ThreadParameters(const ThreadParameters& T);
+    size_t _GetBufferBlock(size_t iTarget, size_t iRequest);
 };
 
 class IResultParser
@@ -61,17 +61,50 @@ private:
         string sPath;
         UINT64 ullFileSize;
         bool fZeroWriteBuffers;
+        DWORD dwFragmentCount;
+    };
+
+    // shared by the threads precreating files in parallel
+    struct PrecreateContext
+    {
+        const IORequestGenerator *pGenerator;
+        const vector<CreateFileParameters> *pvFiles;
+        bool fVerbose;
+        bool fCanSetValidData;          // the privilege for setting the valid data length of files is held
+        const BYTE *pZeroBuffer;        // content of the writes filling files, for each kind of write buffer
+        const BYTE *pPatternBuffer;
+        volatile LONG lNextFile;
+        volatile LONG64 llBytesFilled;
+        volatile bool fError;
+    };
+
+    struct ThreadCpuSnapshot
+    {
+        UINT64 ullKernelTime;
+        UINT64 ullUserTime;
+        UINT64 ullCycleTime;
+        UINT64 ullContextSwitches;
     };
 
     bool _GenerateRequestsForTimeSpan(const Profile& profile, const TimeSpan& timeSpan, Results& results, struct Synchronization *pSynch);
     void _AbortWorkerThreads(HANDLE hStartEvent, vector<HANDLE>& vhThreads) const;
     void _CloseOpenFiles(vector<HANDLE>& vhFiles) const;
     DWORD _CreateDirectoryPath(const char *path) const;
-    bool _CreateFile(UINT64 ullFileSize, const char *pszFilename, bool fZeroBuffers, bool fVerbose) const;
+    bool _CreateFile(UINT64 ullFileSize, const char *pszFilename, bool fZeroBuffers, DWORD dwFragmentCount, PrecreateContext& precreate) const;
+    bool _FillFile(HANDLE hFile, UINT64 ullFileSize, const char *pszFilename, const BYTE *pBuffer, volatile LONG64 *pllBytesFilled) const;
+    bool _CreateFileSet(const Target& target, bool fVerbose) const;
+    bool _FillFragmentedFile(UINT64 ullFileSize, const char *pszFilename, const BYTE *pBuffer, DWORD dwFragmentCount, volatile LONG64 *pllBytesFilled) const;
+    bool _GetFileLayout(const char *pszFilename, TargetLayout& layout) const;
     void _DisplayFileSizeVerbose(bool fVerbose, UINT64 fsize) const;
     bool _GetActiveGroupsAndProcs() const;
     struct ETWSessionInfo _GetResultETWSession(const EVENT_TRACE_PROPERTIES *pTraceProperties) const;
     bool _GetSystemPerfInfo(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION *pInfo, UINT32 uCpuCount) const;
+    bool _GetThreadCpuSnapshots(const vector<HANDLE>& vhThreads, vector<struct ThreadCpuSnapshot>& vSnapshots) const;
+    bool _GetProcessPageFaultCount(UINT64 *pullPageFaultCount) const;
+    bool _GrowWorkingSetForLockedBuffers(const TimeSpan& timeSpan, const vector<Target>& vTargets) const;
+    bool _OpenTargetDevices(const vector<Target>& vTargets, vector<HANDLE>& vhDevices, vector<DeviceResults>& vDeviceResults) const;
+    void _GetDeviceStatistics(vector<HANDLE>& vhDevices, const vector<DeviceResults>& vDeviceResults, vector<DeviceStatistics>& vStats) const;
+    UINT64 _EstimateSchedulingDelay(UINT64 ullInterval, UINT64 ullWaitTime, const struct ThreadCpuSnapshot& end, const struct ThreadCpuSnapshot& start) const;
     void _InitializeGlobalParameters();
     bool _LoadDLLs();
     bool _StopETW(bool fUseETW, TRACEHANDLE hTraceSession) const;
@@ -79,7 +112,11 @@ private:
     bool _ValidateProfile(const Profile& profile) const;
     vector<struct CreateFileParameters> _GetFilesToPrecreate(const Profile& profile) const;
     void _MarkFilesAsCreated(Profile& profile, const vector<struct CreateFileParameters>& vFiles) const;
+    bool _InitializePrecreateContext(PrecreateContext& precreate, const vector<CreateFileParameters> *pvFiles, bool fVerbose) const;
+    void _FreePrecreateContext(PrecreateContext& precreate) const;
+    bool _CreateFilesInParallel(const vector<CreateFileParameters>& vFilesToCreate, bool fVerbose) const;
     bool _PrecreateFiles(Profile& profile) const;
+    static DWORD WINAPI _PrecreateThreadFunc(LPVOID pContext);
 
     HINSTANCE volatile _hNTDLL;     //handle to ntdll.dll
 
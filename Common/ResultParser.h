@@ -47,11 +47,31 @@ private:
     void _Print(const char *format, ...);
     void _PrintProfile(const Profile& profile);
     void _PrintCpuUtilization(const Results&);
+    void _PrintWorkerCpuEfficiency(const Results&);
+    void _PrintNumaPlacement(const Results&);
+    void _PrintBufferPages(const TimeSpan& timeSpan, const Results&);
+    void _PrintBufferWorkingSet(const SystemInformation& system, const TimeSpan& timeSpan, const Results&);
+    void _PrintWorkStage(const Results&);
+    void _PrintWriteDataFill(const Results&);
+    void _PrintFileSet(const Results&);
+    void _PrintMetadata(const Results&);
+    void _PrintFlushes(const Results&);
+    void _PrintGroupCommit(const Results&);
+    void _PrintDataVerification(const TimeSpan& timeSpan, const Results&);
     enum class _SectionEnum {TOTAL, READ, WRITE};
     void _PrintSectionFieldNames(const TimeSpan& timeSpan);
     void _PrintSectionBorderLine(const TimeSpan& timeSpan);
     void _PrintSection(_SectionEnum, const TimeSpan&, const Results&);
     void _PrintLatencyPercentiles(const Results&);
+    void _PrintLatencySampling(const TimeSpan& timeSpan, const Results&);
+    void _PrintCorrectedLatencyPercentiles(const Results&);
+    void _PrintLatencyBreakdown(const Results&);
+    void _PrintCycleProfile(const Results&);
+    void _PrintHardwareCounters(const Results&);
+    void _PrintSchedulingDelay(const TimeSpan& timeSpan, const Results&);
+    void _PrintDeviceStatistics(const Results&);
+    void _PrintFileLayout(const Results&);
+    void _PrintLatencyHistograms(const Histogram<float>& readLatencyHistogram, const Histogram<float>& writeLatencyHistogram);
     void _PrintTimeSpan(const TimeSpan &timeSpan);
     void _PrintTarget(const Target &target, bool fUseThreadsPerFile, bool fCompletionRoutines);
 
@@ -34,6 +34,8 @@ SOFTWARE.
 // time.  The meter is started by calling Start() with the throughput
 // to be simulated.  GetSleepTime() returns 0 when the next IO can be issued.
 // Adjust() is called to notify the ThroughputMeter about how many bytes were read/written.
+// GetIntendedStartTime() returns the time at which the next IO was due according to the
+// pacing schedule, so that latency can be measured free of coordinated omission.
 class ThroughputMeter
 {
 public:
@@ -42,6 +44,7 @@ public:
     bool IsRunning(void) const;
     void Start(DWORD cBytesPerMillisecond, DWORD dwBlockSize, DWORD dwThinkTime, DWORD dwBurstSize);
     DWORD GetSleepTime(void) const;
+    UINT64 GetIntendedStartTime(UINT64 ullStartTime) const;
     void Adjust(size_t cb);
 
 private:
@@ -53,8 +56,8 @@ private:
     ULONGLONG _cbCompleted;         // completed IO
     DWORD _cbBlockSize;
     DWORD _cBytesPerMillisecond;    // rate of throttling
-    ULONGLONG _ullStartTimestamp;
-    ULONGLONG _ullDelayUntil;       // timestamp at which the next IO can be executed
+    UINT64 _ullStartTime;           // PerfTimer timestamp at which the schedule started
+    UINT64 _ullDelayUntil;          // PerfTimer timestamp at which the next IO can be executed
     DWORD _thinkTime;               // time to sleep between burst of IOs
     DWORD _burstSize;               // number of IOs in a burst. meaningless if think time is zero
     DWORD _cIO;                     // count of IOs in the current burst
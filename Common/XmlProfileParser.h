@@ -42,6 +42,11 @@ private:
     HRESULT _ParseTimeSpan(IXMLDOMNode &XmlNode, TimeSpan *pTimeSpan);
     HRESULT _ParseTargets(IXMLDOMNode &XmlNode, TimeSpan *pTimeSpan);
     HRESULT _ParseRandomDataSource(IXMLDOMNode &XmlNode, Target *pTarget);
+    HRESULT _ParseDataGenerator(IXMLDOMNode &XmlNode, Target *pTarget);
+    HRESULT _ParseFileSet(IXMLDOMNode &XmlNode, Target *pTarget);
+    HRESULT _ParseMetadata(IXMLDOMNode &XmlNode, Target *pTarget);
+    HRESULT _ParseFlush(IXMLDOMNode &XmlNode, Target *pTarget);
+    HRESULT _ParseGroupCommit(IXMLDOMNode &XmlNode, Target *pTarget);
     HRESULT _ParseWriteBufferContent(IXMLDOMNode &XmlNode, Target *pTarget);
     HRESULT _ParseTarget(IXMLDOMNode &XmlNode, Target *pTarget);
     HRESULT _ParseAffinityAssignment(IXMLDOMNode &XmlNode, TimeSpan *pTimeSpan);
@@ -40,8 +40,24 @@ private:
     void _PrintETW(struct ETWMask ETWMask, struct ETWEventCounters EtwEventCounters);
     void _PrintETWSessionInfo(struct ETWSessionInfo sessionInfo);
     void _PrintLatencyPercentiles(const Results& results);
+    void _PrintLatencySampling(const TimeSpan& timeSpan, const Results& results);
+    void _PrintCorrectedLatencyPercentiles(const Results& results);
+    void _PrintLatencyBreakdown(const Results& results);
+    void _PrintMetadata(const Results& results);
+    void _PrintFlushes(const Results& results);
+    void _PrintGroupCommit(const Results& results);
+    void _PrintLatencyBuckets(const Histogram<float>& latencyHistogram);
+    void _PrintDeviceStatistics(const Results& results, UINT32 bucketTimeInMs);
+    void _PrintFileLayout(const Results& results);
+    void _PrintBufferWorkingSet(const SystemInformation& system, const TimeSpan& timeSpan, const Results& results);
+    void _PrintThreadCpuEfficiency(const ThreadResults& threadResults);
+    void _PrintThreadHardwareCounters(const ThreadResults& threadResults);
+    void _PrintThreadSchedulingDelay(const ThreadResults& threadResults, UINT64 ullTimeCount, UINT32 bucketTimeInMs);
+    void _PrintThreadCycleProfile(const ThreadResults& threadResults);
+    void _PrintLatencyHistograms(const Histogram<float>& readLatencyHistogram, const Histogram<float>& writeLatencyHistogram);
     void _PrintTargetResults(const TargetResults& results);
     void _PrintTargetLatency(const TargetResults& results);
+    void _PrintTargetVerification(const TargetResults& results);
     void _PrintTargetIops(const IoBucketizer& readBucketizer, const IoBucketizer& writeBucketizer, UINT32 bucketTimeInMs);
     void _PrintOverallIops(const Results& results, UINT32 bucketTimeInMs);
     void _PrintIops(const IoBucketizer& readBucketizer, const IoBucketizer& writeBucketizer, UINT32 bucketTimeInMs);
@@ -41,7 +41,14 @@ SOFTWARE.
 #include <stdlib.h>
 #include <Winioctl.h>   //DISK_GEOMETRY
 #include <windows.h>
+#include <Psapi.h>      //GetProcessMemoryInfo
+#include <SetupAPI.h>   //SetupDiGetClassDevs
+#include <cfgmgr32.h>   //CM_Get_DevNode_Property
+#include <initguid.h>
+#include <devpkey.h>    //DEVPKEY_Device_Numa_Node
 #include <stddef.h>
+#include <algorithm>
+#include <map>
 
 #include <Wmistr.h>     //WNODE_HEADER
 
@@ -173,6 +180,235 @@ UINT64 GetPhysicalDriveSize(HANDLE hFile)
         (UINT64)geom.Cylinders.QuadPart;
 }
 
+/*****************************************************************************/
+// resolves a target to the volume and physical disks it is stored on
+//
+static bool GetTargetDevicePaths(const string& sPath, vector<string>& vDevicePaths)
+{
+    char szDevice[MAX_PATH];
+
+    if (sPath.empty())
+    {
+        return false;
+    }
+
+    //physical drive
+    if ('#' == sPath[0])
+    {
+        sprintf_s(szDevice, _countof(szDevice), "\\\\.\\PhysicalDrive%u", (UINT32)atoi(sPath.c_str() + 1));
+        vDevicePaths.push_back(szDevice);
+        return true;
+    }
+
+    //partition or volume holding a file
+    string sVolume;
+    if (sPath.size() == 2 && ':' == sPath[1])
+    {
+        sVolume = "\\\\.\\" + sPath;
+    }
+    else
+    {
+        char szMountPoint[MAX_PATH];
+        if (!GetVolumePathNameA(sPath.c_str(), szMountPoint, _countof(szMountPoint)))
+        {
+            return false;
+        }
+
+        if (isalpha((unsigned char)szMountPoint[0]) && ':' == szMountPoint[1] && '\\' == szMountPoint[2] && '\0' == szMountPoint[3])
+        {
+            sprintf_s(szDevice, _countof(szDevice), "\\\\.\\%c:", szMountPoint[0]);
+        }
+        else if (!GetVolumeNameForVolumeMountPointA(szMountPoint, szDevice, _countof(szDevice)))
+        {
+            // e.g. remote shares, which have no local device
+            return false;
+        }
+        sVolume = szDevice;
+
+        // the volume GUID path ends with a backslash which would open the root directory instead
+        if ('\\' == sVolume.back())
+        {
+            sVolume.pop_back();
+        }
+    }
+    vDevicePaths.push_back(sVolume);
+
+    //physical disks the volume is laid out on
+    HANDLE hVolume = CreateFileA(sVolume.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if (INVALID_HANDLE_VALUE != hVolume)
+    {
+        BYTE extentsBuffer[sizeof(VOLUME_DISK_EXTENTS) + 31 * sizeof(DISK_EXTENT)];
+        VOLUME_DISK_EXTENTS *pExtents = (VOLUME_DISK_EXTENTS *)extentsBuffer;
+        DWORD cbReturned;
+
+        if (DeviceIoControl(hVolume, IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS, NULL, 0, pExtents, sizeof(extentsBuffer), &cbReturned, NULL))
+        {
+            for (DWORD i = 0; i < pExtents->NumberOfDiskExtents; i++)
+            {
+                sprintf_s(szDevice, _countof(szDevice), "\\\\.\\PhysicalDrive%u", pExtents->Extents[i].DiskNumber);
+                if (find(vDevicePaths.begin(), vDevicePaths.end(), szDevice) == vDevicePaths.end())
+                {
+                    vDevicePaths.push_back(szDevice);
+                }
+            }
+        }
+        CloseHandle(hVolume);
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+// gets the NUMA node of a physical disk; the node is usually a property of the
+// controller (e.g. the NVMe or HBA PCI function) rather than of the disk itself,
+// so the device tree is walked up from the disk until a node is found
+//
+static DWORD GetDiskNumaNode(DWORD dwDiskNumber)
+{
+    DWORD dwNumaNode = NUMA_NO_NODE;
+
+    HDEVINFO hDevInfo = SetupDiGetClassDevsW(&GUID_DEVINTERFACE_DISK, nullptr, nullptr, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+    if (INVALID_HANDLE_VALUE == hDevInfo)
+    {
+        return NUMA_NO_NODE;
+    }
+
+    SP_DEVICE_INTERFACE_DATA interfaceData;
+    interfaceData.cbSize = sizeof(interfaceData);
+    for (DWORD i = 0; SetupDiEnumDeviceInterfaces(hDevInfo, nullptr, &GUID_DEVINTERFACE_DISK, i, &interfaceData); i++)
+    {
+        DWORD cbDetail = 0;
+        SetupDiGetDeviceInterfaceDetailW(hDevInfo, &interfaceData, nullptr, 0, &cbDetail, nullptr);
+        if (cbDetail == 0)
+        {
+            continue;
+        }
+
+        vector<BYTE> vDetail(cbDetail);
+        PSP_DEVICE_INTERFACE_DETAIL_DATA_W pDetail = (PSP_DEVICE_INTERFACE_DETAIL_DATA_W)&vDetail[0];
+        pDetail->cbSize = sizeof(*pDetail);
+        SP_DEVINFO_DATA devInfoData;
+        devInfoData.cbSize = sizeof(devInfoData);
+        if (!SetupDiGetDeviceInterfaceDetailW(hDevInfo, &interfaceData, pDetail, cbDetail, nullptr, &devInfoData))
+        {
+            continue;
+        }
+
+        HANDLE hDisk = CreateFileW(pDetail->DevicePath, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+        if (INVALID_HANDLE_VALUE == hDisk)
+        {
+            continue;
+        }
+
+        STORAGE_DEVICE_NUMBER deviceNumber;
+        DWORD cbReturned;
+        BOOL fOk = DeviceIoControl(hDisk, IOCTL_STORAGE_GET_DEVICE_NUMBER, NULL, 0, &deviceNumber, sizeof(deviceNumber), &cbReturned, NULL);
+        CloseHandle(hDisk);
+
+        if (fOk && deviceNumber.DeviceNumber == dwDiskNumber)
+        {
+            DEVINST devInst = devInfoData.DevInst;
+            do
+            {
+                DEVPROPTYPE propertyType;
+                UINT32 ulNode;
+                ULONG cbNode = sizeof(ulNode);
+                if (CM_Get_DevNode_PropertyW(devInst, &DEVPKEY_Device_Numa_Node, &propertyType, (PBYTE)&ulNode, &cbNode, 0) == CR_SUCCESS &&
+                    DEVPROP_TYPE_UINT32 == propertyType)
+                {
+                    dwNumaNode = ulNode;
+                    break;
+                }
+            } while (CM_Get_Parent(&devInst, devInst, 0) == CR_SUCCESS);
+            break;
+        }
+    }
+
+    SetupDiDestroyDeviceInfoList(hDevInfo);
+    return dwNumaNode;
+}
+
+/*****************************************************************************/
+// gets the NUMA node of the device(s) backing a target; NUMA_NO_NODE if it is
+// not known or the target is laid out on disks attached to different nodes
+//
+static DWORD GetTargetNumaNode(const string& sPath)
+{
+    const string sDiskPrefix("\\\\.\\PhysicalDrive");
+    vector<string> vDevicePaths;
+    DWORD dwNumaNode = NUMA_NO_NODE;
+
+    if (!GetTargetDevicePaths(sPath, vDevicePaths))
+    {
+        return NUMA_NO_NODE;
+    }
+
+    for (const auto& sDevicePath : vDevicePaths)
+    {
+        if (sDevicePath.compare(0, sDiskPrefix.size(), sDiskPrefix) != 0)
+        {
+            continue;
+        }
+
+        DWORD dwDiskNumaNode = GetDiskNumaNode((DWORD)atoi(sDevicePath.c_str() + sDiskPrefix.size()));
+        if (dwDiskNumaNode == NUMA_NO_NODE || (dwNumaNode != NUMA_NO_NODE && dwNumaNode != dwDiskNumaNode))
+        {
+            return NUMA_NO_NODE;
+        }
+        dwNumaNode = dwDiskNumaNode;
+    }
+
+    return dwNumaNode;
+}
+
+static DeviceStatistics DiffDeviceStatistics(const DeviceStatistics& end, const DeviceStatistics& start)
+{
+    DeviceStatistics diff;
+
+    diff.ullReadCount = end.ullReadCount - start.ullReadCount;
+    diff.ullWriteCount = end.ullWriteCount - start.ullWriteCount;
+    diff.ullBytesRead = end.ullBytesRead - start.ullBytesRead;
+    diff.ullBytesWritten = end.ullBytesWritten - start.ullBytesWritten;
+    diff.ullReadTime = end.ullReadTime - start.ullReadTime;
+    diff.ullWriteTime = end.ullWriteTime - start.ullWriteTime;
+    diff.ullIdleTime = end.ullIdleTime - start.ullIdleTime;
+    diff.ullSplitCount = end.ullSplitCount - start.ullSplitCount;
+    diff.ullQueryTime = end.ullQueryTime - start.ullQueryTime;
+    diff.dwQueueDepth = end.dwQueueDepth;
+
+    return diff;
+}
+
+// time a worker has spent waiting up to ullNow, including the part of the wait it is in
+static UINT64 GetWorkerWaitTime(ThreadResults& threadResults, UINT64 ullStartTime, UINT64 ullNow)
+{
+    // read the wait time and start as of the same moment; see ThreadResults
+    UINT64 ullWaitStart;
+    UINT64 ullWaitTime;
+    for (;;)
+    {
+        LONG lSequence = InterlockedCompareExchange(&threadResults.lWaitSequence, 0, 0);
+        ullWaitStart = threadResults.ullWaitStartTime;
+        ullWaitTime = threadResults.ullWaitTime;
+        if ((lSequence & 1) == 0 && InterlockedCompareExchange(&threadResults.lWaitSequence, 0, 0) == lSequence)
+        {
+            break;
+        }
+        YieldProcessor();
+    }
+
+    if (ullWaitStart != 0)
+    {
+        ullWaitStart = max(ullWaitStart, ullStartTime);
+        if (ullNow > ullWaitStart)
+        {
+            ullWaitTime += ullNow - ullWaitStart;
+        }
+    }
+
+    return ullWaitTime;
+}
+
 /*****************************************************************************/
 // activates specified privilege in process token
 //
@@ -472,137 +708,476 @@ bool IORequestGenerator::_GetSystemPerfInfo(SYSTEM_PROCESSOR_PERFORMANCE_INFORMA
 }
 
 /*****************************************************************************/
-// calculate the offset of the next I/O operation
+// opens the devices backing the targets for reading their statistics
 //
-
-__inline UINT64 IORequestGenerator::GetNextFileOffset(ThreadParameters& tp, size_t targetNum, UINT64 prevOffset)
+bool IORequestGenerator::_OpenTargetDevices(const vector<Target>& vTargets, vector<HANDLE>& vhDevices, vector<DeviceResults>& vDeviceResults) const
 {
-    Target &target = tp.vTargets[targetNum];
-
-    UINT64 blockAlignment = target.GetBlockAlignmentInBytes();
-    UINT64 baseFileOffset = target.GetBaseFileOffsetInBytes();
-    UINT64 blockSize = target.GetBlockSizeInBytes();
-    UINT64 nextBlockOffset;
+    vhDevices.clear();
+    vDeviceResults.clear();
 
-    // increment/produce - note, logically relative to base offset
-    if (target.GetUseRandomAccessPattern())
-    {
-        nextBlockOffset = rand64();
-        nextBlockOffset -= (nextBlockOffset % blockAlignment);
-    }
-    else if (target.GetUseParallelAsyncIO())
-    {
-        nextBlockOffset = prevOffset - baseFileOffset + blockAlignment;
-    }
-    else if (target.GetUseInterlockedSequential())
-    {
-        nextBlockOffset = InterlockedAdd64((PLONGLONG) &tp.pullSharedSequentialOffsets[targetNum], blockAlignment) - blockAlignment;
-    }
-    else // normal sequential access pattern
+    for (const auto& target : vTargets)
     {
-        nextBlockOffset = (tp.vullPrivateSequentialOffsets[targetNum] += blockAlignment);
-    }
+        vector<string> vDevicePaths;
+        if (!GetTargetDevicePaths(target.GetPath(), vDevicePaths))
+        {
+            PrintError("Warning: unable to find the device of target %s; its device statistics will not be captured\n", target.GetPath().c_str());
+            continue;
+        }
 
-    // now apply bounds for IO offset
-    // aligned target size is the closed interval of byte offsets at which it is legal to issue IO
-    // ISSUE IMPROVEMENT: much of this should be precalculated. It belongs within Target, which will
-    //      need discovery of target sizing moved from its current just-in-time at thread launch.
-    UINT64 alignedTargetSize = tp.vullFileSizes[targetNum] - baseFileOffset - blockSize;
-    if (target.GetUseRandomAccessPattern() ||
-        target.GetUseInterlockedSequential())
-    {
-        // these access patterns occur on blockaligned boundaries relative to base
-        // convert aligned target size to the open interval
-        alignedTargetSize = ((alignedTargetSize / blockAlignment) + 1) * blockAlignment;
-        nextBlockOffset %= alignedTargetSize;
-    }
-    else
-    {
-        // parasync and seq bases are potentially modified by threadstride and loop back to the
-        // file base offset + increment which will return them to their initial base offset.
-        if (nextBlockOffset > alignedTargetSize)
+        for (const auto& sDevicePath : vDevicePaths)
         {
-            nextBlockOffset = (IORequestGenerator::GetThreadBaseFileOffset(tp, targetNum) - baseFileOffset) % blockAlignment;
-            tp.vullPrivateSequentialOffsets[targetNum] = nextBlockOffset;
+            size_t iDevice;
+            for (iDevice = 0; iDevice < vDeviceResults.size(); iDevice++)
+            {
+                if (vDeviceResults[iDevice].sPath == sDevicePath)
+                {
+                    break;
+                }
+            }
+
+            if (iDevice == vDeviceResults.size())
+            {
+                HANDLE hDevice = CreateFileA(sDevicePath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+                if (INVALID_HANDLE_VALUE == hDevice)
+                {
+                    PrintError("Warning: unable to open device %s (error code: %u)\n", sDevicePath.c_str(), GetLastError());
+                    continue;
+                }
+
+                vhDevices.push_back(hDevice);
+                vDeviceResults.resize(vDeviceResults.size() + 1);
+                vDeviceResults[iDevice].sPath = sDevicePath;
+            }
+            vDeviceResults[iDevice].vTargetPaths.push_back(target.GetPath());
         }
     }
 
-    // Convert into the next full offset
-    nextBlockOffset += baseFileOffset;
+    return true;
+}
 
-#ifndef NDEBUG
-    // Don't overrun the end of the file
-    UINT64 fileSize = tp.vullFileSizes[targetNum];
-    assert(nextBlockOffset + blockSize <= fileSize);
-#endif
+/*****************************************************************************/
+// reads the statistics of the devices; a device which cannot report them (e.g. disk performance
+// counters are off) is closed and left out of the results, and the test goes on without it
+//
+void IORequestGenerator::_GetDeviceStatistics(vector<HANDLE>& vhDevices, const vector<DeviceResults>& vDeviceResults, vector<DeviceStatistics>& vStats) const
+{
+    vStats.resize(vhDevices.size());
 
-    return nextBlockOffset;
+    for (size_t i = 0; i < vhDevices.size(); i++)
+    {
+        DISK_PERFORMANCE perf;
+        DWORD cbReturned;
+
+        if (INVALID_HANDLE_VALUE == vhDevices[i])
+        {
+            continue;
+        }
+
+        if (!DeviceIoControl(vhDevices[i], IOCTL_DISK_PERFORMANCE, NULL, 0, &perf, sizeof(perf), &cbReturned, NULL))
+        {
+            PrintError("Warning: unable to read the statistics of device %s (error code: %u); it will not be reported\n", vDeviceResults[i].sPath.c_str(), GetLastError());
+            CloseHandle(vhDevices[i]);
+            vhDevices[i] = INVALID_HANDLE_VALUE;
+            continue;
+        }
+
+        vStats[i].ullReadCount = perf.ReadCount;
+        vStats[i].ullWriteCount = perf.WriteCount;
+        vStats[i].ullBytesRead = perf.BytesRead.QuadPart;
+        vStats[i].ullBytesWritten = perf.BytesWritten.QuadPart;
+        vStats[i].ullReadTime = perf.ReadTime.QuadPart;
+        vStats[i].ullWriteTime = perf.WriteTime.QuadPart;
+        vStats[i].ullIdleTime = perf.IdleTime.QuadPart;
+        vStats[i].ullSplitCount = perf.SplitCount;
+        vStats[i].ullQueryTime = perf.QueryTime.QuadPart;
+        vStats[i].dwQueueDepth = perf.QueueDepth;
+    }
 }
 
-__inline UINT64 IORequestGenerator::GetThreadBaseFileOffset(ThreadParameters& tp, size_t targetNum)
+/*****************************************************************************/
+// the handles of the devices a time span reads the statistics of (-Md), closed on every way out of
+// it, the early returns on errors included
+//
+struct DeviceHandles
 {
-    const Target &target = tp.vTargets[targetNum];
+    vector<HANDLE> vh;
 
-    UINT64 baseFileOffset = target.GetBaseFileOffsetInBytes();
-    UINT64 nextBlockOffset;
+    ~DeviceHandles()
+    {
+        for (auto h : vh)
+        {
+            if (INVALID_HANDLE_VALUE != h && nullptr != h)
+            {
+                CloseHandle(h);
+            }
+        }
+    }
+};
 
-    if (target.GetUseRandomAccessPattern())
+/*****************************************************************************/
+// estimates how long a worker was runnable but not running over an interval (all in PerfTimer units):
+// the time it spent outside of its waits less the CPU time charged to it
+//
+UINT64 IORequestGenerator::_EstimateSchedulingDelay(UINT64 ullInterval, UINT64 ullWaitTime, const struct ThreadCpuSnapshot& end, const struct ThreadCpuSnapshot& start) const
+{
+    UINT64 ullCpuTime;
+
+    // thread cycle time counts TSC ticks, so with the TSC as the timer it is directly comparable and
+    // much finer grained than the kernel and user times, which are only updated on clock ticks
+    if (PerfTimer::GetSource() == TimerSource::InvariantTsc)
     {
-        nextBlockOffset = IORequestGenerator::GetNextFileOffset(tp, targetNum, 0);
+        ullCpuTime = end.ullCycleTime - start.ullCycleTime;
     }
     else
     {
-        // interlocked sequential   - thread stride is always zero, enforced during profile validation
-        // parallel async           - apply thread stride
-        // sequential               - apply thread stride
-        nextBlockOffset = baseFileOffset + tp.ulRelativeThreadNo * target.GetThreadStrideInBytes();
+        UINT64 ullCpuTime100ns = (end.ullKernelTime - start.ullKernelTime) + (end.ullUserTime - start.ullUserTime);
+        ullCpuTime = PerfTimer::MicrosecondsToPerfTime(ullCpuTime100ns / 10.0);
     }
 
-    return nextBlockOffset;
+    if (ullInterval <= ullWaitTime + ullCpuTime)
+    {
+        return 0;
+    }
+    return ullInterval - ullWaitTime - ullCpuTime;
 }
 
-__inline UINT64 IORequestGenerator::GetStartingFileOffset(ThreadParameters& tp, size_t targetNum)
+/*****************************************************************************/
+// snapshot CPU time, cycles and context switches of the worker threads
+//
+bool IORequestGenerator::_GetThreadCpuSnapshots(const vector<HANDLE>& vhThreads, vector<struct ThreadCpuSnapshot>& vSnapshots) const
 {
-    const Target &target = tp.vTargets[targetNum];
+    vSnapshots.resize(vhThreads.size());
 
-    UINT64 baseFileOffset = target.GetBaseFileOffsetInBytes();
-    UINT64 nextBlockOffset;
+    for (size_t i = 0; i < vhThreads.size(); i++)
+    {
+        FILETIME ftCreation;
+        FILETIME ftExit;
+        FILETIME ftKernel;
+        FILETIME ftUser;
+        ULONG64 ullCycleTime;
+
+        if (!GetThreadTimes(vhThreads[i], &ftCreation, &ftExit, &ftKernel, &ftUser) ||
+            !QueryThreadCycleTime(vhThreads[i], &ullCycleTime))
+        {
+            return false;
+        }
 
-    if (target.GetUseRandomAccessPattern())
+        vSnapshots[i].ullKernelTime = (static_cast<UINT64>(ftKernel.dwHighDateTime) << 32) | ftKernel.dwLowDateTime;
+        vSnapshots[i].ullUserTime = (static_cast<UINT64>(ftUser.dwHighDateTime) << 32) | ftUser.dwLowDateTime;
+        vSnapshots[i].ullCycleTime = ullCycleTime;
+        vSnapshots[i].ullContextSwitches = 0;
+    }
+
+    // context switch counts are only exposed through the system process list
+    vector<BYTE> vBuffer(256 * 1024);
+    NTSTATUS Status;
+    while ((Status = g_pfnNtQuerySysInfo(SystemProcessInformation, &vBuffer[0], (ULONG)vBuffer.size(), NULL)) == STATUS_INFO_LENGTH_MISMATCH)
     {
-        nextBlockOffset = IORequestGenerator::GetNextFileOffset(tp, targetNum, 0);
+        vBuffer.resize(vBuffer.size() * 2);
     }
-    else
+    if (!NT_SUCCESS(Status))
     {
-        // interlocked sequential   - getnext starts the clock from zero, thread independent
-        // parallel async           - getthreadbase, thread dependent
-        // sequential               - "", and initialize private counter
-        if (target.GetUseInterlockedSequential())
-        {
-            nextBlockOffset = IORequestGenerator::GetNextFileOffset(tp, targetNum, 0);
-        }
-        else
-        {
-            nextBlockOffset = IORequestGenerator::GetThreadBaseFileOffset(tp, targetNum);
+        return false;
+    }
 
-            if (!target.GetUseParallelAsyncIO())
+    HANDLE hProcessId = (HANDLE)(ULONG_PTR)GetCurrentProcessId();
+    BYTE *pEntry = &vBuffer[0];
+    for (;;)
+    {
+        PSYSTEM_PROCESS_INFORMATION pProcess = (PSYSTEM_PROCESS_INFORMATION)pEntry;
+        if (pProcess->UniqueProcessId == hProcessId)
+        {
+            // the thread array immediately follows the process entry
+            PSYSTEM_THREAD_INFORMATION pThreads = (PSYSTEM_THREAD_INFORMATION)(pProcess + 1);
+            for (ULONG iThread = 0; iThread < pProcess->NumberOfThreads; iThread++)
             {
-                tp.vullPrivateSequentialOffsets[targetNum] = nextBlockOffset - baseFileOffset;
+                for (size_t i = 0; i < vhThreads.size(); i++)
+                {
+                    if (pThreads[iThread].ClientId.UniqueThread == (HANDLE)(ULONG_PTR)GetThreadId(vhThreads[i]))
+                    {
+                        vSnapshots[i].ullContextSwitches = pThreads[iThread].Reserved3;    //ContextSwitches
+                        break;
+                    }
+                }
             }
+            break;
+        }
+
+        if (pProcess->NextEntryOffset == 0)
+        {
+            break;
         }
+        pEntry += pProcess->NextEntryOffset;
     }
 
-    return nextBlockOffset;
+    return true;
 }
 
 /*****************************************************************************/
-// Decide the kind of IO to issue during a mix test
+bool IORequestGenerator::_GetProcessPageFaultCount(UINT64 *pullPageFaultCount) const
+{
+    PROCESS_MEMORY_COUNTERS counters;
+
+    assert(NULL != pullPageFaultCount);
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return false;
+    }
+
+    *pullPageFaultCount = counters.PageFaultCount;
+    return true;
+}
+
+/*****************************************************************************/
+// VirtualLock can lock no more than the process's minimum working set, which by default is far
+// smaller than the IO buffers; grow it by the size of all the buffers which are going to be locked
+//
+bool IORequestGenerator::_GrowWorkingSetForLockedBuffers(const TimeSpan& timeSpan, const vector<Target>& vTargets) const
+{
+    SIZE_T cbLocked = 0;
+    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+    {
+        if (i->GetLockBuffers() && !i->GetUseLargePages())
+        {
+            SIZE_T cThreads = (timeSpan.GetThreadCount() > 0) ? timeSpan.GetThreadCount() : i->GetThreadsPerFile();
+            cbLocked += cThreads * i->GetBlockSizeInBytes() * i->GetIoBufferCount();
+            cbLocked += static_cast<SIZE_T>(i->GetRandomDataWriteBufferSize());
+        }
+    }
+
+    if (cbLocked == 0)
+    {
+        return true;
+    }
+
+    SIZE_T cbMinimumWorkingSet;
+    SIZE_T cbMaximumWorkingSet;
+    if (!GetProcessWorkingSetSize(GetCurrentProcess(), &cbMinimumWorkingSet, &cbMaximumWorkingSet))
+    {
+        PrintError("ERROR: Could not query the working set size (error code: %u)\n", GetLastError());
+        return false;
+    }
+
+    SetPrivilege(SE_INC_WORKING_SET_NAME, "WARNING:");
+    if (!SetProcessWorkingSetSize(GetCurrentProcess(), cbMinimumWorkingSet + cbLocked, cbMaximumWorkingSet + cbLocked))
+    {
+        PrintError("ERROR: Could not grow the working set by %Iu bytes to lock the IO buffers (error code: %u)\n", cbLocked, GetLastError());
+        return false;
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+// size of the large pages backing a region: a large page allocation is backed by huge (1GiB) pages
+// where the system can find them, and QueryVirtualMemoryInformation (Windows 10 1703 and newer) is
+// the only way to tell; the page size flags follow the six documented flags of the region, and
+// without them the large page size is the minimum
+//
+struct MemoryRegionInformation     // WIN32_MEMORY_REGION_INFORMATION
+{
+    PVOID AllocationBase;
+    ULONG AllocationProtect;
+    ULONG Flags;
+    SIZE_T RegionSize;
+    SIZE_T CommitSize;
+};
+
+typedef BOOL (WINAPI *QueryVirtualMemoryInformationFn)(HANDLE, const VOID *, int, PVOID, SIZE_T, PSIZE_T);
+
+static UINT64 GetLargePageSize(const void *pBuffer)
+{
+    const int MEMORY_REGION_INFO = 0;                   // MemoryRegionInfo
+    const ULONG REGION_PAGE_SIZE_HUGE = (1 << 12);      // follows PageSizeLarge (1 << 11)
+    const UINT64 HUGE_PAGE_SIZE = 1024 * 1024 * 1024;
+
+    QueryVirtualMemoryInformationFn pfnQueryVirtualMemoryInformation =
+        (QueryVirtualMemoryInformationFn)GetProcAddress(GetModuleHandleW(L"kernelbase.dll"), "QueryVirtualMemoryInformation");
+    if (pfnQueryVirtualMemoryInformation != nullptr)
+    {
+        MemoryRegionInformation regionInfo = {};
+        if (pfnQueryVirtualMemoryInformation(GetCurrentProcess(), pBuffer, MEMORY_REGION_INFO, &regionInfo, sizeof(regionInfo), nullptr) &&
+            (regionInfo.Flags & REGION_PAGE_SIZE_HUGE) != 0)
+        {
+            return HUGE_PAGE_SIZE;
+        }
+    }
+    return GetLargePageMinimum();
+}
+
+/*****************************************************************************/
+// size of the pages backing a buffer, and whether they are resident and cannot be paged out
+//
+static void GetBufferPageInfo(const void *pBuffer, UINT64 *pullPageSize, bool *pfLocked)
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    *pullPageSize = systemInfo.dwPageSize;
+    *pfLocked = false;
+
+    PSAPI_WORKING_SET_EX_INFORMATION workingSetInfo;
+    workingSetInfo.VirtualAddress = const_cast<void *>(pBuffer);
+    if (QueryWorkingSetEx(GetCurrentProcess(), &workingSetInfo, sizeof(workingSetInfo)) && workingSetInfo.VirtualAttributes.Valid)
+    {
+        // large pages are always resident and never paged out
+        if (workingSetInfo.VirtualAttributes.LargePage)
+        {
+            *pullPageSize = GetLargePageSize(pBuffer);
+            *pfLocked = true;
+        }
+        else
+        {
+            *pfLocked = (workingSetInfo.VirtualAttributes.Locked != 0);
+        }
+    }
+}
+
+/*****************************************************************************/
+// calculate the offset of the next I/O operation
+//
+
+__inline UINT64 IORequestGenerator::GetNextFileOffset(ThreadParameters& tp, size_t targetNum, UINT64 prevOffset)
+{
+    Target &target = tp.vTargets[targetNum];
+
+    // IOs to a file set take their offsets from the file chosen for them as they are issued
+    if (target.GetFileSetCount() > 0)
+    {
+        return 0;
+    }
+
+    UINT64 blockAlignment = target.GetBlockAlignmentInBytes();
+    UINT64 baseFileOffset = target.GetBaseFileOffsetInBytes();
+    UINT64 blockSize = target.GetBlockSizeInBytes();
+    UINT64 nextBlockOffset;
+
+    // increment/produce - note, logically relative to base offset
+    if (target.GetUseRandomAccessPattern())
+    {
+        nextBlockOffset = rand64();
+        nextBlockOffset -= (nextBlockOffset % blockAlignment);
+    }
+    else if (target.GetUseParallelAsyncIO())
+    {
+        nextBlockOffset = prevOffset - baseFileOffset + blockAlignment;
+    }
+    else if (target.GetUseInterlockedSequential())
+    {
+        nextBlockOffset = InterlockedAdd64((PLONGLONG) &tp.pullSharedSequentialOffsets[targetNum], blockAlignment) - blockAlignment;
+    }
+    else // normal sequential access pattern
+    {
+        nextBlockOffset = (tp.vullPrivateSequentialOffsets[targetNum] += blockAlignment);
+    }
+
+    // now apply bounds for IO offset
+    // aligned target size is the closed interval of byte offsets at which it is legal to issue IO
+    // ISSUE IMPROVEMENT: much of this should be precalculated. It belongs within Target, which will
+    //      need discovery of target sizing moved from its current just-in-time at thread launch.
+    UINT64 alignedTargetSize = tp.vullFileSizes[targetNum] - baseFileOffset - blockSize;
+    if (target.GetUseRandomAccessPattern() ||
+        target.GetUseInterlockedSequential())
+    {
+        // these access patterns occur on blockaligned boundaries relative to base
+        // convert aligned target size to the open interval
+        alignedTargetSize = ((alignedTargetSize / blockAlignment) + 1) * blockAlignment;
+        nextBlockOffset %= alignedTargetSize;
+    }
+    else
+    {
+        // parasync and seq bases are potentially modified by threadstride and loop back to the
+        // file base offset + increment which will return them to their initial base offset.
+        if (nextBlockOffset > alignedTargetSize)
+        {
+            nextBlockOffset = (IORequestGenerator::GetThreadBaseFileOffset(tp, targetNum) - baseFileOffset) % blockAlignment;
+            tp.vullPrivateSequentialOffsets[targetNum] = nextBlockOffset;
+        }
+    }
+
+    // Convert into the next full offset
+    nextBlockOffset += baseFileOffset;
+
+#ifndef NDEBUG
+    // Don't overrun the end of the file
+    UINT64 fileSize = tp.vullFileSizes[targetNum];
+    assert(nextBlockOffset + blockSize <= fileSize);
+#endif
+
+    return nextBlockOffset;
+}
+
+__inline UINT64 IORequestGenerator::GetThreadBaseFileOffset(ThreadParameters& tp, size_t targetNum)
+{
+    const Target &target = tp.vTargets[targetNum];
+
+    UINT64 baseFileOffset = target.GetBaseFileOffsetInBytes();
+    UINT64 nextBlockOffset;
+
+    if (target.GetUseRandomAccessPattern())
+    {
+        nextBlockOffset = IORequestGenerator::GetNextFileOffset(tp, targetNum, 0);
+    }
+    else
+    {
+        // interlocked sequential   - thread stride is always zero, enforced during profile validation
+        // parallel async           - apply thread stride
+        // sequential               - apply thread stride
+        nextBlockOffset = baseFileOffset + tp.ulRelativeThreadNo * target.GetThreadStrideInBytes();
+    }
+
+    return nextBlockOffset;
+}
+
+__inline UINT64 IORequestGenerator::GetStartingFileOffset(ThreadParameters& tp, size_t targetNum)
+{
+    const Target &target = tp.vTargets[targetNum];
+
+    UINT64 baseFileOffset = target.GetBaseFileOffsetInBytes();
+    UINT64 nextBlockOffset;
+
+    if (target.GetUseRandomAccessPattern())
+    {
+        nextBlockOffset = IORequestGenerator::GetNextFileOffset(tp, targetNum, 0);
+    }
+    else
+    {
+        // interlocked sequential   - getnext starts the clock from zero, thread independent
+        // parallel async           - getthreadbase, thread dependent
+        // sequential               - "", and initialize private counter
+        if (target.GetUseInterlockedSequential())
+        {
+            nextBlockOffset = IORequestGenerator::GetNextFileOffset(tp, targetNum, 0);
+        }
+        else
+        {
+            nextBlockOffset = IORequestGenerator::GetThreadBaseFileOffset(tp, targetNum);
+
+            if (!target.GetUseParallelAsyncIO())
+            {
+                tp.vullPrivateSequentialOffsets[targetNum] = nextBlockOffset - baseFileOffset;
+            }
+        }
+    }
+
+    return nextBlockOffset;
+}
+
+/*****************************************************************************/
+// Decide the kind of IO to issue during a mix test
 // Future Work: Add more types of distribution in addition to random
 __inline static IOOperation DecideIo(UINT32 ulWriteRatio)
 {
     return (((UINT32)abs(rand() % 100 + 1)) > ulWriteRatio) ? IOOperation::ReadIO : IOOperation::WriteIO;
  }
 
+/*****************************************************************************/
+// File offset an overlapped IO is issued at
+__inline static UINT64 GetOverlappedOffset(const OVERLAPPED *pOverlapped)
+{
+    return ((UINT64)pOverlapped->OffsetHigh << 32) | pOverlapped->Offset;
+}
+
 /*****************************************************************************/
 // function called from worker thread
 // performs asynch I/O using IO Completion Ports
@@ -675,24 +1250,56 @@ __inline static bool doWorkUsingIOCompletionPorts(ThreadParameters *p, HANDLE hC
             {
                 dwMinSleepTime = min(dwMinSleepTime, dwSleepTime);
                 overlappedQueue.Add(pReadyOverlapped);
+                p->cycleProfiler.Mark(WorkerPhase::Throttle);
                 continue;
             }
+            p->cycleProfiler.Mark(WorkerPhase::Throttle);
+
+            IOOperation readOrWrite;
+            readOrWrite = p->vdwIoType[iOverlapped] = DecideIo(pTarget->GetWriteRatio());
+            p->cycleProfiler.Mark(WorkerPhase::IoType);
+
+            HANDLE hFile = p->GetIoHandle(iTarget, iOverlapped);
+            if (INVALID_HANDLE_VALUE == hFile)
+            {
+                PrintError("t[%u:%u] error opening a file of the file set (error code: %u)\n", p->ulThreadNo, iTarget, GetLastError());
+                fOk = false;
+                goto cleanup;
+            }
+            p->cycleProfiler.Mark(WorkerPhase::FileOpen);
+
+            // the buffer is filled and stamped before the IO's latency starts
+            p->vpIoBuffers[iOverlapped] = (readOrWrite == IOOperation::ReadIO) ? p->GetReadBuffer(iTarget, iRequest) : p->GetWriteBuffer(iTarget, iRequest);
+            if (readOrWrite == IOOperation::WriteIO)
+            {
+                p->PrepareWriteBuffer(iTarget, p->vpIoBuffers[iOverlapped]);
+            }
+            p->dataVerifier.Prepare(iTarget, readOrWrite, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), GetOverlappedOffset(pReadyOverlapped), &p->vullVerifySequences[iOverlapped]);
+            p->cycleProfiler.Mark(WorkerPhase::Process);
 
             if (fMeasureLatency)
             {
-                p->vIoStartTimes[iOverlapped] = PerfTimer::GetTime(); // record IO start time 
+                p->vIoStartTimes[iOverlapped] = 0;  // IOs left out of the latency sample keep a zero start time
+                if (p->latencySampler.Sample(iTarget))
+                {
+                    p->vIoStartTimes[iOverlapped] = PerfTimer::GetTime(); // record IO start time 
+                    if (pThroughputMeter->IsRunning())
+                    {
+                        p->vIntendedStartTimes[iOverlapped] = pThroughputMeter->GetIntendedStartTime(p->vIoStartTimes[iOverlapped]);
+                    }
+                }
+                p->cycleProfiler.Mark(WorkerPhase::Accounting);
             }
 
-            IOOperation readOrWrite;
-            readOrWrite = p->vdwIoType[iOverlapped] = DecideIo(pTarget->GetWriteRatio());
             if (readOrWrite == IOOperation::ReadIO)
             {
-                rslt = ReadFile(p->vhTargets[iTarget], p->GetReadBuffer(iTarget, iRequest), pTarget->GetBlockSizeInBytes(), nullptr, pReadyOverlapped);
+                rslt = ReadFile(hFile, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), nullptr, pReadyOverlapped);
             }
             else
             {
-                rslt = WriteFile(p->vhTargets[iTarget], p->GetWriteBuffer(iTarget, iRequest), pTarget->GetBlockSizeInBytes(), nullptr, pReadyOverlapped);
+                rslt = WriteFile(hFile, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), nullptr, pReadyOverlapped);
             }
+            p->cycleProfiler.Mark(WorkerPhase::Submit);
 
             if (!rslt && GetLastError() != ERROR_IO_PENDING)
             {
@@ -701,25 +1308,44 @@ __inline static bool doWorkUsingIOCompletionPorts(ThreadParameters *p, HANDLE hC
                 goto cleanup;
             }
 
+            if (fMeasureLatency && p->vIoStartTimes[iOverlapped] != 0)
+            {
+                p->vIoSubmitEndTimes[iOverlapped] = PerfTimer::GetTime(); // record IO submit return time
+                p->cycleProfiler.Mark(WorkerPhase::Accounting);
+            }
+
             if (pThroughputMeter->IsRunning())
             {
                 pThroughputMeter->Adjust(pTarget->GetBlockSizeInBytes());
+                p->cycleProfiler.Mark(WorkerPhase::Throttle);
             }
         }
 
         // if no IOs are in flight, wait for the next scheduling time
+        p->schedulingProbe.EnterWait();
         if (fUseThrougputMeter && (overlappedQueue.GetCount() == p->vOverlapped.size()) && dwMinSleepTime != ~((DWORD)0))
         {
             Sleep(dwMinSleepTime);
         }
 
         // wait till one of the IO operations finishes
-        if (GetQueuedCompletionStatus(hCompletionPort, &dwBytesTransferred, &ulCompletionKey, &pCompletedOvrp, 1) != 0)
+        BOOL fDequeued = GetQueuedCompletionStatus(hCompletionPort, &dwBytesTransferred, &ulCompletionKey, &pCompletedOvrp, 1);
+        p->schedulingProbe.LeaveWait();
+        p->hardwareCounters.Update();
+        p->cycleProfiler.Mark(WorkerPhase::Wait);
+        if (fDequeued != 0)
         {
             //find which I/O operation it was (so we know to which buffer should we use)
             DWORD iOverlapped = (DWORD)(pCompletedOvrp - &p->vOverlapped[0]);
             size_t iTarget = p->vOverlappedIdToTargetId[iOverlapped];
 
+            UINT64 ullDequeueTime = 0;
+            bool fLatencySampled = fMeasureLatency && (p->vIoStartTimes[iOverlapped] != 0);
+            if (fLatencySampled)
+            {
+                ullDequeueTime = PerfTimer::GetTime(); // record IO completion dequeue time
+            }
+
             //check if I/O transferred all of the requested bytes
             Target *pTarget = &p->vTargets[iTarget];
             if (dwBytesTransferred != pTarget->GetBlockSizeInBytes())
@@ -738,8 +1364,11 @@ __inline static bool doWorkUsingIOCompletionPorts(ThreadParameters *p, HANDLE hC
                 p->pResults->vTargetResults[iTarget].Add(dwBytesTransferred,
                     p->vdwIoType[iOverlapped],
                     &p->vIoStartTimes[iOverlapped],
+                    &p->vIntendedStartTimes[iOverlapped],
+                    &p->vIoSubmitEndTimes[iOverlapped],
+                    &ullDequeueTime,
                     p->pullStartTime,
-                    fMeasureLatency,
+                    fLatencySampled,
                     p->pTimeSpan->GetCalculateIopsStdDev());
             }
 
@@ -754,6 +1383,13 @@ __inline static bool doWorkUsingIOCompletionPorts(ThreadParameters *p, HANDLE hC
                     dwIOCnt = 0;
                 }
             }
+            p->cycleProfiler.Mark(WorkerPhase::Accounting);
+
+            p->dataVerifier.Complete(iTarget, p->vdwIoType[iOverlapped], p->vpIoBuffers[iOverlapped], dwBytesTransferred, li.QuadPart, p->vullVerifySequences[iOverlapped]);
+            p->workStage.Run(*pTarget, p->vpIoBuffers[iOverlapped], dwBytesTransferred, &p->pResults->vTargetResults[iTarget]);
+            p->fileSetCache.Release(iOverlapped);
+            p->flushInjector.Complete(iTarget, p->vdwIoType[iOverlapped], fLatencySampled ? p->vIoStartTimes[iOverlapped] : 0);
+            p->cycleProfiler.Mark(WorkerPhase::Process);
 
             //restart the I/O operation that just completed
             li.QuadPart = IORequestGenerator::GetNextFileOffset(*p, iTarget, li.QuadPart);
@@ -768,6 +1404,7 @@ __inline static bool doWorkUsingIOCompletionPorts(ThreadParameters *p, HANDLE hC
                 li.QuadPart / pTarget->GetBlockSizeInBytes());
 
             overlappedQueue.Add(pCompletedOvrp);
+            p->cycleProfiler.Mark(WorkerPhase::Offset);
         }
         else
         {
@@ -779,6 +1416,15 @@ __inline static bool doWorkUsingIOCompletionPorts(ThreadParameters *p, HANDLE hC
                 goto cleanup;
             }
         }
+
+        // flushes run on the helper thread, with the thread's other IOs still issued and reaped
+        if (!p->flushInjector.Run())
+        {
+            PrintError("t[%u] error during flush (error code: 0x%x)\n", p->ulThreadNo, GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+        p->cycleProfiler.Mark(WorkerPhase::Wait);
     } // end work loop
 
 cleanup:
@@ -795,9 +1441,20 @@ VOID CALLBACK fileIOCompletionRoutine(DWORD dwErrorCode, DWORD dwBytesTransferre
 
     BOOL rslt = FALSE;
     LARGE_INTEGER li;
+    UINT64 ullDequeueTime = 0;
 
     ThreadParameters *p = (ThreadParameters *)pOverlapped->hEvent;
     bool fMeasureLatency = p->pTimeSpan->GetMeasureLatency();
+    size_t iOverlapped = (pOverlapped - &p->vOverlapped[0]);
+    bool fLatencySampled = fMeasureLatency && (p->vIoStartTimes[iOverlapped] != 0);
+
+    if (fLatencySampled)
+    {
+        ullDequeueTime = PerfTimer::GetTime(); // record IO completion dequeue time
+    }
+    p->schedulingProbe.LeaveWait();
+    p->hardwareCounters.Update();
+    p->cycleProfiler.Mark(WorkerPhase::Wait);
 
     assert(NULL != p);
 
@@ -808,7 +1465,6 @@ VOID CALLBACK fileIOCompletionRoutine(DWORD dwErrorCode, DWORD dwBytesTransferre
         goto cleanup;
     }
 
-    size_t iOverlapped = (pOverlapped - &p->vOverlapped[0]);
     size_t iTarget = p->vOverlappedIdToTargetId[iOverlapped];
     Target *pTarget = &p->vTargets[iTarget];
 
@@ -839,10 +1495,27 @@ VOID CALLBACK fileIOCompletionRoutine(DWORD dwErrorCode, DWORD dwBytesTransferre
         p->pResults->vTargetResults[iTarget].Add(dwBytesTransferred,
             p->vdwIoType[iOverlapped],
             &p->vIoStartTimes[iOverlapped],
+            &p->vIntendedStartTimes[iOverlapped],
+            &p->vIoSubmitEndTimes[iOverlapped],
+            &ullDequeueTime,
             p->pullStartTime,
-            fMeasureLatency,
+            fLatencySampled,
             p->pTimeSpan->GetCalculateIopsStdDev());
     }
+    p->cycleProfiler.Mark(WorkerPhase::Accounting);
+
+    p->dataVerifier.Complete(iTarget, p->vdwIoType[iOverlapped], p->vpIoBuffers[iOverlapped], dwBytesTransferred, GetOverlappedOffset(pOverlapped), p->vullVerifySequences[iOverlapped]);
+    p->workStage.Run(*pTarget, p->vpIoBuffers[iOverlapped], dwBytesTransferred, &p->pResults->vTargetResults[iTarget]);
+    p->fileSetCache.Release(iOverlapped);
+    p->flushInjector.Complete(iTarget, p->vdwIoType[iOverlapped], fLatencySampled ? p->vIoStartTimes[iOverlapped] : 0);
+    p->cycleProfiler.Mark(WorkerPhase::Process);
+
+    if (!p->flushInjector.Run())
+    {
+        PrintError("t[%u:%u] error during flush (error code: 0x%x)\n", p->ulThreadNo, iTarget, GetLastError());
+        goto cleanup;
+    }
+    p->cycleProfiler.Mark(WorkerPhase::Wait);
 
     //restart the I/O operation that just completed
     li.HighPart = pOverlapped->OffsetHigh;
@@ -858,35 +1531,67 @@ VOID CALLBACK fileIOCompletionRoutine(DWORD dwErrorCode, DWORD dwBytesTransferre
         iTarget,
         li.QuadPart,
         li.QuadPart / pTarget->GetBlockSizeInBytes());
+    p->cycleProfiler.Mark(WorkerPhase::Offset);
 
     // start a new IO operation
     if (g_bRun && !g_bThreadError)
     {
         size_t iRequest = iOverlapped - p->vFirstOverlappedIdForTargetId[iTarget];
+
+        IOOperation readOrWrite;
+        readOrWrite = p->vdwIoType[iOverlapped] = DecideIo(pTarget->GetWriteRatio());
+        p->cycleProfiler.Mark(WorkerPhase::IoType);
+
+        HANDLE hFile = p->GetIoHandle(iTarget, iOverlapped);
+        if (INVALID_HANDLE_VALUE == hFile)
+        {
+            PrintError("t[%u:%u] error opening a file of the file set (error code: %u)\n", p->ulThreadNo, iTarget, GetLastError());
+            goto cleanup;
+        }
+        p->cycleProfiler.Mark(WorkerPhase::FileOpen);
+
+        // the buffer is filled and stamped before the IO's latency starts
+        p->vpIoBuffers[iOverlapped] = (readOrWrite == IOOperation::ReadIO) ? p->GetReadBuffer(iTarget, iRequest) : p->GetWriteBuffer(iTarget, iRequest);
+        if (readOrWrite == IOOperation::WriteIO)
+        {
+            p->PrepareWriteBuffer(iTarget, p->vpIoBuffers[iOverlapped]);
+        }
+        p->dataVerifier.Prepare(iTarget, readOrWrite, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), li.QuadPart, &p->vullVerifySequences[iOverlapped]);
+        p->cycleProfiler.Mark(WorkerPhase::Process);
+
         if (fMeasureLatency)
         {
-            p->vIoStartTimes[iOverlapped] = PerfTimer::GetTime(); // record IO start time 
+            // IOs left out of the latency sample keep a zero start time
+            p->vIoStartTimes[iOverlapped] = p->latencySampler.Sample(iTarget) ? PerfTimer::GetTime() : 0; // record IO start time 
+            p->cycleProfiler.Mark(WorkerPhase::Accounting);
         }
 
-        IOOperation readOrWrite;
-        readOrWrite = p->vdwIoType[iOverlapped] = DecideIo(pTarget->GetWriteRatio());
         if (readOrWrite == IOOperation::ReadIO)
         {
-            rslt = ReadFileEx(p->vhTargets[iTarget], p->GetReadBuffer(iTarget, iRequest), pTarget->GetBlockSizeInBytes(), pOverlapped, fileIOCompletionRoutine);
+            rslt = ReadFileEx(hFile, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), pOverlapped, fileIOCompletionRoutine);
         }
         else
         {
-            rslt = WriteFileEx(p->vhTargets[iTarget], p->GetWriteBuffer(iTarget, iRequest), pTarget->GetBlockSizeInBytes(), pOverlapped, fileIOCompletionRoutine);
+            rslt = WriteFileEx(hFile, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), pOverlapped, fileIOCompletionRoutine);
         }
+        p->cycleProfiler.Mark(WorkerPhase::Submit);
 
         if (!rslt)
         {
             PrintError("t[%u:%u] error during %s error code: %u)\n", p->ulThreadNo, iTarget, (readOrWrite == IOOperation::ReadIO ? "read" : "write"), GetLastError());
             goto cleanup;
         }
+
+        if (fMeasureLatency && p->vIoStartTimes[iOverlapped] != 0)
+        {
+            p->vIoSubmitEndTimes[iOverlapped] = PerfTimer::GetTime(); // record IO submit return time
+            p->cycleProfiler.Mark(WorkerPhase::Accounting);
+        }
     }
 
 cleanup:
+    // the routine returns into the alertable wait it was called from
+    p->schedulingProbe.EnterWait();
     return;
 }
 
@@ -910,20 +1615,38 @@ __inline static bool doWorkUsingCompletionRoutines(ThreadParameters *p)
         Target *pTarget = &p->vTargets[iTarget];
         for (size_t iRequest = 0; iRequest < pTarget->GetRequestCount(); ++iRequest)
         {
-            if (fMeasureLatency)
-            {
-                p->vIoStartTimes[iOverlapped] = PerfTimer::GetTime(); // record IO start time 
-            }
-
             IOOperation readOrWrite;
             readOrWrite = p->vdwIoType[iOverlapped] = DecideIo(pTarget->GetWriteRatio());
-            if (readOrWrite == IOOperation::ReadIO)
+
+            HANDLE hFile = p->GetIoHandle(iTarget, iOverlapped);
+            if (INVALID_HANDLE_VALUE == hFile)
             {
-                rslt = ReadFileEx(p->vhTargets[iTarget], p->GetReadBuffer(iTarget, iRequest), pTarget->GetBlockSizeInBytes(), &p->vOverlapped[iOverlapped], fileIOCompletionRoutine);
+                PrintError("t[%u:%u] error opening a file of the file set (error code: %u)\n", p->ulThreadNo, iTarget, GetLastError());
+                fOk = false;
+                goto cleanup;
+            }
+
+            // the buffer is filled and stamped before the IO's latency starts
+            p->vpIoBuffers[iOverlapped] = (readOrWrite == IOOperation::ReadIO) ? p->GetReadBuffer(iTarget, iRequest) : p->GetWriteBuffer(iTarget, iRequest);
+            if (readOrWrite == IOOperation::WriteIO)
+            {
+                p->PrepareWriteBuffer(iTarget, p->vpIoBuffers[iOverlapped]);
+            }
+            p->dataVerifier.Prepare(iTarget, readOrWrite, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), GetOverlappedOffset(&p->vOverlapped[iOverlapped]), &p->vullVerifySequences[iOverlapped]);
+
+            if (fMeasureLatency)
+            {
+                // IOs left out of the latency sample keep a zero start time
+                p->vIoStartTimes[iOverlapped] = p->latencySampler.Sample(iTarget) ? PerfTimer::GetTime() : 0; // record IO start time 
+            }
+
+            if (readOrWrite == IOOperation::ReadIO)
+            {
+                rslt = ReadFileEx(hFile, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), &p->vOverlapped[iOverlapped], fileIOCompletionRoutine);
             }
             else
             {
-                rslt = WriteFileEx(p->vhTargets[iTarget], p->GetWriteBuffer(iTarget, iRequest), pTarget->GetBlockSizeInBytes(), &p->vOverlapped[iOverlapped], fileIOCompletionRoutine);
+                rslt = WriteFileEx(hFile, p->vpIoBuffers[iOverlapped], pTarget->GetBlockSizeInBytes(), &p->vOverlapped[iOverlapped], fileIOCompletionRoutine);
             }
 
             if (!rslt)
@@ -932,6 +1655,11 @@ __inline static bool doWorkUsingCompletionRoutines(ThreadParameters *p)
                 fOk = false;
                 goto cleanup;
             }
+
+            if (fMeasureLatency && p->vIoStartTimes[iOverlapped] != 0)
+            {
+                p->vIoSubmitEndTimes[iOverlapped] = PerfTimer::GetTime(); // record IO submit return time
+            }
             iOverlapped++;
         }
     }
@@ -939,7 +1667,9 @@ __inline static bool doWorkUsingCompletionRoutines(ThreadParameters *p)
     DWORD dwWaitResult = 0;
     while( g_bRun && !g_bThreadError )
     {
+        p->schedulingProbe.EnterWait();
         dwWaitResult = WaitForSingleObjectEx(p->hEndEvent, INFINITE, TRUE);
+        p->schedulingProbe.LeaveWait();
 
         assert(WAIT_IO_COMPLETION == dwWaitResult || (WAIT_OBJECT_0 == dwWaitResult && (!g_bRun || g_bThreadError)));
 
@@ -1016,6 +1746,39 @@ DWORD WINAPI threadFunc(LPVOID cookie)
         bool fPhysical = false;
         bool fPartition = false;
 
+        // the files of a file set are opened as IOs go to them, through the thread's handle cache;
+        // metadata targets have no file to open at all
+        if (pTarget->GetFileSetCount() > 0 || pTarget->IsMetadataTarget())
+        {
+            p->vhTargets.push_back(INVALID_HANDLE_VALUE);
+            if (pTarget->IsMetadataTarget())
+            {
+                // nothing is read or written; keep the per-target vectors in step without a buffer
+                p->vullFileSizes.push_back(0);
+                p->vpDataBuffers.push_back(nullptr);
+                p->vulNextBufferBlock.push_back(0);
+                iTarget++;
+                continue;
+            }
+
+            DWORD dwBufferNumaNode = NUMA_NO_NODE;
+            if (p->pTimeSpan->GetAffinityPolicy() == AffinityPolicy::DeviceLocal)
+            {
+                dwBufferNumaNode = p->vdwTargetNumaNodes[iTarget];
+            }
+
+            // the largest file of the set
+            p->vullFileSizes.push_back(max(pTarget->GetFileSetMaxFileSize(), max(pTarget->GetFileSetMinFileSize(), (UINT64)pTarget->GetBlockSizeInBytes())));
+            if (!p->AllocateAndFillBufferForTarget(*pTarget, dwBufferNumaNode))
+            {
+                PrintError("FATAL ERROR: Could not allocate a buffer bytes for target '%s'. Error code: 0x%x\n", pTarget->GetPath().c_str(), GetLastError());
+                fOk = false;
+                goto cleanup;
+            }
+            iTarget++;
+            continue;
+        }
+
         string sPath(pTarget->GetPath());
         const char *filename = sPath.c_str();
 
@@ -1056,11 +1819,11 @@ DWORD WINAPI threadFunc(LPVOID cookie)
         // get/set file flags
         DWORD dwFlags = pTarget->GetCreateFlags(p->vTargets.size() > 1);
         DWORD dwDesiredAccess = 0;
-        if (pTarget->GetWriteRatio() == 0)
+        if (pTarget->GetWriteRatio() == 0 && !pTarget->GetGroupCommit())
         {
             dwDesiredAccess = GENERIC_READ;
         }
-        else if (pTarget->GetWriteRatio() == 100)
+        else if (pTarget->GetWriteRatio() == 100 || pTarget->GetGroupCommit())
         {
             dwDesiredAccess = GENERIC_WRITE;
         }
@@ -1168,6 +1931,11 @@ DWORD WINAPI threadFunc(LPVOID cookie)
                 p->vullFileSizes.push_back(fsize);
             }
 
+            if (p->vpVerifyStates[iTarget] != nullptr)
+            {
+                p->vpVerifyStates[iTarget]->Initialize(p->vullFileSizes[iTarget], pTarget->GetBlockSizeInBytes());
+            }
+
             UINT64 startingFileOffset = IORequestGenerator::GetThreadBaseFileOffset(*p, iTarget);
 
             // test whether the file is large enough for this thread to do work
@@ -1201,8 +1969,13 @@ DWORD WINAPI threadFunc(LPVOID cookie)
             }
         }
 
-        // allocate memory for a data buffer
-        if (!p->AllocateAndFillBufferForTarget(*pTarget))
+        // allocate memory for a data buffer; with device-local affinity it comes from the device's node
+        DWORD dwBufferNumaNode = NUMA_NO_NODE;
+        if (p->pTimeSpan->GetAffinityPolicy() == AffinityPolicy::DeviceLocal)
+        {
+            dwBufferNumaNode = p->vdwTargetNumaNodes[iTarget];
+        }
+        if (!p->AllocateAndFillBufferForTarget(*pTarget, dwBufferNumaNode))
         {
             PrintError("FATAL ERROR: Could not allocate a buffer bytes for target '%s'. Error code: 0x%x\n", pTarget->GetPath().c_str(), GetLastError());
             fOk = false;
@@ -1229,6 +2002,16 @@ DWORD WINAPI threadFunc(LPVOID cookie)
     {
         p->pResults->vTargetResults[i].sPath = p->vTargets[i].GetPath();
         p->pResults->vTargetResults[i].ullFileSize = p->vullFileSizes[i];
+        p->pResults->vTargetResults[i].dwDeviceNumaNode = p->vdwTargetNumaNodes[i];
+        if (p->vpDataBuffers[i] != nullptr)
+        {
+            p->pResults->vTargetResults[i].ullDataBufferBytes = (UINT64)p->vTargets[i].GetBlockSizeInBytes() * p->vTargets[i].GetIoBufferCount();
+            GetBufferPageInfo(p->vpDataBuffers[i], &p->pResults->vTargetResults[i].ullDataBufferPageSize, &p->pResults->vTargetResults[i].fDataBufferLocked);
+        }
+        if (p->vTargets[i].GetRandomDataWriteBufferBase() != nullptr)
+        {
+            GetBufferPageInfo(p->vTargets[i].GetRandomDataWriteBufferBase(), &p->pResults->vTargetResults[i].ullWriteBufferPageSize, &p->pResults->vTargetResults[i].fWriteBufferLocked);
+        }
         if(fCalculateIopsStdDev) 
         {
             p->pResults->vTargetResults[i].readBucketizer.Initialize(ioBucketDuration, expectedNumberOfBuckets);
@@ -1236,12 +2019,144 @@ DWORD WINAPI threadFunc(LPVOID cookie)
         }
     }
 
+    //
+    // metadata operations
+    //
+    // validation keeps metadata targets and targets of reads and writes on different threads
+
+    if (p->vTargets[0].IsMetadataTarget())
+    {
+        // files left by an earlier run are cleared and half of the thread's files created before the start
+        if (!p->metadataWorker.Start(p->ulThreadNo, p->vTargets, p->pfAccountingOn, p->pResults))
+        {
+            PrintError("thread %u: could not lay out the files for metadata operations (error code: %u)\n", p->ulThreadNo, GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+
+        //wait for a signal to start
+        printfv(p->pProfile->GetVerbose(), "thread %u: waiting for a signal to start\n", p->ulThreadNo);
+        if (WAIT_FAILED == WaitForSingleObject(p->hStartEvent, INFINITE))
+        {
+            PrintError("Waiting for a signal to start failed (error code: %u)\n", GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+        printfv(p->pProfile->GetVerbose(), "thread %u: received signal to start\n", p->ulThreadNo);
+
+        if (g_bError)
+        {
+            fOk = false;
+            goto cleanup;
+        }
+
+        p->hardwareCounters.Start(p->pTimeSpan->GetHardwareCounters(), p->pfAccountingOn, p->pResults);
+        p->schedulingProbe.Start(p->pTimeSpan->GetSchedulingDelay(), p->pfAccountingOn, p->pullStartTime, p->pResults);
+
+        while(g_bRun && !g_bThreadError)
+        {
+            p->hardwareCounters.Update();
+
+            MetadataOperation type;
+            if (!p->metadataWorker.Run(&type))
+            {
+                PrintError("t[%u] error during metadata %s (error code: %u)\n", p->ulThreadNo, MetadataWorker::GetOperationName(type), GetLastError());
+                fOk = false;
+                goto cleanup;
+            }
+
+            // check if we should print a progress dot
+            if (p->pProfile->GetProgress() > 0)
+            {
+                ++dwIOCnt;
+                if (dwIOCnt == p->pProfile->GetProgress())
+                {
+                    print(".");
+                    dwIOCnt = 0;
+                }
+            }
+        }
+    }
+    //
+    // group commit
+    //
+    // validation leaves a group commit log as the only target of its threads
+
+    else if (p->vTargets[0].GetGroupCommit())
+    {
+        // appends are written through (-Sh) or flushed
+        if (!p->flushInjector.Start(p->vTargets, p->vhTargets, p->pfAccountingOn, p->pResults))
+        {
+            PrintError("thread %u: could not prepare the flushes of its targets (error code: %u)\n", p->ulThreadNo, GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+
+        if (!p->groupCommitter.Start(p->vTargets[0],
+                p->vhTargets[0],
+                p->vullFileSizes[0],
+                p->vpGroupCommitLogs[0],
+                (p->vTargets[0].GetCacheMode() == TargetCacheMode::DisableAllCache) ? nullptr : &p->flushInjector,
+                fMeasureLatency,
+                fCalculateIopsStdDev,
+                p->pfAccountingOn,
+                p->pullStartTime,
+                p->pResults,
+                &p->schedulingProbe))
+        {
+            PrintError("thread %u: could not lay out the group commit log; the target must hold the largest append (-Gb) (error code: %u)\n", p->ulThreadNo, GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+
+        //wait for a signal to start
+        printfv(p->pProfile->GetVerbose(), "thread %u: waiting for a signal to start\n", p->ulThreadNo);
+        if (WAIT_FAILED == WaitForSingleObject(p->hStartEvent, INFINITE))
+        {
+            PrintError("Waiting for a signal to start failed (error code: %u)\n", GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+        printfv(p->pProfile->GetVerbose(), "thread %u: received signal to start\n", p->ulThreadNo);
+
+        if (g_bError)
+        {
+            fOk = false;
+            goto cleanup;
+        }
+
+        p->hardwareCounters.Start(p->pTimeSpan->GetHardwareCounters(), p->pfAccountingOn, p->pResults);
+        p->schedulingProbe.Start(p->pTimeSpan->GetSchedulingDelay(), p->pfAccountingOn, p->pullStartTime, p->pResults);
+
+        while(g_bRun && !g_bThreadError)
+        {
+            p->hardwareCounters.Update();
+
+            if (!p->groupCommitter.Run())
+            {
+                PrintError("t[%u] error during group commit (error code: 0x%x)\n", p->ulThreadNo, GetLastError());
+                fOk = false;
+                goto cleanup;
+            }
+
+            // check if we should print a progress dot
+            if (p->pProfile->GetProgress() > 0)
+            {
+                ++dwIOCnt;
+                if (dwIOCnt == p->pProfile->GetProgress())
+                {
+                    print(".");
+                    dwIOCnt = 0;
+                }
+            }
+        }
+    }
     //
     // synchronous access
     //
     //FUTURE EXTENSION: enable asynchronous I/O even if only 1 outstanding I/O per file (requires another parameter)
 
-    if (p->vTargets.size() == 1 && p->vTargets[0].GetRequestCount() == 1)
+    else if (p->vTargets.size() == 1 && p->vTargets[0].GetRequestCount() == 1 && p->vTargets[0].GetFileSetCount() == 0)
     {
         Target *pTarget = &p->vTargets[0];
         DWORD dwBytesTransferred = 0;
@@ -1289,6 +2204,20 @@ DWORD WINAPI threadFunc(LPVOID cookie)
         assert(nullptr != p->vhTargets[0] );
         assert(pTarget->GetBlockSizeInBytes() > 0);
 
+        p->cycleProfiler.Start(p->pTimeSpan->GetProfileCpuCycles(), p->pfAccountingOn, p->pResults);
+        p->latencySampler.Start(p->pTimeSpan->GetLatencySampleRate(), p->ulThreadNo, p->vTargets.size());
+        p->hardwareCounters.Start(p->pTimeSpan->GetHardwareCounters(), p->pfAccountingOn, p->pResults);
+        p->schedulingProbe.Start(p->pTimeSpan->GetSchedulingDelay(), p->pfAccountingOn, p->pullStartTime, p->pResults);
+        p->workStage.Start(p->vTargets, p->pfAccountingOn);
+        p->dataVerifier.Start(p->ulThreadNo, p->vTargets, p->vpVerifyStates, p->pfAccountingOn, p->pullStartTime, p->pResults);
+        p->writeDataGenerator.Start(p->ulThreadNo, p->vTargets, p->pfAccountingOn, p->pResults);
+        if (!p->flushInjector.Start(p->vTargets, p->vhTargets, p->pfAccountingOn, p->pResults))
+        {
+            PrintError("thread %u: could not prepare the flushes of its targets (error code: %u)\n", p->ulThreadNo, GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+
         ThroughputMeter throughputMeter;
         DWORD dwSleepTime;
 
@@ -1305,12 +2234,18 @@ DWORD WINAPI threadFunc(LPVOID cookie)
 
         while(g_bRun && !g_bThreadError)
         {
+            p->hardwareCounters.Update();
+
             if (throughputMeter.IsRunning())
             {
                 dwSleepTime = throughputMeter.GetSleepTime();
+                p->cycleProfiler.Mark(WorkerPhase::Throttle);
                 if (0 != dwSleepTime)
                 {
+                    p->schedulingProbe.EnterWait();
                     Sleep(dwSleepTime);
+                    p->schedulingProbe.LeaveWait();
+                    p->cycleProfiler.Mark(WorkerPhase::Wait);
                     continue;
                 }
             }
@@ -1318,23 +2253,46 @@ DWORD WINAPI threadFunc(LPVOID cookie)
             //start read or write operation (depends of the type of test)
             //first access is always performed on base offset (even in case of random access)
 
+            IOOperation readOrWrite;
+            readOrWrite = DecideIo(pTarget->GetWriteRatio());
+            p->cycleProfiler.Mark(WorkerPhase::IoType);
+
+            // the buffer is filled and stamped before the IO's latency starts
+            BYTE *pIoBuffer = (readOrWrite == IOOperation::ReadIO) ? p->GetReadBuffer(0, 0) : p->GetWriteBuffer(0, 0);
+            if (readOrWrite == IOOperation::WriteIO)
+            {
+                p->PrepareWriteBuffer(0, pIoBuffer);
+            }
+            UINT64 ullVerifySequence = 0;
+            p->dataVerifier.Prepare(0, readOrWrite, pIoBuffer, pTarget->GetBlockSizeInBytes(), li.QuadPart, &ullVerifySequence);
+            p->cycleProfiler.Mark(WorkerPhase::Process);
+
             UINT64 ullStartTime = 0;
+            UINT64 ullIntendedStartTime = 0;
 
-            if (fMeasureLatency)
+            bool fLatencySampled = fMeasureLatency && p->latencySampler.Sample(0);
+            if (fLatencySampled)
             {
                 ullStartTime = PerfTimer::GetTime(); // record IO start time 
+                if (throughputMeter.IsRunning())
+                {
+                    ullIntendedStartTime = throughputMeter.GetIntendedStartTime(ullStartTime);
+                }
+                p->cycleProfiler.Mark(WorkerPhase::Accounting);
             }
 
-            IOOperation readOrWrite;
-            readOrWrite = DecideIo(pTarget->GetWriteRatio());
+            p->schedulingProbe.EnterWait();
             if (readOrWrite == IOOperation::ReadIO) 
             {
-                rslt = ReadFile(p->vhTargets[0], p->GetReadBuffer(0, 0), pTarget->GetBlockSizeInBytes(), &dwBytesTransferred, nullptr);
+                rslt = ReadFile(p->vhTargets[0], pIoBuffer, pTarget->GetBlockSizeInBytes(), &dwBytesTransferred, nullptr);
             }
             else
             {
-                rslt = WriteFile(p->vhTargets[0], p->GetWriteBuffer(0, 0), pTarget->GetBlockSizeInBytes(), &dwBytesTransferred, nullptr);
+                rslt = WriteFile(p->vhTargets[0], pIoBuffer, pTarget->GetBlockSizeInBytes(), &dwBytesTransferred, nullptr);
             }
+            p->schedulingProbe.LeaveWait();
+            // synchronous IO blocks in the call, so device time is charged to the wait phase
+            p->cycleProfiler.Mark(WorkerPhase::Wait);
 
             if (!rslt)
             {
@@ -1352,6 +2310,7 @@ DWORD WINAPI threadFunc(LPVOID cookie)
             if (throughputMeter.IsRunning())
             {
                 throughputMeter.Adjust(pTarget->GetBlockSizeInBytes());
+                p->cycleProfiler.Mark(WorkerPhase::Throttle);
             }
 
             if (*p->pfAccountingOn)
@@ -1359,8 +2318,11 @@ DWORD WINAPI threadFunc(LPVOID cookie)
                 p->pResults->vTargetResults[0].Add(dwBytesTransferred,
                     readOrWrite,
                     &ullStartTime,
+                    &ullIntendedStartTime,
+                    nullptr,    // synchronous IO: the call spans the whole IO, there is nothing to split
+                    nullptr,
                     p->pullStartTime,
-                    fMeasureLatency,
+                    fLatencySampled,
                     fCalculateIopsStdDev);
             }
 
@@ -1374,6 +2336,20 @@ DWORD WINAPI threadFunc(LPVOID cookie)
                     dwIOCnt = 0;
                 }
             }
+            p->cycleProfiler.Mark(WorkerPhase::Accounting);
+
+            p->dataVerifier.Complete(0, readOrWrite, pIoBuffer, dwBytesTransferred, li.QuadPart, ullVerifySequence);
+            p->workStage.Run(*pTarget, pIoBuffer, dwBytesTransferred, &p->pResults->vTargetResults[0]);
+            p->flushInjector.Complete(0, readOrWrite, fLatencySampled ? ullStartTime : 0);
+            p->cycleProfiler.Mark(WorkerPhase::Process);
+
+            if (!p->flushInjector.Run())
+            {
+                PrintError("t[%u] error during flush (error code: 0x%x)\n", p->ulThreadNo, GetLastError());
+                fOk = false;
+                goto cleanup;
+            }
+            p->cycleProfiler.Mark(WorkerPhase::Wait);
 
             li.QuadPart = IORequestGenerator::GetNextFileOffset(*p, 0, li.QuadPart);
 
@@ -1388,6 +2364,7 @@ DWORD WINAPI threadFunc(LPVOID cookie)
                 fOk = false;
                 goto cleanup;
             }
+            p->cycleProfiler.Mark(WorkerPhase::Offset);
 
             assert(!g_bError);  // at this point we shouldn't be seeing initialization error
         }
@@ -1404,6 +2381,11 @@ DWORD WINAPI threadFunc(LPVOID cookie)
         {
             for (unsigned int i = 0; i < p->vTargets.size(); i++)
             {
+                // files of a file set are associated with the port as they are opened
+                if (INVALID_HANDLE_VALUE == p->vhTargets[i] && nullptr != hCompletionPort)
+                {
+                    continue;
+                }
 
                 hCompletionPort = CreateIoCompletionPort(p->vhTargets[i], hCompletionPort, 0, 1);
                 if (nullptr == hCompletionPort)
@@ -1430,6 +2412,17 @@ DWORD WINAPI threadFunc(LPVOID cookie)
         p->vIoStartTimes.clear();
         p->vIoStartTimes.resize(cOverlapped);
 
+        p->vIntendedStartTimes.clear();
+        p->vIntendedStartTimes.resize(cOverlapped);
+
+        p->vIoSubmitEndTimes.clear();
+        p->vIoSubmitEndTimes.resize(cOverlapped);
+
+        p->vpIoBuffers.clear();
+        p->vpIoBuffers.resize(cOverlapped);
+        p->vullVerifySequences.clear();
+        p->vullVerifySequences.resize(cOverlapped);
+
         p->vFirstOverlappedIdForTargetId.clear();
         
         UINT32 iOverlapped = 0;
@@ -1474,6 +2467,9 @@ DWORD WINAPI threadFunc(LPVOID cookie)
             }
         }
 
+        // summing the access distribution of a large file set takes a while, so it is done before the start
+        p->fileSetCache.Start(p->ulThreadNo, p->vTargets, cOverlapped, hCompletionPort, p->pfAccountingOn, p->pResults);
+
         //
         // wait for a signal to start
         //
@@ -1493,6 +2489,20 @@ DWORD WINAPI threadFunc(LPVOID cookie)
             goto cleanup;
         }
 
+        p->cycleProfiler.Start(p->pTimeSpan->GetProfileCpuCycles(), p->pfAccountingOn, p->pResults);
+        p->latencySampler.Start(p->pTimeSpan->GetLatencySampleRate(), p->ulThreadNo, p->vTargets.size());
+        p->hardwareCounters.Start(p->pTimeSpan->GetHardwareCounters(), p->pfAccountingOn, p->pResults);
+        p->schedulingProbe.Start(p->pTimeSpan->GetSchedulingDelay(), p->pfAccountingOn, p->pullStartTime, p->pResults);
+        p->workStage.Start(p->vTargets, p->pfAccountingOn);
+        p->dataVerifier.Start(p->ulThreadNo, p->vTargets, p->vpVerifyStates, p->pfAccountingOn, p->pullStartTime, p->pResults);
+        p->writeDataGenerator.Start(p->ulThreadNo, p->vTargets, p->pfAccountingOn, p->pResults);
+        if (!p->flushInjector.Start(p->vTargets, p->vhTargets, p->pfAccountingOn, p->pResults))
+        {
+            PrintError("thread %u: could not prepare the flushes of its targets (error code: %u)\n", p->ulThreadNo, GetLastError());
+            fOk = false;
+            goto cleanup;
+        }
+
         //error handling and memory freeing is done in doWorkUsingIOCompletionPorts and doWorkUsingCompletionRoutines
         if (!p->pTimeSpan->GetCompletionRoutines())
         {
@@ -1535,9 +2545,16 @@ cleanup:
     }
 
     // close files
+    p->fileSetCache.Close();
+    p->metadataWorker.Close();
+    p->flushInjector.Close();
+    p->groupCommitter.Close();
     for (auto i = p->vhTargets.begin(); i != p->vhTargets.end(); i++)
     {
-        CloseHandle(*i);
+        if (INVALID_HANDLE_VALUE != *i)
+        {
+            CloseHandle(*i);
+        }
     }
 
     // close completion ports
@@ -1619,18 +2636,17 @@ DWORD IORequestGenerator::_CreateDirectoryPath(const char *pszPath) const
 }
 
 /*****************************************************************************/
-// create a file of the given size
+// create a file of the given size; a non-zero fragment count lays it out in that many extents.
+// The privilege and the write buffers come from the precreation context, set up once for all its files
 //
-bool IORequestGenerator::_CreateFile(UINT64 ullFileSize, const char *pszFilename, bool fZeroBuffers, bool fVerbose) const
+bool IORequestGenerator::_CreateFile(UINT64 ullFileSize, const char *pszFilename, bool fZeroBuffers, DWORD dwFragmentCount, PrecreateContext& precreate) const
 {
-    bool fSlowWrites = false;
-    printfv(fVerbose, "Creating file '%s' of size %I64u.\n", pszFilename, ullFileSize);
-
-    //enable SE_MANAGE_VOLUME_NAME privilege, required to set valid size of a file
-    if (!SetPrivilege(SE_MANAGE_VOLUME_NAME, "WARNING:"))
+    bool fSlowWrites = !precreate.fCanSetValidData;
+    const BYTE *pFillBuffer = fZeroBuffers ? precreate.pZeroBuffer : precreate.pPatternBuffer;
+    printfv(precreate.fVerbose, "Creating file '%s' of size %I64u.\n", pszFilename, ullFileSize);
+    if (dwFragmentCount > 0)
     {
-        PrintError("WARNING: Could not set privileges for setting valid file size; will use a slower method of preparing the file\n", GetLastError());
-        fSlowWrites = true;
+        printfv(precreate.fVerbose, "Laying out file '%s' in %u extents.\n", pszFilename, dwFragmentCount);
     }
 
     // there are various forms of paths we do not support creating subdir hierarchies
@@ -1656,7 +2672,22 @@ bool IORequestGenerator::_CreateFile(UINT64 ullFileSize, const char *pszFilename
         return false;
     }
 
-    if (ullFileSize > 0)
+    if (ullFileSize > 0 && dwFragmentCount > 0)
+    {
+        LARGE_INTEGER li;
+        li.QuadPart = ullFileSize;
+
+        //the extents are written in whole sectors; trim the file back to its size afterwards
+        if (!_FillFragmentedFile(ullFileSize, pszFilename, pFillBuffer, dwFragmentCount, &precreate.llBytesFilled) ||
+            !SetFilePointerEx(hFile, li, nullptr, FILE_BEGIN) ||
+            !SetEndOfFile(hFile))
+        {
+            PrintError("Could not lay out the fragmented file (error code: %u)\n", GetLastError());
+            CloseHandle(hFile);
+            return false;
+        }
+    }
+    else if (ullFileSize > 0)
     {
         LARGE_INTEGER li;
         li.QuadPart = ullFileSize;
@@ -1692,154 +2723,632 @@ bool IORequestGenerator::_CreateFile(UINT64 ullFileSize, const char *pszFilename
             fSlowWrites = true;
         }
 
-        //if setting valid size couldn't be performed, fill in the file by simply writing to it (slower)
-        if (fSlowWrites)
+        //if setting valid size couldn't be performed, fill in the file by writing to it (slower)
+        if (fSlowWrites && !_FillFile(hFile, ullFileSize, pszFilename, pFillBuffer, &precreate.llBytesFilled))
         {
-            li.QuadPart = 0;
-            if (!SetFilePointerEx(hFile, li, &liNewFilePointer, FILE_BEGIN))
+            CloseHandle(hFile);
+            return false;
+        }
+    }
+
+    //if compiled with debug support, check file size
+#ifndef NDEBUG
+    LARGE_INTEGER li;
+    if( GetFileSizeEx(hFile, &li) )
+    {
+        assert(li.QuadPart == (LONGLONG)ullFileSize);
+    }
+#endif
+
+    CloseHandle(hFile);
+
+    return true;
+}
+
+/*****************************************************************************/
+// create the files of a file set which are missing or do not have their size; the directories
+// are made here, the files themselves in parallel like precreated ones
+//
+bool IORequestGenerator::_CreateFileSet(const Target& target, bool fVerbose) const
+{
+    vector<CreateFileParameters> vFilesToCreate;
+    string sDirectory;
+    for (UINT64 iFile = 0; iFile < target.GetFileSetCount(); iFile++)
+    {
+        string sPath = target.GetFileSetFilePath(iFile);
+        UINT64 ullFileSize = target.GetFileSetFileSize(iFile);
+
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (GetFileAttributesEx(sPath.c_str(), GetFileExInfoStandard, &attributes) &&
+            ((((UINT64)attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow) == ullFileSize)
+        {
+            continue;
+        }
+
+        // _CreateFile only creates the directories of absolute paths
+        string sFileDirectory = sPath.substr(0, sPath.rfind('\\'));
+        if (sFileDirectory != sDirectory)
+        {
+            sDirectory = sFileDirectory;
+            CreateDirectory(target.GetPath().c_str(), nullptr);
+            if (!CreateDirectory(sDirectory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
             {
-                PrintError("Could not set file pointer during file creation (error code: %u)\n", GetLastError());
-                CloseHandle(hFile);
+                PrintError("Could not create the directory %s (error code: %u)\n", sDirectory.c_str(), GetLastError());
                 return false;
             }
-            if (liNewFilePointer.QuadPart != li.QuadPart)
+        }
+
+        CreateFileParameters file;
+        file.sPath = sPath;
+        file.ullFileSize = ullFileSize;
+        file.fZeroWriteBuffers = target.GetZeroWriteBuffers();
+        file.dwFragmentCount = 0;
+        vFilesToCreate.push_back(file);
+    }
+
+    if (vFilesToCreate.size() > 0 && !_CreateFilesInParallel(vFilesToCreate, false))
+    {
+        return false;
+    }
+
+    printfv(fVerbose, "Created %u of the %u files of file set '%s'.\n", (UINT32)vFilesToCreate.size(), target.GetFileSetCount(), target.GetPath().c_str());
+    return true;
+}
+
+/*****************************************************************************/
+// fill a newly created file of the given size, keeping many large unbuffered writes in flight;
+// hFile is the buffered handle the file was created with, used for a tail which is not sector aligned;
+// pBuffer holds PRECREATE_WRITE_BYTES of the content every write repeats.
+// The file is only filled when its valid data length could not be set, and NTFS serializes writes
+// which extend the valid data length: there, the writes effectively reach the device one at a
+// time, and the queue only keeps the next one ready
+//
+#define PRECREATE_WRITE_BYTES       (1024 * 1024)
+#define PRECREATE_QUEUE_DEPTH       32
+#define PRECREATE_SECTOR_BYTES      4096
+
+bool IORequestGenerator::_FillFile(HANDLE hFile, UINT64 ullFileSize, const char *pszFilename, const BYTE *pBuffer, volatile LONG64 *pllBytesFilled) const
+{
+    bool fUnbuffered = true;
+    HANDLE hFillFile = CreateFile(pszFilename,
+                                  GENERIC_WRITE,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+                                  nullptr);
+    if (INVALID_HANDLE_VALUE == hFillFile)
+    {
+        // e.g. a filesystem which does not support unbuffered IO; the writes stay asynchronous
+        fUnbuffered = false;
+        hFillFile = CreateFile(pszFilename, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+        if (INVALID_HANDLE_VALUE == hFillFile)
+        {
+            PrintError("Could not open the file for filling (error code: %u)\n", GetLastError());
+            return false;
+        }
+    }
+
+    HANDLE hPort = CreateIoCompletionPort(hFillFile, nullptr, 0, 1);
+    if (nullptr == hPort)
+    {
+        PrintError("Could not set up filling the file (error code: %u)\n", GetLastError());
+        CloseHandle(hFillFile);
+        return false;
+    }
+
+    UINT64 ullFillSize = fUnbuffered ? ullFileSize - (ullFileSize % PRECREATE_SECTOR_BYTES) : ullFileSize;
+    UINT64 ullNextOffset = 0;
+    UINT32 cInFlight = 0;
+    bool fOk = true;
+    vector<OVERLAPPED> vOverlapped(PRECREATE_QUEUE_DEPTH);
+
+    for (size_t i = 0; i < vOverlapped.size() || cInFlight > 0; )
+    {
+        OVERLAPPED *pOverlapped = nullptr;
+        if (i < vOverlapped.size())
+        {
+            // fill the queue
+            pOverlapped = &vOverlapped[i++];
+        }
+        else
+        {
+            DWORD dwBytesWritten;
+            ULONG_PTR ulCompletionKey;
+            BOOL fCompleted = GetQueuedCompletionStatus(hPort, &dwBytesWritten, &ulCompletionKey, &pOverlapped, INFINITE);
+            if (nullptr == pOverlapped)
+            {
+                PrintError("Error waiting for writes during file creation (error code: %u)\n", GetLastError());
+                fOk = false;
+                break;
+            }
+            cInFlight--;
+            if (!fCompleted)
             {
-                PrintError("File pointer improperly moved during file creation\n");
-                CloseHandle(hFile);
-                return false;
+                PrintError("Error while writing during file creation (error code: %u)\n", GetLastError());
+                fOk = false;
+            }
+            else if (nullptr != pllBytesFilled)
+            {
+                InterlockedAdd64(pllBytesFilled, dwBytesWritten);
+            }
+        }
+
+        if (!fOk || ullNextOffset >= ullFillSize)
+        {
+            continue;
+        }
+
+        DWORD cbWrite = (DWORD)min((UINT64)PRECREATE_WRITE_BYTES, ullFillSize - ullNextOffset);
+        memset(pOverlapped, 0, sizeof(*pOverlapped));
+        pOverlapped->Offset = (DWORD)ullNextOffset;
+        pOverlapped->OffsetHigh = (DWORD)(ullNextOffset >> 32);
+        if (!WriteFile(hFillFile, pBuffer, cbWrite, nullptr, pOverlapped) && GetLastError() != ERROR_IO_PENDING)
+        {
+            PrintError("Error while writing during file creation (error code: %u)\n", GetLastError());
+            fOk = false;
+            continue;
+        }
+        cInFlight++;
+        ullNextOffset += cbWrite;
+    }
+
+    // the completion port failed with writes in flight; they own the buffer, their OVERLAPPED and
+    // the handle until they complete
+    if (cInFlight > 0)
+    {
+        CancelIoEx(hFillFile, nullptr);
+        for (auto& overlapped : vOverlapped)
+        {
+            while (!HasOverlappedIoCompleted(&overlapped))
+            {
+                Sleep(1);
+            }
+        }
+    }
+
+    CloseHandle(hPort);
+    CloseHandle(hFillFile);
+
+    // unbuffered writes cover whole sectors, the tail goes through the buffered handle
+    if (fOk && ullFillSize < ullFileSize)
+    {
+        LARGE_INTEGER li;
+        li.QuadPart = ullFillSize;
+        DWORD cbTail = (DWORD)(ullFileSize - ullFillSize);
+        DWORD dwBytesWritten;
+        if (!SetFilePointerEx(hFile, li, nullptr, FILE_BEGIN) ||
+            !WriteFile(hFile, pBuffer, cbTail, &dwBytesWritten, nullptr) ||
+            dwBytesWritten != cbTail)
+        {
+            PrintError("Error while writing the end of the file during file creation (error code: %u)\n", GetLastError());
+            fOk = false;
+        }
+        else if (nullptr != pllBytesFilled)
+        {
+            InterlockedAdd64(pllBytesFilled, cbTail);
+        }
+    }
+
+    return fOk;
+}
+
+/*****************************************************************************/
+void IORequestGenerator::_TerminateWorkerThreads(vector<HANDLE>& vhThreads) const
+{
+    for (UINT32 x = 0; x < vhThreads.size(); ++x)
+    {
+        assert(NULL != vhThreads[x]);
+#pragma warning( push )
+#pragma warning( disable : 6258 )
+        if (!TerminateThread(vhThreads[x], 0))
+        {
+            PrintError("Warning: unable to terminate worker thread %u\n", x);
+        }
+#pragma warning( pop )
+    }
+}
+/*****************************************************************************/
+void IORequestGenerator::_AbortWorkerThreads(HANDLE hStartEvent, vector<HANDLE>& vhThreads) const
+{
+    assert(NULL != hStartEvent);
+
+    if (NULL == hStartEvent)
+    {
+        return;
+    }
+
+    g_bError = TRUE;
+    if (!SetEvent(hStartEvent))
+    {
+        PrintError("Error signaling start event\n");
+        _TerminateWorkerThreads(vhThreads);
+    }
+    else
+    {
+        //FUTURE EXTENSION: maximal timeout may be added here (and below)
+        while (g_lRunningThreadsCount > 0)
+        {
+            Sleep(100);
+        }
+    }
+}
+
+/*****************************************************************************/
+bool IORequestGenerator::_StopETW(bool fUseETW, TRACEHANDLE hTraceSession) const
+{
+    bool fOk = true;
+    if (fUseETW)
+    {
+        PEVENT_TRACE_PROPERTIES pETWSession = StopETWSession(hTraceSession);
+        if (nullptr == pETWSession)
+        {
+            PrintError("Error stopping ETW session\n");
+            fOk = false;
+        }
+        else
+        {
+            free(pETWSession);
+        }
+    }
+    return fOk;
+}
+
+/*****************************************************************************/
+// initializes all global parameters
+//
+void IORequestGenerator::_InitializeGlobalParameters()
+{
+    g_lRunningThreadsCount = 0;     //number of currently running worker threads
+    g_bRun = TRUE;                  //used for letting threads know that they should stop working
+
+    g_bThreadError = FALSE;         //true means that an error has occured in one of the threads
+    g_bTracing = FALSE;             //true means that ETW is turned on
+
+    _hNTDLL = nullptr;              //handle to ntdll.dll
+    g_bError = FALSE;               //true means there was fatal error during intialization and threads shouldn't perform their work
+}
+
+/*****************************************************************************/
+// write cb bytes at the current position of a synchronous unbuffered handle; cb is sector aligned
+//
+static bool WriteFileRange(HANDLE hFile, UINT64 cb, const BYTE *pBuffer, volatile LONG64 *pllBytesFilled)
+{
+    while (cb > 0)
+    {
+        DWORD cbWrite = (DWORD)min((UINT64)PRECREATE_WRITE_BYTES, cb);
+        DWORD cbWritten;
+        if (!WriteFile(hFile, pBuffer, cbWrite, &cbWritten, nullptr) || (cbWritten != cbWrite))
+        {
+            return false;
+        }
+        if (nullptr != pllBytesFilled)
+        {
+            InterlockedExchangeAdd64(pllBytesFilled, cbWritten);
+        }
+        cb -= cbWritten;
+    }
+    return true;
+}
+
+/*****************************************************************************/
+// lay out a newly created file in the given number of extents, as on an aged filesystem;
+// each extent of the file is followed by an equally sized extent of a spacer file
+// allocated from the same free space, and deleting the spacer leaves the gaps between them
+//
+#define SPACER_NAME_ATTEMPTS        1024
+
+bool IORequestGenerator::_FillFragmentedFile(UINT64 ullFileSize, const char *pszFilename, const BYTE *pBuffer, DWORD dwFragmentCount, volatile LONG64 *pllBytesFilled) const
+{
+    UINT64 ullExtentSize = Target::GetFragmentExtentSize(ullFileSize, dwFragmentCount);
+
+    //write-through so that every extent is allocated when its write returns, in the order written
+    HANDLE hFillFile = CreateFile(pszFilename,
+                                  GENERIC_WRITE,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH,
+                                  nullptr);
+    if (INVALID_HANDLE_VALUE == hFillFile)
+    {
+        PrintError("Could not open the file for laying it out (error code: %u)\n", GetLastError());
+        return false;
+    }
+
+    //the spacer lives next to the file so that it is allocated on the same volume; it is deleted
+    //on close, so it must never be opened over an existing file - pick a name nobody else holds
+    string sSpacer;
+    HANDLE hSpacer = INVALID_HANDLE_VALUE;
+    for (UINT32 i = 0; i < SPACER_NAME_ATTEMPTS && INVALID_HANDLE_VALUE == hSpacer; i++)
+    {
+        char szSuffix[64];
+        sprintf_s(szSuffix, _countof(szSuffix), ".%u.%u.spacer", GetCurrentProcessId(), i);
+        sSpacer = pszFilename;
+        sSpacer += szSuffix;
+        hSpacer = CreateFile(sSpacer.c_str(),
+                             GENERIC_WRITE | DELETE,
+                             0,
+                             nullptr,
+                             CREATE_NEW,
+                             FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_DELETE_ON_CLOSE,
+                             nullptr);
+        if (INVALID_HANDLE_VALUE == hSpacer && ERROR_FILE_EXISTS != GetLastError())
+        {
+            break;
+        }
+    }
+    if (INVALID_HANDLE_VALUE == hSpacer)
+    {
+        PrintError("Could not create the spacer file %s (error code: %u)\n", sSpacer.c_str(), GetLastError());
+        CloseHandle(hFillFile);
+        return false;
+    }
+
+    bool fOk = true;
+    UINT64 ullOffset = 0;
+    while (fOk && ullOffset < ullFileSize)
+    {
+        UINT64 cbExtent = min(ullExtentSize, ullFileSize - ullOffset);
+        cbExtent = (cbExtent + PRECREATE_SECTOR_BYTES - 1) / PRECREATE_SECTOR_BYTES * PRECREATE_SECTOR_BYTES;
+
+        fOk = WriteFileRange(hFillFile, cbExtent, pBuffer, pllBytesFilled);
+        ullOffset += cbExtent;
+
+        //no gap is needed behind the last extent
+        if (fOk && ullOffset < ullFileSize)
+        {
+            fOk = WriteFileRange(hSpacer, cbExtent, pBuffer, nullptr);
+        }
+    }
+
+    if (!fOk)
+    {
+        PrintError("Error writing the fragmented file (error code: %u)\n", GetLastError());
+    }
+
+    CloseHandle(hSpacer);
+    CloseHandle(hFillFile);
+    return fOk;
+}
+
+/*****************************************************************************/
+// read back the extents a file is allocated in
+//
+bool IORequestGenerator::_GetFileLayout(const char *pszFilename, TargetLayout& layout) const
+{
+    layout.sPath = pszFilename;
+
+    char szVolume[MAX_PATH];
+    DWORD dwSectorsPerCluster;
+    DWORD dwBytesPerSector;
+    DWORD dwFreeClusters;
+    DWORD dwTotalClusters;
+    if (!GetVolumePathNameA(pszFilename, szVolume, _countof(szVolume)) ||
+        !GetDiskFreeSpaceA(szVolume, &dwSectorsPerCluster, &dwBytesPerSector, &dwFreeClusters, &dwTotalClusters))
+    {
+        PrintError("WARNING: Could not get the cluster size of the volume holding %s (error code: %u)\n", pszFilename, GetLastError());
+        return false;
+    }
+    layout.ullClusterBytes = (UINT64)dwSectorsPerCluster * dwBytesPerSector;
+
+    HANDLE hFile = CreateFile(pszFilename,
+                              FILE_READ_ATTRIBUTES,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (INVALID_HANDLE_VALUE == hFile)
+    {
+        PrintError("WARNING: Could not open %s for reading its layout (error code: %u)\n", pszFilename, GetLastError());
+        return false;
+    }
+
+    vector<BYTE> vBuffer(64 * 1024);
+    RETRIEVAL_POINTERS_BUFFER *pPointers = reinterpret_cast<RETRIEVAL_POINTERS_BUFFER *>(&vBuffer[0]);
+    STARTING_VCN_INPUT_BUFFER input;
+    input.StartingVcn.QuadPart = 0;
+
+    bool fOk = true;
+    bool fMoreData = true;
+    while (fMoreData)
+    {
+        DWORD cbReturned;
+        fMoreData = false;
+        if (!DeviceIoControl(hFile, FSCTL_GET_RETRIEVAL_POINTERS, &input, sizeof(input), pPointers, (DWORD)vBuffer.size(), &cbReturned, nullptr))
+        {
+            DWORD dwError = GetLastError();
+            if (ERROR_MORE_DATA == dwError)
+            {
+                fMoreData = true;
+            }
+            else
+            {
+                //a file with no allocation (empty, or resident in its metadata) has no extents
+                if (ERROR_HANDLE_EOF != dwError)
+                {
+                    PrintError("WARNING: Could not get the extents of %s (error code: %u)\n", pszFilename, dwError);
+                    fOk = false;
+                }
+                break;
             }
+        }
 
-            UINT32 ulBufSize;
-            UINT64 ullRemainSize;
+        INT64 llVcn = pPointers->StartingVcn.QuadPart;
+        for (DWORD i = 0; i < pPointers->ExtentCount; i++)
+        {
+            FileExtent extent;
+            extent.ullFileOffset = (UINT64)llVcn * layout.ullClusterBytes;
+            extent.llLcn = pPointers->Extents[i].Lcn.QuadPart;
+            extent.ullBytes = (UINT64)(pPointers->Extents[i].NextVcn.QuadPart - llVcn) * layout.ullClusterBytes;
+            llVcn = pPointers->Extents[i].NextVcn.QuadPart;
 
-            ulBufSize = 1024*1024;
-            if (ullFileSize < (UINT64)ulBufSize)
+            if (extent.llLcn != -1)
             {
-                ulBufSize = (UINT32)ullFileSize;
+                layout.ullExtentCount++;
+                layout.ullAllocatedBytes += extent.ullBytes;
+                layout.ullLargestExtentBytes = max(layout.ullLargestExtentBytes, extent.ullBytes);
             }
-
-            vector<BYTE> vBuf(ulBufSize);
-            for (UINT32 i=0; i<ulBufSize; ++i)
+            if (layout.vExtents.size() < TargetLayout::MAX_REPORTED_EXTENTS)
             {
-                vBuf[i] = fZeroBuffers ? 0 : (BYTE)(i&0xFF);
+                layout.vExtents.push_back(extent);
             }
+        }
+        input.StartingVcn.QuadPart = llVcn;
+    }
 
-            ullRemainSize = ullFileSize;
-            while (ullRemainSize > 0)
-            {
-                DWORD dwBytesWritten;
-                if ((UINT64)ulBufSize > ullRemainSize)
-                {
-                    ulBufSize = (UINT32)ullRemainSize;
-                }
-
-                if (!WriteFile(hFile, &vBuf[0], ulBufSize, &dwBytesWritten, NULL))
-                {
-                    PrintError("Error while writng during file creation (error code: %u)\n", GetLastError());
-                    CloseHandle(hFile);
-                    return false;
-                }
+    CloseHandle(hFile);
+    return fOk;
+}
 
-                if (dwBytesWritten != ulBufSize)
-                {
-                    PrintError("Improperly written data during file creation\n");
-                    CloseHandle(hFile);
-                    return false;
-                }
+/*****************************************************************************/
+// precreation thread: creates files until there are none left or one fails
+//
+DWORD WINAPI IORequestGenerator::_PrecreateThreadFunc(LPVOID pContext)
+{
+    PrecreateContext *pPrecreate = reinterpret_cast<PrecreateContext *>(pContext);
+    const vector<CreateFileParameters>& vFiles = *pPrecreate->pvFiles;
 
-                ullRemainSize -= ulBufSize;
-            }
+    for (LONG iFile = InterlockedIncrement(&pPrecreate->lNextFile) - 1;
+         iFile < (LONG)vFiles.size() && !pPrecreate->fError;
+         iFile = InterlockedIncrement(&pPrecreate->lNextFile) - 1)
+    {
+        const CreateFileParameters& file = vFiles[iFile];
+        if (!pPrecreate->pGenerator->_CreateFile(file.ullFileSize, file.sPath.c_str(), file.fZeroWriteBuffers, file.dwFragmentCount, *pPrecreate))
+        {
+            pPrecreate->fError = true;
         }
     }
+    return 0;
+}
 
-    //if compiled with debug support, check file size
-#ifndef NDEBUG
-    LARGE_INTEGER li;
-    if( GetFileSizeEx(hFile, &li) )
+/*****************************************************************************/
+// set up what the files of a precreation share: the privilege for setting their valid data length,
+// enabled once, and one buffer of each content the writes filling them can have
+//
+bool IORequestGenerator::_InitializePrecreateContext(PrecreateContext& precreate, const vector<CreateFileParameters> *pvFiles, bool fVerbose) const
+{
+    precreate.pGenerator = this;
+    precreate.pvFiles = pvFiles;
+    precreate.fVerbose = fVerbose;
+    precreate.lNextFile = 0;
+    precreate.llBytesFilled = 0;
+    precreate.fError = false;
+
+    //enable SE_MANAGE_VOLUME_NAME privilege, required to set valid size of a file
+    precreate.fCanSetValidData = SetPrivilege(SE_MANAGE_VOLUME_NAME, "WARNING:");
+    if (!precreate.fCanSetValidData)
     {
-        assert(li.QuadPart == (LONGLONG)ullFileSize);
+        PrintError("WARNING: Could not set privileges for setting valid file size; will use a slower method of preparing the file\n");
     }
-#endif
 
-    CloseHandle(hFile);
+    // the buffers are only read from, by every write of every file
+    BYTE *pZeroBuffer = (BYTE *)VirtualAlloc(nullptr, PRECREATE_WRITE_BYTES, MEM_COMMIT, PAGE_READWRITE);
+    BYTE *pPatternBuffer = (BYTE *)VirtualAlloc(nullptr, PRECREATE_WRITE_BYTES, MEM_COMMIT, PAGE_READWRITE);
+    precreate.pZeroBuffer = pZeroBuffer;
+    precreate.pPatternBuffer = pPatternBuffer;
+    if (nullptr == pZeroBuffer || nullptr == pPatternBuffer)
+    {
+        PrintError("Could not allocate the buffers for filling files (error code: %u)\n", GetLastError());
+        _FreePrecreateContext(precreate);
+        return false;
+    }
 
+    for (UINT32 i = 0; i < PRECREATE_WRITE_BYTES; ++i)
+    {
+        pZeroBuffer[i] = 0;
+        pPatternBuffer[i] = (BYTE)(i & 0xFF);
+    }
     return true;
 }
 
-/*****************************************************************************/
-void IORequestGenerator::_TerminateWorkerThreads(vector<HANDLE>& vhThreads) const
+void IORequestGenerator::_FreePrecreateContext(PrecreateContext& precreate) const
 {
-    for (UINT32 x = 0; x < vhThreads.size(); ++x)
+    if (nullptr != precreate.pZeroBuffer)
     {
-        assert(NULL != vhThreads[x]);
-#pragma warning( push )
-#pragma warning( disable : 6258 )
-        if (!TerminateThread(vhThreads[x], 0))
-        {
-            PrintError("Warning: unable to terminate worker thread %u\n", x);
-        }
-#pragma warning( pop )
+        VirtualFree(const_cast<BYTE *>(precreate.pZeroBuffer), 0, MEM_RELEASE);
+        precreate.pZeroBuffer = nullptr;
+    }
+    if (nullptr != precreate.pPatternBuffer)
+    {
+        VirtualFree(const_cast<BYTE *>(precreate.pPatternBuffer), 0, MEM_RELEASE);
+        precreate.pPatternBuffer = nullptr;
     }
 }
+
+#define PRECREATE_MAX_THREADS           8
+#define PRECREATE_PROGRESS_INTERVAL_MS  5000
+
 /*****************************************************************************/
-void IORequestGenerator::_AbortWorkerThreads(HANDLE hStartEvent, vector<HANDLE>& vhThreads) const
+// create the files in parallel; each one that must be filled keeps its own queue of writes
+//
+bool IORequestGenerator::_CreateFilesInParallel(const vector<CreateFileParameters>& vFilesToCreate, bool fVerbose) const
 {
-    assert(NULL != hStartEvent);
-
-    if (NULL == hStartEvent)
+    PrecreateContext context;
+    if (!_InitializePrecreateContext(context, &vFilesToCreate, fVerbose))
     {
-        return;
+        return false;
     }
 
-    g_bError = TRUE;
-    if (!SetEvent(hStartEvent))
+    UINT64 ullTotalBytes = 0;
+    for (const auto& file : vFilesToCreate)
     {
-        PrintError("Error signaling start event\n");
-        _TerminateWorkerThreads(vhThreads);
+        ullTotalBytes += file.ullFileSize;
     }
-    else
+
+    UINT64 ullStartTime = PerfTimer::GetTime();
+    vector<HANDLE> vhThreads;
+    size_t cThreads = min(vFilesToCreate.size(), (size_t)PRECREATE_MAX_THREADS);
+    for (size_t i = 0; i < cThreads; i++)
     {
-        //FUTURE EXTENSION: maximal timeout may be added here (and below)
-        while (g_lRunningThreadsCount > 0)
+        HANDLE hThread = CreateThread(NULL, 64 * 1024, _PrecreateThreadFunc, &context, 0, NULL);
+        if (NULL == hThread)
         {
-            Sleep(100);
+            break;
         }
+        vhThreads.push_back(hThread);
     }
-}
 
-/*****************************************************************************/
-bool IORequestGenerator::_StopETW(bool fUseETW, TRACEHANDLE hTraceSession) const
-{
-    bool fOk = true;
-    if (fUseETW)
+    if (vhThreads.size() == 0)
     {
-        PEVENT_TRACE_PROPERTIES pETWSession = StopETWSession(hTraceSession);
-        if (nullptr == pETWSession)
+        // no thread to spare, create them here
+        _PrecreateThreadFunc(&context);
+    }
+    else
+    {
+        while (WAIT_TIMEOUT == WaitForMultipleObjects((DWORD)vhThreads.size(), &vhThreads[0], TRUE, PRECREATE_PROGRESS_INTERVAL_MS))
         {
-            PrintError("Error stopping ETW session\n");
-            fOk = false;
+            UINT64 ullFilled = context.llBytesFilled;
+            double fSeconds = PerfTimer::PerfTimeToSeconds(PerfTimer::GetTime() - ullStartTime);
+            if (ullFilled > 0)
+            {
+                PrintError("precreating files: %I64u of %I64u MiB written (%.1lf MiB/s)\n",
+                    ullFilled / (1024 * 1024),
+                    ullTotalBytes / (1024 * 1024),
+                    ullFilled / fSeconds / (1024 * 1024));
+            }
         }
-        else
+
+        for (auto hThread : vhThreads)
         {
-            free(pETWSession);
+            CloseHandle(hThread);
         }
     }
-    return fOk;
-}
-
-/*****************************************************************************/
-// initializes all global parameters
-//
-void IORequestGenerator::_InitializeGlobalParameters()
-{
-    g_lRunningThreadsCount = 0;     //number of currently running worker threads
-    g_bRun = TRUE;                  //used for letting threads know that they should stop working
 
-    g_bThreadError = FALSE;         //true means that an error has occured in one of the threads
-    g_bTracing = FALSE;             //true means that ETW is turned on
+    bool fOk = !context.fError;
+    if (fOk && context.llBytesFilled > 0)
+    {
+        double fSeconds = PerfTimer::PerfTimeToSeconds(PerfTimer::GetTime() - ullStartTime);
+        PrintError("precreated %u files, %I64u MiB written in %.1lfs (%.1lf MiB/s)\n",
+            (UINT32)vFilesToCreate.size(),
+            (UINT64)context.llBytesFilled / (1024 * 1024),
+            fSeconds,
+            (fSeconds > 0) ? context.llBytesFilled / fSeconds / (1024 * 1024) : 0);
+    }
 
-    _hNTDLL = nullptr;              //handle to ntdll.dll
-    g_bError = FALSE;               //true means there was fatal error during intialization and threads shouldn't perform their work
+    _FreePrecreateContext(context);
+    return fOk;
 }
 
 bool IORequestGenerator::_PrecreateFiles(Profile& profile) const
@@ -1848,19 +3357,19 @@ bool IORequestGenerator::_PrecreateFiles(Profile& profile) const
     if (profile.GetPrecreateFiles() != PrecreateFiles::None)
     {
         vector<CreateFileParameters> vFilesToCreate = _GetFilesToPrecreate(profile);
-        vector<string> vCreatedFiles;
-        for (auto file : vFilesToCreate)
+        if (vFilesToCreate.size() == 0)
         {
-            fOk = _CreateFile(file.ullFileSize, file.sPath.c_str(), file.fZeroWriteBuffers, profile.GetVerbose());
-            if (!fOk)
-            {
-                break;
-            }
-            vCreatedFiles.push_back(file.sPath);
+            return true;
         }
 
+        fOk = _CreateFilesInParallel(vFilesToCreate, profile.GetVerbose());
         if (fOk)
         {
+            vector<string> vCreatedFiles;
+            for (const auto& file : vFilesToCreate)
+            {
+                vCreatedFiles.push_back(file.sPath);
+            }
             profile.MarkFilesAsPrecreated(vCreatedFiles);
         }
     }
@@ -1930,6 +3439,11 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
     //FUTURE EXTENSION: check if file sizes are enough to have at least first requests not wrapping around
     
     vector<Target> vTargets = timeSpan.GetTargets();
+    if (!_GrowWorkingSetForLockedBuffers(timeSpan, vTargets))
+    {
+        return false;
+    }
+
     // allocate memory for random data write buffers
     for (auto i = vTargets.begin(); i != vTargets.end(); i++)
     {
@@ -1958,13 +3472,49 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
             }
 
             //create only regular files
-            if (!_CreateFile(i->GetFileSize(), str.c_str(), i->GetZeroWriteBuffers(), profile.GetVerbose()))
+            PrecreateContext context;
+            bool fCreated = _InitializePrecreateContext(context, nullptr, profile.GetVerbose()) &&
+                            _CreateFile(i->GetFileSize(), str.c_str(), i->GetZeroWriteBuffers(), i->GetFragmentCount(), context);
+            _FreePrecreateContext(context);
+            if (!fCreated)
             {
                 return false;
             }
         }
     }
 
+    // create the files of file sets which are missing
+    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+    {
+        if (i->GetFileSetCount() > 0 && !_CreateFileSet(*i, profile.GetVerbose()))
+        {
+            return false;
+        }
+    }
+
+    // report where the fragmented files ended up on the volume
+    results.vTargetLayouts.clear();
+    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+    {
+        string str = i->GetPath();
+        if (i->GetFragmentCount() == 0 || '#' == str[0] || (':' == str[1] && '\0' == str[2]))
+        {
+            continue;
+        }
+
+        bool fReported = false;
+        for (const auto& layout : results.vTargetLayouts)
+        {
+            fReported = fReported || (layout.sPath == str);
+        }
+
+        TargetLayout layout;
+        if (!fReported && _GetFileLayout(str.c_str(), layout))
+        {
+            results.vTargetLayouts.push_back(layout);
+        }
+    }
+
     // get thread count
     UINT32 cThreads = timeSpan.GetThreadCount();
     if (cThreads < 1)
@@ -1984,6 +3534,33 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
     vector<SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION> vPerfInit(g_SystemInformation.processorTopology._ulProcCount);
     vector<SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION> vPerfDone(g_SystemInformation.processorTopology._ulProcCount);
     vector<SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION> vPerfDiff(g_SystemInformation.processorTopology._ulProcCount);
+    vector<struct ThreadCpuSnapshot> vThreadCpuInit;
+    vector<struct ThreadCpuSnapshot> vThreadCpuDone;
+    UINT64 ullPageFaultsInit = 0;
+    UINT64 ullPageFaultsDone = 0;
+    bool fPageFaultCountAvailable = false;
+
+    //
+    // open the devices backing the targets
+    //
+    DeviceHandles deviceHandles;
+    vector<HANDLE>& vhDevices = deviceHandles.vh;
+    vector<DeviceStatistics> vDeviceStatsInit;
+    vector<DeviceStatistics> vDeviceStatsDone;
+    vector<DeviceStatistics> vDeviceStatsSample;
+
+    //
+    // scheduling delay samples
+    //
+    vector<struct ThreadCpuSnapshot> vThreadCpuSample;
+    vector<UINT64> vullWaitSample;
+    vector<UINT64> vullWaitDone;
+    UINT64 ullSampleTime = 0;
+    results.vDeviceResults.clear();
+    if (timeSpan.GetDeviceStatistics())
+    {
+        _OpenTargetDevices(vTargets, vhDevices, results.vDeviceResults);
+    }
 
     //
     //create start event
@@ -2015,17 +3592,70 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
 
     g_bRun = TRUE;
 
+    // NUMA nodes of the targets' devices, for device-local placement and for reporting
+    // local/remote placement on multi-node systems
+    vector<DWORD> vdwTargetNumaNodes(vTargets.size(), NUMA_NO_NODE);
+    if (timeSpan.GetAffinityPolicy() == AffinityPolicy::DeviceLocal || g_SystemInformation.processorTopology._vNumaNodes.size() > 1)
+    {
+        for (size_t i = 0; i < vTargets.size(); i++)
+        {
+            vdwTargetNumaNodes[i] = GetTargetNumaNode(vTargets[i].GetPath());
+            if (vdwTargetNumaNodes[i] != NUMA_NO_NODE)
+            {
+                printfv(profile.GetVerbose(), "target %s is attached to NUMA node %u\n", vTargets[i].GetPath().c_str(), vdwTargetNumaNodes[i]);
+            }
+            else if (timeSpan.GetAffinityPolicy() == AffinityPolicy::DeviceLocal)
+            {
+                PrintError("WARNING: the NUMA node of %s is not known; its threads will be affinitized round robin\n", vTargets[i].GetPath().c_str());
+            }
+        }
+    }
+
+    // processors of each device's node and the next one to assign, for device-local placement
+    map<DWORD, vector<AffinityAssignment>> mNodeAffinity;
+    map<DWORD, size_t> mNodeNextProcessor;
+
     // gather affinity information, and move to the first active processor
-    const auto& vAffinity = timeSpan.GetAffinityAssignments();
+    vector<AffinityAssignment> vAffinity(timeSpan.GetAffinityAssignments());
+    if (vAffinity.size() == 0 && !timeSpan.GetDisableAffinity() &&
+        timeSpan.GetAffinityPolicy() != AffinityPolicy::RoundRobin && timeSpan.GetAffinityPolicy() != AffinityPolicy::DeviceLocal)
+    {
+        if (!g_SystemInformation.processorTopology.GetPolicyAffinity(timeSpan.GetAffinityPolicy(), vAffinity))
+        {
+            PrintError("WARNING: processor topology is not available; threads will be affinitized round robin\n");
+        }
+    }
     WORD wGroupCtr = 0;
     BYTE bProcCtr = 0;
     g_SystemInformation.processorTopology.GetActiveGroupProcessor(wGroupCtr, bProcCtr, false);
 
     volatile bool fAccountingOn = false;
-    UINT64 ullStartTime;    //start time
-    UINT64 ullTimeDiff;  //elapsed test time (in units returned by QueryPerformanceCounter)
+    UINT64 ullStartTime = 0;    //start time; 0 until the measured window begins
+    UINT64 ullTimeDiff;  //elapsed test time (in PerfTimer units)
     vector<UINT64> vullSharedSequentialOffsets(vTargets.size(), 0);
 
+    // data verification state is shared by all the threads of a target
+    vector<TargetVerifyState> vVerifyStates(vTargets.size());
+    vector<TargetVerifyState *> vpVerifyStates(vTargets.size(), nullptr);
+    for (size_t i = 0; i < vTargets.size(); i++)
+    {
+        if (vTargets[i].GetVerifyData())
+        {
+            vpVerifyStates[i] = &vVerifyStates[i];
+        }
+    }
+
+    // so is the log of a group commit target
+    vector<GroupCommitLog> vGroupCommitLogs(vTargets.size());
+    vector<GroupCommitLog *> vpGroupCommitLogs(vTargets.size(), nullptr);
+    for (size_t i = 0; i < vTargets.size(); i++)
+    {
+        if (vTargets[i].GetGroupCommit())
+        {
+            vpGroupCommitLogs[i] = &vGroupCommitLogs[i];
+        }
+    }
+
     results.vThreadResults.clear();
     results.vThreadResults.resize(cThreads);
     for (UINT32 iThread = 0; iThread < cThreads; ++iThread)
@@ -2047,6 +3677,9 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
             // and receive the entire seq index array.
             // relative thread number is the same as thread number.
             cookie->vTargets = vTargets;
+            cookie->vdwTargetNumaNodes = vdwTargetNumaNodes;
+            cookie->vpVerifyStates = vpVerifyStates;
+            cookie->vpGroupCommitLogs = vpGroupCommitLogs;
             cookie->pullSharedSequentialOffsets = &vullSharedSequentialOffsets[0];
             ulRelativeThreadNo = iThread;
         }
@@ -2075,6 +3708,9 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
                 if (iThread < cAssignedThreads)
                 {
                     cookie->vTargets.push_back(*i);
+                    cookie->vdwTargetNumaNodes.push_back(vdwTargetNumaNodes[i - vTargets.begin()]);
+                    cookie->vpVerifyStates.push_back(vpVerifyStates[i - vTargets.begin()]);
+                    cookie->vpGroupCommitLogs.push_back(vpGroupCommitLogs[i - vTargets.begin()]);
                     cookie->pullSharedSequentialOffsets = &(*psi);
                     ulRelativeThreadNo = (iThread - cBaseThread) % i->GetThreadsPerFile();
 
@@ -2097,9 +3733,29 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
 
         //Set thread group and proc affinity
 
+        // Device-local: round robin the processors of the node of the device backing
+        //               the thread's first target
+        DWORD dwDeviceNumaNode = NUMA_NO_NODE;
+        if (timeSpan.GetAffinityPolicy() == AffinityPolicy::DeviceLocal && vAffinity.size() == 0 && cookie->vdwTargetNumaNodes.size() > 0)
+        {
+            dwDeviceNumaNode = cookie->vdwTargetNumaNodes[0];
+            if (dwDeviceNumaNode != NUMA_NO_NODE && mNodeAffinity.count(dwDeviceNumaNode) == 0)
+            {
+                g_SystemInformation.processorTopology.GetNumaNodeAffinity(dwDeviceNumaNode, mNodeAffinity[dwDeviceNumaNode]);
+            }
+        }
+
+        if (dwDeviceNumaNode != NUMA_NO_NODE && mNodeAffinity[dwDeviceNumaNode].size() > 0)
+        {
+            const auto& vNodeAffinity = mNodeAffinity[dwDeviceNumaNode];
+            size_t i = mNodeNextProcessor[dwDeviceNumaNode]++ % vNodeAffinity.size();
+
+            cookie->wGroupNum = vNodeAffinity[i].wGroup;
+            cookie->bProcNum = vNodeAffinity[i].bProc;
+        }
         // Default: Round robin cores in order of groups, starting at group 0.
         //          Fill each group before moving to next.
-        if (vAffinity.size() == 0)
+        else if (vAffinity.size() == 0)
         {
             cookie->wGroupNum = wGroupCtr;
             cookie->bProcNum = bProcCtr;
@@ -2115,6 +3771,17 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
             cookie->wGroupNum = vAffinity[i].wGroup;
             cookie->bProcNum = vAffinity[i].bProc;
         }
+        results.vThreadResults[iThread].wGroupNum = cookie->wGroupNum;
+        results.vThreadResults[iThread].bProcNum = cookie->bProcNum;
+        if (!timeSpan.GetDisableAffinity())
+        {
+            PROCESSOR_NUMBER processorNumber = { cookie->wGroupNum, cookie->bProcNum, 0 };
+            USHORT usNumaNode;
+            if (GetNumaProcessorNodeEx(&processorNumber, &usNumaNode))
+            {
+                results.vThreadResults[iThread].dwNumaNode = usNumaNode;
+            }
+        }
 
         //create thread
         cookie->pResults = &results.vThreadResults[iThread];
@@ -2236,6 +3903,28 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
             return false;
         }
 
+        // the workers' CPU times are needed for their efficiency (-Me) and scheduling delay (-Ms);
+        // without them the run goes on and they are left out of the results
+        if ((timeSpan.GetCpuEfficiency() || timeSpan.GetSchedulingDelay()) && !_GetThreadCpuSnapshots(vhThreads, vThreadCpuInit))
+        {
+            PrintError("Warning: could not read the worker threads' CPU times; they are not reported\n");
+            vThreadCpuInit.clear();
+        }
+
+        if (timeSpan.GetCpuEfficiency())
+        {
+            fPageFaultCountAvailable = _GetProcessPageFaultCount(&ullPageFaultsInit);
+            if (!fPageFaultCountAvailable)
+            {
+                PrintError("Warning: could not read the process's page fault count (error code: %u); it is not reported\n", GetLastError());
+            }
+        }
+
+        _GetDeviceStatistics(vhDevices, results.vDeviceResults, vDeviceStatsInit);
+        vDeviceStatsSample = vDeviceStatsInit;
+        vThreadCpuSample = vThreadCpuInit;
+        vullWaitSample.assign(vhThreads.size(), 0);
+
         printfv(profile.GetVerbose(), "starting measurements...\n");
         //get cycle count (it will be used to calculate actual work time)
 
@@ -2249,6 +3938,7 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
         }
 
         ullStartTime = PerfTimer::GetTime();
+        ullSampleTime = ullStartTime;
 
 #pragma warning( push )
 #pragma warning( disable : 28931 )
@@ -2256,22 +3946,71 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
 #pragma warning( pop )
 
         assert(timeSpan.GetDuration() > 0);
-        if (bSynchStop)
+
+        // with -D, device statistics and scheduling delay are sampled at the end of every bucket;
+        // otherwise the whole measured window is a single wait
+        DWORD dwSampleInterval = 1000 * timeSpan.GetDuration();
+        if ((vhDevices.size() > 0 || timeSpan.GetSchedulingDelay()) && timeSpan.GetCalculateIopsStdDev())
         {
-            assert(NULL != pSynch->hStopEvent);
-            dwWaitStatus = WaitForSingleObject(pSynch->hStopEvent, 1000 * timeSpan.GetDuration());
-            if (WAIT_OBJECT_0 != dwWaitStatus && WAIT_TIMEOUT != dwWaitStatus)
-            {
-                PrintError("Error during WaitForSingleObject\n");
-                _StopETW(fUseETW, hTraceSession);
-                _TerminateWorkerThreads(vhThreads);    //FUTURE EXTENSION: worker threads should have a chance to free allocated memory (see also other places calling terminateWorkerThreads())
-                return FALSE;
-            }
-            bBreak = (WAIT_TIMEOUT != dwWaitStatus);
+            dwSampleInterval = timeSpan.GetIoBucketDurationInMilliseconds();
         }
-        else
+
+        // the sample edges are kept on the clock, so that oversleeping and the time spent sampling do
+        // not push the later ones back
+        UINT64 ullDuration = PerfTimer::MillisecondsToPerfTime(1000 * timeSpan.GetDuration());
+        UINT64 ullSampleInterval = PerfTimer::MillisecondsToPerfTime(dwSampleInterval);
+        UINT64 ullSampleEnd = 0;
+        while (ullSampleEnd < ullDuration && !bBreak)
         {
-            Sleep(1000 * timeSpan.GetDuration());
+            ullSampleEnd = min(ullSampleEnd + ullSampleInterval, ullDuration);
+            UINT64 ullElapsed = PerfTimer::GetTime() - ullStartTime;
+            DWORD dwWait = (ullElapsed < ullSampleEnd) ? static_cast<DWORD>(PerfTimer::PerfTimeToMilliseconds(ullSampleEnd - ullElapsed)) + 1 : 0;
+            if (bSynchStop)
+            {
+                assert(NULL != pSynch->hStopEvent);
+                dwWaitStatus = WaitForSingleObject(pSynch->hStopEvent, dwWait);
+                if (WAIT_OBJECT_0 != dwWaitStatus && WAIT_TIMEOUT != dwWaitStatus)
+                {
+                    PrintError("Error during WaitForSingleObject\n");
+                    _StopETW(fUseETW, hTraceSession);
+                    _TerminateWorkerThreads(vhThreads);    //FUTURE EXTENSION: worker threads should have a chance to free allocated memory (see also other places calling terminateWorkerThreads())
+                    return FALSE;
+                }
+                bBreak = (WAIT_TIMEOUT != dwWaitStatus);
+            }
+            else
+            {
+                Sleep(dwWait);
+            }
+
+            if (dwSampleInterval < 1000 * timeSpan.GetDuration() && !bBreak)
+            {
+                vector<DeviceStatistics> vDeviceStatsNow;
+                _GetDeviceStatistics(vhDevices, results.vDeviceResults, vDeviceStatsNow);
+                for (size_t i = 0; i < vhDevices.size(); i++)
+                {
+                    if (INVALID_HANDLE_VALUE != vhDevices[i])
+                    {
+                        results.vDeviceResults[i].vBuckets.push_back(DiffDeviceStatistics(vDeviceStatsNow[i], vDeviceStatsSample[i]));
+                    }
+                }
+                vDeviceStatsSample = vDeviceStatsNow;
+
+                vector<struct ThreadCpuSnapshot> vThreadCpuNow;
+                if (timeSpan.GetSchedulingDelay() && !vThreadCpuSample.empty() && _GetThreadCpuSnapshots(vhThreads, vThreadCpuNow))
+                {
+                    UINT64 ullNow = PerfTimer::GetTime();
+                    for (size_t i = 0; i < vhThreads.size(); i++)
+                    {
+                        UINT64 ullWaitTime = GetWorkerWaitTime(results.vThreadResults[i], ullStartTime, ullNow);
+                        results.vThreadResults[i].vullSchedulingDelayBuckets.push_back(
+                            _EstimateSchedulingDelay(ullNow - ullSampleTime, ullWaitTime - vullWaitSample[i], vThreadCpuNow[i], vThreadCpuSample[i]));
+                        vullWaitSample[i] = ullWaitTime;
+                    }
+                    vThreadCpuSample = vThreadCpuNow;
+                    ullSampleTime = ullNow;
+                }
+            }
         }
 
         fAccountingOn = false;
@@ -2279,6 +4018,12 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
         //get cycle count and perf counters
         ullTimeDiff = PerfTimer::GetTime() - ullStartTime;
 
+        // workers leave their wait state alone once accounting is off; close the waits still open
+        for (size_t i = 0; i < vhThreads.size(); i++)
+        {
+            vullWaitDone.push_back(GetWorkerWaitTime(results.vThreadResults[i], ullStartTime, ullStartTime + ullTimeDiff));
+        }
+
         //
         // notify the front-end that the test has just finished;
         // do it after stopping timing in order not to perturb measurements
@@ -2296,6 +4041,23 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
             return false;
         }
 
+        if (!vThreadCpuInit.empty() && !_GetThreadCpuSnapshots(vhThreads, vThreadCpuDone))
+        {
+            PrintError("Warning: could not read the worker threads' CPU times; they are not reported\n");
+            vThreadCpuDone.clear();
+        }
+
+        if (fPageFaultCountAvailable)
+        {
+            fPageFaultCountAvailable = _GetProcessPageFaultCount(&ullPageFaultsDone);
+            if (!fPageFaultCountAvailable)
+            {
+                PrintError("Warning: could not read the process's page fault count (error code: %u); it is not reported\n", GetLastError());
+            }
+        }
+
+        _GetDeviceStatistics(vhDevices, results.vDeviceResults, vDeviceStatsDone);
+
         //
         // stop etw session
         //
@@ -2415,6 +4177,47 @@ bool IORequestGenerator::_GenerateRequestsForTimeSpan(const Profile& profile, co
     results.vSystemProcessorPerfInfo = vPerfDiff;
     results.ullTimeCount = ullTimeDiff;
 
+    // get worker threads' CPU usage over the measured window
+    results.fThreadCpuTimesAvailable = (vThreadCpuDone.size() == results.vThreadResults.size()) && (vThreadCpuInit.size() == vThreadCpuDone.size());
+    if (results.fThreadCpuTimesAvailable)
+    {
+        for (size_t i = 0; i < results.vThreadResults.size(); i++)
+        {
+            results.vThreadResults[i].ullKernelTime = vThreadCpuDone[i].ullKernelTime - vThreadCpuInit[i].ullKernelTime;
+            results.vThreadResults[i].ullUserTime = vThreadCpuDone[i].ullUserTime - vThreadCpuInit[i].ullUserTime;
+            results.vThreadResults[i].ullCycleTime = vThreadCpuDone[i].ullCycleTime - vThreadCpuInit[i].ullCycleTime;
+            results.vThreadResults[i].ullContextSwitches = vThreadCpuDone[i].ullContextSwitches - vThreadCpuInit[i].ullContextSwitches;
+            if (timeSpan.GetSchedulingDelay())
+            {
+                results.vThreadResults[i].ullSchedulingDelay = _EstimateSchedulingDelay(ullTimeDiff, vullWaitDone[i], vThreadCpuDone[i], vThreadCpuInit[i]);
+            }
+        }
+    }
+    results.fPageFaultCountAvailable = fPageFaultCountAvailable;
+    results.ullPageFaultCount = fPageFaultCountAvailable ? ullPageFaultsDone - ullPageFaultsInit : 0;
+
+    // get the change in the devices' statistics over the measured window, leaving out the devices
+    // which could not report them
+    if (vDeviceStatsDone.size() == results.vDeviceResults.size())
+    {
+        for (size_t i = results.vDeviceResults.size(); i-- > 0; )
+        {
+            if (INVALID_HANDLE_VALUE == vhDevices[i])
+            {
+                results.vDeviceResults.erase(results.vDeviceResults.begin() + i);
+            }
+            else
+            {
+                results.vDeviceResults[i].stats = DiffDeviceStatistics(vDeviceStatsDone[i], vDeviceStatsInit[i]);
+            }
+        }
+    }
+    else
+    {
+        results.vDeviceResults.clear();
+    }
+    _CloseOpenFiles(vhDevices);
+
     //
     // create structure containing etw results and properties
     //
@@ -2464,6 +4267,7 @@ vector<struct IORequestGenerator::CreateFileParameters> IORequestGenerator::_Get
             createFileParameters.sPath = target.GetPath();
             createFileParameters.ullFileSize = target.GetFileSize();
             createFileParameters.fZeroWriteBuffers = target.GetZeroWriteBuffers();
+            createFileParameters.dwFragmentCount = target.GetFragmentCount();
 
             filesMap[createFileParameters.sPath].push_back(createFileParameters);
         }
@@ -2510,6 +4314,10 @@ vector<struct IORequestGenerator::CreateFileParameters> IORequestGenerator::_Get
             {
                 struct CreateFileParameters file = fileMapEntry.second[0];
                 file.ullFileSize = ullMaxSize;
+                for (const auto& entry : fileMapEntry.second)
+                {
+                    file.dwFragmentCount = max(file.dwFragmentCount, entry.dwFragmentCount);
+                }
                 if (filter == PrecreateFiles::UseMaxSize)
                 {
                     vFilesToCreate.push_back(file);
@@ -27,6 +27,7 @@ SOFTWARE.
 
 */
 
+#include "Common.h"
 #include "ThroughputMeter.h"
 
 ThroughputMeter::ThroughputMeter(void) :
@@ -54,7 +55,7 @@ void ThroughputMeter::Start(DWORD cBytesPerMillisecond, DWORD dwBlockSize, DWORD
     _burstSize = 0;
     _fRunning = false;
 
-    _ullStartTimestamp = GetTickCount64();
+    _ullStartTime = PerfTimer::GetTime();
 
     if (0 != cBytesPerMillisecond)
     {
@@ -75,10 +76,10 @@ DWORD ThroughputMeter::GetSleepTime(void) const
 {
     if (_fThink)
     {
-        ULONGLONG ullTimestamp = GetTickCount64();
+        UINT64 ullTimestamp = PerfTimer::GetTime();
         if (ullTimestamp < _ullDelayUntil)
         {
-            return (DWORD)(_ullDelayUntil - ullTimestamp);
+            return (DWORD)Util::QuotientCeiling(_ullDelayUntil - ullTimestamp, PerfTimer::MillisecondsToPerfTime(1));
         }
         else
         {
@@ -100,10 +101,31 @@ DWORD ThroughputMeter::GetSleepTime(void) const
 
 DWORD ThroughputMeter::_GetThrottleTime(void) const
 {
-    ULONGLONG cbExpected = (GetTickCount64() - _ullStartTimestamp) * _cBytesPerMillisecond;
+    ULONGLONG cbExpected = (ULONGLONG)(PerfTimer::PerfTimeToMilliseconds(PerfTimer::GetTime() - _ullStartTime) * _cBytesPerMillisecond);
     return cbExpected >= (_cbCompleted + _cbBlockSize) ? 0 : 1;
 }
 
+// Returns the time at which the next IO should have been issued according to the schedule.
+// Throttled IOs are due as soon as the byte budget allows them; with think time, the first
+// IO of a burst is due once the think time has elapsed. IOs the schedule doesn't pace
+// (the rest of a burst) are due when they were actually issued (ullStartTime).
+UINT64 ThroughputMeter::GetIntendedStartTime(UINT64 ullStartTime) const
+{
+    UINT64 ullIntendedStartTime = 0;
+
+    if (_fThrottle)
+    {
+        ullIntendedStartTime = _ullStartTime + PerfTimer::MillisecondsToPerfTime(static_cast<double>(_cbCompleted + _cbBlockSize) / _cBytesPerMillisecond);
+    }
+
+    if (_fThink && (0 == _cIO))
+    {
+        ullIntendedStartTime = max(ullIntendedStartTime, max(_ullStartTime, _ullDelayUntil));
+    }
+
+    return (0 != ullIntendedStartTime) ? ullIntendedStartTime : ullStartTime;
+}
+
 void ThroughputMeter::Adjust(size_t cb)
 {
     _cbCompleted += cb;
@@ -113,7 +135,7 @@ void ThroughputMeter::Adjust(size_t cb)
         if (_cIO >= _burstSize)
         {
             _cIO = 0;
-            _ullDelayUntil = GetTickCount64() + _thinkTime;
+            _ullDelayUntil = PerfTimer::GetTime() + PerfTimer::MillisecondsToPerfTime(_thinkTime);
         }
     }
 }
\ No newline at end of file
@@ -41,6 +41,7 @@ SOFTWARE.
 #include <Evntrace.h>
 
 #include <assert.h>
+#include <algorithm>
 
 // TODO: refactor to a single function shared with the XmlResultParser
 void ResultParser::_Print(const char *format, ...)
@@ -239,6 +240,115 @@ void ResultParser::_PrintTarget(const Target &target, bool fUseThreadsPerFile, b
         break;
     }
 
+    if (target.GetUseLargePages())
+    {
+        _Print("\t\tusing large pages for IO buffers\n");
+    }
+
+    switch (target.GetWorkKernel()) {
+    case WorkKernel::Crc32c:
+        _Print("\t\twork stage: CRC32C checksum of the data of every IO%s\n", WorkStage::IsCrc32cAccelerated() ? "" : " (no SSE4.2, table driven)");
+        break;
+    case WorkKernel::Encrypt:
+        _Print("\t\twork stage: AES encryption pass over the data of every IO\n");
+        break;
+    case WorkKernel::Copy:
+        _Print("\t\twork stage: copy of the data of every IO to an application buffer\n");
+        break;
+    case WorkKernel::Spin:
+        _Print("\t\twork stage: %u cycles per byte of every IO\n", target.GetWorkCyclesPerByte());
+        break;
+    }
+
+    if (target.GetLockBuffers())
+    {
+        _Print("\t\tlocking IO buffers in memory\n");
+    }
+
+    if (target.IsMetadataTarget())
+    {
+        _Print("\t\tmetadata operations over %u files per thread, %u per directory; weights: create %u, stat %u, open %u, rename %u, unlink %u\n",
+            target.GetMetadataFileCount(),
+            target.GetFilesPerDirectory(),
+            target.GetMetadataWeight(MetadataOperation::Create),
+            target.GetMetadataWeight(MetadataOperation::Stat),
+            target.GetMetadataWeight(MetadataOperation::Open),
+            target.GetMetadataWeight(MetadataOperation::Rename),
+            target.GetMetadataWeight(MetadataOperation::Unlink));
+    }
+
+    if (target.GetGroupCommit())
+    {
+        char szRate[32] = "back to back";
+        if (target.GetCommitRate() > 0)
+        {
+            sprintf_s(szRate, sizeof(szRate), "%u per second", target.GetCommitRate());
+        }
+        _Print("\t\tgroup commit log: %u byte records, %s per thread; appends of up to %u bytes of records, %s\n",
+            target.GetCommitRecordSize(),
+            szRate,
+            target.GetCommitBatchSize(),
+            (target.GetCacheMode() == TargetCacheMode::DisableAllCache) ? "written through" : "flushed");
+        if (target.GetCommitDelay() > 0)
+        {
+            _Print("\t\t  appends wait %uus for more records to join\n", target.GetCommitDelay());
+        }
+    }
+
+    if (target.GetFlushWriteInterval() > 0 || target.GetFlushTimeInterval() > 0)
+    {
+        char szWrites[32] = "-";
+        char szTime[32] = "-";
+        if (target.GetFlushWriteInterval() > 0)
+        {
+            sprintf_s(szWrites, sizeof(szWrites), "%u writes", target.GetFlushWriteInterval());
+        }
+        if (target.GetFlushTimeInterval() > 0)
+        {
+            sprintf_s(szTime, sizeof(szTime), "%ums", target.GetFlushTimeInterval());
+        }
+        _Print("\t\tflushing every %s / %s (%s)\n",
+            szWrites,
+            szTime,
+            (target.GetFlushMode() == FlushMode::Full) ? "data, metadata and device cache" :
+                ((target.GetFlushMode() == FlushMode::Data) ? "data only" : "writeback, no device cache flush"));
+    }
+
+    if (target.GetFileSetCount() > 0)
+    {
+        UINT64 ullMinSize = max(target.GetFileSetMinFileSize(), (UINT64)target.GetBlockSizeInBytes());
+        _Print("\t\tfile set: %u files, %u per directory, %I64u to %I64u bytes each\n",
+            target.GetFileSetCount(),
+            target.GetFilesPerDirectory(),
+            ullMinSize,
+            max(target.GetFileSetMaxFileSize(), ullMinSize));
+        _Print("\t\t  %s, %s file choice, %u handles cached per thread\n",
+            target.GetFileSetWholeFile() ? "whole files read or written in turn" : "random blocks",
+            target.GetFileSetSkew() > 0 ? "zipf" : "uniform",
+            target.GetHandleCacheSize());
+        if (target.GetFileSetSkew() > 0)
+        {
+            _Print("\t\t  file choice skew: %.3f\n", target.GetFileSetSkew());
+        }
+    }
+
+    if (target.GetVerifyData())
+    {
+        _Print("\t\tverifying data: written blocks are stamped and checked when read\n");
+    }
+
+    if (target.GetRandomizeWriteData())
+    {
+        _Print("\t\tfilling every write with fresh pseudo-random data (%s)\n", WriteDataGenerator::IsAvx2Available() ? "AVX2" : "SSE2");
+    }
+
+    if (target.GetGenerateWriteData())
+    {
+        _Print("\t\tgenerating write data: %u%% compressible, %u%% duplicate blocks\n",
+            target.GetDataCompressionPercent(),
+            target.GetDataDuplicatePercent());
+    }
+
     if (target.GetZeroWriteBuffers())
     {
         _Print("\t\tzeroing write buffers\n");
@@ -290,6 +400,19 @@ void ResultParser::_PrintTarget(const Target &target, bool fUseThreadsPerFile, b
     _Print("%I64u)\n", target.GetBlockAlignmentInBytes());
 
     _Print("\t\tnumber of outstanding I/O operations: %d\n", target.GetRequestCount());
+    if (target.GetBufferWorkingSetSize() > 0)
+    {
+        _Print("\t\tbuffer working set: %I64u bytes per thread, rotating through %u buffers%s\n",
+            (UINT64)target.GetIoBufferCount() * target.GetBlockSizeInBytes(),
+            target.GetIoBufferCount(),
+            target.GetInterleaveBuffers() ? ", interleaved across NUMA nodes" : "");
+    }
+    else if (target.GetIoBufferCount() < target.GetRequestCount())
+    {
+        _Print("\t\tnumber of IO buffers: %u (%I64u bytes per thread)\n",
+            target.GetIoBufferCount(),
+            (UINT64)target.GetIoBufferCount() * target.GetBlockSizeInBytes());
+    }
     if (0 != target.GetBaseFileOffsetInBytes())
     {
         _Print("\t\tbase file offset: %I64u\n", target.GetBaseFileOffsetInBytes());
@@ -347,121 +470,992 @@ void ResultParser::_PrintTarget(const Target &target, bool fUseThreadsPerFile, b
     }
     else
     {
-        _Print("\t\tIO priority: unknown\n");
+        _Print("\t\tIO priority: unknown\n");
+    }
+}
+
+void ResultParser::_PrintTimeSpan(const TimeSpan& timeSpan)
+{
+    _Print("\tduration: %us\n", timeSpan.GetDuration());
+    _Print("\twarm up time: %us\n", timeSpan.GetWarmup());
+    _Print("\tcool down time: %us\n", timeSpan.GetCooldown());
+    if (timeSpan.GetDisableAffinity())
+    {
+        _Print("\taffinity disabled\n");
+    }
+    switch (timeSpan.GetAffinityPolicy())
+    {
+    case AffinityPolicy::PhysicalCore:
+        _Print("\taffinity policy: one thread per physical core\n");
+        break;
+    case AffinityPolicy::SpreadNodes:
+        _Print("\taffinity policy: spread across NUMA nodes\n");
+        break;
+    case AffinityPolicy::CompactL3:
+        _Print("\taffinity policy: compact on one L3 cache\n");
+        break;
+    case AffinityPolicy::AvoidSmt:
+        _Print("\taffinity policy: avoid SMT siblings\n");
+        break;
+    case AffinityPolicy::DeviceLocal:
+        _Print("\taffinity policy: NUMA node of the target's device\n");
+        break;
+    default:
+        break;
+    }
+    if (timeSpan.GetMeasureLatency())
+    {
+        if (timeSpan.GetLatencySampleRate() > 1)
+        {
+            _Print("\tmeasuring latency of 1 in %u I/Os\n", timeSpan.GetLatencySampleRate());
+        }
+        else
+        {
+            _Print("\tmeasuring latency\n");
+        }
+    }
+    if (timeSpan.GetCalculateIopsStdDev())
+    {
+        _Print("\tgathering IOPS at intervals of %ums\n", timeSpan.GetIoBucketDurationInMilliseconds());
+    }
+    _Print("\trandom seed: %u\n", timeSpan.GetRandSeed());
+
+    const auto& vAffinity = timeSpan.GetAffinityAssignments();
+    if ( vAffinity.size() > 0)
+    {
+        _Print("\tadvanced affinity round robin (group/core): ");
+        for (unsigned int x = 0; x < vAffinity.size(); ++x)
+        {
+            _Print("%u/%u", vAffinity[x].wGroup, vAffinity[x].bProc);
+            if (x < vAffinity.size() - 1)
+            {
+                _Print(", ");
+            }
+        }
+        _Print("\n");
+    }
+
+    vector<Target> vTargets(timeSpan.GetTargets());
+    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
+    {
+        _PrintTarget(*i, (timeSpan.GetThreadCount() == 0), timeSpan.GetCompletionRoutines());
+    }
+}
+
+void ResultParser::_PrintProfile(const Profile& profile)
+{
+    _Print("\nCommand Line: %s\n", profile.GetCmdLine().c_str());
+    _Print("\n");
+    _Print("Input parameters:\n\n");
+    if (profile.GetVerbose())
+    {
+        _Print("\tusing verbose mode\n");
+    }
+
+    const vector<TimeSpan>& vTimeSpans = profile.GetTimeSpans();
+    int c = 1;
+    for (auto i = vTimeSpans.begin(); i != vTimeSpans.end(); i++)
+    {
+        _Print("\ttimespan: %3d\n", c++);
+        _Print("\t-------------\n");
+        _PrintTimeSpan(*i);
+        _Print("\n");
+    }
+}
+
+void ResultParser::_PrintCpuUtilization(const Results& results)
+{
+    size_t ulProcCount = results.vSystemProcessorPerfInfo.size();
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    char szFloatBuffer[1024];
+
+    // DPC and interrupt time are the parts of kernel time spent servicing deferred procedure
+    // calls and interrupts (Reserved1[0] and Reserved1[1]); Reserved2 is the interrupt count
+    _Print("\nCPU |  Usage |  User  |  Kernel |  Idle  |   DPC  |  Intr\n");
+    _Print("-----------------------------------------------------------\n");
+
+    double busyTime = 0;
+    double totalIdleTime = 0;
+    double totalUserTime = 0;
+    double totalKrnlTime = 0;
+    double totalDpcTime = 0;
+    double totalIntrTime = 0;
+    UINT64 ullInterruptCount = 0;
+
+    for (unsigned int x = 0; x<ulProcCount; ++x)
+    {
+        double idleTime;
+        double userTime;
+        double krnlTime;
+        double dpcTime;
+        double intrTime;
+        double thisTime;
+
+        idleTime = 100.0 * results.vSystemProcessorPerfInfo[x].IdleTime.QuadPart / 10000000 / fTime;
+        krnlTime = 100.0 * results.vSystemProcessorPerfInfo[x].KernelTime.QuadPart / 10000000 / fTime;
+        userTime = 100.0 * results.vSystemProcessorPerfInfo[x].UserTime.QuadPart / 10000000 / fTime;
+        dpcTime = 100.0 * results.vSystemProcessorPerfInfo[x].Reserved1[0].QuadPart / 10000000 / fTime;
+        intrTime = 100.0 * results.vSystemProcessorPerfInfo[x].Reserved1[1].QuadPart / 10000000 / fTime;
+
+        thisTime = (krnlTime + userTime) - idleTime;
+
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%4u| %6.2lf%%| %6.2lf%%|  %6.2lf%%| %6.2lf%%| %6.2lf%%| %6.2lf%%\n",
+            x,
+            thisTime,
+            userTime,
+            krnlTime - idleTime,
+            idleTime,
+            dpcTime,
+            intrTime);
+        _Print("%s", szFloatBuffer);
+
+        busyTime += thisTime;
+        totalIdleTime += idleTime;
+        totalUserTime += userTime;
+        totalKrnlTime += krnlTime;
+        totalDpcTime += dpcTime;
+        totalIntrTime += intrTime;
+        ullInterruptCount += results.vSystemProcessorPerfInfo[x].Reserved2;
+    }
+    _Print("-----------------------------------------------------------\n");
+
+    sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "avg.| %6.2lf%%| %6.2lf%%|  %6.2lf%%| %6.2lf%%| %6.2lf%%| %6.2lf%%\n",
+        busyTime / ulProcCount,
+        totalUserTime / ulProcCount,
+        (totalKrnlTime - totalIdleTime) / ulProcCount,
+        totalIdleTime / ulProcCount,
+        totalDpcTime / ulProcCount,
+        totalIntrTime / ulProcCount);
+    _Print("%s", szFloatBuffer);
+
+    UINT64 ullIOCount = 0;
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            ullIOCount += target.ullIOCount;
+        }
+    }
+    if (ullIOCount > 0)
+    {
+        _Print("\ninterrupts per I/O:\t%.2lf\n", (double)ullInterruptCount / ullIOCount);
+    }
+}
+
+void ResultParser::_PrintWorkerCpuEfficiency(const Results& results)
+{
+    char szFloatBuffer[1024];
+    UINT64 ullTotalIOCount = 0;
+    UINT64 ullTotalCpuTime = 0;
+
+    if (!results.fThreadCpuTimesAvailable)
+    {
+        _Print("\nthe workers' CPU times could not be read\n");
+        return;
+    }
+
+    _Print("\nthread |  User (s) | Kernel (s) | Cycles/IO | CPU us/IO | IOs per CPU-s | Ctx switches\n");
+    _Print("---------------------------------------------------------------------------------------\n");
+
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        const ThreadResults& threadResults = results.vThreadResults[iThread];
+        UINT64 ullIOCount = 0;
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            ullIOCount += targetResults.ullIOCount;
+        }
+
+        UINT64 ullCpuTime = threadResults.ullKernelTime + threadResults.ullUserTime;
+        ullTotalIOCount += ullIOCount;
+        ullTotalCpuTime += ullCpuTime;
+
+        // thread times are in 100ns units
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %9.3lf | %10.3lf | %9.0lf | %9.2lf | %13.0lf | %12I64u\n",
+            (unsigned int)iThread,
+            threadResults.ullUserTime / 10000000.0,
+            threadResults.ullKernelTime / 10000000.0,
+            (ullIOCount > 0) ? (double)threadResults.ullCycleTime / ullIOCount : 0,
+            (ullIOCount > 0) ? ullCpuTime / 10.0 / ullIOCount : 0,
+            (ullCpuTime > 0) ? ullIOCount / (ullCpuTime / 10000000.0) : 0,
+            threadResults.ullContextSwitches);
+        _Print("%s", szFloatBuffer);
+    }
+    _Print("---------------------------------------------------------------------------------------\n");
+
+    sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "total: %.2lf CPU us/IO, %.0lf IOs per CPU-s\n",
+        (ullTotalIOCount > 0) ? ullTotalCpuTime / 10.0 / ullTotalIOCount : 0,
+        (ullTotalCpuTime > 0) ? ullTotalIOCount / (ullTotalCpuTime / 10000000.0) : 0);
+    _Print("%s", szFloatBuffer);
+    if (results.fPageFaultCountAvailable)
+    {
+        _Print("page faults (process):\t%I64u\n", results.ullPageFaultCount);
+    }
+}
+
+void ResultParser::_PrintHardwareCounters(const Results& results)
+{
+    char szFloatBuffer[1024];
+
+    _Print("\n\nHardware counters per I/O (core-wide fixed-function counters):\n");
+    _Print("thread | Instructions |    Cycles | Ref cycles |  IPC\n");
+    _Print("-----------------------------------------------------\n");
+
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        const ThreadResults& threadResults = results.vThreadResults[iThread];
+        if (!threadResults.fHardwareCountersAvailable)
+        {
+            _Print("%6u | not available\n", (unsigned int)iThread);
+            continue;
+        }
+
+        UINT64 ullIOCount = 0;
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            ullIOCount += targetResults.ullIOCount;
+        }
+
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %12.0lf | %9.0lf | %10.0lf | %4.2lf\n",
+            (unsigned int)iThread,
+            (ullIOCount > 0) ? (double)threadResults.ullInstructionsRetired / ullIOCount : 0,
+            (ullIOCount > 0) ? (double)threadResults.ullCoreCycles / ullIOCount : 0,
+            (ullIOCount > 0) ? (double)threadResults.ullReferenceCycles / ullIOCount : 0,
+            (threadResults.ullCoreCycles > 0) ? (double)threadResults.ullInstructionsRetired / threadResults.ullCoreCycles : 0);
+        _Print("%s", szFloatBuffer);
+    }
+}
+
+void ResultParser::_PrintNumaPlacement(const Results& results)
+{
+    bool fDeviceNodesKnown = false;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            fDeviceNodesKnown = fDeviceNodesKnown || (targetResults.dwDeviceNumaNode != NUMA_NO_NODE);
+        }
+    }
+    if (!fDeviceNodesKnown)
+    {
+        return;
+    }
+
+    _Print("\n\nNUMA placement:\n");
+    _Print("thread | thread node | device node | placement | file\n");
+    _Print("------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        const ThreadResults& threadResults = results.vThreadResults[iThread];
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            const char *pszPlacement = "unknown";
+            if (threadResults.dwNumaNode != NUMA_NO_NODE && targetResults.dwDeviceNumaNode != NUMA_NO_NODE)
+            {
+                pszPlacement = (threadResults.dwNumaNode == targetResults.dwDeviceNumaNode) ? "local" : "remote";
+            }
+
+            _Print("%6u | ", (unsigned int)iThread);
+            if (threadResults.dwNumaNode != NUMA_NO_NODE)
+            {
+                _Print("%11u | ", threadResults.dwNumaNode);
+            }
+            else
+            {
+                _Print("%11s | ", "-");
+            }
+            if (targetResults.dwDeviceNumaNode != NUMA_NO_NODE)
+            {
+                _Print("%11u | ", targetResults.dwDeviceNumaNode);
+            }
+            else
+            {
+                _Print("%11s | ", "-");
+            }
+            _Print("%9s | %s\n", pszPlacement, targetResults.sPath.c_str());
+        }
+    }
+}
+
+void ResultParser::_PrintBufferPages(const TimeSpan& timeSpan, const Results& results)
+{
+    bool fPinnedBuffers = false;
+    for (const auto& target : timeSpan.GetTargets())
+    {
+        fPinnedBuffers = fPinnedBuffers || target.GetUseLargePages() || target.GetLockBuffers();
+    }
+    if (!fPinnedBuffers)
+    {
+        return;
+    }
+
+    _Print("\n\nIO buffer pages:\n");
+    _Print("thread | buffer page size | locked | write buffer page size | locked | file\n");
+    _Print("-------------------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            _Print("%6u | %16I64u | %6s | ",
+                (unsigned int)iThread,
+                targetResults.ullDataBufferPageSize,
+                targetResults.fDataBufferLocked ? "yes" : "no");
+            if (targetResults.ullWriteBufferPageSize > 0)
+            {
+                _Print("%22I64u | %6s | ", targetResults.ullWriteBufferPageSize, targetResults.fWriteBufferLocked ? "yes" : "no");
+            }
+            else
+            {
+                _Print("%22s | %6s | ", "-", "-");
+            }
+            _Print("%s\n", targetResults.sPath.c_str());
+        }
+    }
+}
+
+void ResultParser::_PrintBufferWorkingSet(const SystemInformation& system, const TimeSpan& timeSpan, const Results& results)
+{
+    bool fWorkingSet = false;
+    for (const auto& target : timeSpan.GetTargets())
+    {
+        fWorkingSet = fWorkingSet || (target.GetBufferWorkingSetSize() > 0);
+    }
+    if (!fWorkingSet)
+    {
+        return;
+    }
+
+    UINT64 ullBufferBytes = 0;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            ullBufferBytes += targetResults.ullDataBufferBytes;
+        }
+    }
+
+    // compare runs on either side of this ratio to see what IOs into buffers which are no longer cache resident cost
+    UINT64 ullL3CacheBytes = system.processorTopology._ullL3CacheBytes;
+    _Print("\n\nIO buffer working set: %I64u bytes across all threads\n", ullBufferBytes);
+    if (ullL3CacheBytes > 0)
+    {
+        char szFloatBuffer[1024];
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "L3 cache: %I64u bytes; the working set is %.2lfx the L3 cache and %s fit in it\n",
+            ullL3CacheBytes,
+            (double)ullBufferBytes / ullL3CacheBytes,
+            (ullBufferBytes <= ullL3CacheBytes) ? "can" : "does not");
+        _Print("%s", szFloatBuffer);
+    }
+}
+
+void ResultParser::_PrintWorkStage(const Results& results)
+{
+    bool fWorkStage = false;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            fWorkStage = fWorkStage || (targetResults.ullWorkBytes > 0);
+        }
+    }
+    if (!fWorkStage)
+    {
+        return;
+    }
+
+    char szFloatBuffer[1024];
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("\n\nWork stage cost:\n");
+    _Print("thread | work (ms) | %% of time |  us/IO | cycles/byte |    MiB/s | file\n");
+    _Print("-----------------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            if (targetResults.ullWorkBytes == 0)
+            {
+                continue;
+            }
+
+            double fWorkSeconds = PerfTimer::PerfTimeToSeconds(targetResults.ullWorkTime);
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %9.2lf | %9.2lf | %6.2lf | %11.2lf | %8.2lf | %s\n",
+                (unsigned int)iThread,
+                fWorkSeconds * 1000,
+                (fTime > 0) ? 100 * fWorkSeconds / fTime : 0,
+                (targetResults.ullIOCount > 0) ? 1000000 * fWorkSeconds / targetResults.ullIOCount : 0,
+                (targetResults.ullWorkBytes > 0) ? (double)targetResults.ullWorkCycles / targetResults.ullWorkBytes : 0,
+                (fWorkSeconds > 0) ? targetResults.ullWorkBytes / fWorkSeconds / (1024 * 1024) : 0,
+                targetResults.sPath.c_str());
+            _Print("%s", szFloatBuffer);
+        }
+    }
+}
+
+void ResultParser::_PrintWriteDataFill(const Results& results)
+{
+    bool fFill = false;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            fFill = fFill || (targetResults.ullWriteFillCount > 0);
+        }
+    }
+    if (!fFill)
+    {
+        return;
+    }
+
+    char szFloatBuffer[1024];
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    // the fill happens before an IO is issued and is not part of its latency
+    _Print("\n\nWrite data generation cost:\n");
+    _Print("thread | fill (ms) | %% of time | us/write |    MiB/s | file\n");
+    _Print("------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            if (targetResults.ullWriteFillCount == 0)
+            {
+                continue;
+            }
+
+            double fFillSeconds = PerfTimer::PerfTimeToSeconds(targetResults.ullWriteFillTime);
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %9.2lf | %9.2lf | %8.2lf | %8.2lf | %s\n",
+                (unsigned int)iThread,
+                fFillSeconds * 1000,
+                (fTime > 0) ? 100 * fFillSeconds / fTime : 0,
+                1000000 * fFillSeconds / targetResults.ullWriteFillCount,
+                (fFillSeconds > 0) ? targetResults.ullWriteFillBytes / fFillSeconds / (1024 * 1024) : 0,
+                targetResults.sPath.c_str());
+            _Print("%s", szFloatBuffer);
+        }
+    }
+}
+
+void ResultParser::_PrintFileSet(const Results& results)
+{
+    bool fFileSet = false;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            fFileSet = fFileSet || (targetResults.ullFileOpenCount + targetResults.ullHandleCacheHitCount > 0);
+        }
+    }
+    if (!fFileSet)
+    {
+        return;
+    }
+
+    char szFloatBuffer[1024];
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    // opens happen on the issuing thread before the IO and are not part of its latency
+    _Print("\n\nFile set handle cache:\n");
+    _Print("thread |    opens | us/open |   closes | us/close | cache hits |      I/O per s | file\n");
+    _Print("---------------------------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            UINT64 ullLookups = targetResults.ullFileOpenCount + targetResults.ullHandleCacheHitCount;
+            if (ullLookups == 0)
+            {
+                continue;
+            }
+
+            double fOpenSeconds = PerfTimer::PerfTimeToSeconds(targetResults.ullFileOpenTime);
+            double fCloseSeconds = PerfTimer::PerfTimeToSeconds(targetResults.ullFileCloseTime);
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %8I64u | %7.2lf | %8I64u | %8.2lf | %9.2lf%% | %14.2lf | %s\n",
+                (unsigned int)iThread,
+                targetResults.ullFileOpenCount,
+                (targetResults.ullFileOpenCount > 0) ? 1000000 * fOpenSeconds / targetResults.ullFileOpenCount : 0,
+                targetResults.ullFileCloseCount,
+                (targetResults.ullFileCloseCount > 0) ? 1000000 * fCloseSeconds / targetResults.ullFileCloseCount : 0,
+                100.0 * targetResults.ullHandleCacheHitCount / ullLookups,
+                (fTime > 0) ? targetResults.ullIOCount / fTime : 0,
+                targetResults.sPath.c_str());
+            _Print("%s", szFloatBuffer);
+        }
+    }
+}
+
+void ResultParser::_PrintMetadata(const Results& results)
+{
+    const int cTypes = static_cast<int>(MetadataOperation::Count);
+    Histogram<float> vLatencyHistograms[cTypes];
+    UINT64 ullTotalCount = 0;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            for (int iType = 0; iType < cTypes; iType++)
+            {
+                vLatencyHistograms[iType].Merge(targetResults.vMetadataLatencyHistograms[iType]);
+                ullTotalCount += targetResults.vullMetadataCount[iType];
+            }
+        }
+    }
+    if (ullTotalCount == 0)
+    {
+        return;
+    }
+
+    char szFloatBuffer[1024];
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("\n\nMetadata operations:\n");
+    _Print("thread |    creates |      stats |      opens |    renames |    unlinks |    ops per s | file\n");
+    _Print("----------------------------------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            UINT64 ullCount = 0;
+            for (int iType = 0; iType < cTypes; iType++)
+            {
+                ullCount += targetResults.vullMetadataCount[iType];
+            }
+            if (ullCount == 0)
+            {
+                continue;
+            }
+
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %10I64u | %10I64u | %10I64u | %10I64u | %10I64u | %12.2lf | %s\n",
+                (unsigned int)iThread,
+                targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Create)],
+                targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Stat)],
+                targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Open)],
+                targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Rename)],
+                targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Unlink)],
+                (fTime > 0) ? ullCount / fTime : 0,
+                targetResults.sPath.c_str());
+            _Print("%s", szFloatBuffer);
+        }
+    }
+
+    _Print("\n operation |      count |    ops per s | avg (ms) | 50th (ms) | 90th (ms) | 99th (ms) | 3-nines (ms) | max (ms)\n");
+    _Print("---------------------------------------------------------------------------------------------------------\n");
+    for (int iType = 0; iType < cTypes; iType++)
+    {
+        const Histogram<float>& latencyHistogram = vLatencyHistograms[iType];
+        if (latencyHistogram.GetSampleSize() == 0)
+        {
+            continue;
+        }
+
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%10s | %10u | %12.2lf | %8.3lf | %9.3lf | %9.3lf | %9.3lf | %12.3lf | %8.3lf\n",
+            MetadataWorker::GetOperationName(static_cast<MetadataOperation>(iType)),
+            latencyHistogram.GetSampleSize(),
+            (fTime > 0) ? latencyHistogram.GetSampleSize() / fTime : 0,
+            latencyHistogram.GetAvg() / 1000,
+            latencyHistogram.GetPercentile(0.50) / 1000,
+            latencyHistogram.GetPercentile(0.90) / 1000,
+            latencyHistogram.GetPercentile(0.99) / 1000,
+            latencyHistogram.GetPercentile(0.999) / 1000,
+            latencyHistogram.GetMax() / 1000);
+        _Print("%s", szFloatBuffer);
+    }
+}
+
+void ResultParser::_PrintFlushes(const Results& results)
+{
+    Histogram<float> flushLatencyHistogram;
+    Histogram<float> overlapLatencyHistogram;
+    Histogram<float> ioLatencyHistogram;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            flushLatencyHistogram.Merge(targetResults.flushLatencyHistogram);
+            overlapLatencyHistogram.Merge(targetResults.flushOverlapLatencyHistogram);
+            if (targetResults.ullFlushCount > 0)
+            {
+                ioLatencyHistogram.Merge(targetResults.readLatencyHistogram);
+                ioLatencyHistogram.Merge(targetResults.writeLatencyHistogram);
+            }
+        }
+    }
+    if (flushLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    char szFloatBuffer[1024];
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("\n\nFlushes:\n");
+    _Print("thread |    flushes | flushes per s | avg (ms) | max (ms) | file\n");
+    _Print("----------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            if (targetResults.ullFlushCount == 0)
+            {
+                continue;
+            }
+
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %10I64u | %13.2lf | %8.3lf | %8.3lf | %s\n",
+                (unsigned int)iThread,
+                targetResults.ullFlushCount,
+                (fTime > 0) ? targetResults.ullFlushCount / fTime : 0,
+                targetResults.flushLatencyHistogram.GetAvg() / 1000,
+                targetResults.flushLatencyHistogram.GetMax() / 1000,
+                targetResults.sPath.c_str());
+            _Print("%s", szFloatBuffer);
+        }
+    }
+
+    // the IOs in flight during a flush are only known for the sampled IOs (-L)
+    bool fOverlap = (overlapLatencyHistogram.GetSampleSize() > 0);
+
+    _Print("\n  %%-ile |   flush (ms)%s\n", fOverlap ? " | IO during flush (ms) | all IO (ms)" : "");
+    _Print("-----------------------%s\n", fOverlap ? "--------------------------------------" : "");
+
+    const double vPercentiles[] = {0, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 0.9999, 1};
+    const char *vszNames[] = {"min", "25th", "50th", "75th", "90th", "95th", "99th", "3-nines", "4-nines", "max"};
+    for (size_t i = 0; i < _countof(vPercentiles); i++)
+    {
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%8s | %12.3lf",
+            vszNames[i],
+            flushLatencyHistogram.GetPercentile(vPercentiles[i]) / 1000);
+        _Print("%s", szFloatBuffer);
+        if (fOverlap)
+        {
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), " | %20.3lf | %11.3lf",
+                overlapLatencyHistogram.GetPercentile(vPercentiles[i]) / 1000,
+                ioLatencyHistogram.GetPercentile(vPercentiles[i]) / 1000);
+            _Print("%s", szFloatBuffer);
+        }
+        _Print("\n");
+    }
+    if (fOverlap)
+    {
+        _Print("%I64u of %I64u sampled IOs were in flight during a flush\n",
+            (UINT64)overlapLatencyHistogram.GetSampleSize(),
+            (UINT64)ioLatencyHistogram.GetSampleSize());
+    }
+}
+
+void ResultParser::_PrintGroupCommit(const Results& results)
+{
+    Histogram<float> commitLatencyHistogram;
+    Histogram<float> appendLatencyHistogram;
+    UINT64 ullAppendCount = 0;
+    UINT64 ullAppendRecordCount = 0;
+    UINT64 ullAppendBytes = 0;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            if (targetResults.ullCommitCount == 0 && targetResults.ullLogAppendCount == 0)
+            {
+                continue;
+            }
+            commitLatencyHistogram.Merge(targetResults.commitLatencyHistogram);
+            appendLatencyHistogram.Merge(targetResults.writeLatencyHistogram);
+            ullAppendCount += targetResults.ullLogAppendCount;
+            ullAppendRecordCount += targetResults.ullLogAppendRecordCount;
+            ullAppendBytes += targetResults.ullWriteBytesCount;
+        }
+    }
+    if (commitLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    char szFloatBuffer[1024];
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("\n\nGroup commit:\n");
+    _Print("thread |    commits | commits per s | avg (ms) |  appends led | file\n");
+    _Print("-------------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            if (targetResults.ullCommitCount == 0)
+            {
+                continue;
+            }
+
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %10I64u | %13.2lf | %8.3lf | %12I64u | %s\n",
+                (unsigned int)iThread,
+                targetResults.ullCommitCount,
+                (fTime > 0) ? targetResults.ullCommitCount / fTime : 0,
+                targetResults.commitLatencyHistogram.GetAvg() / 1000,
+                targetResults.ullLogAppendCount,
+                targetResults.sPath.c_str());
+            _Print("%s", szFloatBuffer);
+        }
+    }
+
+    // the device sees the appends; records per append is the achieved batch size
+    sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "\n%I64u commits, %.2lf per second, in %I64u appends, %.2lf per second: %.2lf records and %.0lf bytes per append\n",
+        (UINT64)commitLatencyHistogram.GetSampleSize(),
+        (fTime > 0) ? commitLatencyHistogram.GetSampleSize() / fTime : 0,
+        ullAppendCount,
+        (fTime > 0) ? ullAppendCount / fTime : 0,
+        (ullAppendCount > 0) ? (double)ullAppendRecordCount / ullAppendCount : 0,
+        (ullAppendCount > 0) ? (double)ullAppendBytes / ullAppendCount : 0);
+    _Print("%s", szFloatBuffer);
+
+    // the appends are only timed with -L; their flushes are reported with the other flushes
+    bool fAppendLatency = (appendLatencyHistogram.GetSampleSize() > 0);
+
+    _Print("\n  %%-ile |  commit (ms)%s\n", fAppendLatency ? " | append (ms)" : "");
+    _Print("-----------------------%s\n", fAppendLatency ? "--------------" : "");
+
+    const double vPercentiles[] = {0, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 0.9999, 1};
+    const char *vszNames[] = {"min", "25th", "50th", "75th", "90th", "95th", "99th", "3-nines", "4-nines", "max"};
+    for (size_t i = 0; i < _countof(vPercentiles); i++)
+    {
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%8s | %12.3lf",
+            vszNames[i],
+            commitLatencyHistogram.GetPercentile(vPercentiles[i]) / 1000);
+        _Print("%s", szFloatBuffer);
+        if (fAppendLatency)
+        {
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), " | %11.3lf", appendLatencyHistogram.GetPercentile(vPercentiles[i]) / 1000);
+            _Print("%s", szFloatBuffer);
+        }
+        _Print("\n");
     }
 }
 
-void ResultParser::_PrintTimeSpan(const TimeSpan& timeSpan)
+void ResultParser::_PrintDataVerification(const TimeSpan& timeSpan, const Results& results)
 {
-    _Print("\tduration: %us\n", timeSpan.GetDuration());
-    _Print("\twarm up time: %us\n", timeSpan.GetWarmup());
-    _Print("\tcool down time: %us\n", timeSpan.GetCooldown());
-    if (timeSpan.GetDisableAffinity())
+    bool fVerifyData = false;
+    for (const auto& target : timeSpan.GetTargets())
     {
-        _Print("\taffinity disabled\n");
+        fVerifyData = fVerifyData || target.GetVerifyData();
     }
-    if (timeSpan.GetMeasureLatency())
+    if (!fVerifyData)
     {
-        _Print("\tmeasuring latency\n");
+        return;
     }
-    if (timeSpan.GetCalculateIopsStdDev())
+
+    char szBuffer[1024];
+    UINT64 ullFailureCount = 0;
+
+    _Print("\n\nData verification:\n");
+    _Print("thread | stamped writes | verified reads | unverified reads | failures | file\n");
+    _Print("---------------------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
     {
-        _Print("\tgathering IOPS at intervals of %ums\n", timeSpan.GetIoBucketDurationInMilliseconds());
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
+        {
+            sprintf_s(szBuffer, sizeof(szBuffer), "%6u | %14I64u | %14I64u | %16I64u | %8I64u | %s\n",
+                (unsigned int)iThread,
+                targetResults.ullStampedWriteCount,
+                targetResults.ullVerifiedReadCount,
+                targetResults.ullUnverifiedReadCount,
+                targetResults.ullVerifyFailureCount,
+                targetResults.sPath.c_str());
+            _Print("%s", szBuffer);
+            ullFailureCount += targetResults.ullVerifyFailureCount;
+        }
     }
-    _Print("\trandom seed: %u\n", timeSpan.GetRandSeed());
 
-    const auto& vAffinity = timeSpan.GetAffinityAssignments();
-    if ( vAffinity.size() > 0)
+    // unverified reads raced a write to their block, or read blocks which were not written during the run
+    if (ullFailureCount == 0)
     {
-        _Print("\tadvanced affinity round robin (group/core): ");
-        for (unsigned int x = 0; x < vAffinity.size(); ++x)
+        return;
+    }
+
+    _Print("\nverification failures (first %u per thread and target):\n", (UINT32)DataVerifier::MAX_RECORDED_FAILURES);
+    _Print("thread |        type |           offset |    time (ms) | expected seq |    found seq |     found offset | writer | file\n");
+    _Print("------------------------------------------------------------------------------------------------------------------\n");
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        for (const auto& targetResults : results.vThreadResults[iThread].vTargetResults)
         {
-            _Print("%u/%u", vAffinity[x].wGroup, vAffinity[x].bProc);
-            if (x < vAffinity.size() - 1)
+            for (const auto& failure : targetResults.vVerifyFailures)
             {
-                _Print(", ");
+                const char *pszType = "";
+                switch (failure.type)
+                {
+                case VerifyFailureType::Corrupt:
+                    pszType = "corrupt";
+                    break;
+                case VerifyFailureType::Misdirected:
+                    pszType = "misdirected";
+                    break;
+                case VerifyFailureType::Stale:
+                    pszType = "stale";
+                    break;
+                case VerifyFailureType::Missing:
+                    pszType = "missing";
+                    break;
+                }
+
+                char szTime[32];
+                if (failure.fMeasured)
+                {
+                    sprintf_s(szTime, sizeof(szTime), "%12.3lf", PerfTimer::PerfTimeToMilliseconds(failure.ullTime));
+                }
+                else
+                {
+                    sprintf_s(szTime, sizeof(szTime), "%12s", "warm up/down");
+                }
+
+                sprintf_s(szBuffer, sizeof(szBuffer), "%6u | %11s | %16I64u | %s | %12I64u | %12I64u | %16I64u | %6u | %s\n",
+                    (unsigned int)iThread,
+                    pszType,
+                    failure.ullOffset,
+                    szTime,
+                    failure.ullExpectedSequence,
+                    failure.ullFoundSequence,
+                    failure.ullFoundOffset,
+                    failure.ulWriterThreadNo,
+                    targetResults.sPath.c_str());
+                _Print("%s", szBuffer);
             }
         }
-        _Print("\n");
-    }
-
-    vector<Target> vTargets(timeSpan.GetTargets());
-    for (auto i = vTargets.begin(); i != vTargets.end(); i++)
-    {
-        _PrintTarget(*i, (timeSpan.GetThreadCount() == 0), timeSpan.GetCompletionRoutines());
     }
 }
 
-void ResultParser::_PrintProfile(const Profile& profile)
+void ResultParser::_PrintSchedulingDelay(const TimeSpan& timeSpan, const Results& results)
 {
-    _Print("\nCommand Line: %s\n", profile.GetCmdLine().c_str());
-    _Print("\n");
-    _Print("Input parameters:\n\n");
-    if (profile.GetVerbose())
+    char szFloatBuffer[1024];
+    bool fSignificant = false;
+
+    _Print("\n\nScheduling delay (lower bound of the time workers were runnable but not running):\n");
+    _Print("thread | Delay (ms) | %% of time | Delay us/IO\n");
+    _Print("---------------------------------------------\n");
+
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
     {
-        _Print("\tusing verbose mode\n");
+        const ThreadResults& threadResults = results.vThreadResults[iThread];
+        UINT64 ullIOCount = 0;
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            ullIOCount += targetResults.ullIOCount;
+        }
+
+        bool fThreadSignificant = threadResults.IsSchedulingDelaySignificant(results.ullTimeCount);
+        fSignificant = fSignificant || fThreadSignificant;
+
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %10.3lf | %8.2lf%% | %11.2lf%s\n",
+            (unsigned int)iThread,
+            PerfTimer::PerfTimeToMilliseconds(threadResults.ullSchedulingDelay),
+            (results.ullTimeCount > 0) ? 100.0 * threadResults.ullSchedulingDelay / results.ullTimeCount : 0,
+            (ullIOCount > 0) ? PerfTimer::PerfTimeToMicroseconds(threadResults.ullSchedulingDelay) / ullIOCount : 0,
+            fThreadSignificant ? " *" : "");
+        _Print("%s", szFloatBuffer);
     }
 
-    const vector<TimeSpan>& vTimeSpans = profile.GetTimeSpans();
-    int c = 1;
-    for (auto i = vTimeSpans.begin(); i != vTimeSpans.end(); i++)
+    if (fSignificant)
     {
-        _Print("\ttimespan: %3d\n", c++);
-        _Print("\t-------------\n");
-        _PrintTimeSpan(*i);
+        _Print("\n* scheduling delay is a significant part of the measured I/O latency");
+        size_t cProcessors = results.vSystemProcessorPerfInfo.size();
+        if (results.vThreadResults.size() > cProcessors)
+        {
+            _Print("; %u threads share %u processors", (unsigned int)results.vThreadResults.size(), (unsigned int)cProcessors);
+        }
+        if (timeSpan.GetDisableAffinity())
+        {
+            _Print("; affinity is disabled (-n)");
+        }
         _Print("\n");
     }
 }
 
-void ResultParser::_PrintCpuUtilization(const Results& results)
+void ResultParser::_PrintFileLayout(const Results& results)
 {
-    size_t ulProcCount = results.vSystemProcessorPerfInfo.size();
-    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
-
     char szFloatBuffer[1024];
 
-    _Print("\nCPU |  Usage |  User  |  Kernel |  Idle\n");
-    _Print("-------------------------------------------\n");
+    _Print("\n\nFile layout:\n");
+    _Print("  extents | allocated MiB | avg extent KiB | largest extent KiB | cluster | path\n");
+    _Print("------------------------------------------------------------------------------------\n");
 
-    double busyTime = 0;
-    double totalIdleTime = 0;
-    double totalUserTime = 0;
-    double totalKrnlTime = 0;
+    for (const auto& layout : results.vTargetLayouts)
+    {
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%9I64u | %13.2lf | %14.2lf | %18.2lf | %7I64u | %s\n",
+            layout.ullExtentCount,
+            (double)layout.ullAllocatedBytes / (1024 * 1024),
+            (layout.ullExtentCount > 0) ? (double)layout.ullAllocatedBytes / layout.ullExtentCount / 1024 : 0,
+            (double)layout.ullLargestExtentBytes / 1024,
+            layout.ullClusterBytes,
+            layout.sPath.c_str());
+        _Print("%s", szFloatBuffer);
+    }
+}
 
-    for (unsigned int x = 0; x<ulProcCount; ++x)
+void ResultParser::_PrintDeviceStatistics(const Results& results)
+{
+    char szFloatBuffer[1024];
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("\n\nDevice statistics:\n");
+    if (results.vDeviceResults.size() == 0)
     {
-        double idleTime;
-        double userTime;
-        double krnlTime;
-        double thisTime;
+        _Print("  no devices could be queried\n");
+        return;
+    }
 
-        idleTime = 100.0 * results.vSystemProcessorPerfInfo[x].IdleTime.QuadPart / 10000000 / fTime;
-        krnlTime = 100.0 * results.vSystemProcessorPerfInfo[x].KernelTime.QuadPart / 10000000 / fTime;
-        userTime = 100.0 * results.vSystemProcessorPerfInfo[x].UserTime.QuadPart / 10000000 / fTime;
+    _Print("device |  app I/Os  | device I/Os |     MB     |  splits  | AvgRdLat | AvgWrLat |  util  | queue | path\n");
+    _Print("-----------------------------------------------------------------------------------------------------------\n");
 
-        thisTime = (krnlTime + userTime) - idleTime;
+    for (size_t iDevice = 0; iDevice < results.vDeviceResults.size(); iDevice++)
+    {
+        const DeviceResults& deviceResults = results.vDeviceResults[iDevice];
+        const DeviceStatistics& stats = deviceResults.stats;
 
-        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%4u| %6.2lf%%| %6.2lf%%|  %6.2lf%%| %6.2lf%%\n",
-            x,
-            thisTime,
-            userTime,
-            krnlTime - idleTime,
-            idleTime);
+        // sum the I/Os the application issued against the targets this device backs
+        UINT64 ullAppIOCount = 0;
+        for (const auto& threadResults : results.vThreadResults)
+        {
+            for (const auto& targetResults : threadResults.vTargetResults)
+            {
+                if (find(deviceResults.vTargetPaths.begin(), deviceResults.vTargetPaths.end(), targetResults.sPath) != deviceResults.vTargetPaths.end())
+                {
+                    ullAppIOCount += targetResults.ullIOCount;
+                }
+            }
+        }
+
+        sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "%6u | %10I64u | %11I64u | %10.2lf | %8I64u | %8.3lf | %8.3lf | %5.1lf%% | %5u | %s\n",
+            (unsigned int)iDevice,
+            ullAppIOCount,
+            stats.ullReadCount + stats.ullWriteCount,
+            (double)(stats.ullBytesRead + stats.ullBytesWritten) / (1024 * 1024),
+            stats.ullSplitCount,
+            (stats.ullReadCount > 0) ? (double)stats.ullReadTime / stats.ullReadCount / 10000 : 0,
+            (stats.ullWriteCount > 0) ? (double)stats.ullWriteTime / stats.ullWriteCount / 10000 : 0,
+            (stats.ullQueryTime > 0 && stats.ullIdleTime <= stats.ullQueryTime) ? 100.0 * (1.0 - (double)stats.ullIdleTime / stats.ullQueryTime) : 0,
+            stats.dwQueueDepth,
+            deviceResults.sPath.c_str());
         _Print("%s", szFloatBuffer);
+    }
 
-        busyTime += thisTime;
-        totalIdleTime += idleTime;
-        totalUserTime += userTime;
-        totalKrnlTime += krnlTime;
+    _Print("\n");
+    for (size_t iDevice = 0; iDevice < results.vDeviceResults.size(); iDevice++)
+    {
+        const DeviceResults& deviceResults = results.vDeviceResults[iDevice];
+        for (const auto& sTargetPath : deviceResults.vTargetPaths)
+        {
+            _Print("device %u backs %s\n", (unsigned int)iDevice, sTargetPath.c_str());
+        }
     }
-    _Print("-------------------------------------------\n");
 
-    sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "avg.| %6.2lf%%| %6.2lf%%|  %6.2lf%%| %6.2lf%%\n",
-        busyTime / ulProcCount,
-        totalUserTime / ulProcCount,
-        (totalKrnlTime - totalIdleTime) / ulProcCount,
-        totalIdleTime / ulProcCount);
-    _Print("%s", szFloatBuffer);
+    if (fTime > 0)
+    {
+        for (size_t iDevice = 0; iDevice < results.vDeviceResults.size(); iDevice++)
+        {
+            const DeviceStatistics& stats = results.vDeviceResults[iDevice].stats;
+            sprintf_s(szFloatBuffer, sizeof(szFloatBuffer), "device %u: %.2lf device I/O per s\n",
+                (unsigned int)iDevice,
+                (double)(stats.ullReadCount + stats.ullWriteCount) / fTime);
+            _Print("%s", szFloatBuffer);
+        }
+    }
 }
 
 void ResultParser::_PrintSectionFieldNames(const TimeSpan& timeSpan)
@@ -630,21 +1624,222 @@ void ResultParser::_PrintLatencyPercentiles(const Results& results)
 {
     Histogram<float> readLatencyHistogram;
     Histogram<float> writeLatencyHistogram;
-    Histogram<float> totalLatencyHistogram;
 
     for (const auto& thread : results.vThreadResults)
     {
         for (const auto& target : thread.vTargetResults)
         {
             readLatencyHistogram.Merge(target.readLatencyHistogram);
-
             writeLatencyHistogram.Merge(target.writeLatencyHistogram);
+        }
+    }
 
-            totalLatencyHistogram.Merge(target.writeLatencyHistogram);
+    _PrintLatencyHistograms(readLatencyHistogram, writeLatencyHistogram);
+}
+
+void ResultParser::_PrintCorrectedLatencyPercentiles(const Results& results)
+{
+    Histogram<float> readLatencyHistogram;
+    Histogram<float> writeLatencyHistogram;
+    UINT64 ullScheduleSlipCount = 0;
+    UINT64 ullScheduleSlipTime = 0;
+
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            readLatencyHistogram.Merge(target.readCorrectedLatencyHistogram);
+            writeLatencyHistogram.Merge(target.writeCorrectedLatencyHistogram);
+            ullScheduleSlipCount += target.ullScheduleSlipCount;
+            ullScheduleSlipTime += target.ullScheduleSlipTime;
+        }
+    }
+
+    // only paced (throttled or think time) targets have a schedule to correct against
+    if (readLatencyHistogram.GetSampleSize() == 0 && writeLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    _Print("\n\nLatency corrected for coordinated omission (measured from the intended issue time):\n");
+    _Print("schedule slips:\t\t%I64u I/Os, %.3lfms total\n\n", ullScheduleSlipCount, PerfTimer::PerfTimeToMilliseconds(ullScheduleSlipTime));
+    _PrintLatencyHistograms(readLatencyHistogram, writeLatencyHistogram);
+}
+
+void ResultParser::_PrintLatencyBreakdown(const Results& results)
+{
+    Histogram<float> submitLatencyHistogram;
+    Histogram<float> serviceLatencyHistogram;
+    Histogram<float> dispatchLatencyHistogram;
+
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            submitLatencyHistogram.Merge(target.readSubmitLatencyHistogram);
+            submitLatencyHistogram.Merge(target.writeSubmitLatencyHistogram);
+            serviceLatencyHistogram.Merge(target.readServiceLatencyHistogram);
+            serviceLatencyHistogram.Merge(target.writeServiceLatencyHistogram);
+            dispatchLatencyHistogram.Merge(target.readDispatchLatencyHistogram);
+            dispatchLatencyHistogram.Merge(target.writeDispatchLatencyHistogram);
+        }
+    }
+
+    // synchronous IO has no separate submission and completion
+    if (submitLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    _Print("\n\nLatency breakdown (submit: ReadFile/WriteFile call, service: until completion dequeued, dispatch: until accounted):\n");
+    _Print("service includes the time a completion waits while the thread is busy, and is an upper bound of the device's service time\n");
+    _Print("  %%-ile | Submit (ms) | Service (ms) | Dispatch (ms)\n");
+    _Print("-----------------------------------------------------\n");
+    _Print("    min | %11.3lf | %12.3lf | %13.3lf\n",
+           submitLatencyHistogram.GetMin() / 1000,
+           serviceLatencyHistogram.GetMin() / 1000,
+           dispatchLatencyHistogram.GetMin() / 1000);
+
+    PercentileDescriptor percentiles[] =
+    {
+        {       0.50, "50th"    },
+        {       0.90, "90th"    },
+        {       0.99, "99th"    },
+        {      0.999, "3-nines" },
+        {     0.9999, "4-nines" },
+    };
+
+    for (auto p : percentiles)
+    {
+        _Print("%7s | %11.3lf | %12.3lf | %13.3lf\n",
+               p.Name.c_str(),
+               submitLatencyHistogram.GetPercentile(p.Percentile) / 1000,
+               serviceLatencyHistogram.GetPercentile(p.Percentile) / 1000,
+               dispatchLatencyHistogram.GetPercentile(p.Percentile) / 1000);
+    }
+
+    _Print("    max | %11.3lf | %12.3lf | %13.3lf\n",
+           submitLatencyHistogram.GetMax() / 1000,
+           serviceLatencyHistogram.GetMax() / 1000,
+           dispatchLatencyHistogram.GetMax() / 1000);
+}
+
+void ResultParser::_PrintLatencySampling(const TimeSpan& timeSpan, const Results& results)
+{
+    Histogram<float> totalLatencyHistogram;
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
             totalLatencyHistogram.Merge(target.readLatencyHistogram);
+            totalLatencyHistogram.Merge(target.writeLatencyHistogram);
+        }
+    }
+
+    UINT64 ullSampleCount = totalLatencyHistogram.GetSampleSize();
+    if (ullSampleCount == 0)
+    {
+        return;
+    }
+
+    _Print("\n\nLatency sampled for 1 in %u I/Os (%I64u samples); 95%% confidence bounds of the total:\n",
+           timeSpan.GetLatencySampleRate(),
+           ullSampleCount);
+    _Print("  %%-ile | Lower (ms) | Total (ms) | Upper (ms)\n");
+    _Print("----------------------------------------------\n");
+
+    PercentileDescriptor percentiles[] =
+    {
+        {       0.25, "25th"    },
+        {       0.50, "50th"    },
+        {       0.75, "75th"    },
+        {       0.90, "90th"    },
+        {       0.95, "95th"    },
+        {       0.99, "99th"    },
+        {      0.999, "3-nines" },
+        {     0.9999, "4-nines" },
+        {    0.99999, "5-nines" },
+    };
+
+    for (auto p : percentiles)
+    {
+        _Print("%7s | %10.3lf | %10.3lf | %10.3lf\n",
+               p.Name.c_str(),
+               totalLatencyHistogram.GetPercentile(Util::PercentileConfidenceBound(p.Percentile, ullSampleCount, -1.96)) / 1000,
+               totalLatencyHistogram.GetPercentile(p.Percentile) / 1000,
+               totalLatencyHistogram.GetPercentile(Util::PercentileConfidenceBound(p.Percentile, ullSampleCount, 1.96)) / 1000);
+    }
+}
+
+void ResultParser::_PrintCycleProfile(const Results& results)
+{
+    const int cPhases = static_cast<int>(WorkerPhase::Count);
+    UINT64 vullTotalCycles[cPhases] = {};
+    UINT64 ullTotalIOCount = 0;
+
+    _Print("\n\nGenerator cycles per I/O (TSC):\n");
+    _Print("thread | throttle |  io type |   submit |     wait | accounting |   offset |  process | file open |     total\n");
+    _Print("------------------------------------------------------------------------------------------------------------\n");
+
+    for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
+    {
+        const ThreadResults& threadResults = results.vThreadResults[iThread];
+        UINT64 ullIOCount = 0;
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            ullIOCount += targetResults.ullIOCount;
+        }
+        ullTotalIOCount += ullIOCount;
+
+        double fTotal = 0;
+        double vfCyclesPerIO[cPhases];
+        for (int i = 0; i < cPhases; i++)
+        {
+            vullTotalCycles[i] += threadResults.vullPhaseCycles[i];
+            vfCyclesPerIO[i] = (ullIOCount > 0) ? (double)threadResults.vullPhaseCycles[i] / ullIOCount : 0;
+            fTotal += vfCyclesPerIO[i];
         }
+
+        _Print("%6u | %8.0lf | %8.0lf | %8.0lf | %8.0lf | %10.0lf | %8.0lf | %8.0lf | %9.0lf | %9.0lf\n",
+               (unsigned int)iThread,
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::Throttle)],
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::IoType)],
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::Submit)],
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::Wait)],
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::Accounting)],
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::Offset)],
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::Process)],
+               vfCyclesPerIO[static_cast<int>(WorkerPhase::FileOpen)],
+               fTotal);
+    }
+
+    double fTotal = 0;
+    double vfCyclesPerIO[cPhases];
+    for (int i = 0; i < cPhases; i++)
+    {
+        vfCyclesPerIO[i] = (ullTotalIOCount > 0) ? (double)vullTotalCycles[i] / ullTotalIOCount : 0;
+        fTotal += vfCyclesPerIO[i];
     }
 
+    _Print("------------------------------------------------------------------------------------------------------------\n");
+    _Print(" total | %8.0lf | %8.0lf | %8.0lf | %8.0lf | %10.0lf | %8.0lf | %8.0lf | %9.0lf | %9.0lf\n",
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::Throttle)],
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::IoType)],
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::Submit)],
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::Wait)],
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::Accounting)],
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::Offset)],
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::Process)],
+           vfCyclesPerIO[static_cast<int>(WorkerPhase::FileOpen)],
+           fTotal);
+}
+
+void ResultParser::_PrintLatencyHistograms(const Histogram<float>& readLatencyHistogram, const Histogram<float>& writeLatencyHistogram)
+{
+    Histogram<float> totalLatencyHistogram;
+    totalLatencyHistogram.Merge(readLatencyHistogram);
+    totalLatencyHistogram.Merge(writeLatencyHistogram);
+
     bool fHasReads = readLatencyHistogram.GetSampleSize() > 0;
     bool fHasWrites = writeLatencyHistogram.GetSampleSize() > 0;
 
@@ -759,10 +1954,58 @@ string ResultParser::ParseResults(Profile& profile, const SystemInformation& sys
             _Print("\nWrite IO\n");
             _PrintSection(_SectionEnum::WRITE, timeSpan, results);
 
+            if (timeSpan.GetCpuEfficiency())
+            {
+                _Print("\nWorker CPU efficiency\n");
+                _PrintWorkerCpuEfficiency(results);
+            }
+
+            _PrintNumaPlacement(results);
+            _PrintBufferPages(timeSpan, results);
+            _PrintBufferWorkingSet(system, timeSpan, results);
+            _PrintWorkStage(results);
+            _PrintWriteDataFill(results);
+            _PrintFileSet(results);
+            _PrintMetadata(results);
+            _PrintFlushes(results);
+            _PrintGroupCommit(results);
+            _PrintDataVerification(timeSpan, results);
+
             if (timeSpan.GetMeasureLatency())
             {
                 _Print("\n\n");
                 _PrintLatencyPercentiles(results);
+                if (timeSpan.GetLatencySampleRate() > 1)
+                {
+                    _PrintLatencySampling(timeSpan, results);
+                }
+                _PrintCorrectedLatencyPercentiles(results);
+                _PrintLatencyBreakdown(results);
+            }
+
+            if (timeSpan.GetProfileCpuCycles())
+            {
+                _PrintCycleProfile(results);
+            }
+
+            if (timeSpan.GetHardwareCounters())
+            {
+                _PrintHardwareCounters(results);
+            }
+
+            if (timeSpan.GetSchedulingDelay())
+            {
+                _PrintSchedulingDelay(timeSpan, results);
+            }
+
+            if (timeSpan.GetDeviceStatistics())
+            {
+                _PrintDeviceStatistics(results);
+            }
+
+            if (results.vTargetLayouts.size() > 0)
+            {
+                _PrintFileLayout(results);
             }
 
             //etw
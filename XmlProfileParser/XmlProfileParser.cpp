@@ -519,6 +519,66 @@ HRESULT XmlProfileParser::_ParseTimeSpan(IXMLDOMNode &XmlNode, TimeSpan *pTimeSp
         }
     }
 
+    if (SUCCEEDED(hr))
+    {
+        bool fProfileCpuCycles;
+        hr = _GetBool(XmlNode, "ProfileCpuCycles", &fProfileCpuCycles);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTimeSpan->SetProfileCpuCycles(fProfileCpuCycles);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        bool fHardwareCounters;
+        hr = _GetBool(XmlNode, "HardwareCounters", &fHardwareCounters);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTimeSpan->SetHardwareCounters(fHardwareCounters);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        bool fDeviceStatistics;
+        hr = _GetBool(XmlNode, "DeviceStatistics", &fDeviceStatistics);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTimeSpan->SetDeviceStatistics(fDeviceStatistics);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        bool fSchedulingDelay;
+        hr = _GetBool(XmlNode, "SchedulingDelay", &fSchedulingDelay);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTimeSpan->SetSchedulingDelay(fSchedulingDelay);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        bool fCpuEfficiency;
+        hr = _GetBool(XmlNode, "CpuEfficiency", &fCpuEfficiency);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTimeSpan->SetCpuEfficiency(fCpuEfficiency);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        UINT32 ulLatencySampleRate;
+        hr = _GetUINT32(XmlNode, "LatencySampleRate", &ulLatencySampleRate);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTimeSpan->SetLatencySampleRate(ulLatencySampleRate);
+        }
+    }
+
     if (SUCCEEDED(hr))
     {
         UINT32 ulIoBucketDuration;
@@ -529,6 +589,39 @@ HRESULT XmlProfileParser::_ParseTimeSpan(IXMLDOMNode &XmlNode, TimeSpan *pTimeSp
         }
     }
 
+    if (SUCCEEDED(hr))
+    {
+        string sAffinityPolicy;
+        hr = _GetString(XmlNode, "AffinityPolicy", &sAffinityPolicy);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            if (sAffinityPolicy == "PhysicalCore")
+            {
+                pTimeSpan->SetAffinityPolicy(AffinityPolicy::PhysicalCore);
+            }
+            else if (sAffinityPolicy == "SpreadNodes")
+            {
+                pTimeSpan->SetAffinityPolicy(AffinityPolicy::SpreadNodes);
+            }
+            else if (sAffinityPolicy == "CompactL3")
+            {
+                pTimeSpan->SetAffinityPolicy(AffinityPolicy::CompactL3);
+            }
+            else if (sAffinityPolicy == "AvoidSmt")
+            {
+                pTimeSpan->SetAffinityPolicy(AffinityPolicy::AvoidSmt);
+            }
+            else if (sAffinityPolicy == "DeviceLocal")
+            {
+                pTimeSpan->SetAffinityPolicy(AffinityPolicy::DeviceLocal);
+            }
+            else
+            {
+                hr = E_INVALIDARG;
+            }
+        }
+    }
+
     // Look for downlevel non-group aware assignment
     if (SUCCEEDED(hr))
     {
@@ -609,6 +702,308 @@ HRESULT XmlProfileParser::_ParseRandomDataSource(IXMLDOMNode &XmlNode, Target *p
     return hr;
 }
 
+HRESULT XmlProfileParser::_ParseDataGenerator(IXMLDOMNode &XmlNode, Target *pTarget)
+{
+    IXMLDOMNodeListPtr spNodeList;
+    _variant_t query("DataGenerator");
+    HRESULT hr = XmlNode.selectNodes(query.bstrVal, &spNodeList);
+    if (SUCCEEDED(hr))
+    {
+        long cNodes;
+        hr = spNodeList->get_length(&cNodes);
+        if (SUCCEEDED(hr) && (cNodes == 1))
+        {
+            IXMLDOMNodePtr spNode;
+            hr = spNodeList->get_item(0, &spNode);
+            if (SUCCEEDED(hr))
+            {
+                DWORD dwPercent;
+                hr = _GetDWORD(spNode, "CompressionPercent", &dwPercent);
+                if (SUCCEEDED(hr) && (S_FALSE != hr))
+                {
+                    pTarget->SetDataCompressionPercent(dwPercent);
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "DuplicatePercent", &dwPercent);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetDataDuplicatePercent(dwPercent);
+                    }
+                }
+            }
+        }
+    }
+    return hr;
+}
+
+HRESULT XmlProfileParser::_ParseFileSet(IXMLDOMNode &XmlNode, Target *pTarget)
+{
+    IXMLDOMNodeListPtr spNodeList;
+    _variant_t query("FileSet");
+    HRESULT hr = XmlNode.selectNodes(query.bstrVal, &spNodeList);
+    if (SUCCEEDED(hr))
+    {
+        long cNodes;
+        hr = spNodeList->get_length(&cNodes);
+        if (SUCCEEDED(hr) && (cNodes == 1))
+        {
+            IXMLDOMNodePtr spNode;
+            hr = spNodeList->get_item(0, &spNode);
+            if (SUCCEEDED(hr))
+            {
+                DWORD dwValue;
+                hr = _GetDWORD(spNode, "FileCount", &dwValue);
+                if (SUCCEEDED(hr) && (S_FALSE != hr))
+                {
+                    pTarget->SetFileSetCount(dwValue);
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "FilesPerDirectory", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetFilesPerDirectory(dwValue);
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    UINT64 ullSize;
+                    hr = _GetUINT64(spNode, "MinFileSize", &ullSize);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetFileSetMinFileSize(ullSize);
+                    }
+
+                    if (SUCCEEDED(hr))
+                    {
+                        hr = _GetUINT64(spNode, "MaxFileSize", &ullSize);
+                        if (SUCCEEDED(hr) && (S_FALSE != hr))
+                        {
+                            pTarget->SetFileSetMaxFileSize(ullSize);
+                        }
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    string sSkew;
+                    hr = _GetString(spNode, "Skew", &sSkew);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetFileSetSkew(strtod(sSkew.c_str(), nullptr));
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    bool fWholeFile;
+                    hr = _GetBool(spNode, "WholeFile", &fWholeFile);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetFileSetWholeFile(fWholeFile);
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "HandleCacheSize", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetHandleCacheSize(dwValue);
+                    }
+                }
+            }
+        }
+    }
+    return hr;
+}
+
+HRESULT XmlProfileParser::_ParseMetadata(IXMLDOMNode &XmlNode, Target *pTarget)
+{
+    IXMLDOMNodeListPtr spNodeList;
+    _variant_t query("Metadata");
+    HRESULT hr = XmlNode.selectNodes(query.bstrVal, &spNodeList);
+    if (SUCCEEDED(hr))
+    {
+        long cNodes;
+        hr = spNodeList->get_length(&cNodes);
+        if (SUCCEEDED(hr) && (cNodes == 1))
+        {
+            IXMLDOMNodePtr spNode;
+            hr = spNodeList->get_item(0, &spNode);
+            if (SUCCEEDED(hr))
+            {
+                const struct
+                {
+                    const char *pszQuery;
+                    MetadataOperation type;
+                } weights[] =
+                {
+                    { "Create", MetadataOperation::Create },
+                    { "Stat", MetadataOperation::Stat },
+                    { "Open", MetadataOperation::Open },
+                    { "Rename", MetadataOperation::Rename },
+                    { "Unlink", MetadataOperation::Unlink },
+                };
+
+                DWORD dwValue;
+                for (const auto& weight : weights)
+                {
+                    hr = _GetDWORD(spNode, weight.pszQuery, &dwValue);
+                    if (FAILED(hr))
+                    {
+                        break;
+                    }
+                    if (S_FALSE != hr)
+                    {
+                        pTarget->SetMetadataWeight(weight.type, dwValue);
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "FileCount", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetMetadataFileCount(dwValue);
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "FilesPerDirectory", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetFilesPerDirectory(dwValue);
+                    }
+                }
+            }
+        }
+    }
+    return hr;
+}
+
+HRESULT XmlProfileParser::_ParseGroupCommit(IXMLDOMNode &XmlNode, Target *pTarget)
+{
+    IXMLDOMNodeListPtr spNodeList;
+    _variant_t query("GroupCommit");
+    HRESULT hr = XmlNode.selectNodes(query.bstrVal, &spNodeList);
+    if (SUCCEEDED(hr))
+    {
+        long cNodes;
+        hr = spNodeList->get_length(&cNodes);
+        if (SUCCEEDED(hr) && (cNodes == 1))
+        {
+            IXMLDOMNodePtr spNode;
+            hr = spNodeList->get_item(0, &spNode);
+            if (SUCCEEDED(hr))
+            {
+                pTarget->SetGroupCommit(true);
+
+                DWORD dwValue;
+                hr = _GetDWORD(spNode, "Rate", &dwValue);
+                if (SUCCEEDED(hr) && (S_FALSE != hr))
+                {
+                    pTarget->SetCommitRate(dwValue);
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "RecordSize", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetCommitRecordSize(dwValue);
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "BatchSize", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetCommitBatchSize(dwValue);
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "Delay", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetCommitDelay(dwValue);
+                    }
+                }
+            }
+        }
+    }
+    return hr;
+}
+
+HRESULT XmlProfileParser::_ParseFlush(IXMLDOMNode &XmlNode, Target *pTarget)
+{
+    IXMLDOMNodeListPtr spNodeList;
+    _variant_t query("Flush");
+    HRESULT hr = XmlNode.selectNodes(query.bstrVal, &spNodeList);
+    if (SUCCEEDED(hr))
+    {
+        long cNodes;
+        hr = spNodeList->get_length(&cNodes);
+        if (SUCCEEDED(hr) && (cNodes == 1))
+        {
+            IXMLDOMNodePtr spNode;
+            hr = spNodeList->get_item(0, &spNode);
+            if (SUCCEEDED(hr))
+            {
+                DWORD dwValue;
+                hr = _GetDWORD(spNode, "WriteInterval", &dwValue);
+                if (SUCCEEDED(hr) && (S_FALSE != hr))
+                {
+                    pTarget->SetFlushWriteInterval(dwValue);
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    hr = _GetDWORD(spNode, "TimeInterval", &dwValue);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        pTarget->SetFlushTimeInterval(dwValue);
+                    }
+                }
+
+                if (SUCCEEDED(hr))
+                {
+                    string sMode;
+                    hr = _GetString(spNode, "Mode", &sMode);
+                    if (SUCCEEDED(hr) && (S_FALSE != hr))
+                    {
+                        if (sMode == "full")
+                        {
+                            pTarget->SetFlushMode(FlushMode::Full);
+                        }
+                        else if (sMode == "data")
+                        {
+                            pTarget->SetFlushMode(FlushMode::Data);
+                        }
+                        else if (sMode == "writeback")
+                        {
+                            pTarget->SetFlushMode(FlushMode::Writeback);
+                        }
+                        else
+                        {
+                            hr = E_INVALIDARG;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return hr;
+}
+
 HRESULT XmlProfileParser::_ParseWriteBufferContent(IXMLDOMNode &XmlNode, Target *pTarget)
 {
     IXMLDOMNodeListPtr spNodeList;
@@ -640,6 +1035,15 @@ HRESULT XmlProfileParser::_ParseWriteBufferContent(IXMLDOMNode &XmlNode, Target
                     {
                         hr = _ParseRandomDataSource(spNode, pTarget);
                     }
+                    else if (sPattern == "prng")
+                    {
+                        pTarget->SetRandomizeWriteData(true);
+                    }
+                    else if (sPattern == "generated")
+                    {
+                        pTarget->SetGenerateWriteData(true);
+                        hr = _ParseDataGenerator(spNode, pTarget);
+                    }
                     else
                     {
                         hr = E_INVALIDARG;
@@ -740,6 +1144,26 @@ HRESULT XmlProfileParser::_ParseTarget(IXMLDOMNode &XmlNode, Target *pTarget)
         }
     }
 
+    if (SUCCEEDED(hr))
+    {
+        bool fLockBuffers;
+        hr = _GetBool(XmlNode, "LockBuffers", &fLockBuffers);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTarget->SetLockBuffers(fLockBuffers);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        bool fVerifyData;
+        hr = _GetBool(XmlNode, "VerifyData", &fVerifyData);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTarget->SetVerifyData(fVerifyData);
+        }
+    }
+
     if (SUCCEEDED(hr))
     {
         DWORD dwRequestCount;
@@ -750,6 +1174,75 @@ HRESULT XmlProfileParser::_ParseTarget(IXMLDOMNode &XmlNode, Target *pTarget)
         }
     }
 
+    if (SUCCEEDED(hr))
+    {
+        string sWorkKernel;
+        hr = _GetString(XmlNode, "WorkKernel", &sWorkKernel);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            if (sWorkKernel == "Crc32c")
+            {
+                pTarget->SetWorkKernel(WorkKernel::Crc32c);
+            }
+            else if (sWorkKernel == "Encrypt")
+            {
+                pTarget->SetWorkKernel(WorkKernel::Encrypt);
+            }
+            else if (sWorkKernel == "Copy")
+            {
+                pTarget->SetWorkKernel(WorkKernel::Copy);
+            }
+            else if (sWorkKernel == "Spin")
+            {
+                pTarget->SetWorkKernel(WorkKernel::Spin);
+            }
+            else
+            {
+                hr = E_INVALIDARG;
+            }
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        DWORD dwWorkCyclesPerByte;
+        hr = _GetDWORD(XmlNode, "WorkCyclesPerByte", &dwWorkCyclesPerByte);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTarget->SetWorkCyclesPerByte(dwWorkCyclesPerByte);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        DWORD dwIoBufferCount;
+        hr = _GetDWORD(XmlNode, "IoBufferCount", &dwIoBufferCount);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTarget->SetIoBufferCount(dwIoBufferCount);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        UINT64 ullBufferWorkingSetSize;
+        hr = _GetUINT64(XmlNode, "BufferWorkingSetSize", &ullBufferWorkingSetSize);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTarget->SetBufferWorkingSetSize(ullBufferWorkingSetSize);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        bool fInterleaveBuffers;
+        hr = _GetBool(XmlNode, "InterleaveBuffers", &fInterleaveBuffers);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTarget->SetInterleaveBuffers(fInterleaveBuffers);
+        }
+    }
+
     if (SUCCEEDED(hr))
     {
         UINT64 ullRandom;
@@ -849,6 +1342,36 @@ HRESULT XmlProfileParser::_ParseTarget(IXMLDOMNode &XmlNode, Target *pTarget)
         }
     }
 
+    if (SUCCEEDED(hr))
+    {
+        DWORD dwFragmentCount;
+        hr = _GetDWORD(XmlNode, "FragmentCount", &dwFragmentCount);
+        if (SUCCEEDED(hr) && (hr != S_FALSE))
+        {
+            pTarget->SetFragmentCount(dwFragmentCount);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = _ParseFileSet(XmlNode, pTarget);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = _ParseMetadata(XmlNode, pTarget);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = _ParseFlush(XmlNode, pTarget);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = _ParseGroupCommit(XmlNode, pTarget);
+    }
+
     if (SUCCEEDED(hr))
     {
         UINT64 ullMaxFileSize;
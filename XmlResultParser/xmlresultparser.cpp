@@ -28,6 +28,7 @@ SOFTWARE.
 */
 
 #include "xmlresultparser.h"
+#include <algorithm>
 
 // TODO: refactor to a single function shared with the ResultParser
 void XmlResultParser::_Print(const char *format, ...)
@@ -57,6 +58,54 @@ void XmlResultParser::_PrintTargetResults(const TargetResults& results)
     _Print("<WriteCount>%I64u</WriteCount>\n", results.ullWriteIOCount);
 }
 
+void XmlResultParser::_PrintTargetVerification(const TargetResults& results)
+{
+    if (results.ullStampedWriteCount == 0 && results.ullVerifiedReadCount == 0 &&
+        results.ullUnverifiedReadCount == 0 && results.ullVerifyFailureCount == 0)
+    {
+        return;
+    }
+
+    _Print("<Verify>\n");
+    _Print("<StampedWrites>%I64u</StampedWrites>\n", results.ullStampedWriteCount);
+    _Print("<VerifiedReads>%I64u</VerifiedReads>\n", results.ullVerifiedReadCount);
+    _Print("<UnverifiedReads>%I64u</UnverifiedReads>\n", results.ullUnverifiedReadCount);
+    _Print("<Failures>%I64u</Failures>\n", results.ullVerifyFailureCount);
+    for (const auto& failure : results.vVerifyFailures)
+    {
+        const char *pszType = "";
+        switch (failure.type)
+        {
+        case VerifyFailureType::Corrupt:
+            pszType = "Corrupt";
+            break;
+        case VerifyFailureType::Misdirected:
+            pszType = "Misdirected";
+            break;
+        case VerifyFailureType::Stale:
+            pszType = "Stale";
+            break;
+        case VerifyFailureType::Missing:
+            pszType = "Missing";
+            break;
+        }
+
+        _Print("<Failure>\n");
+        _Print("<Type>%s</Type>\n", pszType);
+        _Print("<Offset>%I64u</Offset>\n", failure.ullOffset);
+        if (failure.fMeasured)
+        {
+            _Print("<Milliseconds>%.3f</Milliseconds>\n", PerfTimer::PerfTimeToMilliseconds(failure.ullTime));
+        }
+        _Print("<ExpectedSequence>%I64u</ExpectedSequence>\n", failure.ullExpectedSequence);
+        _Print("<FoundSequence>%I64u</FoundSequence>\n", failure.ullFoundSequence);
+        _Print("<FoundOffset>%I64u</FoundOffset>\n", failure.ullFoundOffset);
+        _Print("<WriterThread>%u</WriterThread>\n", failure.ulWriterThreadNo);
+        _Print("</Failure>\n");
+    }
+    _Print("</Verify>\n");
+}
+
 void XmlResultParser::_PrintTargetLatency(const TargetResults& results)
 {
     if (results.readLatencyHistogram.GetSampleSize() > 0)
@@ -77,6 +126,33 @@ void XmlResultParser::_PrintTargetLatency(const TargetResults& results)
         _Print("<AverageLatencyMilliseconds>%.3f</AverageLatencyMilliseconds>\n", totalLatencyHistogram.GetAvg() / 1000);
         _Print("<LatencyStdev>%.3f</LatencyStdev>\n", totalLatencyHistogram.GetStandardDeviation() / 1000);
     }
+    Histogram<float> totalCorrectedLatencyHistogram;
+    totalCorrectedLatencyHistogram.Merge(results.readCorrectedLatencyHistogram);
+    totalCorrectedLatencyHistogram.Merge(results.writeCorrectedLatencyHistogram);
+    if (totalCorrectedLatencyHistogram.GetSampleSize() > 0)
+    {
+        _Print("<AverageCorrectedLatencyMilliseconds>%.3f</AverageCorrectedLatencyMilliseconds>\n", totalCorrectedLatencyHistogram.GetAvg() / 1000);
+        _Print("<CorrectedLatencyStdev>%.3f</CorrectedLatencyStdev>\n", totalCorrectedLatencyHistogram.GetStandardDeviation() / 1000);
+        _Print("<ScheduleSlipCount>%I64u</ScheduleSlipCount>\n", results.ullScheduleSlipCount);
+        _Print("<ScheduleSlipMilliseconds>%.3f</ScheduleSlipMilliseconds>\n", PerfTimer::PerfTimeToMilliseconds(results.ullScheduleSlipTime));
+    }
+
+    Histogram<float> totalSubmitLatencyHistogram;
+    totalSubmitLatencyHistogram.Merge(results.readSubmitLatencyHistogram);
+    totalSubmitLatencyHistogram.Merge(results.writeSubmitLatencyHistogram);
+    if (totalSubmitLatencyHistogram.GetSampleSize() > 0)
+    {
+        Histogram<float> totalServiceLatencyHistogram;
+        totalServiceLatencyHistogram.Merge(results.readServiceLatencyHistogram);
+        totalServiceLatencyHistogram.Merge(results.writeServiceLatencyHistogram);
+        Histogram<float> totalDispatchLatencyHistogram;
+        totalDispatchLatencyHistogram.Merge(results.readDispatchLatencyHistogram);
+        totalDispatchLatencyHistogram.Merge(results.writeDispatchLatencyHistogram);
+
+        _Print("<AverageSubmitMilliseconds>%.3f</AverageSubmitMilliseconds>\n", totalSubmitLatencyHistogram.GetAvg() / 1000);
+        _Print("<AverageServiceMilliseconds>%.3f</AverageServiceMilliseconds>\n", totalServiceLatencyHistogram.GetAvg() / 1000);
+        _Print("<AverageDispatchMilliseconds>%.3f</AverageDispatchMilliseconds>\n", totalDispatchLatencyHistogram.GetAvg() / 1000);
+    }
 }
 
 void XmlResultParser::_PrintTargetIops(const IoBucketizer& readBucketizer, const IoBucketizer& writeBucketizer, UINT32 bucketTimeInMs)
@@ -209,17 +285,24 @@ void XmlResultParser::_PrintCpuUtilization(const Results& results)
     double totalIdleTime = 0;
     double totalUserTime = 0;
     double totalKrnlTime = 0;
+    double totalDpcTime = 0;
+    double totalIntrTime = 0;
+    UINT64 ullInterruptCount = 0;
 
     for (unsigned int x = 0; x<ulProcCount; ++x)
     {
         double idleTime;
         double userTime;
         double krnlTime;
+        double dpcTime;
+        double intrTime;
         double thisTime;
 
         idleTime = 100.0 * results.vSystemProcessorPerfInfo[x].IdleTime.QuadPart / 10000000 / fTime;
         krnlTime = 100.0 * results.vSystemProcessorPerfInfo[x].KernelTime.QuadPart / 10000000 / fTime;
         userTime = 100.0 * results.vSystemProcessorPerfInfo[x].UserTime.QuadPart / 10000000 / fTime;
+        dpcTime = 100.0 * results.vSystemProcessorPerfInfo[x].Reserved1[0].QuadPart / 10000000 / fTime;   // DPC time
+        intrTime = 100.0 * results.vSystemProcessorPerfInfo[x].Reserved1[1].QuadPart / 10000000 / fTime;  // interrupt time
 
         thisTime = (krnlTime + userTime) - idleTime;
 
@@ -229,18 +312,40 @@ void XmlResultParser::_PrintCpuUtilization(const Results& results)
         _Print("<UserPercent>%.2f</UserPercent>\n", userTime);
         _Print("<KernelPercent>%.2f</KernelPercent>\n", krnlTime - idleTime);
         _Print("<IdlePercent>%.2f</IdlePercent>\n", idleTime);
+        _Print("<DpcPercent>%.2f</DpcPercent>\n", dpcTime);
+        _Print("<InterruptPercent>%.2f</InterruptPercent>\n", intrTime);
+        _Print("<Interrupts>%u</Interrupts>\n", results.vSystemProcessorPerfInfo[x].Reserved2);
         _Print("</CPU>\n");
 
         busyTime += thisTime;
         totalIdleTime += idleTime;
         totalUserTime += userTime;
         totalKrnlTime += krnlTime;
+        totalDpcTime += dpcTime;
+        totalIntrTime += intrTime;
+        ullInterruptCount += results.vSystemProcessorPerfInfo[x].Reserved2;
     }
+
+    UINT64 ullIOCount = 0;
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            ullIOCount += target.ullIOCount;
+        }
+    }
+
     _Print("<Average>\n");
     _Print("<UsagePercent>%.2f</UsagePercent>\n", busyTime / ulProcCount);
     _Print("<UserPercent>%.2f</UserPercent>\n", totalUserTime / ulProcCount);
     _Print("<KernelPercent>%.2f</KernelPercent>\n", (totalKrnlTime - totalIdleTime) / ulProcCount);
     _Print("<IdlePercent>%.2f</IdlePercent>\n", totalIdleTime / ulProcCount);
+    _Print("<DpcPercent>%.2f</DpcPercent>\n", totalDpcTime / ulProcCount);
+    _Print("<InterruptPercent>%.2f</InterruptPercent>\n", totalIntrTime / ulProcCount);
+    if (ullIOCount > 0)
+    {
+        _Print("<InterruptsPerIO>%.2f</InterruptsPerIO>\n", (double)ullInterruptCount / ullIOCount);
+    }
     _Print("</Average>\n");
 
     _Print("</CpuUtilization>\n");
@@ -295,22 +400,505 @@ void XmlResultParser::_PrintLatencyPercentiles(const Results& results)
 {
     Histogram<float> readLatencyHistogram;
     Histogram<float> writeLatencyHistogram;
-    Histogram<float> totalLatencyHistogram;
 
     for (const auto& thread : results.vThreadResults)
     {
         for (const auto& target : thread.vTargetResults)
         {
             readLatencyHistogram.Merge(target.readLatencyHistogram);
-
             writeLatencyHistogram.Merge(target.writeLatencyHistogram);
+        }
+    }
 
-            totalLatencyHistogram.Merge(target.writeLatencyHistogram);
+    _Print("<Latency>\n");
+    _PrintLatencyHistograms(readLatencyHistogram, writeLatencyHistogram);
+    _Print("</Latency>\n");
+}
+
+void XmlResultParser::_PrintCorrectedLatencyPercentiles(const Results& results)
+{
+    Histogram<float> readLatencyHistogram;
+    Histogram<float> writeLatencyHistogram;
+    UINT64 ullScheduleSlipCount = 0;
+    UINT64 ullScheduleSlipTime = 0;
+
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            readLatencyHistogram.Merge(target.readCorrectedLatencyHistogram);
+            writeLatencyHistogram.Merge(target.writeCorrectedLatencyHistogram);
+            ullScheduleSlipCount += target.ullScheduleSlipCount;
+            ullScheduleSlipTime += target.ullScheduleSlipTime;
+        }
+    }
+
+    // only paced (throttled or think time) targets have a schedule to correct against
+    if (readLatencyHistogram.GetSampleSize() == 0 && writeLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    _Print("<CorrectedLatency>\n");
+    _Print("<ScheduleSlipCount>%I64u</ScheduleSlipCount>\n", ullScheduleSlipCount);
+    _Print("<ScheduleSlipMilliseconds>%.3f</ScheduleSlipMilliseconds>\n", PerfTimer::PerfTimeToMilliseconds(ullScheduleSlipTime));
+    _PrintLatencyHistograms(readLatencyHistogram, writeLatencyHistogram);
+    _Print("</CorrectedLatency>\n");
+}
+
+void XmlResultParser::_PrintThreadCpuEfficiency(const ThreadResults& threadResults)
+{
+    UINT64 ullIOCount = 0;
+    for (const auto& targetResults : threadResults.vTargetResults)
+    {
+        ullIOCount += targetResults.ullIOCount;
+    }
+
+    UINT64 ullCpuTime = threadResults.ullKernelTime + threadResults.ullUserTime;
+
+    // thread times are in 100ns units
+    _Print("<CpuEfficiency>\n");
+    _Print("<UserSeconds>%.3f</UserSeconds>\n", threadResults.ullUserTime / 10000000.0);
+    _Print("<KernelSeconds>%.3f</KernelSeconds>\n", threadResults.ullKernelTime / 10000000.0);
+    _Print("<Cycles>%I64u</Cycles>\n", threadResults.ullCycleTime);
+    _Print("<ContextSwitches>%I64u</ContextSwitches>\n", threadResults.ullContextSwitches);
+    if (ullIOCount > 0)
+    {
+        _Print("<CyclesPerIO>%.0f</CyclesPerIO>\n", (double)threadResults.ullCycleTime / ullIOCount);
+        _Print("<CpuMicrosecondsPerIO>%.2f</CpuMicrosecondsPerIO>\n", ullCpuTime / 10.0 / ullIOCount);
+    }
+    if (ullCpuTime > 0)
+    {
+        _Print("<IOsPerCpuSecond>%.0f</IOsPerCpuSecond>\n", ullIOCount / (ullCpuTime / 10000000.0));
+    }
+    _Print("</CpuEfficiency>\n");
+}
+
+void XmlResultParser::_PrintLatencySampling(const TimeSpan& timeSpan, const Results& results)
+{
+    Histogram<float> totalLatencyHistogram;
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
             totalLatencyHistogram.Merge(target.readLatencyHistogram);
+            totalLatencyHistogram.Merge(target.writeLatencyHistogram);
         }
     }
 
-    _Print("<Latency>\n");
+    UINT64 ullSampleCount = totalLatencyHistogram.GetSampleSize();
+
+    _Print("<LatencySampling>\n");
+    _Print("<SampleRate>%u</SampleRate>\n", timeSpan.GetLatencySampleRate());
+    _Print("<SampleCount>%I64u</SampleCount>\n", ullSampleCount);
+    if (ullSampleCount > 0)
+    {
+        // 95% confidence bounds of the total latency percentiles
+        vector<pair<int, double>> vPercentiles;
+        vPercentiles.push_back(make_pair(0, 25));
+        vPercentiles.push_back(make_pair(0, 50));
+        vPercentiles.push_back(make_pair(0, 75));
+        vPercentiles.push_back(make_pair(0, 90));
+        vPercentiles.push_back(make_pair(0, 95));
+        vPercentiles.push_back(make_pair(0, 99));
+        vPercentiles.push_back(make_pair(1, 99.9));
+        vPercentiles.push_back(make_pair(2, 99.99));
+        vPercentiles.push_back(make_pair(3, 99.999));
+
+        for (auto p : vPercentiles)
+        {
+            _Print("<Bucket>\n");
+            _Print("<Percentile>%.*f</Percentile>\n", p.first, p.second);
+            _Print("<LowerMilliseconds>%.3f</LowerMilliseconds>\n", totalLatencyHistogram.GetPercentile(Util::PercentileConfidenceBound(p.second / 100, ullSampleCount, -1.96)) / 1000);
+            _Print("<TotalMilliseconds>%.3f</TotalMilliseconds>\n", totalLatencyHistogram.GetPercentile(p.second / 100) / 1000);
+            _Print("<UpperMilliseconds>%.3f</UpperMilliseconds>\n", totalLatencyHistogram.GetPercentile(Util::PercentileConfidenceBound(p.second / 100, ullSampleCount, 1.96)) / 1000);
+            _Print("</Bucket>\n");
+        }
+    }
+    _Print("</LatencySampling>\n");
+}
+
+void XmlResultParser::_PrintBufferWorkingSet(const SystemInformation& system, const TimeSpan& timeSpan, const Results& results)
+{
+    bool fWorkingSet = false;
+    for (const auto& target : timeSpan.GetTargets())
+    {
+        fWorkingSet = fWorkingSet || (target.GetBufferWorkingSetSize() > 0);
+    }
+    if (!fWorkingSet)
+    {
+        return;
+    }
+
+    UINT64 ullBufferBytes = 0;
+    for (const auto& threadResults : results.vThreadResults)
+    {
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            ullBufferBytes += targetResults.ullDataBufferBytes;
+        }
+    }
+
+    _Print("<BufferWorkingSet>\n");
+    _Print("<Bytes>%I64u</Bytes>\n", ullBufferBytes);
+    if (system.processorTopology._ullL3CacheBytes > 0)
+    {
+        _Print("<L3CacheBytes>%I64u</L3CacheBytes>\n", system.processorTopology._ullL3CacheBytes);
+    }
+    _Print("</BufferWorkingSet>\n");
+}
+
+void XmlResultParser::_PrintFileLayout(const Results& results)
+{
+    _Print("<FileLayout>\n");
+    for (const auto& layout : results.vTargetLayouts)
+    {
+        _Print("<File>\n");
+        _Print("<Path>%s</Path>\n", layout.sPath.c_str());
+        _Print("<ClusterBytes>%I64u</ClusterBytes>\n", layout.ullClusterBytes);
+        _Print("<ExtentCount>%I64u</ExtentCount>\n", layout.ullExtentCount);
+        _Print("<AllocatedBytes>%I64u</AllocatedBytes>\n", layout.ullAllocatedBytes);
+        _Print("<LargestExtentBytes>%I64u</LargestExtentBytes>\n", layout.ullLargestExtentBytes);
+        for (const auto& extent : layout.vExtents)
+        {
+            _Print("<Extent FileOffset=\"%I64u\" Lcn=\"%I64d\" Bytes=\"%I64u\"/>\n",
+                extent.ullFileOffset,
+                extent.llLcn,
+                extent.ullBytes);
+        }
+        _Print("</File>\n");
+    }
+    _Print("</FileLayout>\n");
+}
+
+void XmlResultParser::_PrintDeviceStatistics(const Results& results, UINT32 bucketTimeInMs)
+{
+    _Print("<Devices>\n");
+    for (const auto& deviceResults : results.vDeviceResults)
+    {
+        const DeviceStatistics& stats = deviceResults.stats;
+
+        UINT64 ullAppReadCount = 0;
+        UINT64 ullAppWriteCount = 0;
+        for (const auto& threadResults : results.vThreadResults)
+        {
+            for (const auto& targetResults : threadResults.vTargetResults)
+            {
+                if (find(deviceResults.vTargetPaths.begin(), deviceResults.vTargetPaths.end(), targetResults.sPath) != deviceResults.vTargetPaths.end())
+                {
+                    ullAppReadCount += targetResults.ullReadIOCount;
+                    ullAppWriteCount += targetResults.ullWriteIOCount;
+                }
+            }
+        }
+
+        _Print("<Device>\n");
+        _Print("<Path>%s</Path>\n", deviceResults.sPath.c_str());
+        for (const auto& sTargetPath : deviceResults.vTargetPaths)
+        {
+            _Print("<Target>%s</Target>\n", sTargetPath.c_str());
+        }
+        _Print("<ReadCount>%I64u</ReadCount>\n", stats.ullReadCount);
+        _Print("<WriteCount>%I64u</WriteCount>\n", stats.ullWriteCount);
+        _Print("<BytesRead>%I64u</BytesRead>\n", stats.ullBytesRead);
+        _Print("<BytesWritten>%I64u</BytesWritten>\n", stats.ullBytesWritten);
+        _Print("<SplitCount>%I64u</SplitCount>\n", stats.ullSplitCount);
+        if (stats.ullReadCount > 0)
+        {
+            _Print("<AverageReadMilliseconds>%.3f</AverageReadMilliseconds>\n", (double)stats.ullReadTime / stats.ullReadCount / 10000);
+        }
+        if (stats.ullWriteCount > 0)
+        {
+            _Print("<AverageWriteMilliseconds>%.3f</AverageWriteMilliseconds>\n", (double)stats.ullWriteTime / stats.ullWriteCount / 10000);
+        }
+        if (stats.ullQueryTime > 0 && stats.ullIdleTime <= stats.ullQueryTime)
+        {
+            _Print("<UtilizationPercent>%.2f</UtilizationPercent>\n", 100.0 * (1.0 - (double)stats.ullIdleTime / stats.ullQueryTime));
+        }
+        _Print("<QueueDepth>%u</QueueDepth>\n", stats.dwQueueDepth);
+        _Print("<ApplicationReadCount>%I64u</ApplicationReadCount>\n", ullAppReadCount);
+        _Print("<ApplicationWriteCount>%I64u</ApplicationWriteCount>\n", ullAppWriteCount);
+        for (size_t i = 0; i < deviceResults.vBuckets.size(); i++)
+        {
+            const DeviceStatistics& bucket = deviceResults.vBuckets[i];
+            _Print("<Bucket SampleMillisecond=\"%lu\" Read=\"%I64u\" Write=\"%I64u\" BytesRead=\"%I64u\" BytesWritten=\"%I64u\"/>\n",
+                bucketTimeInMs * (i + 1),
+                bucket.ullReadCount,
+                bucket.ullWriteCount,
+                bucket.ullBytesRead,
+                bucket.ullBytesWritten);
+        }
+        _Print("</Device>\n");
+    }
+    _Print("</Devices>\n");
+}
+
+void XmlResultParser::_PrintThreadSchedulingDelay(const ThreadResults& threadResults, UINT64 ullTimeCount, UINT32 bucketTimeInMs)
+{
+    UINT64 ullIOCount = 0;
+    for (const auto& targetResults : threadResults.vTargetResults)
+    {
+        ullIOCount += targetResults.ullIOCount;
+    }
+
+    _Print("<SchedulingDelay>\n");
+    _Print("<Milliseconds>%.3f</Milliseconds>\n", PerfTimer::PerfTimeToMilliseconds(threadResults.ullSchedulingDelay));
+    if (ullTimeCount > 0)
+    {
+        _Print("<PercentOfTime>%.2f</PercentOfTime>\n", 100.0 * threadResults.ullSchedulingDelay / ullTimeCount);
+    }
+    if (ullIOCount > 0)
+    {
+        _Print("<MicrosecondsPerIO>%.2f</MicrosecondsPerIO>\n", PerfTimer::PerfTimeToMicroseconds(threadResults.ullSchedulingDelay) / ullIOCount);
+    }
+    _Print("<Significant>%s</Significant>\n", threadResults.IsSchedulingDelaySignificant(ullTimeCount) ? "true" : "false");
+    for (size_t i = 0; i < threadResults.vullSchedulingDelayBuckets.size(); i++)
+    {
+        _Print("<Bucket SampleMillisecond=\"%lu\" Milliseconds=\"%.3f\"/>\n",
+            bucketTimeInMs * (i + 1),
+            PerfTimer::PerfTimeToMilliseconds(threadResults.vullSchedulingDelayBuckets[i]));
+    }
+    _Print("</SchedulingDelay>\n");
+}
+
+void XmlResultParser::_PrintThreadHardwareCounters(const ThreadResults& threadResults)
+{
+    _Print("<HardwareCounters>\n");
+    _Print("<Available>%s</Available>\n", threadResults.fHardwareCountersAvailable ? "true" : "false");
+    if (threadResults.fHardwareCountersAvailable)
+    {
+        UINT64 ullIOCount = 0;
+        for (const auto& targetResults : threadResults.vTargetResults)
+        {
+            ullIOCount += targetResults.ullIOCount;
+        }
+
+        _Print("<InstructionsRetired>%I64u</InstructionsRetired>\n", threadResults.ullInstructionsRetired);
+        _Print("<CoreCycles>%I64u</CoreCycles>\n", threadResults.ullCoreCycles);
+        _Print("<ReferenceCycles>%I64u</ReferenceCycles>\n", threadResults.ullReferenceCycles);
+        if (ullIOCount > 0)
+        {
+            _Print("<InstructionsPerIO>%.0f</InstructionsPerIO>\n", (double)threadResults.ullInstructionsRetired / ullIOCount);
+            _Print("<CoreCyclesPerIO>%.0f</CoreCyclesPerIO>\n", (double)threadResults.ullCoreCycles / ullIOCount);
+            _Print("<ReferenceCyclesPerIO>%.0f</ReferenceCyclesPerIO>\n", (double)threadResults.ullReferenceCycles / ullIOCount);
+        }
+    }
+    _Print("</HardwareCounters>\n");
+}
+
+void XmlResultParser::_PrintThreadCycleProfile(const ThreadResults& threadResults)
+{
+    UINT64 ullIOCount = 0;
+    for (const auto& targetResults : threadResults.vTargetResults)
+    {
+        ullIOCount += targetResults.ullIOCount;
+    }
+
+    const char *vszPhaseNames[] = { "Throttle", "IoType", "Submit", "Wait", "Accounting", "Offset", "Process", "FileOpen" };
+    static_assert(_countof(vszPhaseNames) == static_cast<int>(WorkerPhase::Count), "every worker phase needs a name");
+
+    _Print("<CyclesPerIO>\n");
+    for (int i = 0; i < static_cast<int>(WorkerPhase::Count); i++)
+    {
+        _Print("<%s>%.0f</%s>\n",
+               vszPhaseNames[i],
+               (ullIOCount > 0) ? (double)threadResults.vullPhaseCycles[i] / ullIOCount : 0,
+               vszPhaseNames[i]);
+    }
+    _Print("</CyclesPerIO>\n");
+}
+
+void XmlResultParser::_PrintLatencyBreakdown(const Results& results)
+{
+    Histogram<float> readSubmitLatencyHistogram;
+    Histogram<float> writeSubmitLatencyHistogram;
+    Histogram<float> readServiceLatencyHistogram;
+    Histogram<float> writeServiceLatencyHistogram;
+    Histogram<float> readDispatchLatencyHistogram;
+    Histogram<float> writeDispatchLatencyHistogram;
+
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            readSubmitLatencyHistogram.Merge(target.readSubmitLatencyHistogram);
+            writeSubmitLatencyHistogram.Merge(target.writeSubmitLatencyHistogram);
+            readServiceLatencyHistogram.Merge(target.readServiceLatencyHistogram);
+            writeServiceLatencyHistogram.Merge(target.writeServiceLatencyHistogram);
+            readDispatchLatencyHistogram.Merge(target.readDispatchLatencyHistogram);
+            writeDispatchLatencyHistogram.Merge(target.writeDispatchLatencyHistogram);
+        }
+    }
+
+    // synchronous IO has no separate submission and completion
+    if (readSubmitLatencyHistogram.GetSampleSize() == 0 && writeSubmitLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    _Print("<LatencyBreakdown>\n");
+    _Print("<Submit>\n");
+    _PrintLatencyHistograms(readSubmitLatencyHistogram, writeSubmitLatencyHistogram);
+    _Print("</Submit>\n");
+    _Print("<Service>\n");
+    _PrintLatencyHistograms(readServiceLatencyHistogram, writeServiceLatencyHistogram);
+    _Print("</Service>\n");
+    _Print("<Dispatch>\n");
+    _PrintLatencyHistograms(readDispatchLatencyHistogram, writeDispatchLatencyHistogram);
+    _Print("</Dispatch>\n");
+    _Print("</LatencyBreakdown>\n");
+}
+
+void XmlResultParser::_PrintLatencyBuckets(const Histogram<float>& latencyHistogram)
+{
+    _Print("<Bucket>\n");
+    _Print("<Percentile>0</Percentile>\n");
+    _Print("<Milliseconds>%.3f</Milliseconds>\n", latencyHistogram.GetMin() / 1000);
+    _Print("</Bucket>\n");
+    for (int p = 1; p <= 99; p++)
+    {
+        _Print("<Bucket>\n");
+        _Print("<Percentile>%d</Percentile>\n", p);
+        _Print("<Milliseconds>%.3f</Milliseconds>\n", latencyHistogram.GetPercentile(p) / 1000);
+        _Print("</Bucket>\n");
+    }
+    _Print("<Bucket>\n");
+    _Print("<Percentile>99.9</Percentile>\n");
+    _Print("<Milliseconds>%.3f</Milliseconds>\n", latencyHistogram.GetPercentile(0.999) / 1000);
+    _Print("</Bucket>\n");
+    _Print("<Bucket>\n");
+    _Print("<Percentile>100</Percentile>\n");
+    _Print("<Milliseconds>%.3f</Milliseconds>\n", latencyHistogram.GetMax() / 1000);
+    _Print("</Bucket>\n");
+}
+
+void XmlResultParser::_PrintFlushes(const Results& results)
+{
+    Histogram<float> flushLatencyHistogram;
+    Histogram<float> overlapLatencyHistogram;
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            flushLatencyHistogram.Merge(target.flushLatencyHistogram);
+            overlapLatencyHistogram.Merge(target.flushOverlapLatencyHistogram);
+        }
+    }
+    if (flushLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("<Flushes>\n");
+    _Print("<Count>%u</Count>\n", flushLatencyHistogram.GetSampleSize());
+    _Print("<FlushesPerSecond>%.2f</FlushesPerSecond>\n", (fTime > 0) ? flushLatencyHistogram.GetSampleSize() / fTime : 0);
+    _Print("<AverageMilliseconds>%.3f</AverageMilliseconds>\n", flushLatencyHistogram.GetAvg() / 1000);
+    _Print("<LatencyStdev>%.3f</LatencyStdev>\n", flushLatencyHistogram.GetStandardDeviation() / 1000);
+    _PrintLatencyBuckets(flushLatencyHistogram);
+    if (overlapLatencyHistogram.GetSampleSize() > 0)
+    {
+        _Print("<OverlappingIO>\n");
+        _Print("<Count>%u</Count>\n", overlapLatencyHistogram.GetSampleSize());
+        _Print("<AverageMilliseconds>%.3f</AverageMilliseconds>\n", overlapLatencyHistogram.GetAvg() / 1000);
+        _Print("<LatencyStdev>%.3f</LatencyStdev>\n", overlapLatencyHistogram.GetStandardDeviation() / 1000);
+        _PrintLatencyBuckets(overlapLatencyHistogram);
+        _Print("</OverlappingIO>\n");
+    }
+    _Print("</Flushes>\n");
+}
+
+void XmlResultParser::_PrintGroupCommit(const Results& results)
+{
+    Histogram<float> commitLatencyHistogram;
+    UINT64 ullAppendCount = 0;
+    UINT64 ullAppendRecordCount = 0;
+    UINT64 ullAppendBytes = 0;
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            if (target.ullCommitCount == 0 && target.ullLogAppendCount == 0)
+            {
+                continue;
+            }
+            commitLatencyHistogram.Merge(target.commitLatencyHistogram);
+            ullAppendCount += target.ullLogAppendCount;
+            ullAppendRecordCount += target.ullLogAppendRecordCount;
+            ullAppendBytes += target.ullWriteBytesCount;
+        }
+    }
+    if (commitLatencyHistogram.GetSampleSize() == 0)
+    {
+        return;
+    }
+
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("<GroupCommit>\n");
+    _Print("<Commits>%u</Commits>\n", commitLatencyHistogram.GetSampleSize());
+    _Print("<CommitsPerSecond>%.2f</CommitsPerSecond>\n", (fTime > 0) ? commitLatencyHistogram.GetSampleSize() / fTime : 0);
+    _Print("<Appends>%I64u</Appends>\n", ullAppendCount);
+    _Print("<AppendsPerSecond>%.2f</AppendsPerSecond>\n", (fTime > 0) ? ullAppendCount / fTime : 0);
+    _Print("<RecordsPerAppend>%.2f</RecordsPerAppend>\n", (ullAppendCount > 0) ? (double)ullAppendRecordCount / ullAppendCount : 0);
+    _Print("<BytesPerAppend>%.0f</BytesPerAppend>\n", (ullAppendCount > 0) ? (double)ullAppendBytes / ullAppendCount : 0);
+    _Print("<AverageMilliseconds>%.3f</AverageMilliseconds>\n", commitLatencyHistogram.GetAvg() / 1000);
+    _Print("<LatencyStdev>%.3f</LatencyStdev>\n", commitLatencyHistogram.GetStandardDeviation() / 1000);
+    _PrintLatencyBuckets(commitLatencyHistogram);
+    _Print("</GroupCommit>\n");
+}
+
+void XmlResultParser::_PrintMetadata(const Results& results)
+{
+    const int cTypes = static_cast<int>(MetadataOperation::Count);
+    Histogram<float> vLatencyHistograms[cTypes];
+    UINT64 ullTotalCount = 0;
+    for (const auto& thread : results.vThreadResults)
+    {
+        for (const auto& target : thread.vTargetResults)
+        {
+            for (int iType = 0; iType < cTypes; iType++)
+            {
+                vLatencyHistograms[iType].Merge(target.vMetadataLatencyHistograms[iType]);
+                ullTotalCount += target.vullMetadataCount[iType];
+            }
+        }
+    }
+    if (ullTotalCount == 0)
+    {
+        return;
+    }
+
+    double fTime = PerfTimer::PerfTimeToSeconds(results.ullTimeCount);
+
+    _Print("<MetadataOperations>\n");
+    for (int iType = 0; iType < cTypes; iType++)
+    {
+        const Histogram<float>& latencyHistogram = vLatencyHistograms[iType];
+        if (latencyHistogram.GetSampleSize() == 0)
+        {
+            continue;
+        }
+
+        _Print("<Operation>\n");
+        _Print("<Type>%s</Type>\n", MetadataWorker::GetOperationName(static_cast<MetadataOperation>(iType)));
+        _Print("<Count>%u</Count>\n", latencyHistogram.GetSampleSize());
+        _Print("<OperationsPerSecond>%.2f</OperationsPerSecond>\n", (fTime > 0) ? latencyHistogram.GetSampleSize() / fTime : 0);
+        _Print("<AverageMilliseconds>%.3f</AverageMilliseconds>\n", latencyHistogram.GetAvg() / 1000);
+        _Print("<LatencyStdev>%.3f</LatencyStdev>\n", latencyHistogram.GetStandardDeviation() / 1000);
+        _PrintLatencyBuckets(latencyHistogram);
+        _Print("</Operation>\n");
+    }
+    _Print("</MetadataOperations>\n");
+}
+
+void XmlResultParser::_PrintLatencyHistograms(const Histogram<float>& readLatencyHistogram, const Histogram<float>& writeLatencyHistogram)
+{
+    Histogram<float> totalLatencyHistogram;
+    totalLatencyHistogram.Merge(readLatencyHistogram);
+    totalLatencyHistogram.Merge(writeLatencyHistogram);
+
     if (readLatencyHistogram.GetSampleSize() > 0)
     {
         _Print("<AverageReadMilliseconds>%.3f</AverageReadMilliseconds>\n", readLatencyHistogram.GetAvg() / 1000);
@@ -393,7 +981,6 @@ void XmlResultParser::_PrintLatencyPercentiles(const Results& results)
         _Print("<TotalMilliseconds>%.3f</TotalMilliseconds>\n", totalLatencyHistogram.GetMax() / 1000);
     }
     _Print("</Bucket>\n");
-    _Print("</Latency>\n");
 }
 
 string XmlResultParser::ParseResults(Profile& profile, const SystemInformation& system, vector<Results> vResults)
@@ -422,32 +1009,171 @@ string XmlResultParser::ParseResults(Profile& profile, const SystemInformation&
             _Print("<ProcCount>%u</ProcCount>\n", ulProcCount);
 
             _PrintCpuUtilization(results);
+            if (timeSpan.GetCpuEfficiency() && results.fPageFaultCountAvailable)
+            {
+                _Print("<ProcessPageFaults>%I64u</ProcessPageFaults>\n", results.ullPageFaultCount);
+            }
+            _PrintBufferWorkingSet(system, timeSpan, results);
 
             if (timeSpan.GetMeasureLatency())
             {
                 _PrintLatencyPercentiles(results);
+                if (timeSpan.GetLatencySampleRate() > 1)
+                {
+                    _PrintLatencySampling(timeSpan, results);
+                }
+                _PrintCorrectedLatencyPercentiles(results);
+                _PrintLatencyBreakdown(results);
             }
 
+            _PrintMetadata(results);
+            _PrintFlushes(results);
+            _PrintGroupCommit(results);
+
             if (timeSpan.GetCalculateIopsStdDev())
             {
                 _PrintOverallIops(results, timeSpan.GetIoBucketDurationInMilliseconds());
             }
 
+            if (timeSpan.GetDeviceStatistics())
+            {
+                _PrintDeviceStatistics(results, timeSpan.GetIoBucketDurationInMilliseconds());
+            }
+
+            if (results.vTargetLayouts.size() > 0)
+            {
+                _PrintFileLayout(results);
+            }
+
             if (results.fUseETW)
             {
                 _PrintETW(results.EtwMask, results.EtwEventCounters);
                 _PrintETWSessionInfo(results.EtwSessionInfo);
             }
 
+            // the size of the buffers is only of interest with a buffer working set, and the pages backing
+            // them when large or locked pages were asked for
+            bool fWorkingSet = false;
+            bool fPinnedBuffers = false;
+            for (const auto& target : timeSpan.GetTargets())
+            {
+                fWorkingSet = fWorkingSet || (target.GetBufferWorkingSetSize() > 0);
+                fPinnedBuffers = fPinnedBuffers || target.GetUseLargePages() || target.GetLockBuffers();
+            }
+
             for (size_t iThread = 0; iThread < results.vThreadResults.size(); iThread++)
             {
                 const ThreadResults& threadResults = results.vThreadResults[iThread];
                 _Print("<Thread>\n");
                 _Print("<Id>%u</Id>\n", iThread);
+                if (!timeSpan.GetDisableAffinity())
+                {
+                    _Print("<Group>%u</Group>\n", threadResults.wGroupNum);
+                    _Print("<Processor>%u</Processor>\n", threadResults.bProcNum);
+                    if (threadResults.dwNumaNode != NUMA_NO_NODE)
+                    {
+                        _Print("<NumaNode>%u</NumaNode>\n", threadResults.dwNumaNode);
+                    }
+                }
+                if (timeSpan.GetCpuEfficiency() && results.fThreadCpuTimesAvailable)
+                {
+                    _PrintThreadCpuEfficiency(threadResults);
+                }
+                if (timeSpan.GetProfileCpuCycles())
+                {
+                    _PrintThreadCycleProfile(threadResults);
+                }
+                if (timeSpan.GetHardwareCounters())
+                {
+                    _PrintThreadHardwareCounters(threadResults);
+                }
+                if (timeSpan.GetSchedulingDelay())
+                {
+                    _PrintThreadSchedulingDelay(threadResults, results.ullTimeCount, timeSpan.GetIoBucketDurationInMilliseconds());
+                }
                 for (const auto& targetResults : threadResults.vTargetResults)
                 {
                     _Print("<Target>\n");
                     _PrintTargetResults(targetResults);
+                    if (targetResults.dwDeviceNumaNode != NUMA_NO_NODE)
+                    {
+                        _Print("<DeviceNumaNode>%u</DeviceNumaNode>\n", targetResults.dwDeviceNumaNode);
+                        if (threadResults.dwNumaNode != NUMA_NO_NODE)
+                        {
+                            _Print("<NumaPlacement>%s</NumaPlacement>\n", (threadResults.dwNumaNode == targetResults.dwDeviceNumaNode) ? "Local" : "Remote");
+                        }
+                    }
+                    if (targetResults.ullWorkBytes > 0)
+                    {
+                        _Print("<WorkStage>\n");
+                        _Print("<Bytes>%I64u</Bytes>\n", targetResults.ullWorkBytes);
+                        _Print("<Milliseconds>%.3f</Milliseconds>\n", PerfTimer::PerfTimeToMilliseconds(targetResults.ullWorkTime));
+                        _Print("<CyclesPerByte>%.2f</CyclesPerByte>\n", (double)targetResults.ullWorkCycles / targetResults.ullWorkBytes);
+                        _Print("</WorkStage>\n");
+                    }
+                    if (targetResults.ullWriteFillCount > 0)
+                    {
+                        _Print("<WriteDataFill>\n");
+                        _Print("<Writes>%I64u</Writes>\n", targetResults.ullWriteFillCount);
+                        _Print("<Bytes>%I64u</Bytes>\n", targetResults.ullWriteFillBytes);
+                        _Print("<Milliseconds>%.3f</Milliseconds>\n", PerfTimer::PerfTimeToMilliseconds(targetResults.ullWriteFillTime));
+                        _Print("</WriteDataFill>\n");
+                    }
+                    if (targetResults.ullFileOpenCount + targetResults.ullHandleCacheHitCount > 0)
+                    {
+                        _Print("<FileSet>\n");
+                        _Print("<Opens>%I64u</Opens>\n", targetResults.ullFileOpenCount);
+                        _Print("<OpenMilliseconds>%.3f</OpenMilliseconds>\n", PerfTimer::PerfTimeToMilliseconds(targetResults.ullFileOpenTime));
+                        _Print("<Closes>%I64u</Closes>\n", targetResults.ullFileCloseCount);
+                        _Print("<CloseMilliseconds>%.3f</CloseMilliseconds>\n", PerfTimer::PerfTimeToMilliseconds(targetResults.ullFileCloseTime));
+                        _Print("<HandleCacheHits>%I64u</HandleCacheHits>\n", targetResults.ullHandleCacheHitCount);
+                        _Print("</FileSet>\n");
+                    }
+                    if (targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Create)] +
+                        targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Stat)] +
+                        targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Open)] +
+                        targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Rename)] +
+                        targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Unlink)] > 0)
+                    {
+                        _Print("<Metadata>\n");
+                        _Print("<Creates>%I64u</Creates>\n", targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Create)]);
+                        _Print("<Stats>%I64u</Stats>\n", targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Stat)]);
+                        _Print("<Opens>%I64u</Opens>\n", targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Open)]);
+                        _Print("<Renames>%I64u</Renames>\n", targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Rename)]);
+                        _Print("<Unlinks>%I64u</Unlinks>\n", targetResults.vullMetadataCount[static_cast<int>(MetadataOperation::Unlink)]);
+                        _Print("</Metadata>\n");
+                    }
+                    if (targetResults.ullCommitCount > 0 || targetResults.ullLogAppendCount > 0)
+                    {
+                        _Print("<GroupCommit>\n");
+                        _Print("<Commits>%I64u</Commits>\n", targetResults.ullCommitCount);
+                        _Print("<AverageMilliseconds>%.3f</AverageMilliseconds>\n", targetResults.commitLatencyHistogram.GetSampleSize() > 0 ? targetResults.commitLatencyHistogram.GetAvg() / 1000 : 0);
+                        _Print("<Appends>%I64u</Appends>\n", targetResults.ullLogAppendCount);
+                        _Print("<AppendedRecords>%I64u</AppendedRecords>\n", targetResults.ullLogAppendRecordCount);
+                        _Print("</GroupCommit>\n");
+                    }
+                    if (targetResults.ullFlushCount > 0)
+                    {
+                        _Print("<Flush>\n");
+                        _Print("<Count>%I64u</Count>\n", targetResults.ullFlushCount);
+                        _Print("<AverageMilliseconds>%.3f</AverageMilliseconds>\n", targetResults.flushLatencyHistogram.GetAvg() / 1000);
+                        _Print("</Flush>\n");
+                    }
+                    _PrintTargetVerification(targetResults);
+                    if (fWorkingSet)
+                    {
+                        _Print("<BufferBytes>%I64u</BufferBytes>\n", targetResults.ullDataBufferBytes);
+                    }
+                    if (fPinnedBuffers)
+                    {
+                        _Print("<BufferPageSize>%I64u</BufferPageSize>\n", targetResults.ullDataBufferPageSize);
+                        _Print("<BufferLocked>%s</BufferLocked>\n", targetResults.fDataBufferLocked ? "true" : "false");
+                        if (targetResults.ullWriteBufferPageSize > 0)
+                        {
+                            _Print("<WriteBufferPageSize>%I64u</WriteBufferPageSize>\n", targetResults.ullWriteBufferPageSize);
+                            _Print("<WriteBufferLocked>%s</WriteBufferLocked>\n", targetResults.fWriteBufferLocked ? "true" : "false");
+                        }
+                    }
                     if (timeSpan.GetMeasureLatency())
                     {
                         _PrintTargetLatency(targetResults);